@@ -0,0 +1,44 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+#pragma once
+#include "cpu/vision.h"
+
+#ifdef WITH_CUDA
+#include "cuda/vision.h"
+#endif
+
+
+// BoxCoder.encode in a single pass. CPU only.
+at::Tensor BoxEncode(const at::Tensor& reference_boxes,
+                     const at::Tensor& proposals,
+                     const std::vector<double>& weights) {
+  if (proposals.type().is_cuda()) {
+    AT_ERROR("Not implemented on the GPU");
+  }
+  return BoxEncode_cpu(reference_boxes, proposals, weights);
+}
+
+// BoxCoder.decode in a single pass. CPU only.
+at::Tensor BoxDecode(const at::Tensor& rel_codes,
+                     const at::Tensor& boxes,
+                     const std::vector<double>& weights,
+                     const float bbox_xform_clip) {
+  if (rel_codes.type().is_cuda()) {
+    AT_ERROR("Not implemented on the GPU");
+  }
+  return BoxDecode_cpu(rel_codes, boxes, weights, bbox_xform_clip);
+}
+
+// BoxCoder.decode, clip_to_image and remove_small_boxes in a single pass,
+// returning the kept boxes and their indices. CPU only.
+std::tuple<at::Tensor, at::Tensor> BoxDecodeClip(const at::Tensor& rel_codes,
+                                                 const at::Tensor& boxes,
+                                                 const std::vector<double>& weights,
+                                                 const float bbox_xform_clip,
+                                                 const int image_width,
+                                                 const int image_height,
+                                                 const float min_size) {
+  if (rel_codes.type().is_cuda()) {
+    AT_ERROR("Not implemented on the GPU");
+  }
+  return BoxDecodeClip_cpu(rel_codes, boxes, weights, bbox_xform_clip, image_width, image_height, min_size);
+}
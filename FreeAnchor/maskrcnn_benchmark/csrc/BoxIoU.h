@@ -0,0 +1,67 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+#pragma once
+#include "cpu/vision.h"
+
+#ifdef WITH_CUDA
+#include "cuda/vision.h"
+#endif
+
+
+// Pairwise IoU of two sets of boxes, or their block IoU. CPU only.
+at::Tensor BoxIoU(const at::Tensor& boxes1,
+                  const at::Tensor& boxes2,
+                  const bool block) {
+  if (boxes1.type().is_cuda()) {
+    AT_ERROR("Not implemented on the GPU");
+  }
+  return BoxIoU_cpu(boxes1, boxes2, block);
+}
+
+// max and argmax over dim of BoxIoU, without the [N, M] matrix. CPU only.
+std::tuple<at::Tensor, at::Tensor> BoxIoUMax(const at::Tensor& boxes1,
+                                             const at::Tensor& boxes2,
+                                             const bool block,
+                                             const int dim) {
+  if (boxes1.type().is_cuda()) {
+    AT_ERROR("Not implemented on the GPU");
+  }
+  return BoxIoUMax_cpu(boxes1, boxes2, block, dim);
+}
+
+// Top k anchors of every box by IoU and their IoUs, as topk of boxlist_iou
+// without the dense IoU matrix. CPU only.
+std::tuple<at::Tensor, at::Tensor> BoxIoUTopK(const at::Tensor& boxes,
+                                              const at::Tensor& anchors,
+                                              const int k) {
+  if (boxes.type().is_cuda()) {
+    AT_ERROR("Not implemented on the GPU");
+  }
+  return BoxIoUTopK_cpu(boxes, anchors, k);
+}
+
+// Sparse (anchor, class) probabilities of the FreeAnchor negative bag. CPU only.
+std::tuple<at::Tensor, at::Tensor> BoxIoUClassProb(const at::Tensor& boxes,
+                                                   const at::Tensor& labels,
+                                                   const at::Tensor& anchors,
+                                                   const int num_classes,
+                                                   const float threshold) {
+  if (boxes.type().is_cuda()) {
+    AT_ERROR("Not implemented on the GPU");
+  }
+  return BoxIoUClassProb_cpu(boxes, labels, anchors, num_classes, threshold);
+}
+
+// Matcher on the IoU of gt_boxes and boxes, computed tile by tile without
+// the IoU matrix. CPU only.
+at::Tensor MatchBoxes(const at::Tensor& gt_boxes,
+                      const at::Tensor& boxes,
+                      const float high_threshold,
+                      const float low_threshold,
+                      const bool allow_low_quality_matches,
+                      const float low_quality_threshold) {
+  if (boxes.type().is_cuda()) {
+    AT_ERROR("Not implemented on the GPU");
+  }
+  return MatchBoxes_cpu(gt_boxes, boxes, high_threshold, low_threshold,
+                        allow_low_quality_matches, low_quality_threshold);
+}
@@ -41,6 +41,40 @@ at::Tensor ROIAlign_backward(const at::Tensor& grad,
     AT_ERROR("Not compiled with GPU support");
 #endif
   }
-  AT_ERROR("Not implemented on the CPU");
+  return ROIAlign_backward_cpu(grad, rois, spatial_scale, pooled_height, pooled_width, batch_size, channels, height, width, sampling_ratio);
 }
 
+
+// ROIAlign of every roi on its FPN level, chosen as LevelMapper does, in a
+// single pass over the rois. CPU only.
+at::Tensor MultiLevelROIAlign_forward(const std::vector<at::Tensor>& inputs,
+                                      const at::Tensor& rois,
+                                      const std::vector<double>& spatial_scales,
+                                      const int pooled_height,
+                                      const int pooled_width,
+                                      const int sampling_ratio,
+                                      const float canonical_scale,
+                                      const float canonical_level) {
+  if (rois.type().is_cuda()) {
+    AT_ERROR("Not implemented on the GPU");
+  }
+  return MultiLevelROIAlign_forward_cpu(inputs, rois, spatial_scales, pooled_height, pooled_width, sampling_ratio, canonical_scale, canonical_level);
+}
+
+std::vector<at::Tensor> MultiLevelROIAlign_backward(const at::Tensor& grad,
+                                                    const at::Tensor& rois,
+                                                    const std::vector<double>& spatial_scales,
+                                                    const int pooled_height,
+                                                    const int pooled_width,
+                                                    const int batch_size,
+                                                    const int channels,
+                                                    const std::vector<int64_t>& heights,
+                                                    const std::vector<int64_t>& widths,
+                                                    const int sampling_ratio,
+                                                    const float canonical_scale,
+                                                    const float canonical_level) {
+  if (grad.type().is_cuda()) {
+    AT_ERROR("Not implemented on the GPU");
+  }
+  return MultiLevelROIAlign_backward_cpu(grad, rois, spatial_scales, pooled_height, pooled_width, batch_size, channels, heights, widths, sampling_ratio, canonical_scale, canonical_level);
+}
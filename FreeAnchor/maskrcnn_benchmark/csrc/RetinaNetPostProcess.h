@@ -0,0 +1,32 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+#pragma once
+#include "cpu/vision.h"
+
+#ifdef WITH_CUDA
+#include "cuda/vision.h"
+#endif
+
+
+// RetinaNetPostProcessor of a batch in a single call: the detections of
+// every image as boxes, scores and labels, with counts[n] of them for
+// image n. CPU only.
+std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> RetinaNetPostProcess(
+    const std::vector<at::Tensor>& box_cls,
+    const std::vector<at::Tensor>& box_regression,
+    const std::vector<at::Tensor>& anchors,
+    const std::vector<int64_t>& image_widths,
+    const std::vector<int64_t>& image_heights,
+    const float pre_nms_thresh,
+    const int pre_nms_top_n,
+    const float nms_thresh,
+    const int fpn_post_nms_top_n,
+    const float min_size,
+    const std::vector<double>& weights,
+    const float bbox_xform_clip) {
+  if (box_cls[0].type().is_cuda()) {
+    AT_ERROR("Not implemented on the GPU");
+  }
+  return RetinaNetPostProcess_cpu(box_cls, box_regression, anchors, image_widths, image_heights,
+                                  pre_nms_thresh, pre_nms_top_n, nms_thresh, fpn_post_nms_top_n,
+                                  min_size, weights, bbox_xform_clip);
+}
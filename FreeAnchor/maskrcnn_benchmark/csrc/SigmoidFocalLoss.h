@@ -20,7 +20,7 @@ at::Tensor SigmoidFocalLoss_forward(
     AT_ERROR("Not compiled with GPU support");
 #endif
   }
-  AT_ERROR("Not implemented on the CPU");
+  return SigmoidFocalLoss_forward_cpu(logits, targets, num_classes, gamma, alpha);
 }
 
 at::Tensor SigmoidFocalLoss_backward(
@@ -37,5 +37,19 @@ at::Tensor SigmoidFocalLoss_backward(
     AT_ERROR("Not compiled with GPU support");
 #endif
   }
-  AT_ERROR("Not implemented on the CPU");
+  return SigmoidFocalLoss_backward_cpu(logits, targets, d_losses, num_classes, gamma, alpha);
+}
+
+// Summed loss and its gradient in a single pass, CPU only
+std::tuple<at::Tensor, at::Tensor> SigmoidFocalLoss_fused(
+		const at::Tensor& logits,
+                const at::Tensor& targets,
+		const int num_classes,
+		const float gamma,
+		const float alpha,
+		const bool compute_grad) {
+  if (logits.type().is_cuda()) {
+    AT_ERROR("Not implemented on the GPU");
+  }
+  return SigmoidFocalLoss_fused_cpu(logits, targets, num_classes, gamma, alpha, compute_grad);
 }
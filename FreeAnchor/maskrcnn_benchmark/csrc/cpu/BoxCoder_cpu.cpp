@@ -0,0 +1,245 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+#include "cpu/vision.h"
+#include <ATen/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+
+
+// BoxCoder weights known at compile time, so that the divisions by them
+// are by constants: (10, 10, 5, 5) of the RPN and RetinaNet, (1, 1, 1, 1).
+template <int WX, int WY, int WW, int WH>
+struct BoxCoderFixedWeights {
+  explicit BoxCoderFixedWeights(const std::vector<double>&) {}
+  static constexpr double wx() { return WX; }
+  static constexpr double wy() { return WY; }
+  static constexpr double ww() { return WW; }
+  static constexpr double wh() { return WH; }
+};
+
+struct BoxCoderWeights {
+  explicit BoxCoderWeights(const std::vector<double>& weights)
+      : wx_(weights[0]), wy_(weights[1]), ww_(weights[2]), wh_(weights[3]) {}
+  double wx() const { return wx_; }
+  double wy() const { return wy_; }
+  double ww() const { return ww_; }
+  double wh() const { return wh_; }
+  double wx_, wy_, ww_, wh_;
+};
+
+// Runs the lambda with weights_t, the weights type matching WEIGHTS, as
+// AT_DISPATCH_FLOATING_TYPES does with scalar_t.
+#define BOX_CODER_DISPATCH_WEIGHTS(WEIGHTS, ...)                    \
+  [&] {                                                             \
+    if (WEIGHTS == std::vector<double>{10, 10, 5, 5}) {             \
+      using weights_t = BoxCoderFixedWeights<10, 10, 5, 5>;         \
+      return __VA_ARGS__();                                         \
+    } else if (WEIGHTS == std::vector<double>{1, 1, 1, 1}) {        \
+      using weights_t = BoxCoderFixedWeights<1, 1, 1, 1>;           \
+      return __VA_ARGS__();                                         \
+    } else {                                                        \
+      using weights_t = BoxCoderWeights;                            \
+      return __VA_ARGS__();                                         \
+    }                                                               \
+  }()
+
+template <typename scalar_t, typename Weights>
+void box_encode_cpu_kernel(const scalar_t* reference_boxes,
+                           const scalar_t* proposals,
+                           const int64_t num_boxes,
+                           const Weights& weights,
+                           scalar_t* targets) {
+  const scalar_t TO_REMOVE = 1;
+  const scalar_t wx = weights.wx(), wy = weights.wy(), ww = weights.ww(), wh = weights.wh();
+  at::parallel_for(0, num_boxes, 2048, [&](int64_t begin, int64_t end) {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for (int64_t i = begin; i < end; i++) {
+      const scalar_t* gt = reference_boxes + i * 4;
+      const scalar_t* ex = proposals + i * 4;
+      const scalar_t ex_width = ex[2] - ex[0] + TO_REMOVE;
+      const scalar_t ex_height = ex[3] - ex[1] + TO_REMOVE;
+      const scalar_t ex_ctr_x = ex[0] + static_cast<scalar_t>(0.5) * ex_width;
+      const scalar_t ex_ctr_y = ex[1] + static_cast<scalar_t>(0.5) * ex_height;
+      const scalar_t gt_width = gt[2] - gt[0] + TO_REMOVE;
+      const scalar_t gt_height = gt[3] - gt[1] + TO_REMOVE;
+      const scalar_t gt_ctr_x = gt[0] + static_cast<scalar_t>(0.5) * gt_width;
+      const scalar_t gt_ctr_y = gt[1] + static_cast<scalar_t>(0.5) * gt_height;
+      scalar_t* target = targets + i * 4;
+      target[0] = wx * (gt_ctr_x - ex_ctr_x) / ex_width;
+      target[1] = wy * (gt_ctr_y - ex_ctr_y) / ex_height;
+      target[2] = ww * std::log(gt_width / ex_width);
+      target[3] = wh * std::log(gt_height / ex_height);
+    }
+  });
+}
+
+// Decodes the code of one box. The divisions by the weights are kept, as
+// BoxCoder.decode does them, for the same results.
+template <typename scalar_t, typename Weights>
+inline void box_decode_one(const scalar_t* code,
+                           const scalar_t* box,
+                           const Weights& weights,
+                           const scalar_t bbox_xform_clip,
+                           scalar_t* pred) {
+  const scalar_t TO_REMOVE = 1;
+  const scalar_t width = box[2] - box[0] + TO_REMOVE;
+  const scalar_t height = box[3] - box[1] + TO_REMOVE;
+  const scalar_t ctr_x = box[0] + static_cast<scalar_t>(0.5) * width;
+  const scalar_t ctr_y = box[1] + static_cast<scalar_t>(0.5) * height;
+  const scalar_t dx = code[0] / static_cast<scalar_t>(weights.wx());
+  const scalar_t dy = code[1] / static_cast<scalar_t>(weights.wy());
+  const scalar_t dw = std::min(code[2] / static_cast<scalar_t>(weights.ww()), bbox_xform_clip);
+  const scalar_t dh = std::min(code[3] / static_cast<scalar_t>(weights.wh()), bbox_xform_clip);
+  const scalar_t pred_ctr_x = dx * width + ctr_x;
+  const scalar_t pred_ctr_y = dy * height + ctr_y;
+  const scalar_t pred_w = std::exp(dw) * width;
+  const scalar_t pred_h = std::exp(dh) * height;
+  pred[0] = pred_ctr_x - static_cast<scalar_t>(0.5) * pred_w;
+  pred[1] = pred_ctr_y - static_cast<scalar_t>(0.5) * pred_h;
+  pred[2] = pred_ctr_x + static_cast<scalar_t>(0.5) * pred_w - 1;
+  pred[3] = pred_ctr_y + static_cast<scalar_t>(0.5) * pred_h - 1;
+}
+
+template <typename scalar_t, typename Weights>
+void box_decode_cpu_kernel(const scalar_t* rel_codes,
+                           const scalar_t* boxes,
+                           const int64_t num_boxes,
+                           const int64_t num_codes,
+                           const Weights& weights,
+                           const scalar_t bbox_xform_clip,
+                           scalar_t* pred_boxes) {
+  at::parallel_for(0, num_boxes, 1024, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; i++) {
+      for (int64_t k = 0; k < num_codes; k++) {
+        const int64_t offset = (i * num_codes + k) * 4;
+        box_decode_one(rel_codes + offset, boxes + i * 4, weights, bbox_xform_clip, pred_boxes + offset);
+      }
+    }
+  });
+}
+
+// The boxes decoded, clipped as clip_to_image(remove_empty=False) and kept
+// as remove_small_boxes in place, compacted to the first rows of pred_boxes.
+// Returns the number of kept boxes, their indices in keep.
+template <typename scalar_t, typename Weights>
+int64_t box_decode_clip_cpu_kernel(const scalar_t* rel_codes,
+                                   const scalar_t* boxes,
+                                   const int64_t num_boxes,
+                                   const Weights& weights,
+                                   const scalar_t bbox_xform_clip,
+                                   const scalar_t max_x,
+                                   const scalar_t max_y,
+                                   const scalar_t min_size,
+                                   scalar_t* pred_boxes,
+                                   int64_t* keep) {
+  const scalar_t TO_REMOVE = 1;
+  std::vector<uint8_t> kept(num_boxes);
+  at::parallel_for(0, num_boxes, 1024, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; i++) {
+      scalar_t* pred = pred_boxes + i * 4;
+      box_decode_one(rel_codes + i * 4, boxes + i * 4, weights, bbox_xform_clip, pred);
+      pred[0] = std::min(std::max(pred[0], scalar_t(0)), max_x);
+      pred[1] = std::min(std::max(pred[1], scalar_t(0)), max_y);
+      pred[2] = std::min(std::max(pred[2], scalar_t(0)), max_x);
+      pred[3] = std::min(std::max(pred[3], scalar_t(0)), max_y);
+      kept[i] = pred[2] - pred[0] + TO_REMOVE >= min_size &&
+                pred[3] - pred[1] + TO_REMOVE >= min_size;
+    }
+  });
+
+  int64_t num_kept = 0;
+  for (int64_t i = 0; i < num_boxes; i++) {
+    if (kept[i]) {
+      if (num_kept != i) {
+        std::copy(pred_boxes + i * 4, pred_boxes + i * 4 + 4, pred_boxes + num_kept * 4);
+      }
+      keep[num_kept++] = i;
+    }
+  }
+  return num_kept;
+}
+
+// BoxCoder.encode of proposals with respect to reference_boxes, both Nx4.
+at::Tensor BoxEncode_cpu(const at::Tensor& reference_boxes,
+                         const at::Tensor& proposals,
+                         const std::vector<double>& weights) {
+  AT_ASSERTM(!reference_boxes.type().is_cuda(), "reference_boxes must be a CPU tensor");
+  AT_ASSERTM(!proposals.type().is_cuda(), "proposals must be a CPU tensor");
+  AT_ASSERTM(reference_boxes.type() == proposals.type(),
+             "reference_boxes should have the same type as proposals");
+  AT_ASSERTM(proposals.dim() == 2 && proposals.size(1) == 4, "proposals must be a Nx4 tensor");
+  AT_ASSERTM(reference_boxes.sizes() == proposals.sizes(),
+             "reference_boxes must have the size of proposals");
+  AT_ASSERTM(weights.size() == 4, "weights must have 4 elements");
+
+  auto reference_boxes_ = reference_boxes.contiguous();
+  auto proposals_ = proposals.contiguous();
+  at::Tensor targets = at::empty({proposals_.size(0), 4}, proposals_.options());
+  AT_DISPATCH_FLOATING_TYPES(proposals.type(), "BoxEncode", [&] {
+    BOX_CODER_DISPATCH_WEIGHTS(weights, [&] {
+      box_encode_cpu_kernel<scalar_t>(reference_boxes_.data<scalar_t>(), proposals_.data<scalar_t>(),
+                                      proposals_.size(0), weights_t(weights), targets.data<scalar_t>());
+    });
+  });
+  return targets;
+}
+
+// BoxCoder.decode of rel_codes, Nx(4K), with respect to boxes, Nx4.
+at::Tensor BoxDecode_cpu(const at::Tensor& rel_codes,
+                         const at::Tensor& boxes,
+                         const std::vector<double>& weights,
+                         const float bbox_xform_clip) {
+  AT_ASSERTM(!rel_codes.type().is_cuda(), "rel_codes must be a CPU tensor");
+  AT_ASSERTM(!boxes.type().is_cuda(), "boxes must be a CPU tensor");
+  AT_ASSERTM(rel_codes.dim() == 2 && rel_codes.size(1) % 4 == 0, "rel_codes must be a Nx(4K) tensor");
+  AT_ASSERTM(boxes.dim() == 2 && boxes.size(1) == 4 && boxes.size(0) == rel_codes.size(0),
+             "boxes must be a Nx4 tensor");
+  AT_ASSERTM(weights.size() == 4, "weights must have 4 elements");
+
+  auto rel_codes_ = rel_codes.contiguous();
+  auto boxes_ = boxes.toType(rel_codes.type()).contiguous();
+  at::Tensor pred_boxes = at::empty({rel_codes_.size(0), rel_codes_.size(1)}, rel_codes_.options());
+  AT_DISPATCH_FLOATING_TYPES(rel_codes.type(), "BoxDecode", [&] {
+    BOX_CODER_DISPATCH_WEIGHTS(weights, [&] {
+      box_decode_cpu_kernel<scalar_t>(rel_codes_.data<scalar_t>(), boxes_.data<scalar_t>(),
+                                      rel_codes_.size(0), rel_codes_.size(1) / 4, weights_t(weights),
+                                      bbox_xform_clip, pred_boxes.data<scalar_t>());
+    });
+  });
+  return pred_boxes;
+}
+
+// BoxCoder.decode of rel_codes, Nx4, then clip_to_image(remove_empty=False)
+// and remove_small_boxes, in one pass. Returns the kept boxes and their
+// indices.
+std::tuple<at::Tensor, at::Tensor> BoxDecodeClip_cpu(const at::Tensor& rel_codes,
+                                                     const at::Tensor& boxes,
+                                                     const std::vector<double>& weights,
+                                                     const float bbox_xform_clip,
+                                                     const int image_width,
+                                                     const int image_height,
+                                                     const float min_size) {
+  AT_ASSERTM(!rel_codes.type().is_cuda(), "rel_codes must be a CPU tensor");
+  AT_ASSERTM(!boxes.type().is_cuda(), "boxes must be a CPU tensor");
+  AT_ASSERTM(rel_codes.dim() == 2 && rel_codes.size(1) == 4, "rel_codes must be a Nx4 tensor");
+  AT_ASSERTM(boxes.sizes() == rel_codes.sizes(), "boxes must have the size of rel_codes");
+  AT_ASSERTM(weights.size() == 4, "weights must have 4 elements");
+
+  auto rel_codes_ = rel_codes.contiguous();
+  auto boxes_ = boxes.toType(rel_codes.type()).contiguous();
+  const int64_t num_boxes = rel_codes_.size(0);
+  at::Tensor pred_boxes = at::empty({rel_codes_.size(0), rel_codes_.size(1)}, rel_codes_.options());
+  at::Tensor keep = at::empty({num_boxes}, rel_codes.options().dtype(at::kLong));
+  int64_t num_kept = 0;
+  AT_DISPATCH_FLOATING_TYPES(rel_codes.type(), "BoxDecodeClip", [&] {
+    BOX_CODER_DISPATCH_WEIGHTS(weights, [&] {
+      num_kept = box_decode_clip_cpu_kernel<scalar_t>(
+          rel_codes_.data<scalar_t>(), boxes_.data<scalar_t>(), num_boxes, weights_t(weights), bbox_xform_clip,
+          image_width - 1, image_height - 1, min_size,
+          pred_boxes.data<scalar_t>(), keep.data<int64_t>());
+    });
+  });
+  return std::make_tuple(pred_boxes.narrow(0, 0, num_kept), keep.narrow(0, 0, num_kept));
+}
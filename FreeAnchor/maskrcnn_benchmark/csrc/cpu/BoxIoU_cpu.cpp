@@ -0,0 +1,473 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+#include "cpu/vision.h"
+#include "cpu/box_iou_tile.h"
+#include <ATen/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+
+// Largest number of grid cells along one axis of a bucket.
+constexpr int64_t boxGridMaxCells = 1024;
+
+// Uniform grid over the centers of a set of boxes. Boxes are bucketed by the
+// power of two of their larger side, and each bucket is a grid with cells
+// about the largest side of its boxes, so that the boxes that can intersect a
+// query box are found in a few cells of every bucket.
+template <typename scalar_t>
+struct BoxGrid {
+  struct Bucket {
+    scalar_t half_w = 0, half_h = 0;  // largest half extents of the bucket
+    scalar_t x0 = 0, y0 = 0, cell = 1;
+    int64_t nx = 1, ny = 1;
+    std::vector<int64_t> cell_start;  // [nx * ny + 1]
+    std::vector<int64_t> boxes;       // by cell, by increasing index within a cell
+  };
+  std::vector<Bucket> buckets;
+};
+
+template <typename scalar_t>
+BoxGrid<scalar_t> box_grid_build(const scalar_t* boxes, const int64_t num_boxes) {
+  const scalar_t TO_REMOVE = 1;
+  std::vector<int> level(num_boxes);
+  int max_level = -1;
+  for (int64_t j = 0; j < num_boxes; j++) {
+    const scalar_t* box = boxes + j * 4;
+    const scalar_t extent = std::max(box[2] - box[0], box[3] - box[1]) + TO_REMOVE;
+    level[j] = std::isfinite(extent) ? std::ilogb(std::max<scalar_t>(extent, 1)) : -1;
+    if (level[j] >= 0) {
+      max_level = std::max(max_level, level[j]);
+    }
+  }
+
+  BoxGrid<scalar_t> grid;
+  grid.buckets.resize(max_level + 1);
+  std::vector<std::vector<int64_t>> members(grid.buckets.size());
+  for (int64_t j = 0; j < num_boxes; j++) {
+    if (level[j] >= 0) {
+      members[level[j]].push_back(j);
+    }
+  }
+  for (size_t b = 0; b < grid.buckets.size(); b++) {
+    auto& bucket = grid.buckets[b];
+    if (members[b].empty()) {
+      bucket.cell_start.assign(2, 0);
+      continue;
+    }
+    scalar_t x_min = INFINITY, y_min = INFINITY, x_max = -INFINITY, y_max = -INFINITY;
+    for (auto j : members[b]) {
+      const scalar_t* box = boxes + j * 4;
+      const scalar_t cx = (box[0] + box[2]) / 2, cy = (box[1] + box[3]) / 2;
+      x_min = std::min(x_min, cx);
+      y_min = std::min(y_min, cy);
+      x_max = std::max(x_max, cx);
+      y_max = std::max(y_max, cy);
+      bucket.half_w = std::max(bucket.half_w, (box[2] - box[0] + TO_REMOVE) / 2);
+      bucket.half_h = std::max(bucket.half_h, (box[3] - box[1] + TO_REMOVE) / 2);
+    }
+    bucket.x0 = x_min;
+    bucket.y0 = y_min;
+    bucket.cell = std::max<scalar_t>({2 * std::max(bucket.half_w, bucket.half_h),
+                                      (x_max - x_min) / boxGridMaxCells,
+                                      (y_max - y_min) / boxGridMaxCells,
+                                      1});
+    bucket.nx = std::min<int64_t>(static_cast<int64_t>((x_max - x_min) / bucket.cell) + 1, boxGridMaxCells);
+    bucket.ny = std::min<int64_t>(static_cast<int64_t>((y_max - y_min) / bucket.cell) + 1, boxGridMaxCells);
+
+    // counting sort of the members by cell, stable in the box index
+    std::vector<int64_t> cells(members[b].size());
+    bucket.cell_start.assign(bucket.nx * bucket.ny + 1, 0);
+    for (size_t m = 0; m < members[b].size(); m++) {
+      const scalar_t* box = boxes + members[b][m] * 4;
+      const int64_t ix = std::min<int64_t>((((box[0] + box[2]) / 2) - bucket.x0) / bucket.cell, bucket.nx - 1);
+      const int64_t iy = std::min<int64_t>((((box[1] + box[3]) / 2) - bucket.y0) / bucket.cell, bucket.ny - 1);
+      cells[m] = iy * bucket.nx + ix;
+      bucket.cell_start[cells[m] + 1]++;
+    }
+    std::partial_sum(bucket.cell_start.begin(), bucket.cell_start.end(), bucket.cell_start.begin());
+    bucket.boxes.resize(members[b].size());
+    std::vector<int64_t> fill(bucket.cell_start.begin(), bucket.cell_start.end() - 1);
+    for (size_t m = 0; m < members[b].size(); m++) {
+      bucket.boxes[fill[cells[m]]++] = members[b][m];
+    }
+  }
+  return grid;
+}
+
+// Calls fn(j, iou) for every box j of the grid whose IoU with query, as
+// boxlist_iou computes it, is positive.
+template <typename scalar_t, typename Fn>
+void box_grid_query(const BoxGrid<scalar_t>& grid,
+                    const scalar_t* boxes,
+                    const scalar_t* query,
+                    Fn fn) {
+  const scalar_t TO_REMOVE = 1;
+  const scalar_t qx1 = query[0], qy1 = query[1], qx2 = query[2], qy2 = query[3];
+  const scalar_t query_area = (qx2 - qx1 + TO_REMOVE) * (qy2 - qy1 + TO_REMOVE);
+  for (const auto& bucket : grid.buckets) {
+    if (bucket.boxes.empty()) {
+      continue;
+    }
+    // centers of the boxes that can intersect the query, with one pixel of slack
+    const scalar_t lo_x = qx1 - bucket.half_w - TO_REMOVE, hi_x = qx2 + bucket.half_w + TO_REMOVE;
+    const scalar_t lo_y = qy1 - bucket.half_h - TO_REMOVE, hi_y = qy2 + bucket.half_h + TO_REMOVE;
+    if (!(hi_x >= bucket.x0 && hi_y >= bucket.y0)) {
+      continue;
+    }
+    const int64_t ix0 = std::max<int64_t>(std::floor((lo_x - bucket.x0) / bucket.cell), 0);
+    const int64_t iy0 = std::max<int64_t>(std::floor((lo_y - bucket.y0) / bucket.cell), 0);
+    const int64_t ix1 = std::min<int64_t>(std::floor((hi_x - bucket.x0) / bucket.cell), bucket.nx - 1);
+    const int64_t iy1 = std::min<int64_t>(std::floor((hi_y - bucket.y0) / bucket.cell), bucket.ny - 1);
+    for (int64_t iy = iy0; iy <= iy1; iy++) {
+      for (int64_t ix = ix0; ix <= ix1; ix++) {
+        const int64_t cell = iy * bucket.nx + ix;
+        for (int64_t m = bucket.cell_start[cell]; m < bucket.cell_start[cell + 1]; m++) {
+          const int64_t j = bucket.boxes[m];
+          const scalar_t* box = boxes + j * 4;
+          const scalar_t w = std::max<scalar_t>(std::min(qx2, box[2]) - std::max(qx1, box[0]) + TO_REMOVE, 0);
+          const scalar_t h = std::max<scalar_t>(std::min(qy2, box[3]) - std::max(qy1, box[1]) + TO_REMOVE, 0);
+          const scalar_t inter = w * h;
+          if (!(inter > 0)) {
+            continue;
+          }
+          const scalar_t area = (box[2] - box[0] + TO_REMOVE) * (box[3] - box[1] + TO_REMOVE);
+          fn(j, inter / (query_area + area - inter));
+        }
+      }
+    }
+  }
+}
+
+template <typename scalar_t>
+struct BoxIoUCandidate {
+  scalar_t iou;
+  int64_t index;
+};
+
+template <typename scalar_t>
+inline bool box_iou_better(const BoxIoUCandidate<scalar_t>& a,
+                           const BoxIoUCandidate<scalar_t>& b) {
+  return a.iou > b.iou || (a.iou == b.iou && a.index < b.index);
+}
+
+template <typename scalar_t>
+std::tuple<at::Tensor, at::Tensor> box_iou_topk_cpu_kernel(const at::Tensor& boxes,
+                                                           const at::Tensor& anchors,
+                                                           const int k) {
+  const int64_t num_boxes = boxes.size(0);
+  const int64_t num_anchors = anchors.size(0);
+  at::Tensor ious_t = at::empty({num_boxes, k}, boxes.options());
+  at::Tensor indices_t = at::empty({num_boxes, k}, boxes.options().dtype(at::kLong));
+  if (num_boxes == 0 || k == 0) {
+    return std::make_tuple(ious_t, indices_t);
+  }
+
+  auto boxes_data = boxes.data<scalar_t>();
+  auto anchors_data = anchors.data<scalar_t>();
+  auto ious_data = ious_t.data<scalar_t>();
+  auto indices_data = indices_t.data<int64_t>();
+  const auto grid = box_grid_build(anchors_data, num_anchors);
+
+  at::parallel_for(0, num_boxes, 1, [&](int64_t begin, int64_t end) {
+    std::vector<BoxIoUCandidate<scalar_t>> heap;
+    for (int64_t i = begin; i < end; i++) {
+      // min-heap of the k best overlapping anchors
+      heap.clear();
+      box_grid_query(grid, anchors_data, boxes_data + i * 4, [&](int64_t j, scalar_t iou) {
+        BoxIoUCandidate<scalar_t> candidate{iou, j};
+        if (heap.size() < static_cast<size_t>(k)) {
+          heap.push_back(candidate);
+          std::push_heap(heap.begin(), heap.end(), box_iou_better<scalar_t>);
+        } else if (box_iou_better(candidate, heap.front())) {
+          std::pop_heap(heap.begin(), heap.end(), box_iou_better<scalar_t>);
+          heap.back() = candidate;
+          std::push_heap(heap.begin(), heap.end(), box_iou_better<scalar_t>);
+        }
+      });
+      std::sort(heap.begin(), heap.end(), box_iou_better<scalar_t>);
+
+      // fewer than k overlapping anchors: the first ones of IoU 0
+      if (heap.size() < static_cast<size_t>(k)) {
+        std::vector<int64_t> taken;
+        for (const auto& candidate : heap) {
+          taken.push_back(candidate.index);
+        }
+        std::sort(taken.begin(), taken.end());
+        for (int64_t j = 0; heap.size() < static_cast<size_t>(k); j++) {
+          if (!std::binary_search(taken.begin(), taken.end(), j)) {
+            heap.push_back({0, j});
+          }
+        }
+      }
+      for (int c = 0; c < k; c++) {
+        ious_data[i * k + c] = heap[c].iou;
+        indices_data[i * k + c] = heap[c].index;
+      }
+    }
+  });
+  return std::make_tuple(ious_t, indices_t);
+}
+
+// Top k anchors of every box by boxlist_iou, without the dense IoU matrix.
+// Only anchors whose centers are close enough to a box to intersect it are
+// visited; ties are broken by the lower anchor index, and boxes that
+// intersect fewer than k anchors get the first other anchors, of IoU 0.
+std::tuple<at::Tensor, at::Tensor> BoxIoUTopK_cpu(const at::Tensor& boxes,
+                                                  const at::Tensor& anchors,
+                                                  const int k) {
+  AT_ASSERTM(!boxes.type().is_cuda(), "boxes must be a CPU tensor");
+  AT_ASSERTM(!anchors.type().is_cuda(), "anchors must be a CPU tensor");
+  AT_ASSERTM(boxes.type() == anchors.type(), "boxes should have the same type as anchors");
+  AT_ASSERTM(boxes.dim() == 2 && boxes.size(1) == 4, "boxes must be a Nx4 tensor");
+  AT_ASSERTM(anchors.dim() == 2 && anchors.size(1) == 4, "anchors must be a Mx4 tensor");
+  AT_ASSERTM(k >= 0 && k <= anchors.size(0), "k must be at most the number of anchors");
+
+  std::tuple<at::Tensor, at::Tensor> result;
+  AT_DISPATCH_FLOATING_TYPES(boxes.type(), "BoxIoUTopK", [&] {
+    result = box_iou_topk_cpu_kernel<scalar_t>(boxes.contiguous(), anchors.contiguous(), k);
+  });
+  return result;
+}
+
+template <typename scalar_t>
+std::tuple<at::Tensor, at::Tensor> box_iou_class_prob_cpu_kernel(const at::Tensor& boxes,
+                                                                 const at::Tensor& labels,
+                                                                 const at::Tensor& anchors,
+                                                                 const int num_classes,
+                                                                 const float threshold) {
+  const int64_t num_boxes = boxes.size(0);
+  const int64_t num_anchors = anchors.size(0);
+  auto boxes_data = boxes.data<scalar_t>();
+  auto labels_data = labels.data<int64_t>();
+  auto anchors_data = anchors.data<scalar_t>();
+  const auto grid = box_grid_build(anchors_data, num_anchors);
+
+  const scalar_t t1 = threshold;
+  const scalar_t t1_eps = static_cast<scalar_t>(threshold + 1e-12);
+
+  // (anchor * num_classes + label, prob) of every box above the threshold
+  std::vector<std::vector<std::pair<int64_t, scalar_t>>> box_probs(num_boxes);
+  at::parallel_for(0, num_boxes, 1, [&](int64_t begin, int64_t end) {
+    std::vector<BoxIoUCandidate<scalar_t>> above;
+    for (int64_t i = begin; i < end; i++) {
+      above.clear();
+      scalar_t max_iou = 0;
+      box_grid_query(grid, anchors_data, boxes_data + i * 4, [&](int64_t j, scalar_t iou) {
+        max_iou = std::max(max_iou, iou);
+        if (iou > t1) {
+          above.push_back({iou, j});
+        }
+      });
+      const scalar_t t2 = std::max(max_iou, t1_eps);
+      const int64_t label = labels_data[i];
+      for (const auto& candidate : above) {
+        const scalar_t prob = std::min<scalar_t>((candidate.iou - t1) / (t2 - t1), 1);
+        box_probs[i].emplace_back(candidate.index * num_classes + label, prob);
+      }
+    }
+  });
+
+  // max over the boxes of every (anchor, class)
+  std::vector<std::pair<int64_t, scalar_t>> probs;
+  for (auto& p : box_probs) {
+    probs.insert(probs.end(), p.begin(), p.end());
+  }
+  std::sort(probs.begin(), probs.end(), [](const std::pair<int64_t, scalar_t>& a,
+                                           const std::pair<int64_t, scalar_t>& b) {
+    return a.first < b.first;
+  });
+  std::vector<std::pair<int64_t, scalar_t>> reduced;
+  for (const auto& p : probs) {
+    if (!reduced.empty() && reduced.back().first == p.first) {
+      reduced.back().second = std::max(reduced.back().second, p.second);
+    } else {
+      reduced.push_back(p);
+    }
+  }
+
+  const int64_t num_probs = reduced.size();
+  at::Tensor indices_t = at::empty({2, num_probs}, labels.options());
+  at::Tensor values_t = at::empty({num_probs}, boxes.options());
+  auto indices_data = indices_t.data<int64_t>();
+  auto values_data = values_t.data<scalar_t>();
+  for (int64_t n = 0; n < num_probs; n++) {
+    indices_data[n] = reduced[n].first / num_classes;
+    indices_data[num_probs + n] = reduced[n].first % num_classes;
+    values_data[n] = reduced[n].second;
+  }
+  return std::make_tuple(indices_t, values_t);
+}
+
+// The negative bag probability of FreeAnchorLoss in sparse form: for every
+// box i, prob_ij = clamp((IoU_ij - t1) / (max_j IoU_ij - t1), 0, 1) with its
+// anchors j, reduced by max over the boxes of each label. Returns the
+// (anchor, class) indices [2, K], in increasing order, and the K nonzero values.
+std::tuple<at::Tensor, at::Tensor> BoxIoUClassProb_cpu(const at::Tensor& boxes,
+                                                       const at::Tensor& labels,
+                                                       const at::Tensor& anchors,
+                                                       const int num_classes,
+                                                       const float threshold) {
+  AT_ASSERTM(!boxes.type().is_cuda(), "boxes must be a CPU tensor");
+  AT_ASSERTM(!labels.type().is_cuda(), "labels must be a CPU tensor");
+  AT_ASSERTM(!anchors.type().is_cuda(), "anchors must be a CPU tensor");
+  AT_ASSERTM(boxes.type() == anchors.type(), "boxes should have the same type as anchors");
+  AT_ASSERTM(boxes.dim() == 2 && boxes.size(1) == 4, "boxes must be a Nx4 tensor");
+  AT_ASSERTM(anchors.dim() == 2 && anchors.size(1) == 4, "anchors must be a Mx4 tensor");
+  AT_ASSERTM(labels.dim() == 1 && labels.size(0) == boxes.size(0),
+             "labels must have one element per box");
+  AT_ASSERTM(labels.scalar_type() == at::kLong, "labels must be int64");
+
+  auto labels_ = labels.contiguous();
+  auto labels_data = labels_.data<int64_t>();
+  for (int64_t i = 0; i < labels_.numel(); i++) {
+    AT_ASSERTM(labels_data[i] >= 0 && labels_data[i] < num_classes, "labels out of range");
+  }
+
+  std::tuple<at::Tensor, at::Tensor> result;
+  AT_DISPATCH_FLOATING_TYPES(boxes.type(), "BoxIoUClassProb", [&] {
+    result = box_iou_class_prob_cpu_kernel<scalar_t>(
+        boxes.contiguous(), labels_, anchors.contiguous(), num_classes, threshold);
+  });
+  return result;
+}
+
+template <typename scalar_t, bool block>
+at::Tensor box_iou_cpu_kernel(const at::Tensor& boxes1, const at::Tensor& boxes2) {
+  const int64_t N = boxes1.size(0);
+  const int64_t M = boxes2.size(0);
+  at::Tensor iou_t = at::empty({N, M}, boxes1.options());
+  if (N == 0 || M == 0) {
+    return iou_t;
+  }
+  auto boxes1_data = boxes1.data<scalar_t>();
+  auto iou_data = iou_t.data<scalar_t>();
+  const auto columns = box_iou_columns(boxes2.data<scalar_t>(), M);
+
+  // threads take tiles of boxes2, every row of a tile is written in place
+  const int64_t num_tiles = (M + boxIoUTile - 1) / boxIoUTile;
+  at::parallel_for(0, num_tiles, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t tile = begin; tile < end; tile++) {
+      const int64_t start = tile * boxIoUTile;
+      const int64_t size = std::min(M - start, boxIoUTile);
+      for (int64_t i = 0; i < N; i++) {
+        box_iou_tile<scalar_t, block>(boxes1_data + i * 4, columns, start, size, iou_data + i * M + start);
+      }
+    }
+  });
+  return iou_t;
+}
+
+template <typename scalar_t, bool block>
+std::tuple<at::Tensor, at::Tensor> box_iou_max_cpu_kernel(const at::Tensor& boxes1,
+                                                          const at::Tensor& boxes2,
+                                                          const int dim) {
+  const int64_t N = boxes1.size(0);
+  const int64_t M = boxes2.size(0);
+  const int64_t size = dim == 0 ? M : N;
+  at::Tensor max_t = at::empty({size}, boxes1.options());
+  at::Tensor argmax_t = at::empty({size}, boxes1.options().dtype(at::kLong));
+  if (size == 0) {
+    return std::make_tuple(max_t, argmax_t);
+  }
+  auto boxes1_data = boxes1.data<scalar_t>();
+  auto max_data = max_t.data<scalar_t>();
+  auto argmax_data = argmax_t.data<int64_t>();
+  const auto columns = box_iou_columns(boxes2.data<scalar_t>(), M);
+  const int64_t num_tiles = (M + boxIoUTile - 1) / boxIoUTile;
+
+  if (dim == 0) {
+    // the best of boxes1 for every box of boxes2, a running max per tile
+    at::parallel_for(0, num_tiles, 1, [&](int64_t begin, int64_t end) {
+      std::vector<scalar_t> row(boxIoUTile);
+      for (int64_t tile = begin; tile < end; tile++) {
+        const int64_t start = tile * boxIoUTile;
+        const int64_t tile_size = std::min(M - start, boxIoUTile);
+        scalar_t* best = max_data + start;
+        int64_t* best_index = argmax_data + start;
+        box_iou_tile<scalar_t, block>(boxes1_data, columns, start, tile_size, best);
+        std::fill(best_index, best_index + tile_size, 0);
+        for (int64_t i = 1; i < N; i++) {
+          box_iou_tile<scalar_t, block>(boxes1_data + i * 4, columns, start, tile_size, row.data());
+          for (int64_t j = 0; j < tile_size; j++) {
+            if (row[j] > best[j]) {
+              best[j] = row[j];
+              best_index[j] = i;
+            }
+          }
+        }
+      }
+    });
+  } else {
+    // the best of boxes2 for every box of boxes1, tile by tile
+    at::parallel_for(0, N, 1, [&](int64_t begin, int64_t end) {
+      std::vector<scalar_t> row(boxIoUTile);
+      for (int64_t i = begin; i < end; i++) {
+        scalar_t best = 0;
+        int64_t best_index = -1;
+        for (int64_t tile = 0; tile < num_tiles; tile++) {
+          const int64_t start = tile * boxIoUTile;
+          const int64_t tile_size = std::min(M - start, boxIoUTile);
+          box_iou_tile<scalar_t, block>(boxes1_data + i * 4, columns, start, tile_size, row.data());
+          for (int64_t j = 0; j < tile_size; j++) {
+            if (best_index < 0 || row[j] > best) {
+              best = row[j];
+              best_index = start + j;
+            }
+          }
+        }
+        max_data[i] = best;
+        argmax_data[i] = best_index;
+      }
+    });
+  }
+  return std::make_tuple(max_t, argmax_t);
+}
+
+// Dense [N, M] IoU of two sets of boxes, or their block IoU (the smaller of
+// the IoUs of their x and y extents) if block.
+at::Tensor BoxIoU_cpu(const at::Tensor& boxes1,
+                      const at::Tensor& boxes2,
+                      const bool block) {
+  AT_ASSERTM(!boxes1.type().is_cuda(), "boxes1 must be a CPU tensor");
+  AT_ASSERTM(!boxes2.type().is_cuda(), "boxes2 must be a CPU tensor");
+  AT_ASSERTM(boxes1.type() == boxes2.type(), "boxes1 should have the same type as boxes2");
+  AT_ASSERTM(boxes1.dim() == 2 && boxes1.size(1) == 4, "boxes1 must be a Nx4 tensor");
+  AT_ASSERTM(boxes2.dim() == 2 && boxes2.size(1) == 4, "boxes2 must be a Mx4 tensor");
+
+  at::Tensor result;
+  AT_DISPATCH_FLOATING_TYPES(boxes1.type(), "BoxIoU", [&] {
+    if (block) {
+      result = box_iou_cpu_kernel<scalar_t, true>(boxes1.contiguous(), boxes2.contiguous());
+    } else {
+      result = box_iou_cpu_kernel<scalar_t, false>(boxes1.contiguous(), boxes2.contiguous());
+    }
+  });
+  return result;
+}
+
+// max and argmax over dim of BoxIoU_cpu, without the [N, M] matrix. Ties
+// go to the lowest index.
+std::tuple<at::Tensor, at::Tensor> BoxIoUMax_cpu(const at::Tensor& boxes1,
+                                                 const at::Tensor& boxes2,
+                                                 const bool block,
+                                                 const int dim) {
+  AT_ASSERTM(!boxes1.type().is_cuda(), "boxes1 must be a CPU tensor");
+  AT_ASSERTM(!boxes2.type().is_cuda(), "boxes2 must be a CPU tensor");
+  AT_ASSERTM(boxes1.type() == boxes2.type(), "boxes1 should have the same type as boxes2");
+  AT_ASSERTM(boxes1.dim() == 2 && boxes1.size(1) == 4, "boxes1 must be a Nx4 tensor");
+  AT_ASSERTM(boxes2.dim() == 2 && boxes2.size(1) == 4, "boxes2 must be a Mx4 tensor");
+  AT_ASSERTM(dim == 0 || dim == 1, "dim must be 0 or 1");
+  AT_ASSERTM(boxes1.size(0) > 0 || dim == 1, "cannot reduce over an empty boxes1");
+  AT_ASSERTM(boxes2.size(0) > 0 || dim == 0, "cannot reduce over an empty boxes2");
+
+  std::tuple<at::Tensor, at::Tensor> result;
+  AT_DISPATCH_FLOATING_TYPES(boxes1.type(), "BoxIoUMax", [&] {
+    if (block) {
+      result = box_iou_max_cpu_kernel<scalar_t, true>(boxes1.contiguous(), boxes2.contiguous(), dim);
+    } else {
+      result = box_iou_max_cpu_kernel<scalar_t, false>(boxes1.contiguous(), boxes2.contiguous(), dim);
+    }
+  });
+  return result;
+}
@@ -0,0 +1,130 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+#include "cpu/vision.h"
+#include "cpu/box_iou_tile.h"
+
+#include <algorithm>
+#include <vector>
+
+
+constexpr int64_t BELOW_LOW_THRESHOLD = -1;
+constexpr int64_t BETWEEN_THRESHOLDS = -2;
+
+template <typename scalar_t>
+at::Tensor match_boxes_cpu_kernel(const at::Tensor& gt_boxes,
+                                  const at::Tensor& boxes,
+                                  const float high_threshold,
+                                  const float low_threshold,
+                                  const bool allow_low_quality_matches,
+                                  const float low_quality_threshold) {
+  const int64_t M = gt_boxes.size(0);
+  const int64_t N = boxes.size(0);
+  if (M == 0 || N == 0) {
+    return at::empty({0}, boxes.options().dtype(at::kLong));
+  }
+  at::Tensor matches_t = at::empty({N}, boxes.options().dtype(at::kLong));
+  auto gt_data = gt_boxes.data<scalar_t>();
+  auto matches_data = matches_t.data<int64_t>();
+  const auto columns = box_iou_columns(boxes.data<scalar_t>(), N);
+  const int64_t num_tiles = (N + boxIoUTile - 1) / boxIoUTile;
+
+  // the best gt of every box and the best IoU of every gt in every tile
+  std::vector<scalar_t> matched_vals(N);
+  std::vector<scalar_t> tile_gt_max(num_tiles * M);
+  at::parallel_for(0, num_tiles, 1, [&](int64_t begin, int64_t end) {
+    std::vector<scalar_t> row(boxIoUTile);
+    for (int64_t tile = begin; tile < end; tile++) {
+      const int64_t start = tile * boxIoUTile;
+      const int64_t size = std::min(N - start, boxIoUTile);
+      scalar_t* best = matched_vals.data() + start;
+      int64_t* best_index = matches_data + start;
+      for (int64_t i = 0; i < M; i++) {
+        box_iou_tile<scalar_t, false>(gt_data + i * 4, columns, start, size, row.data());
+        scalar_t gt_max = row[0];
+        for (int64_t j = 0; j < size; j++) {
+          if (i == 0 || row[j] > best[j]) {
+            best[j] = row[j];
+            best_index[j] = i;
+          }
+          gt_max = std::max(gt_max, row[j]);
+        }
+        tile_gt_max[tile * M + i] = gt_max;
+      }
+    }
+  });
+
+  // the boxes that have the highest IoU of some gt, ties included
+  std::vector<uint8_t> low_quality;
+  if (allow_low_quality_matches) {
+    std::vector<scalar_t> gt_max(M);
+    for (int64_t i = 0; i < M; i++) {
+      gt_max[i] = tile_gt_max[i];
+      for (int64_t tile = 1; tile < num_tiles; tile++) {
+        gt_max[i] = std::max(gt_max[i], tile_gt_max[tile * M + i]);
+      }
+    }
+    low_quality.assign(N, 0);
+    // only the tiles holding the highest IoU of a gt are computed again
+    at::parallel_for(0, num_tiles, 1, [&](int64_t begin, int64_t end) {
+      std::vector<scalar_t> row(boxIoUTile);
+      for (int64_t tile = begin; tile < end; tile++) {
+        const int64_t start = tile * boxIoUTile;
+        const int64_t size = std::min(N - start, boxIoUTile);
+        for (int64_t i = 0; i < M; i++) {
+          if (low_quality_threshold > 0 && !(gt_max[i] >= low_quality_threshold)) {
+            continue;
+          }
+          if (tile_gt_max[tile * M + i] != gt_max[i]) {
+            continue;
+          }
+          box_iou_tile<scalar_t, false>(gt_data + i * 4, columns, start, size, row.data());
+          for (int64_t j = 0; j < size; j++) {
+            if (row[j] == gt_max[i]) {
+              low_quality[start + j] = 1;
+            }
+          }
+        }
+      }
+    });
+  }
+
+  const scalar_t high = high_threshold;
+  const scalar_t low = low_threshold;
+  at::parallel_for(0, N, 2048, [&](int64_t begin, int64_t end) {
+    for (int64_t j = begin; j < end; j++) {
+      if (allow_low_quality_matches && low_quality[j]) {
+        continue;
+      }
+      if (matched_vals[j] < low) {
+        matches_data[j] = BELOW_LOW_THRESHOLD;
+      } else if (matched_vals[j] < high) {
+        matches_data[j] = BETWEEN_THRESHOLDS;
+      }
+    }
+  });
+  return matches_t;
+}
+
+// Matcher of boxlist_iou(gt_boxes, boxes), computed tile by tile: only the
+// best gt of every box, the best IoU of every gt in every tile and the boxes
+// tied at the best IoU of a gt are kept, never the [M, N] IoU matrix.
+at::Tensor MatchBoxes_cpu(const at::Tensor& gt_boxes,
+                          const at::Tensor& boxes,
+                          const float high_threshold,
+                          const float low_threshold,
+                          const bool allow_low_quality_matches,
+                          const float low_quality_threshold) {
+  AT_ASSERTM(!gt_boxes.type().is_cuda(), "gt_boxes must be a CPU tensor");
+  AT_ASSERTM(!boxes.type().is_cuda(), "boxes must be a CPU tensor");
+  AT_ASSERTM(gt_boxes.type() == boxes.type(), "gt_boxes should have the same type as boxes");
+  AT_ASSERTM(gt_boxes.dim() == 2 && gt_boxes.size(1) == 4, "gt_boxes must be a Mx4 tensor");
+  AT_ASSERTM(boxes.dim() == 2 && boxes.size(1) == 4, "boxes must be a Nx4 tensor");
+  AT_ASSERTM(low_threshold <= high_threshold, "low_threshold must be at most high_threshold");
+
+  at::Tensor result;
+  AT_DISPATCH_FLOATING_TYPES(boxes.type(), "MatchBoxes", [&] {
+    result = match_boxes_cpu_kernel<scalar_t>(
+        gt_boxes.contiguous(), boxes.contiguous(), high_threshold, low_threshold,
+        allow_low_quality_matches, low_quality_threshold);
+  });
+  return result;
+}
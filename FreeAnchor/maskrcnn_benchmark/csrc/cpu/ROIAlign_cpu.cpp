@@ -1,5 +1,10 @@
 // Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
 #include "cpu/vision.h"
+#include <ATen/Parallel.h>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 // implementation taken from Caffe2
 template <typename T>
@@ -110,97 +115,239 @@ void pre_calc_for_bilinear_interpolate(
   }
 }
 
+// Channels processed per PreCalc entry by the channels-last path; one
+// AVX-512 register or two AVX2 registers of float.
+constexpr int kChannelBlock = 16;
+
 template <typename T>
-void ROIAlignForward_cpu_kernel(
-    const int nthreads,
-    const T* bottom_data,
-    const T& spatial_scale,
-    const int channels,
-    const int height,
-    const int width,
+inline void bilinear_accumulate(
+    const T* p1,
+    const T* p2,
+    const T* p3,
+    const T* p4,
+    const PreCalc<T>& pc,
+    const int len,
+    T* acc) {
+  for (int k = 0; k < len; k++) {
+    acc[k] += pc.w1 * p1[k] + pc.w2 * p2[k] + pc.w3 * p3[k] + pc.w4 * p4[k];
+  }
+}
+
+#if defined(__AVX512F__)
+template <>
+inline void bilinear_accumulate<float>(
+    const float* p1,
+    const float* p2,
+    const float* p3,
+    const float* p4,
+    const PreCalc<float>& pc,
+    const int len,
+    float* acc) {
+  if (len != kChannelBlock) {
+    for (int k = 0; k < len; k++) {
+      acc[k] += pc.w1 * p1[k] + pc.w2 * p2[k] + pc.w3 * p3[k] + pc.w4 * p4[k];
+    }
+    return;
+  }
+  __m512 a = _mm512_loadu_ps(acc);
+  a = _mm512_fmadd_ps(_mm512_set1_ps(pc.w1), _mm512_loadu_ps(p1), a);
+  a = _mm512_fmadd_ps(_mm512_set1_ps(pc.w2), _mm512_loadu_ps(p2), a);
+  a = _mm512_fmadd_ps(_mm512_set1_ps(pc.w3), _mm512_loadu_ps(p3), a);
+  a = _mm512_fmadd_ps(_mm512_set1_ps(pc.w4), _mm512_loadu_ps(p4), a);
+  _mm512_storeu_ps(acc, a);
+}
+#elif defined(__AVX2__) && defined(__FMA__)
+template <>
+inline void bilinear_accumulate<float>(
+    const float* p1,
+    const float* p2,
+    const float* p3,
+    const float* p4,
+    const PreCalc<float>& pc,
+    const int len,
+    float* acc) {
+  if (len != kChannelBlock) {
+    for (int k = 0; k < len; k++) {
+      acc[k] += pc.w1 * p1[k] + pc.w2 * p2[k] + pc.w3 * p3[k] + pc.w4 * p4[k];
+    }
+    return;
+  }
+  const __m256 w1 = _mm256_set1_ps(pc.w1);
+  const __m256 w2 = _mm256_set1_ps(pc.w2);
+  const __m256 w3 = _mm256_set1_ps(pc.w3);
+  const __m256 w4 = _mm256_set1_ps(pc.w4);
+  for (int k = 0; k < kChannelBlock; k += 8) {
+    __m256 a = _mm256_loadu_ps(acc + k);
+    a = _mm256_fmadd_ps(w1, _mm256_loadu_ps(p1 + k), a);
+    a = _mm256_fmadd_ps(w2, _mm256_loadu_ps(p2 + k), a);
+    a = _mm256_fmadd_ps(w3, _mm256_loadu_ps(p3 + k), a);
+    a = _mm256_fmadd_ps(w4, _mm256_loadu_ps(p4 + k), a);
+    _mm256_storeu_ps(acc + k, a);
+  }
+}
+#endif
+
+// A feature map the rois are pooled from: the input of ROIAlign, or one FPN
+// level of the multi-level op.
+template <typename T>
+struct ROIAlignLevel {
+  int height;
+  int width;
+  T spatial_scale;
+};
+
+// Sampling grid of a single roi; everything the kernels need besides the
+// PreCalc table itself.
+template <typename T>
+struct ROIAlignGrid {
+  int batch_ind;
+  int level;
+  T start_h;
+  T start_w;
+  T bin_size_h;
+  T bin_size_w;
+  int grid_h;
+  int grid_w;
+  int64_t pre_calc_offset;
+};
+
+// LevelMapper of modeling/poolers.py: the level of every roi by Eqn.(1) of
+// the FPN paper, counted from k_min, with the operations of the python
+// version in the precision of the rois.
+template <typename T>
+void map_roi_levels(
+    const T* bottom_rois,
+    const int n_rois,
+    const T canonical_scale,
+    const T canonical_level,
+    const T k_min,
+    const T k_max,
+    std::vector<int>& roi_levels) {
+  const T TO_REMOVE = 1;
+  const T eps = 1e-6;
+  roi_levels.resize(n_rois);
+  for (int n = 0; n < n_rois; n++) {
+    const T* offset_bottom_rois = bottom_rois + n * 5;
+    const T area = (offset_bottom_rois[3] - offset_bottom_rois[1] + TO_REMOVE) *
+        (offset_bottom_rois[4] - offset_bottom_rois[2] + TO_REMOVE);
+    T level = std::floor(
+        canonical_level + std::log2(std::sqrt(area) / canonical_scale + eps));
+    level = std::min(std::max(level, k_min), k_max);
+    roi_levels[n] = static_cast<int>(level - k_min);
+  }
+}
+
+// Computes the sampling grid of every roi and fills one flat PreCalc table
+// for all of them (the rois are independent, so this is done in parallel).
+// roi_levels is the level of every roi, or nullptr if there is one level.
+template <typename T>
+void ROIAlign_pre_calc_all_rois(
+    const T* bottom_rois,
+    const int* roi_levels,
+    const int n_rois,
+    const std::vector<ROIAlignLevel<T>>& levels,
     const int pooled_height,
     const int pooled_width,
     const int sampling_ratio,
-    const T* bottom_rois,
-    //int roi_cols,
-    T* top_data) {
-  //AT_ASSERT(roi_cols == 4 || roi_cols == 5);
-  int roi_cols = 5;
-
-  int n_rois = nthreads / channels / pooled_width / pooled_height;
-  // (n, c, ph, pw) is an element in the pooled output
-  // can be parallelized using omp
-  // #pragma omp parallel for num_threads(32)
+    std::vector<ROIAlignGrid<T>>& grids,
+    std::vector<PreCalc<T>>& pre_calc) {
+  grids.resize(n_rois);
+  int64_t pre_calc_size = 0;
   for (int n = 0; n < n_rois; n++) {
-    int index_n = n * channels * pooled_width * pooled_height;
-
-    // roi could have 4 or 5 columns
-    const T* offset_bottom_rois = bottom_rois + n * roi_cols;
-    int roi_batch_ind = 0;
-    if (roi_cols == 5) {
-      roi_batch_ind = offset_bottom_rois[0];
-      offset_bottom_rois++;
-    }
+    const T* offset_bottom_rois = bottom_rois + n * 5;
+    ROIAlignGrid<T>& g = grids[n];
+    g.batch_ind = offset_bottom_rois[0];
+    g.level = roi_levels ? roi_levels[n] : 0;
+    const T spatial_scale = levels[g.level].spatial_scale;
 
     // Do not using rounding; this implementation detail is critical
-    T roi_start_w = offset_bottom_rois[0] * spatial_scale;
-    T roi_start_h = offset_bottom_rois[1] * spatial_scale;
-    T roi_end_w = offset_bottom_rois[2] * spatial_scale;
-    T roi_end_h = offset_bottom_rois[3] * spatial_scale;
-    // T roi_start_w = round(offset_bottom_rois[0] * spatial_scale);
-    // T roi_start_h = round(offset_bottom_rois[1] * spatial_scale);
-    // T roi_end_w = round(offset_bottom_rois[2] * spatial_scale);
-    // T roi_end_h = round(offset_bottom_rois[3] * spatial_scale);
+    g.start_w = offset_bottom_rois[1] * spatial_scale;
+    g.start_h = offset_bottom_rois[2] * spatial_scale;
+    T roi_end_w = offset_bottom_rois[3] * spatial_scale;
+    T roi_end_h = offset_bottom_rois[4] * spatial_scale;
 
     // Force malformed ROIs to be 1x1
-    T roi_width = std::max(roi_end_w - roi_start_w, (T)1.);
-    T roi_height = std::max(roi_end_h - roi_start_h, (T)1.);
-    T bin_size_h = static_cast<T>(roi_height) / static_cast<T>(pooled_height);
-    T bin_size_w = static_cast<T>(roi_width) / static_cast<T>(pooled_width);
+    T roi_width = std::max(roi_end_w - g.start_w, (T)1.);
+    T roi_height = std::max(roi_end_h - g.start_h, (T)1.);
+    g.bin_size_h = static_cast<T>(roi_height) / static_cast<T>(pooled_height);
+    g.bin_size_w = static_cast<T>(roi_width) / static_cast<T>(pooled_width);
 
     // We use roi_bin_grid to sample the grid and mimic integral
-    int roi_bin_grid_h = (sampling_ratio > 0)
+    g.grid_h = (sampling_ratio > 0)
         ? sampling_ratio
         : ceil(roi_height / pooled_height); // e.g., = 2
-    int roi_bin_grid_w =
+    g.grid_w =
         (sampling_ratio > 0) ? sampling_ratio : ceil(roi_width / pooled_width);
 
-    // We do average (integral) pooling inside a bin
-    const T count = roi_bin_grid_h * roi_bin_grid_w; // e.g. = 4
-
-    // we want to precalculate indeces and weights shared by all chanels,
-    // this is the key point of optimiation
-    std::vector<PreCalc<T>> pre_calc(
-        roi_bin_grid_h * roi_bin_grid_w * pooled_width * pooled_height);
-    pre_calc_for_bilinear_interpolate(
-        height,
-        width,
-        pooled_height,
-        pooled_width,
-        roi_bin_grid_h,
-        roi_bin_grid_w,
-        roi_start_h,
-        roi_start_w,
-        bin_size_h,
-        bin_size_w,
-        roi_bin_grid_h,
-        roi_bin_grid_w,
-        pre_calc);
-
-      for (int c = 0; c < channels; c++) {
-      int index_n_c = index_n + c * pooled_width * pooled_height;
-      const T* offset_bottom_data =
-          bottom_data + (roi_batch_ind * channels + c) * height * width;
+    g.pre_calc_offset = pre_calc_size;
+    pre_calc_size +=
+        static_cast<int64_t>(g.grid_h) * g.grid_w * pooled_width * pooled_height;
+  }
+
+  pre_calc.resize(pre_calc_size);
+  at::parallel_for(0, n_rois, 1, [&](int64_t begin, int64_t end) {
+    std::vector<PreCalc<T>> roi_pre_calc;
+    for (int64_t n = begin; n < end; n++) {
+      const ROIAlignGrid<T>& g = grids[n];
+      roi_pre_calc.resize(g.grid_h * g.grid_w * pooled_width * pooled_height);
+      pre_calc_for_bilinear_interpolate(
+          levels[g.level].height,
+          levels[g.level].width,
+          pooled_height,
+          pooled_width,
+          g.grid_h,
+          g.grid_w,
+          g.start_h,
+          g.start_w,
+          g.bin_size_h,
+          g.bin_size_w,
+          g.grid_h,
+          g.grid_w,
+          roi_pre_calc);
+      std::copy(
+          roi_pre_calc.begin(),
+          roi_pre_calc.end(),
+          pre_calc.begin() + g.pre_calc_offset);
+    }
+  });
+}
+
+// One task per (roi, channel): four scalar taps per sample on the NCHW
+// input. Used when the input is too thin or too large relative to the
+// number of samples for a channels-last copy to pay off.
+template <typename T>
+void ROIAlignForward_cpu_kernel(
+    const std::vector<const T*>& bottom_data,
+    const int n_rois,
+    const int channels,
+    const std::vector<ROIAlignLevel<T>>& levels,
+    const int pooled_height,
+    const int pooled_width,
+    const std::vector<ROIAlignGrid<T>>& grids,
+    const std::vector<PreCalc<T>>& pre_calc,
+    T* top_data) {
+  // (n, c, ph, pw) is an element in the pooled output
+  at::parallel_for(0, n_rois * channels, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t nc = begin; nc < end; nc++) {
+      const int n = nc / channels;
+      const int c = nc % channels;
+      const ROIAlignGrid<T>& g = grids[n];
+      const ROIAlignLevel<T>& level = levels[g.level];
+      // We do average (integral) pooling inside a bin
+      const T count = g.grid_h * g.grid_w; // e.g. = 4
+
+      const T* offset_bottom_data = bottom_data[g.level] +
+          static_cast<int64_t>(g.batch_ind * channels + c) * level.height * level.width;
+      T* offset_top_data = top_data + nc * pooled_width * pooled_height;
+      const PreCalc<T>* roi_pre_calc = pre_calc.data() + g.pre_calc_offset;
       int pre_calc_index = 0;
 
       for (int ph = 0; ph < pooled_height; ph++) {
         for (int pw = 0; pw < pooled_width; pw++) {
-          int index = index_n_c + ph * pooled_width + pw;
-
           T output_val = 0.;
-          for (int iy = 0; iy < roi_bin_grid_h; iy++) {
-            for (int ix = 0; ix < roi_bin_grid_w; ix++) {
-              PreCalc<T> pc = pre_calc[pre_calc_index];
+          for (int iy = 0; iy < g.grid_h; iy++) {
+            for (int ix = 0; ix < g.grid_w; ix++) {
+              const PreCalc<T>& pc = roi_pre_calc[pre_calc_index];
               output_val += pc.w1 * offset_bottom_data[pc.pos1] +
                   pc.w2 * offset_bottom_data[pc.pos2] +
                   pc.w3 * offset_bottom_data[pc.pos3] +
@@ -211,11 +358,215 @@ void ROIAlignForward_cpu_kernel(
           }
           output_val /= count;
 
-          top_data[index] = output_val;
+          offset_top_data[ph * pooled_width + pw] = output_val;
         } // for pw
       } // for ph
-    } // for c
-  } // for n
+    } // for nc
+  });
+}
+
+// One task per (roi, block of kChannelBlock channels) on a channels-last
+// copy of the input, so the four taps of a PreCalc entry are contiguous
+// vector loads shared by the whole channel block.
+template <typename T>
+void ROIAlignForward_cpu_kernel_nhwc(
+    const std::vector<const T*>& bottom_data_nhwc,
+    const int n_rois,
+    const int channels,
+    const std::vector<ROIAlignLevel<T>>& levels,
+    const int pooled_height,
+    const int pooled_width,
+    const std::vector<ROIAlignGrid<T>>& grids,
+    const std::vector<PreCalc<T>>& pre_calc,
+    T* top_data) {
+  const int n_blocks = (channels + kChannelBlock - 1) / kChannelBlock;
+  const int pooled_size = pooled_height * pooled_width;
+
+  at::parallel_for(0, n_rois * n_blocks, 1, [&](int64_t begin, int64_t end) {
+    T acc[kChannelBlock];
+    for (int64_t nb = begin; nb < end; nb++) {
+      const int n = nb / n_blocks;
+      const int c0 = (nb % n_blocks) * kChannelBlock;
+      const int len = std::min(kChannelBlock, channels - c0);
+      const ROIAlignGrid<T>& g = grids[n];
+      const ROIAlignLevel<T>& level = levels[g.level];
+      const T count = g.grid_h * g.grid_w;
+
+      const T* offset_bottom_data = bottom_data_nhwc[g.level] +
+          static_cast<int64_t>(g.batch_ind) * level.height * level.width * channels + c0;
+      T* offset_top_data =
+          top_data + (n * channels + c0) * pooled_size;
+      const PreCalc<T>* roi_pre_calc = pre_calc.data() + g.pre_calc_offset;
+      int pre_calc_index = 0;
+
+      for (int p = 0; p < pooled_size; p++) {
+        std::fill(acc, acc + kChannelBlock, T(0));
+        for (int i = 0; i < g.grid_h * g.grid_w; i++) {
+          const PreCalc<T>& pc = roi_pre_calc[pre_calc_index];
+          bilinear_accumulate(
+              offset_bottom_data + pc.pos1 * channels,
+              offset_bottom_data + pc.pos2 * channels,
+              offset_bottom_data + pc.pos3 * channels,
+              offset_bottom_data + pc.pos4 * channels,
+              pc,
+              len,
+              acc);
+          pre_calc_index += 1;
+        }
+        for (int k = 0; k < len; k++) {
+          offset_top_data[k * pooled_size + p] = acc[k] / count;
+        }
+      } // for p
+    } // for nb
+  });
+}
+
+// Channel partitioning: every task owns whole (batch, channel) planes of
+// grad_input, at every level, and scatters the gradient of all rois of that
+// image into them, so no two threads ever write the same location and no
+// atomics are needed.
+template <typename T>
+void ROIAlignBackward_cpu_kernel(
+    const T* top_diff,
+    const int n_rois,
+    const int batch_size,
+    const int channels,
+    const std::vector<ROIAlignLevel<T>>& levels,
+    const int pooled_height,
+    const int pooled_width,
+    const std::vector<ROIAlignGrid<T>>& grids,
+    const std::vector<PreCalc<T>>& pre_calc,
+    const std::vector<T*>& bottom_diff) {
+  std::vector<std::vector<int>> rois_per_image(batch_size);
+  for (int n = 0; n < n_rois; n++) {
+    AT_ASSERTM(grids[n].batch_ind >= 0 && grids[n].batch_ind < batch_size,
+               "roi batch index out of range");
+    rois_per_image[grids[n].batch_ind].push_back(n);
+  }
+
+  const int pooled_size = pooled_height * pooled_width;
+  at::parallel_for(0, batch_size * channels, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t bc = begin; bc < end; bc++) {
+      const int b = bc / channels;
+      const int c = bc % channels;
+
+      for (int n : rois_per_image[b]) {
+        const ROIAlignGrid<T>& g = grids[n];
+        const ROIAlignLevel<T>& level = levels[g.level];
+        const T count = g.grid_h * g.grid_w;
+        T* offset_bottom_diff =
+            bottom_diff[g.level] + bc * level.height * level.width;
+        const T* offset_top_diff =
+            top_diff + (n * channels + c) * pooled_size;
+        const PreCalc<T>* roi_pre_calc = pre_calc.data() + g.pre_calc_offset;
+        int pre_calc_index = 0;
+
+        for (int p = 0; p < pooled_size; p++) {
+          const T top_diff_this_bin = offset_top_diff[p] / count;
+          for (int i = 0; i < g.grid_h * g.grid_w; i++) {
+            const PreCalc<T>& pc = roi_pre_calc[pre_calc_index];
+            offset_bottom_diff[pc.pos1] += pc.w1 * top_diff_this_bin;
+            offset_bottom_diff[pc.pos2] += pc.w2 * top_diff_this_bin;
+            offset_bottom_diff[pc.pos3] += pc.w3 * top_diff_this_bin;
+            offset_bottom_diff[pc.pos4] += pc.w4 * top_diff_this_bin;
+            pre_calc_index += 1;
+          }
+        } // for p
+      } // for n
+    } // for bc
+  });
+}
+
+// Pools every roi from its level of the contiguous inputs into top_data.
+template <typename T>
+void ROIAlignForward_cpu_levels(
+    const std::vector<at::Tensor>& inputs,
+    const std::vector<ROIAlignLevel<T>>& levels,
+    const T* bottom_rois,
+    const int* roi_levels,
+    const int n_rois,
+    const int channels,
+    const int pooled_height,
+    const int pooled_width,
+    const int sampling_ratio,
+    T* top_data) {
+  std::vector<ROIAlignGrid<T>> grids;
+  std::vector<PreCalc<T>> pre_calc;
+  ROIAlign_pre_calc_all_rois<T>(
+       bottom_rois,
+       roi_levels,
+       n_rois,
+       levels,
+       pooled_height,
+       pooled_width,
+       sampling_ratio,
+       grids,
+       pre_calc);
+
+  // The channels-last copy reads the inputs once; it pays off as soon as
+  // the rois sample at least as many locations as the feature maps have.
+  int64_t input_size = 0;
+  for (const auto& input : inputs) {
+    input_size += input.size(0) * input.size(2) * input.size(3);
+  }
+  bool use_nhwc = channels >= kChannelBlock &&
+      static_cast<int64_t>(pre_calc.size()) * 4 >= input_size;
+
+  std::vector<at::Tensor> inputs_nhwc;
+  std::vector<const T*> bottom_data;
+  for (const auto& input : inputs) {
+    if (use_nhwc) {
+      inputs_nhwc.push_back(input.permute({0, 2, 3, 1}).contiguous());
+      bottom_data.push_back(inputs_nhwc.back().data<T>());
+    } else {
+      bottom_data.push_back(input.data<T>());
+    }
+  }
+  if (use_nhwc) {
+    ROIAlignForward_cpu_kernel_nhwc<T>(
+         bottom_data, n_rois, channels, levels, pooled_height, pooled_width,
+         grids, pre_calc, top_data);
+  } else {
+    ROIAlignForward_cpu_kernel<T>(
+         bottom_data, n_rois, channels, levels, pooled_height, pooled_width,
+         grids, pre_calc, top_data);
+  }
+}
+
+// Scatters the gradient of every roi into its level of the zeroed grad_inputs.
+template <typename T>
+void ROIAlignBackward_cpu_levels(
+    const T* top_diff,
+    const std::vector<ROIAlignLevel<T>>& levels,
+    const T* bottom_rois,
+    const int* roi_levels,
+    const int n_rois,
+    const int batch_size,
+    const int channels,
+    const int pooled_height,
+    const int pooled_width,
+    const int sampling_ratio,
+    std::vector<at::Tensor>& grad_inputs) {
+  std::vector<ROIAlignGrid<T>> grids;
+  std::vector<PreCalc<T>> pre_calc;
+  ROIAlign_pre_calc_all_rois<T>(
+       bottom_rois,
+       roi_levels,
+       n_rois,
+       levels,
+       pooled_height,
+       pooled_width,
+       sampling_ratio,
+       grids,
+       pre_calc);
+
+  std::vector<T*> bottom_diff;
+  for (auto& grad_input : grad_inputs) {
+    bottom_diff.push_back(grad_input.data<T>());
+  }
+  ROIAlignBackward_cpu_kernel<T>(
+       top_diff, n_rois, batch_size, channels, levels, pooled_height,
+       pooled_width, grids, pre_calc, bottom_diff);
 }
 
 at::Tensor ROIAlign_forward_cpu(const at::Tensor& input,
@@ -233,25 +584,214 @@ at::Tensor ROIAlign_forward_cpu(const at::Tensor& input,
   auto width = input.size(3);
 
   auto output = at::empty({num_rois, channels, pooled_height, pooled_width}, input.options());
-  auto output_size = num_rois * pooled_height * pooled_width * channels;
 
   if (output.numel() == 0) {
     return output;
   }
 
+  auto input_ = input.contiguous();
+  auto rois_ = rois.contiguous();
+
   AT_DISPATCH_FLOATING_TYPES(input.type(), "ROIAlign_forward", [&] {
-    ROIAlignForward_cpu_kernel<scalar_t>(
-         output_size,
-         input.data<scalar_t>(),
-         spatial_scale,
+    std::vector<ROIAlignLevel<scalar_t>> levels = {
+        {static_cast<int>(height), static_cast<int>(width), spatial_scale}};
+    ROIAlignForward_cpu_levels<scalar_t>(
+         {input_},
+         levels,
+         rois_.data<scalar_t>(),
+         nullptr,
+         num_rois,
+         channels,
+         pooled_height,
+         pooled_width,
+         sampling_ratio,
+         output.data<scalar_t>());
+  });
+  return output;
+}
+
+at::Tensor ROIAlign_backward_cpu(const at::Tensor& grad,
+                                 const at::Tensor& rois,
+                                 const float spatial_scale,
+                                 const int pooled_height,
+                                 const int pooled_width,
+                                 const int batch_size,
+                                 const int channels,
+                                 const int height,
+                                 const int width,
+                                 const int sampling_ratio) {
+  AT_ASSERTM(!grad.type().is_cuda(), "grad must be a CPU tensor");
+  AT_ASSERTM(!rois.type().is_cuda(), "rois must be a CPU tensor");
+
+  auto num_rois = rois.size(0);
+  auto grad_input = at::zeros({batch_size, channels, height, width}, grad.options());
+
+  // handle possibly empty gradients
+  if (grad.numel() == 0) {
+    return grad_input;
+  }
+
+  auto grad_ = grad.contiguous();
+  auto rois_ = rois.contiguous();
+
+  AT_DISPATCH_FLOATING_TYPES(grad.type(), "ROIAlign_backward", [&] {
+    std::vector<ROIAlignLevel<scalar_t>> levels = {
+        {height, width, spatial_scale}};
+    std::vector<at::Tensor> grad_inputs = {grad_input};
+    ROIAlignBackward_cpu_levels<scalar_t>(
+         grad_.data<scalar_t>(),
+         levels,
+         rois_.data<scalar_t>(),
+         nullptr,
+         num_rois,
+         batch_size,
+         channels,
+         pooled_height,
+         pooled_width,
+         sampling_ratio,
+         grad_inputs);
+  });
+  return grad_input;
+}
+
+// The FPN levels of inputs[0] ... inputs[L - 1] are k_min ... k_max, with
+// k = -log2(spatial_scale) as Pooler computes them.
+template <typename T>
+std::vector<ROIAlignLevel<T>> multilevel_levels(
+    const std::vector<int64_t>& heights,
+    const std::vector<int64_t>& widths,
+    const std::vector<double>& spatial_scales,
+    T& k_min,
+    T& k_max) {
+  std::vector<ROIAlignLevel<T>> levels;
+  for (size_t l = 0; l < spatial_scales.size(); l++) {
+    levels.push_back({static_cast<int>(heights[l]), static_cast<int>(widths[l]),
+                      static_cast<T>(static_cast<float>(spatial_scales[l]))});
+  }
+  k_min = -std::log2(static_cast<float>(spatial_scales.front()));
+  k_max = -std::log2(static_cast<float>(spatial_scales.back()));
+  return levels;
+}
+
+at::Tensor MultiLevelROIAlign_forward_cpu(const std::vector<at::Tensor>& inputs,
+                                          const at::Tensor& rois,
+                                          const std::vector<double>& spatial_scales,
+                                          const int pooled_height,
+                                          const int pooled_width,
+                                          const int sampling_ratio,
+                                          const float canonical_scale,
+                                          const float canonical_level) {
+  AT_ASSERTM(!inputs.empty(), "inputs must not be empty");
+  AT_ASSERTM(inputs.size() == spatial_scales.size(),
+             "inputs and spatial_scales must have the same length");
+  AT_ASSERTM(!rois.type().is_cuda(), "rois must be a CPU tensor");
+  std::vector<at::Tensor> inputs_;
+  std::vector<int64_t> heights, widths;
+  for (const auto& input : inputs) {
+    AT_ASSERTM(!input.type().is_cuda(), "inputs must be CPU tensors");
+    AT_ASSERTM(input.type() == inputs[0].type() && input.dim() == 4 &&
+               input.size(0) == inputs[0].size(0) &&
+               input.size(1) == inputs[0].size(1),
+               "inputs must have the same type, batch size and channels");
+    inputs_.push_back(input.contiguous());
+    heights.push_back(input.size(2));
+    widths.push_back(input.size(3));
+  }
+
+  auto num_rois = rois.size(0);
+  auto channels = inputs[0].size(1);
+  auto output = at::empty({num_rois, channels, pooled_height, pooled_width}, inputs[0].options());
+
+  if (output.numel() == 0) {
+    return output;
+  }
+
+  auto rois_ = rois.contiguous();
+
+  AT_DISPATCH_FLOATING_TYPES(inputs[0].type(), "MultiLevelROIAlign_forward", [&] {
+    scalar_t k_min, k_max;
+    auto levels = multilevel_levels<scalar_t>(heights, widths, spatial_scales, k_min, k_max);
+    std::vector<int> roi_levels;
+    map_roi_levels<scalar_t>(
+         rois_.data<scalar_t>(),
+         num_rois,
+         canonical_scale,
+         canonical_level,
+         k_min,
+         k_max,
+         roi_levels);
+    ROIAlignForward_cpu_levels<scalar_t>(
+         inputs_,
+         levels,
+         rois_.data<scalar_t>(),
+         roi_levels.data(),
+         num_rois,
          channels,
-         height,
-         width,
          pooled_height,
          pooled_width,
          sampling_ratio,
-         rois.data<scalar_t>(),
          output.data<scalar_t>());
   });
   return output;
 }
+
+std::vector<at::Tensor> MultiLevelROIAlign_backward_cpu(const at::Tensor& grad,
+                                                        const at::Tensor& rois,
+                                                        const std::vector<double>& spatial_scales,
+                                                        const int pooled_height,
+                                                        const int pooled_width,
+                                                        const int batch_size,
+                                                        const int channels,
+                                                        const std::vector<int64_t>& heights,
+                                                        const std::vector<int64_t>& widths,
+                                                        const int sampling_ratio,
+                                                        const float canonical_scale,
+                                                        const float canonical_level) {
+  AT_ASSERTM(!grad.type().is_cuda(), "grad must be a CPU tensor");
+  AT_ASSERTM(!rois.type().is_cuda(), "rois must be a CPU tensor");
+  AT_ASSERTM(!spatial_scales.empty() &&
+             heights.size() == spatial_scales.size() &&
+             widths.size() == spatial_scales.size(),
+             "heights, widths and spatial_scales must have the same length");
+
+  auto num_rois = rois.size(0);
+  std::vector<at::Tensor> grad_inputs;
+  for (size_t l = 0; l < spatial_scales.size(); l++) {
+    grad_inputs.push_back(at::zeros({batch_size, channels, heights[l], widths[l]}, grad.options()));
+  }
+
+  // handle possibly empty gradients
+  if (grad.numel() == 0) {
+    return grad_inputs;
+  }
+
+  auto grad_ = grad.contiguous();
+  auto rois_ = rois.contiguous();
+
+  AT_DISPATCH_FLOATING_TYPES(grad.type(), "MultiLevelROIAlign_backward", [&] {
+    scalar_t k_min, k_max;
+    auto levels = multilevel_levels<scalar_t>(heights, widths, spatial_scales, k_min, k_max);
+    std::vector<int> roi_levels;
+    map_roi_levels<scalar_t>(
+         rois_.data<scalar_t>(),
+         num_rois,
+         canonical_scale,
+         canonical_level,
+         k_min,
+         k_max,
+         roi_levels);
+    ROIAlignBackward_cpu_levels<scalar_t>(
+         grad_.data<scalar_t>(),
+         levels,
+         rois_.data<scalar_t>(),
+         roi_levels.data(),
+         num_rois,
+         batch_size,
+         channels,
+         pooled_height,
+         pooled_width,
+         sampling_ratio,
+         grad_inputs);
+  });
+  return grad_inputs;
+}
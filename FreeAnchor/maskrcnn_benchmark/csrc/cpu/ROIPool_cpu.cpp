@@ -0,0 +1,224 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+#include "cpu/vision.h"
+#include <ATen/Parallel.h>
+
+#include <cfloat>
+
+
+// Max of row[0, len); written as a plain reduction so that it vectorizes.
+template <typename T>
+inline T row_max(const T* row, const int len) {
+  T maxval = -FLT_MAX;
+#ifdef _OPENMP
+#pragma omp simd reduction(max:maxval)
+#endif
+  for (int w = 0; w < len; ++w) {
+    maxval = row[w] > maxval ? row[w] : maxval;
+  }
+  return maxval;
+}
+
+template <typename T>
+void ROIPoolForward_cpu_kernel(
+    const T* bottom_data,
+    const T spatial_scale,
+    const int num_rois,
+    const int channels,
+    const int height,
+    const int width,
+    const int pooled_height,
+    const int pooled_width,
+    const T* bottom_rois,
+    T* top_data,
+    int* argmax_data) {
+  // (n, c) is a pooled plane of the output
+  at::parallel_for(0, num_rois * channels, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t nc = begin; nc < end; nc++) {
+      int c = nc % channels;
+      int n = nc / channels;
+
+      const T* offset_bottom_rois = bottom_rois + n * 5;
+      int roi_batch_ind = offset_bottom_rois[0];
+      int roi_start_w = round(offset_bottom_rois[1] * spatial_scale);
+      int roi_start_h = round(offset_bottom_rois[2] * spatial_scale);
+      int roi_end_w = round(offset_bottom_rois[3] * spatial_scale);
+      int roi_end_h = round(offset_bottom_rois[4] * spatial_scale);
+
+      // Force malformed ROIs to be 1x1
+      int roi_width = std::max(roi_end_w - roi_start_w + 1, 1);
+      int roi_height = std::max(roi_end_h - roi_start_h + 1, 1);
+      T bin_size_h = static_cast<T>(roi_height)
+                         / static_cast<T>(pooled_height);
+      T bin_size_w = static_cast<T>(roi_width)
+                         / static_cast<T>(pooled_width);
+
+      const T* offset_bottom_data =
+          bottom_data + (roi_batch_ind * channels + c) * height * width;
+      T* offset_top_data = top_data + nc * pooled_height * pooled_width;
+      int* offset_argmax_data = argmax_data + nc * pooled_height * pooled_width;
+
+      for (int ph = 0; ph < pooled_height; ++ph) {
+        int hstart = static_cast<int>(floor(static_cast<T>(ph)
+                                            * bin_size_h));
+        int hend = static_cast<int>(ceil(static_cast<T>(ph + 1)
+                                         * bin_size_h));
+        // Add roi offsets and clip to input boundaries
+        hstart = std::min(std::max(hstart + roi_start_h, 0), height);
+        hend = std::min(std::max(hend + roi_start_h, 0), height);
+
+        for (int pw = 0; pw < pooled_width; ++pw) {
+          int wstart = static_cast<int>(floor(static_cast<T>(pw)
+                                              * bin_size_w));
+          int wend = static_cast<int>(ceil(static_cast<T>(pw + 1)
+                                           * bin_size_w));
+          wstart = std::min(std::max(wstart + roi_start_w, 0), width);
+          wend = std::min(std::max(wend + roi_start_w, 0), width);
+          bool is_empty = (hend <= hstart) || (wend <= wstart);
+
+          // Define an empty pooling region to be zero
+          T maxval = is_empty ? 0 : -FLT_MAX;
+          // If nothing is pooled, argmax = -1 causes nothing to be backprop'd
+          int maxidx = -1;
+          for (int h = hstart; h < hend && !is_empty; ++h) {
+            const T* row = offset_bottom_data + h * width + wstart;
+            T rowval = row_max(row, wend - wstart);
+            // Only locate the element when the row improves on the bin, so
+            // ties keep the first element in (h, w) order like the CUDA kernel
+            if (rowval > maxval) {
+              int w = 0;
+              while (row[w] != rowval) {
+                ++w;
+              }
+              maxval = rowval;
+              maxidx = h * width + wstart + w;
+            }
+          }
+          offset_top_data[ph * pooled_width + pw] = maxval;
+          offset_argmax_data[ph * pooled_width + pw] = maxidx;
+        } // for pw
+      } // for ph
+    } // for nc
+  });
+}
+
+// Every output element has cached its argmax, so the backward is a single
+// pass over the outputs. Tasks own whole (batch, channel) planes of the
+// input gradient, which keeps the scatter free of atomics.
+template <typename T>
+void ROIPoolBackward_cpu_kernel(
+    const T* top_diff,
+    const int* argmax_data,
+    const int num_rois,
+    const int batch_size,
+    const int channels,
+    const int height,
+    const int width,
+    const int pooled_height,
+    const int pooled_width,
+    T* bottom_diff,
+    const T* bottom_rois) {
+  std::vector<std::vector<int>> rois_per_image(batch_size);
+  for (int n = 0; n < num_rois; n++) {
+    int roi_batch_ind = bottom_rois[n * 5];
+    AT_ASSERTM(roi_batch_ind >= 0 && roi_batch_ind < batch_size,
+               "roi batch index out of range");
+    rois_per_image[roi_batch_ind].push_back(n);
+  }
+
+  const int pooled_size = pooled_height * pooled_width;
+  at::parallel_for(0, batch_size * channels, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t bc = begin; bc < end; bc++) {
+      int b = bc / channels;
+      int c = bc % channels;
+      T* offset_bottom_diff = bottom_diff + bc * height * width;
+
+      for (int n : rois_per_image[b]) {
+        int top_offset = (n * channels + c) * pooled_size;
+        const T* offset_top_diff = top_diff + top_offset;
+        const int* offset_argmax_data = argmax_data + top_offset;
+        for (int p = 0; p < pooled_size; p++) {
+          int argmax = offset_argmax_data[p];
+          if (argmax != -1) {
+            offset_bottom_diff[argmax] += offset_top_diff[p];
+          }
+        }
+      }
+    }
+  });
+}
+
+std::tuple<at::Tensor, at::Tensor> ROIPool_forward_cpu(const at::Tensor& input,
+                                const at::Tensor& rois,
+                                const float spatial_scale,
+                                const int pooled_height,
+                                const int pooled_width) {
+  AT_ASSERTM(!input.type().is_cuda(), "input must be a CPU tensor");
+  AT_ASSERTM(!rois.type().is_cuda(), "rois must be a CPU tensor");
+
+  auto num_rois = rois.size(0);
+  auto channels = input.size(1);
+  auto height = input.size(2);
+  auto width = input.size(3);
+
+  auto output = at::empty({num_rois, channels, pooled_height, pooled_width}, input.options());
+  auto argmax = at::zeros({num_rois, channels, pooled_height, pooled_width}, input.options().dtype(at::kInt));
+
+  if (output.numel() == 0) {
+    return std::make_tuple(output, argmax);
+  }
+
+  AT_DISPATCH_FLOATING_TYPES(input.type(), "ROIPool_forward", [&] {
+    ROIPoolForward_cpu_kernel<scalar_t>(
+         input.contiguous().data<scalar_t>(),
+         spatial_scale,
+         num_rois,
+         channels,
+         height,
+         width,
+         pooled_height,
+         pooled_width,
+         rois.contiguous().data<scalar_t>(),
+         output.data<scalar_t>(),
+         argmax.data<int>());
+  });
+  return std::make_tuple(output, argmax);
+}
+
+at::Tensor ROIPool_backward_cpu(const at::Tensor& grad,
+                                const at::Tensor& input,
+                                const at::Tensor& rois,
+                                const at::Tensor& argmax,
+                                const float spatial_scale,
+                                const int pooled_height,
+                                const int pooled_width,
+                                const int batch_size,
+                                const int channels,
+                                const int height,
+                                const int width) {
+  AT_ASSERTM(!grad.type().is_cuda(), "grad must be a CPU tensor");
+  AT_ASSERTM(!rois.type().is_cuda(), "rois must be a CPU tensor");
+
+  auto num_rois = rois.size(0);
+  auto grad_input = at::zeros({batch_size, channels, height, width}, grad.options());
+
+  // handle possibly empty gradients
+  if (grad.numel() == 0) {
+    return grad_input;
+  }
+
+  AT_DISPATCH_FLOATING_TYPES(grad.type(), "ROIPool_backward", [&] {
+    ROIPoolBackward_cpu_kernel<scalar_t>(
+         grad.contiguous().data<scalar_t>(),
+         argmax.contiguous().data<int>(),
+         num_rois,
+         batch_size,
+         channels,
+         height,
+         width,
+         pooled_height,
+         pooled_width,
+         grad_input.data<scalar_t>(),
+         rois.contiguous().data<scalar_t>());
+  });
+  return grad_input;
+}
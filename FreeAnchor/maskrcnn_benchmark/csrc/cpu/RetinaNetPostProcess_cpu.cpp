@@ -0,0 +1,320 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+#include "cpu/vision.h"
+#include "cpu/nms_bitmask.h"
+#include <ATen/Parallel.h>
+
+#include <algorithm>
+#include <cmath>
+
+
+// Sigmoids are only evaluated for logits above the logit of the threshold
+// minus this margin, the exact test is then done on the sigmoid itself.
+constexpr double retinaNetLogitMargin = 1e-3;
+
+template <typename scalar_t>
+struct RetinaNetCandidate {
+  scalar_t score;
+  int64_t position;  // (anchor, class) of the level, in the order of the python loop
+};
+
+template <typename scalar_t>
+inline bool retinanet_better(const RetinaNetCandidate<scalar_t>& a,
+                             const RetinaNetCandidate<scalar_t>& b) {
+  return a.score > b.score || (a.score == b.score && a.position < b.position);
+}
+
+template <typename scalar_t>
+struct RetinaNetDetection {
+  scalar_t box[4];
+  scalar_t score;
+  int64_t label;
+};
+
+// forward_for_single_feature_map of one image on one level: the candidates
+// above pre_nms_thresh, the pre_nms_top_n best of them by a heap, decoded
+// by the BoxCoder, clipped to the image and without the small boxes.
+template <typename scalar_t>
+void retinanet_level_detections(const scalar_t* logits,
+                                const scalar_t* regression,
+                                const scalar_t* anchors,
+                                const int64_t num_anchors_per_location,
+                                const int64_t num_classes,
+                                const int64_t hw,
+                                const float pre_nms_thresh,
+                                const int pre_nms_top_n,
+                                const std::vector<double>& weights,
+                                const float bbox_xform_clip,
+                                const float min_size,
+                                const int64_t image_width,
+                                const int64_t image_height,
+                                std::vector<RetinaNetDetection<scalar_t>>& detections) {
+  const int64_t A = num_anchors_per_location;
+  const int64_t C = num_classes;
+  const scalar_t thresh = pre_nms_thresh;
+  const scalar_t logit_thresh =
+      std::log(pre_nms_thresh / (1. - pre_nms_thresh)) - retinaNetLogitMargin;
+
+  // min-heap of the best pre_nms_top_n candidates seen so far
+  std::vector<RetinaNetCandidate<scalar_t>> heap;
+  auto worse = [](const RetinaNetCandidate<scalar_t>& a,
+                  const RetinaNetCandidate<scalar_t>& b) {
+    return retinanet_better(a, b);
+  };
+  for (int64_t ac = 0; ac < A * C; ac++) {
+    const scalar_t* plane = logits + ac * hw;
+    const int64_t a = ac / C;
+    const int64_t c = ac % C;
+    for (int64_t p = 0; p < hw; p++) {
+      if (!(plane[p] > logit_thresh)) {
+        continue;
+      }
+      const scalar_t score = static_cast<scalar_t>(1) / (1 + std::exp(-plane[p]));
+      if (!(score > thresh)) {
+        continue;
+      }
+      RetinaNetCandidate<scalar_t> candidate{score, (p * A + a) * C + c};
+      if (heap.size() < static_cast<size_t>(pre_nms_top_n)) {
+        heap.push_back(candidate);
+        std::push_heap(heap.begin(), heap.end(), worse);
+      } else if (pre_nms_top_n > 0 && retinanet_better(candidate, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), worse);
+        heap.back() = candidate;
+        std::push_heap(heap.begin(), heap.end(), worse);
+      }
+    }
+  }
+  std::sort(heap.begin(), heap.end(), retinanet_better<scalar_t>);
+
+  const scalar_t TO_REMOVE = 1;
+  const scalar_t wx = weights[0], wy = weights[1], ww = weights[2], wh = weights[3];
+  const scalar_t clip = bbox_xform_clip;
+  const scalar_t max_x = image_width - TO_REMOVE;
+  const scalar_t max_y = image_height - TO_REMOVE;
+  for (const auto& candidate : heap) {
+    const int64_t k = candidate.position / C;  // anchor, (p * A + a)
+    const int64_t a = k % A;
+    const int64_t p = k / A;
+    const scalar_t* anchor = anchors + k * 4;
+    const scalar_t* code = regression + a * 4 * hw + p;
+
+    // BoxCoder.decode
+    const scalar_t width = anchor[2] - anchor[0] + TO_REMOVE;
+    const scalar_t height = anchor[3] - anchor[1] + TO_REMOVE;
+    const scalar_t ctr_x = anchor[0] + static_cast<scalar_t>(0.5) * width;
+    const scalar_t ctr_y = anchor[1] + static_cast<scalar_t>(0.5) * height;
+    const scalar_t dx = code[0] / wx;
+    const scalar_t dy = code[hw] / wy;
+    const scalar_t dw = std::min(code[2 * hw] / ww, clip);
+    const scalar_t dh = std::min(code[3 * hw] / wh, clip);
+    const scalar_t pred_ctr_x = dx * width + ctr_x;
+    const scalar_t pred_ctr_y = dy * height + ctr_y;
+    const scalar_t pred_w = std::exp(dw) * width;
+    const scalar_t pred_h = std::exp(dh) * height;
+
+    // clip_to_image
+    RetinaNetDetection<scalar_t> det;
+    det.box[0] = std::min(std::max(pred_ctr_x - static_cast<scalar_t>(0.5) * pred_w, scalar_t(0)), max_x);
+    det.box[1] = std::min(std::max(pred_ctr_y - static_cast<scalar_t>(0.5) * pred_h, scalar_t(0)), max_y);
+    det.box[2] = std::min(std::max(pred_ctr_x + static_cast<scalar_t>(0.5) * pred_w - 1, scalar_t(0)), max_x);
+    det.box[3] = std::min(std::max(pred_ctr_y + static_cast<scalar_t>(0.5) * pred_h - 1, scalar_t(0)), max_y);
+
+    // remove_small_boxes
+    if (!(det.box[2] - det.box[0] + TO_REMOVE >= min_size &&
+          det.box[3] - det.box[1] + TO_REMOVE >= min_size)) {
+      continue;
+    }
+    det.score = candidate.score;
+    det.label = candidate.position % C + 1;
+    detections.push_back(det);
+  }
+}
+
+// Detections of every image: the candidates of every level, NMS within
+// every (image, class) in parallel, then the fpn_post_nms_top_n best over
+// all classes, ties at the last score kept as torch.kthvalue does. The
+// detections of an image are ordered by class, then by decreasing score.
+template <typename scalar_t>
+std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> retinanet_postprocess_cpu_kernel(
+    const std::vector<at::Tensor>& box_cls,
+    const std::vector<at::Tensor>& box_regression,
+    const std::vector<at::Tensor>& anchors,
+    const std::vector<int64_t>& image_widths,
+    const std::vector<int64_t>& image_heights,
+    const float pre_nms_thresh,
+    const int pre_nms_top_n,
+    const float nms_thresh,
+    const int fpn_post_nms_top_n,
+    const float min_size,
+    const std::vector<double>& weights,
+    const float bbox_xform_clip) {
+  const int64_t num_levels = box_cls.size();
+  const int64_t num_images = image_widths.size();
+
+  std::vector<at::Tensor> box_cls_, box_regression_, anchors_;
+  std::vector<int64_t> num_anchors_per_location(num_levels), num_classes(num_levels);
+  for (int64_t l = 0; l < num_levels; l++) {
+    box_cls_.push_back(box_cls[l].contiguous());
+    box_regression_.push_back(box_regression[l].contiguous());
+    anchors_.push_back(anchors[l].contiguous());
+    num_anchors_per_location[l] = box_regression[l].size(1) / 4;
+    num_classes[l] = box_cls[l].size(1) / num_anchors_per_location[l];
+    AT_ASSERTM(anchors[l].size(1) == box_cls[l].size(2) * box_cls[l].size(3) * num_anchors_per_location[l],
+               "anchors must have H * W * A boxes per image");
+  }
+
+  // forward_for_single_feature_map, one task per (image, level)
+  std::vector<std::vector<RetinaNetDetection<scalar_t>>> level_detections(num_images * num_levels);
+  at::parallel_for(0, num_images * num_levels, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t nl = begin; nl < end; nl++) {
+      const int64_t n = nl / num_levels;
+      const int64_t l = nl % num_levels;
+      const int64_t A = num_anchors_per_location[l];
+      const int64_t C = num_classes[l];
+      const int64_t hw = box_cls_[l].size(2) * box_cls_[l].size(3);
+      retinanet_level_detections<scalar_t>(
+          box_cls_[l].data<scalar_t>() + n * A * C * hw,
+          box_regression_[l].data<scalar_t>() + n * A * 4 * hw,
+          anchors_[l].data<scalar_t>() + n * hw * A * 4,
+          A, C, hw, pre_nms_thresh, pre_nms_top_n, weights, bbox_xform_clip,
+          min_size, image_widths[n], image_heights[n], level_detections[nl]);
+    }
+  });
+
+  // every (image, class) group, its detections by decreasing score
+  std::vector<std::vector<RetinaNetDetection<scalar_t>>> images(num_images);
+  std::vector<int64_t> group_image, group_starts;
+  for (int64_t n = 0; n < num_images; n++) {
+    auto& dets = images[n];
+    for (int64_t l = 0; l < num_levels; l++) {
+      auto& level = level_detections[n * num_levels + l];
+      dets.insert(dets.end(), level.begin(), level.end());
+      std::vector<RetinaNetDetection<scalar_t>>().swap(level);
+    }
+    std::stable_sort(dets.begin(), dets.end(), [](const RetinaNetDetection<scalar_t>& a,
+                                                  const RetinaNetDetection<scalar_t>& b) {
+      return a.label < b.label || (a.label == b.label && a.score > b.score);
+    });
+    for (size_t i = 0; i < dets.size(); i++) {
+      if (i == 0 || dets[i].label != dets[i - 1].label) {
+        group_image.push_back(n);
+        group_starts.push_back(i);
+      }
+    }
+  }
+  const int64_t num_groups = group_image.size();
+
+  // boxlist_nms of every class, in parallel
+  std::vector<std::vector<int64_t>> group_keep(num_groups);
+  at::parallel_for(0, num_groups, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t g = begin; g < end; g++) {
+      const auto& dets = images[group_image[g]];
+      const int64_t start = group_starts[g];
+      const int64_t stop = (g + 1 < num_groups && group_image[g + 1] == group_image[g])
+          ? group_starts[g + 1] : static_cast<int64_t>(dets.size());
+      NMSBoxes<scalar_t> boxes;
+      for (int64_t i = start; i < stop; i++) {
+        const scalar_t* box = dets[i].box;
+        boxes.x1.push_back(box[0]);
+        boxes.y1.push_back(box[1]);
+        boxes.x2.push_back(box[2]);
+        boxes.y2.push_back(box[3]);
+        boxes.areas.push_back((box[2] - box[0] + 1) * (box[3] - box[1] + 1));
+      }
+      nms_bitmask_keep(boxes, nms_thresh, group_keep[g]);
+      for (auto& k : group_keep[g]) {
+        k += start;
+      }
+    }
+  });
+
+  std::vector<std::vector<int64_t>> keep(num_images);
+  for (int64_t g = 0; g < num_groups; g++) {
+    auto& image_keep = keep[group_image[g]];
+    image_keep.insert(image_keep.end(), group_keep[g].begin(), group_keep[g].end());
+  }
+
+  // limit to fpn_post_nms_top_n detections over all classes
+  int64_t num_to_keep = 0;
+  for (int64_t n = 0; n < num_images; n++) {
+    auto& image_keep = keep[n];
+    const auto& dets = images[n];
+    const int64_t num_dets = image_keep.size();
+    if (fpn_post_nms_top_n > 0 && num_dets > fpn_post_nms_top_n) {
+      std::vector<scalar_t> scores(num_dets);
+      for (int64_t i = 0; i < num_dets; i++) {
+        scores[i] = dets[image_keep[i]].score;
+      }
+      std::nth_element(scores.begin(), scores.begin() + fpn_post_nms_top_n - 1,
+                       scores.end(), std::greater<scalar_t>());
+      const scalar_t image_thresh = scores[fpn_post_nms_top_n - 1];
+      image_keep.erase(std::remove_if(image_keep.begin(), image_keep.end(), [&](int64_t i) {
+        return !(dets[i].score >= image_thresh);
+      }), image_keep.end());
+    }
+    num_to_keep += image_keep.size();
+  }
+
+  auto options = box_cls[0].options();
+  at::Tensor boxes_t = at::empty({num_to_keep, 4}, options);
+  at::Tensor scores_t = at::empty({num_to_keep}, options);
+  at::Tensor labels_t = at::empty({num_to_keep}, options.dtype(at::kLong));
+  at::Tensor counts_t = at::empty({num_images}, options.dtype(at::kLong));
+  auto boxes_out = boxes_t.data<scalar_t>();
+  auto scores_out = scores_t.data<scalar_t>();
+  auto labels_out = labels_t.data<int64_t>();
+  auto counts_out = counts_t.data<int64_t>();
+  int64_t i = 0;
+  for (int64_t n = 0; n < num_images; n++) {
+    counts_out[n] = keep[n].size();
+    for (auto k : keep[n]) {
+      const auto& det = images[n][k];
+      std::copy(det.box, det.box + 4, boxes_out + i * 4);
+      scores_out[i] = det.score;
+      labels_out[i] = det.label;
+      i++;
+    }
+  }
+  return std::make_tuple(boxes_t, scores_t, labels_t, counts_t);
+}
+
+std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> RetinaNetPostProcess_cpu(
+    const std::vector<at::Tensor>& box_cls,
+    const std::vector<at::Tensor>& box_regression,
+    const std::vector<at::Tensor>& anchors,
+    const std::vector<int64_t>& image_widths,
+    const std::vector<int64_t>& image_heights,
+    const float pre_nms_thresh,
+    const int pre_nms_top_n,
+    const float nms_thresh,
+    const int fpn_post_nms_top_n,
+    const float min_size,
+    const std::vector<double>& weights,
+    const float bbox_xform_clip) {
+  AT_ASSERTM(!box_cls.empty(), "box_cls must not be empty");
+  AT_ASSERTM(box_regression.size() == box_cls.size() && anchors.size() == box_cls.size(),
+             "box_cls, box_regression and anchors must have one tensor per level");
+  AT_ASSERTM(image_heights.size() == image_widths.size(),
+             "image_widths and image_heights must have the same length");
+  AT_ASSERTM(weights.size() == 4, "weights must have 4 elements");
+  for (size_t l = 0; l < box_cls.size(); l++) {
+    AT_ASSERTM(!box_cls[l].type().is_cuda() && !box_regression[l].type().is_cuda() &&
+               !anchors[l].type().is_cuda(), "inputs must be CPU tensors");
+    AT_ASSERTM(box_cls[l].type() == box_cls[0].type() &&
+               box_regression[l].type() == box_cls[0].type() &&
+               anchors[l].type() == box_cls[0].type(),
+               "inputs must have the same type");
+    AT_ASSERTM(box_cls[l].size(0) == static_cast<int64_t>(image_widths.size()) &&
+               box_regression[l].size(0) == box_cls[l].size(0) &&
+               anchors[l].size(0) == box_cls[l].size(0),
+               "inputs must have one row per image");
+  }
+
+  std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> result;
+  AT_DISPATCH_FLOATING_TYPES(box_cls[0].type(), "RetinaNetPostProcess", [&] {
+    result = retinanet_postprocess_cpu_kernel<scalar_t>(
+        box_cls, box_regression, anchors, image_widths, image_heights,
+        pre_nms_thresh, pre_nms_top_n, nms_thresh, fpn_post_nms_top_n,
+        min_size, weights, bbox_xform_clip);
+  });
+  return result;
+}
@@ -0,0 +1,212 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+#include "cpu/vision.h"
+#include <ATen/Parallel.h>
+
+#include <cmath>
+
+
+// Loss and d(loss)/d(logit) of a single logit. The sigmoid and both
+// log-sigmoids are derived from one exp(-|x|), which keeps them finite for
+// any x (log(p) = min(x, 0) - log1p(exp(-|x|)), and likewise for 1 - p).
+template <typename T>
+struct FocalTerms {
+  T loss;
+  T grad;
+};
+
+template <typename T>
+inline T focal_pow(const T base, const float gamma) {
+  return gamma == 2.f ? base * base : std::pow(base, static_cast<T>(gamma));
+}
+
+template <typename T>
+inline FocalTerms<T> focal_negative(const T x, const float gamma, const T zn) {
+  const T e = std::exp(-std::abs(x));
+  const T inv = 1 / (1 + e);
+  const T p = x >= 0 ? inv : e * inv;
+  const T log_1mp = -std::max(x, T(0)) - std::log1p(e);
+  const T p_g = focal_pow(p, gamma);
+  // p**g * log(1-p), and (p**g) * (g*(1-p)*log(1-p) - p)
+  return {-zn * p_g * log_1mp, -zn * p_g * (gamma * (1 - p) * log_1mp - p)};
+}
+
+template <typename T>
+inline FocalTerms<T> focal_positive(const T x, const float gamma, const T zp) {
+  const T e = std::exp(-std::abs(x));
+  const T inv = 1 / (1 + e);
+  const T p = x >= 0 ? inv : e * inv;
+  const T one_m_p = x >= 0 ? e * inv : inv;
+  const T log_p = std::min(x, T(0)) - std::log1p(e);
+  const T one_m_p_g = focal_pow(one_m_p, gamma);
+  // (1-p)**g * log(p), and (1-p)**g * (1 - p - g*p*log(p))
+  return {-zp * one_m_p_g * log_p,
+          -zp * one_m_p_g * (one_m_p - gamma * p * log_p)};
+}
+
+// One pass over a row of logits. Every class of an anchor is a negative
+// except its label (targets are 1-based, 0 is background and -1 is
+// ignored), so the per-anchor label index is enough and no one-hot target
+// is ever built. Either output may be null. Returns the sum of the row.
+template <typename T>
+inline T SigmoidFocalLoss_row(
+    const T* logits,
+    const int target,
+    const int num_classes,
+    const float gamma,
+    const float alpha,
+    T* losses,
+    T* d_logits) {
+  const T zn = 1.0 - alpha;
+  const T zp = alpha;
+  T row_loss = 0;
+  if (target < 0) {
+    if (losses) std::fill(losses, losses + num_classes, T(0));
+    if (d_logits) std::fill(d_logits, d_logits + num_classes, T(0));
+    return row_loss;
+  }
+  for (int d = 0; d < num_classes; d++) {
+    FocalTerms<T> t = focal_negative(logits[d], gamma, zn);
+    row_loss += t.loss;
+    if (losses) losses[d] = t.loss;
+    if (d_logits) d_logits[d] = t.grad;
+  }
+  int d = target - 1;
+  if (d >= 0 && d < num_classes) {
+    FocalTerms<T> neg = focal_negative(logits[d], gamma, zn);
+    FocalTerms<T> pos = focal_positive(logits[d], gamma, zp);
+    row_loss += pos.loss - neg.loss;
+    if (losses) losses[d] = pos.loss;
+    if (d_logits) d_logits[d] = pos.grad;
+  }
+  return row_loss;
+}
+
+at::Tensor SigmoidFocalLoss_forward_cpu(
+		const at::Tensor& logits,
+                const at::Tensor& targets,
+		const int num_classes,
+		const float gamma,
+		const float alpha) {
+  AT_ASSERTM(!logits.type().is_cuda(), "logits must be a CPU tensor");
+  AT_ASSERTM(!targets.type().is_cuda(), "targets must be a CPU tensor");
+  AT_ASSERTM(logits.dim() == 2, "logits should be NxClass");
+  AT_ASSERTM(logits.size(1) == num_classes, "logits.size(1) should be num_classes");
+
+  const int num_samples = logits.size(0);
+  auto losses = at::empty({num_samples, logits.size(1)}, logits.options());
+
+  if (losses.numel() == 0) {
+    return losses;
+  }
+
+  auto logits_ = logits.contiguous();
+  auto targets_ = targets.contiguous();
+  AT_DISPATCH_FLOATING_TYPES(logits.type(), "SigmoidFocalLoss_forward", [&] {
+    const scalar_t* logits_data = logits_.data<scalar_t>();
+    const int* targets_data = targets_.data<int>();
+    scalar_t* losses_data = losses.data<scalar_t>();
+    at::parallel_for(0, num_samples, 64, [&](int64_t begin, int64_t end) {
+      for (int64_t n = begin; n < end; n++) {
+        SigmoidFocalLoss_row<scalar_t>(
+            logits_data + n * num_classes, targets_data[n], num_classes,
+            gamma, alpha, losses_data + n * num_classes, nullptr);
+      }
+    });
+  });
+  return losses;
+}
+
+at::Tensor SigmoidFocalLoss_backward_cpu(
+		const at::Tensor& logits,
+                const at::Tensor& targets,
+		const at::Tensor& d_losses,
+		const int num_classes,
+		const float gamma,
+		const float alpha) {
+  AT_ASSERTM(!logits.type().is_cuda(), "logits must be a CPU tensor");
+  AT_ASSERTM(!targets.type().is_cuda(), "targets must be a CPU tensor");
+  AT_ASSERTM(!d_losses.type().is_cuda(), "d_losses must be a CPU tensor");
+  AT_ASSERTM(logits.dim() == 2, "logits should be NxClass");
+  AT_ASSERTM(logits.size(1) == num_classes, "logits.size(1) should be num_classes");
+
+  const int num_samples = logits.size(0);
+  auto d_logits = at::empty({num_samples, num_classes}, logits.options());
+
+  if (d_logits.numel() == 0) {
+    return d_logits;
+  }
+
+  auto logits_ = logits.contiguous();
+  auto targets_ = targets.contiguous();
+  auto d_losses_ = d_losses.contiguous();
+  AT_DISPATCH_FLOATING_TYPES(logits.type(), "SigmoidFocalLoss_backward", [&] {
+    const scalar_t* logits_data = logits_.data<scalar_t>();
+    const int* targets_data = targets_.data<int>();
+    const scalar_t* d_losses_data = d_losses_.data<scalar_t>();
+    scalar_t* d_logits_data = d_logits.data<scalar_t>();
+    at::parallel_for(0, num_samples, 64, [&](int64_t begin, int64_t end) {
+      for (int64_t n = begin; n < end; n++) {
+        scalar_t* row = d_logits_data + n * num_classes;
+        SigmoidFocalLoss_row<scalar_t>(
+            logits_data + n * num_classes, targets_data[n], num_classes,
+            gamma, alpha, nullptr, row);
+        const scalar_t* d_row = d_losses_data + n * num_classes;
+        for (int d = 0; d < num_classes; d++) {
+          row[d] *= d_row[d];
+        }
+      }
+    });
+  });
+  return d_logits;
+}
+
+// Summed loss and, if requested, its gradient from the same pass over the
+// logits. This is what SigmoidFocalLoss needs on the CPU: neither the NxC
+// losses nor a second read of the logits in the backward.
+std::tuple<at::Tensor, at::Tensor> SigmoidFocalLoss_fused_cpu(
+		const at::Tensor& logits,
+                const at::Tensor& targets,
+		const int num_classes,
+		const float gamma,
+		const float alpha,
+		const bool compute_grad) {
+  AT_ASSERTM(!logits.type().is_cuda(), "logits must be a CPU tensor");
+  AT_ASSERTM(!targets.type().is_cuda(), "targets must be a CPU tensor");
+  AT_ASSERTM(logits.dim() == 2, "logits should be NxClass");
+  AT_ASSERTM(logits.size(1) == num_classes, "logits.size(1) should be num_classes");
+
+  const int num_samples = logits.size(0);
+  auto loss = at::zeros({}, logits.options());
+  auto d_logits = compute_grad
+      ? at::empty({num_samples, num_classes}, logits.options())
+      : at::empty({0}, logits.options());
+
+  if (num_samples == 0 || num_classes == 0) {
+    return std::make_tuple(loss, d_logits);
+  }
+
+  auto logits_ = logits.contiguous();
+  auto targets_ = targets.contiguous();
+  AT_DISPATCH_FLOATING_TYPES(logits.type(), "SigmoidFocalLoss_fused", [&] {
+    const scalar_t* logits_data = logits_.data<scalar_t>();
+    const int* targets_data = targets_.data<int>();
+    scalar_t* d_logits_data = compute_grad ? d_logits.data<scalar_t>() : nullptr;
+    // per-anchor partial sums, reduced in order so that the result does not
+    // depend on the number of threads
+    std::vector<scalar_t> row_losses(num_samples);
+    at::parallel_for(0, num_samples, 64, [&](int64_t begin, int64_t end) {
+      for (int64_t n = begin; n < end; n++) {
+        row_losses[n] = SigmoidFocalLoss_row<scalar_t>(
+            logits_data + n * num_classes, targets_data[n], num_classes,
+            gamma, alpha, nullptr,
+            d_logits_data ? d_logits_data + n * num_classes : nullptr);
+      }
+    });
+    scalar_t total = 0;
+    for (int n = 0; n < num_samples; n++) {
+      total += row_losses[n];
+    }
+    *loss.data<scalar_t>() = total;
+  });
+  return std::make_tuple(loss, d_logits);
+}
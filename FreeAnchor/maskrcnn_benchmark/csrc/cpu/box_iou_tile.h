@@ -0,0 +1,74 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+// Tiled pairwise IoU of BoxIoU_cpu.cpp, shared with the CPU ops that reduce
+// the IoU of two sets of boxes without storing it.
+#pragma once
+#include <torch/extension.h>
+#include <ATen/Parallel.h>
+
+#include <algorithm>
+#include <vector>
+
+// Boxes of the second set per tile, so that the coordinates of a tile stay
+// in L1 while every box of the first set runs over it.
+constexpr int64_t boxIoUTile = 512;
+
+// Boxes as separate coordinate arrays, with the sides of every box.
+template <typename scalar_t>
+struct BoxIoUColumns {
+  std::vector<scalar_t> x1, y1, x2, y2, w, h;
+};
+
+template <typename scalar_t>
+inline BoxIoUColumns<scalar_t> box_iou_columns(const scalar_t* boxes, const int64_t num_boxes) {
+  const scalar_t TO_REMOVE = 1;
+  BoxIoUColumns<scalar_t> columns;
+  for (auto v : {&columns.x1, &columns.y1, &columns.x2, &columns.y2, &columns.w, &columns.h}) {
+    v->resize(num_boxes);
+  }
+  at::parallel_for(0, num_boxes, 2048, [&](int64_t begin, int64_t end) {
+    for (int64_t j = begin; j < end; j++) {
+      const scalar_t* box = boxes + j * 4;
+      columns.x1[j] = box[0];
+      columns.y1[j] = box[1];
+      columns.x2[j] = box[2];
+      columns.y2[j] = box[3];
+      columns.w[j] = box[2] - box[0] + TO_REMOVE;
+      columns.h[j] = box[3] - box[1] + TO_REMOVE;
+    }
+  });
+  return columns;
+}
+
+// IoU of box with the boxes [start, start + size) of columns, into out, as
+// boxlist_iou computes it, or as boxlist_block_iou does if block.
+template <typename scalar_t, bool block>
+inline void box_iou_tile(const scalar_t* box,
+                         const BoxIoUColumns<scalar_t>& columns,
+                         const int64_t start,
+                         const int64_t size,
+                         scalar_t* out) {
+  const scalar_t TO_REMOVE = 1;
+  const scalar_t* x1 = columns.x1.data() + start;
+  const scalar_t* y1 = columns.y1.data() + start;
+  const scalar_t* x2 = columns.x2.data() + start;
+  const scalar_t* y2 = columns.y2.data() + start;
+  const scalar_t* w = columns.w.data() + start;
+  const scalar_t* h = columns.h.data() + start;
+  const scalar_t bx1 = box[0], by1 = box[1], bx2 = box[2], by2 = box[3];
+  const scalar_t bw = bx2 - bx1 + TO_REMOVE;
+  const scalar_t bh = by2 - by1 + TO_REMOVE;
+  const scalar_t barea = bw * bh;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+  for (int64_t j = 0; j < size; j++) {
+    const scalar_t iw = std::max<scalar_t>(std::min(bx2, x2[j]) - std::max(bx1, x1[j]) + TO_REMOVE, 0);
+    const scalar_t ih = std::max<scalar_t>(std::min(by2, y2[j]) - std::max(by1, y1[j]) + TO_REMOVE, 0);
+    if (block) {
+      out[j] = std::min(iw / (bw + w[j] - iw), ih / (bh + h[j] - ih));
+    } else {
+      const scalar_t inter = iw * ih;
+      out[j] = inter / (barea + w[j] * h[j] - inter);
+    }
+  }
+}
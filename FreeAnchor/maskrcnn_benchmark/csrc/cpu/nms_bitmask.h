@@ -0,0 +1,126 @@
+// Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+// Blocked bitmask NMS of nms_cpu.cpp, shared with the CPU ops that run
+// NMS on boxes they already hold.
+#pragma once
+#include <torch/extension.h>
+#include <ATen/Parallel.h>
+
+#include <vector>
+
+constexpr int boxesPerBlock = sizeof(uint64_t) * 8;
+
+// Sorted boxes as separate coordinate arrays, so that one box can be
+// tested against a whole block of boxes with vector instructions.
+template <typename scalar_t>
+struct NMSBoxes {
+  std::vector<scalar_t> x1, y1, x2, y2, areas;
+};
+
+// Bit j is set if box i overlaps box col_start + j by at least threshold.
+template <typename scalar_t>
+inline uint64_t nms_block_mask(const NMSBoxes<scalar_t>& boxes,
+                               const int64_t i,
+                               const int64_t col_start,
+                               const int col_size,
+                               const float threshold) {
+  const scalar_t* x1 = boxes.x1.data() + col_start;
+  const scalar_t* y1 = boxes.y1.data() + col_start;
+  const scalar_t* x2 = boxes.x2.data() + col_start;
+  const scalar_t* y2 = boxes.y2.data() + col_start;
+  const scalar_t* areas = boxes.areas.data() + col_start;
+  auto ix1 = boxes.x1[i];
+  auto iy1 = boxes.y1[i];
+  auto ix2 = boxes.x2[i];
+  auto iy2 = boxes.y2[i];
+  auto iarea = boxes.areas[i];
+
+  uint8_t over[boxesPerBlock];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+  for (int j = 0; j < col_size; j++) {
+    auto xx1 = std::max(ix1, x1[j]);
+    auto yy1 = std::max(iy1, y1[j]);
+    auto xx2 = std::min(ix2, x2[j]);
+    auto yy2 = std::min(iy2, y2[j]);
+
+    auto w = std::max(static_cast<scalar_t>(0), xx2 - xx1 + 1);
+    auto h = std::max(static_cast<scalar_t>(0), yy2 - yy1 + 1);
+    auto inter = w * h;
+    auto ovr = inter / (iarea + areas[j] - inter);
+    over[j] = ovr >= threshold;
+  }
+  uint64_t mask = 0;
+  for (int j = 0; j < col_size; j++) {
+    mask |= static_cast<uint64_t>(over[j]) << j;
+  }
+  return mask;
+}
+
+// Gathers boxes order[0, n) of an Nx4 array into an NMSBoxes.
+template <typename scalar_t>
+inline void nms_gather_boxes(const scalar_t* dets_data,
+                             const int64_t* order,
+                             const int64_t n,
+                             NMSBoxes<scalar_t>& boxes) {
+  boxes.x1.resize(n);
+  boxes.y1.resize(n);
+  boxes.x2.resize(n);
+  boxes.y2.resize(n);
+  boxes.areas.resize(n);
+  at::parallel_for(0, n, 2048, [&](int64_t begin, int64_t end) {
+    for (int64_t _i = begin; _i < end; _i++) {
+      const scalar_t* box = dets_data + order[_i] * 4;
+      boxes.x1[_i] = box[0];
+      boxes.y1[_i] = box[1];
+      boxes.x2[_i] = box[2];
+      boxes.y2[_i] = box[3];
+      boxes.areas[_i] = (box[2] - box[0] + 1) * (box[3] - box[1] + 1);
+    }
+  });
+}
+
+// Same result as nms_cpu_kernel, organized like the CUDA kernel: boxes are
+// split in blocks of 64 and suppression is tracked as one 64-bit mask per
+// block. Blocks are resolved in score order; once a block is resolved, its
+// kept boxes are tested against all later blocks in parallel. Only the
+// masks of kept boxes are ever computed, and no NxN/64 matrix is stored.
+// Appends the positions (in score order) of the kept boxes to keep.
+template <typename scalar_t>
+inline void nms_bitmask_keep(const NMSBoxes<scalar_t>& boxes,
+                             const float threshold,
+                             std::vector<int64_t>& keep) {
+  const int64_t ndets = boxes.x1.size();
+  const int64_t col_blocks = (ndets + boxesPerBlock - 1) / boxesPerBlock;
+  std::vector<uint64_t> remv(col_blocks, 0);
+  std::vector<int64_t> kept(boxesPerBlock);
+
+  for (int64_t row_block = 0; row_block < col_blocks; row_block++) {
+    const int64_t row_start = row_block * boxesPerBlock;
+    const int row_size = std::min<int64_t>(ndets - row_start, boxesPerBlock);
+
+    // resolve this block; earlier blocks can no longer change its mask
+    int num_kept = 0;
+    for (int i = 0; i < row_size; i++) {
+      if (remv[row_block] & (1ULL << i))
+        continue;
+      kept[num_kept++] = row_start + i;
+      keep.push_back(row_start + i);
+      uint64_t mask = nms_block_mask(boxes, row_start + i, row_start, row_size, threshold);
+      // only boxes after i in score order can be suppressed by it
+      remv[row_block] |= mask & ~((2ULL << i) - 1);
+    }
+
+    at::parallel_for(row_block + 1, col_blocks, 16, [&](int64_t begin, int64_t end) {
+      for (int64_t col_block = begin; col_block < end; col_block++) {
+        const int64_t col_start = col_block * boxesPerBlock;
+        const int col_size = std::min<int64_t>(ndets - col_start, boxesPerBlock);
+        uint64_t mask = remv[col_block];
+        for (int k = 0; k < num_kept; k++) {
+          mask |= nms_block_mask(boxes, kept[k], col_start, col_size, threshold);
+        }
+        remv[col_block] = mask;
+      }
+    });
+  }
+}
@@ -1,5 +1,9 @@
 // Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
 #include "cpu/vision.h"
+#include "cpu/nms_bitmask.h"
+#include <ATen/Parallel.h>
+
+#include <numeric>
 
 
 template <typename scalar_t>
@@ -64,12 +68,154 @@ at::Tensor nms_cpu_kernel(const at::Tensor& dets,
   return at::nonzero(suppressed_t == 0).squeeze(1);
 }
 
+template <typename scalar_t>
+at::Tensor nms_bitmask_cpu_kernel(const at::Tensor& dets,
+                                  const at::Tensor& scores,
+                                  const float threshold) {
+  AT_ASSERTM(!dets.type().is_cuda(), "dets must be a CPU tensor");
+  AT_ASSERTM(!scores.type().is_cuda(), "scores must be a CPU tensor");
+  AT_ASSERTM(dets.type() == scores.type(), "dets should have the same type as scores");
+
+  if (dets.numel() == 0) {
+    return at::empty({0}, dets.options().dtype(at::kLong).device(at::kCPU));
+  }
+
+  auto order_t = std::get<1>(scores.sort(0, /* descending=*/true));
+  auto dets_t = dets.contiguous();
+
+  auto ndets = dets.size(0);
+  auto order = order_t.data<int64_t>();
+
+  NMSBoxes<scalar_t> boxes;
+  nms_gather_boxes(dets_t.data<scalar_t>(), order, ndets, boxes);
+
+  std::vector<int64_t> kept;
+  nms_bitmask_keep(boxes, threshold, kept);
+
+  at::Tensor keep_t = at::zeros({ndets}, dets.options().dtype(at::kByte).device(at::kCPU));
+  auto keep = keep_t.data<uint8_t>();
+  for (auto k : kept) {
+    keep[order[k]] = 1;
+  }
+  return at::nonzero(keep_t).squeeze(1);
+}
+
+// Groups smaller than this are suppressed one per task, in parallel;
+// larger ones one at a time, each using all threads.
+int const batchedNMSLargeGroup = 4096;
+
+// NMS applied independently to every group of boxes sharing an idxs value.
+// Returns the kept indices group by group in increasing group id, each group
+// in increasing index order and truncated to max_per_group (if > 0), which
+// is what concatenating one nms() call per group would give.
+template <typename scalar_t>
+at::Tensor batched_nms_cpu_kernel(const at::Tensor& dets,
+                                  const at::Tensor& scores,
+                                  const at::Tensor& idxs,
+                                  const float threshold,
+                                  const int max_per_group) {
+  AT_ASSERTM(!dets.type().is_cuda(), "dets must be a CPU tensor");
+  AT_ASSERTM(!scores.type().is_cuda(), "scores must be a CPU tensor");
+  AT_ASSERTM(!idxs.type().is_cuda(), "idxs must be a CPU tensor");
+  AT_ASSERTM(dets.type() == scores.type(), "dets should have the same type as scores");
+  AT_ASSERTM(idxs.type().scalarType() == at::kLong, "idxs should be a Long tensor");
+
+  if (dets.numel() == 0) {
+    return at::empty({0}, dets.options().dtype(at::kLong).device(at::kCPU));
+  }
+
+  auto dets_t = dets.contiguous();
+  auto scores_t = scores.contiguous();
+  auto idxs_t = idxs.contiguous();
+  auto ndets = dets.size(0);
+  auto dets_data = dets_t.data<scalar_t>();
+  auto scores_data = scores_t.data<scalar_t>();
+  auto idxs_data = idxs_t.data<int64_t>();
+
+  // partition: boxes ordered by group, then by decreasing score
+  std::vector<int64_t> order(ndets);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int64_t a, int64_t b) {
+    return idxs_data[a] < idxs_data[b];
+  });
+  std::vector<int64_t> group_starts;
+  for (int64_t i = 0; i < ndets; i++) {
+    if (i == 0 || idxs_data[order[i]] != idxs_data[order[i - 1]]) {
+      group_starts.push_back(i);
+    }
+  }
+  const int64_t num_groups = group_starts.size();
+  group_starts.push_back(ndets);
+
+  std::vector<std::vector<int64_t>> group_keep(num_groups);
+  auto run_group = [&](int64_t g) {
+    int64_t* group_order = order.data() + group_starts[g];
+    int64_t n = group_starts[g + 1] - group_starts[g];
+    std::stable_sort(group_order, group_order + n, [&](int64_t a, int64_t b) {
+      return scores_data[a] > scores_data[b];
+    });
+    NMSBoxes<scalar_t> boxes;
+    nms_gather_boxes(dets_data, group_order, n, boxes);
+    std::vector<int64_t>& keep = group_keep[g];
+    nms_bitmask_keep(boxes, threshold, keep);
+    for (auto& k : keep) {
+      k = group_order[k];
+    }
+    std::sort(keep.begin(), keep.end());
+    if (max_per_group > 0 && keep.size() > static_cast<size_t>(max_per_group)) {
+      keep.resize(max_per_group);
+    }
+  };
+
+  std::vector<int64_t> small_groups;
+  for (int64_t g = 0; g < num_groups; g++) {
+    if (group_starts[g + 1] - group_starts[g] >= batchedNMSLargeGroup) {
+      run_group(g);
+    } else {
+      small_groups.push_back(g);
+    }
+  }
+  at::parallel_for(0, small_groups.size(), 1, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; i++) {
+      run_group(small_groups[i]);
+    }
+  });
+
+  int64_t num_to_keep = 0;
+  for (const auto& keep : group_keep) {
+    num_to_keep += keep.size();
+  }
+  at::Tensor keep_t = at::empty({num_to_keep}, dets.options().dtype(at::kLong).device(at::kCPU));
+  auto keep_out = keep_t.data<int64_t>();
+  for (const auto& keep : group_keep) {
+    keep_out = std::copy(keep.begin(), keep.end(), keep_out);
+  }
+  return keep_t;
+}
+
 at::Tensor nms_cpu(const at::Tensor& dets,
                const at::Tensor& scores,
-               const float threshold) {
+               const float threshold,
+               const bool bitmask) {
   at::Tensor result;
   AT_DISPATCH_FLOATING_TYPES(dets.type(), "nms", [&] {
-    result = nms_cpu_kernel<scalar_t>(dets, scores, threshold);
+    if (bitmask) {
+      result = nms_bitmask_cpu_kernel<scalar_t>(dets, scores, threshold);
+    } else {
+      result = nms_cpu_kernel<scalar_t>(dets, scores, threshold);
+    }
+  });
+  return result;
+}
+
+at::Tensor batched_nms_cpu(const at::Tensor& dets,
+                           const at::Tensor& scores,
+                           const at::Tensor& idxs,
+                           const float threshold,
+                           const int max_per_group) {
+  at::Tensor result;
+  AT_DISPATCH_FLOATING_TYPES(dets.type(), "batched_nms", [&] {
+    result = batched_nms_cpu_kernel<scalar_t>(dets, scores, idxs, threshold, max_per_group);
   });
   return result;
 }
@@ -3,6 +3,29 @@
 #include <torch/extension.h>
 
 
+at::Tensor SigmoidFocalLoss_forward_cpu(
+		const at::Tensor& logits,
+                const at::Tensor& targets,
+		const int num_classes,
+		const float gamma,
+		const float alpha);
+
+at::Tensor SigmoidFocalLoss_backward_cpu(
+			     const at::Tensor& logits,
+                             const at::Tensor& targets,
+			     const at::Tensor& d_losses,
+			     const int num_classes,
+			     const float gamma,
+			     const float alpha);
+
+std::tuple<at::Tensor, at::Tensor> SigmoidFocalLoss_fused_cpu(
+		const at::Tensor& logits,
+                const at::Tensor& targets,
+		const int num_classes,
+		const float gamma,
+		const float alpha,
+		const bool compute_grad);
+
 at::Tensor ROIAlign_forward_cpu(const at::Tensor& input,
                                 const at::Tensor& rois,
                                 const float spatial_scale,
@@ -10,7 +33,126 @@ at::Tensor ROIAlign_forward_cpu(const at::Tensor& input,
                                 const int pooled_width,
                                 const int sampling_ratio);
 
+at::Tensor ROIAlign_backward_cpu(const at::Tensor& grad,
+                                 const at::Tensor& rois,
+                                 const float spatial_scale,
+                                 const int pooled_height,
+                                 const int pooled_width,
+                                 const int batch_size,
+                                 const int channels,
+                                 const int height,
+                                 const int width,
+                                 const int sampling_ratio);
+
+at::Tensor MultiLevelROIAlign_forward_cpu(const std::vector<at::Tensor>& inputs,
+                                          const at::Tensor& rois,
+                                          const std::vector<double>& spatial_scales,
+                                          const int pooled_height,
+                                          const int pooled_width,
+                                          const int sampling_ratio,
+                                          const float canonical_scale,
+                                          const float canonical_level);
+
+std::vector<at::Tensor> MultiLevelROIAlign_backward_cpu(const at::Tensor& grad,
+                                                        const at::Tensor& rois,
+                                                        const std::vector<double>& spatial_scales,
+                                                        const int pooled_height,
+                                                        const int pooled_width,
+                                                        const int batch_size,
+                                                        const int channels,
+                                                        const std::vector<int64_t>& heights,
+                                                        const std::vector<int64_t>& widths,
+                                                        const int sampling_ratio,
+                                                        const float canonical_scale,
+                                                        const float canonical_level);
+
+
+std::tuple<at::Tensor, at::Tensor> ROIPool_forward_cpu(const at::Tensor& input,
+                                const at::Tensor& rois,
+                                const float spatial_scale,
+                                const int pooled_height,
+                                const int pooled_width);
+
+at::Tensor ROIPool_backward_cpu(const at::Tensor& grad,
+                                const at::Tensor& input,
+                                const at::Tensor& rois,
+                                const at::Tensor& argmax,
+                                const float spatial_scale,
+                                const int pooled_height,
+                                const int pooled_width,
+                                const int batch_size,
+                                const int channels,
+                                const int height,
+                                const int width);
+
 
 at::Tensor nms_cpu(const at::Tensor& dets,
                    const at::Tensor& scores,
-                   const float threshold);
+                   const float threshold,
+                   const bool bitmask);
+
+at::Tensor batched_nms_cpu(const at::Tensor& dets,
+                           const at::Tensor& scores,
+                           const at::Tensor& idxs,
+                           const float threshold,
+                           const int max_per_group);
+
+
+std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> RetinaNetPostProcess_cpu(
+    const std::vector<at::Tensor>& box_cls,
+    const std::vector<at::Tensor>& box_regression,
+    const std::vector<at::Tensor>& anchors,
+    const std::vector<int64_t>& image_widths,
+    const std::vector<int64_t>& image_heights,
+    const float pre_nms_thresh,
+    const int pre_nms_top_n,
+    const float nms_thresh,
+    const int fpn_post_nms_top_n,
+    const float min_size,
+    const std::vector<double>& weights,
+    const float bbox_xform_clip);
+
+
+std::tuple<at::Tensor, at::Tensor> BoxIoUTopK_cpu(const at::Tensor& boxes,
+                                                  const at::Tensor& anchors,
+                                                  const int k);
+
+std::tuple<at::Tensor, at::Tensor> BoxIoUClassProb_cpu(const at::Tensor& boxes,
+                                                       const at::Tensor& labels,
+                                                       const at::Tensor& anchors,
+                                                       const int num_classes,
+                                                       const float threshold);
+
+at::Tensor BoxIoU_cpu(const at::Tensor& boxes1,
+                      const at::Tensor& boxes2,
+                      const bool block);
+
+std::tuple<at::Tensor, at::Tensor> BoxIoUMax_cpu(const at::Tensor& boxes1,
+                                                 const at::Tensor& boxes2,
+                                                 const bool block,
+                                                 const int dim);
+
+at::Tensor MatchBoxes_cpu(const at::Tensor& gt_boxes,
+                          const at::Tensor& boxes,
+                          const float high_threshold,
+                          const float low_threshold,
+                          const bool allow_low_quality_matches,
+                          const float low_quality_threshold);
+
+
+at::Tensor BoxEncode_cpu(const at::Tensor& reference_boxes,
+                         const at::Tensor& proposals,
+                         const std::vector<double>& weights);
+
+at::Tensor BoxDecode_cpu(const at::Tensor& rel_codes,
+                         const at::Tensor& boxes,
+                         const std::vector<double>& weights,
+                         const float bbox_xform_clip);
+
+std::tuple<at::Tensor, at::Tensor> BoxDecodeClip_cpu(const at::Tensor& rel_codes,
+                                                     const at::Tensor& boxes,
+                                                     const std::vector<double>& weights,
+                                                     const float bbox_xform_clip,
+                                                     const int image_width,
+                                                     const int image_height,
+                                                     const float min_size);
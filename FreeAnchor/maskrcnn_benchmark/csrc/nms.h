@@ -7,9 +7,12 @@
 #endif
 
 
+// bitmask selects the blocked bitmask engine on the CPU; false runs the
+// plain sequential loop. Both keep the same boxes.
 at::Tensor nms(const at::Tensor& dets,
                const at::Tensor& scores,
-               const float threshold) {
+               const float threshold,
+               const bool bitmask) {
 
   if (dets.type().is_cuda()) {
 #ifdef WITH_CUDA
@@ -23,6 +26,66 @@ at::Tensor nms(const at::Tensor& dets,
 #endif
   }
 
-  at::Tensor result = nms_cpu(dets, scores, threshold);
+  at::Tensor result = nms_cpu(dets, scores, threshold, bitmask);
   return result;
 }
+
+#ifdef WITH_CUDA
+// Orders the indices kept by one NMS over all groups (in increasing index
+// order) the same way as batched_nms_cpu: by group, then by index, with at
+// most max_per_group per group. keep and idxs are CPU tensors, and so is
+// the result.
+inline at::Tensor batched_nms_group_keep(const at::Tensor& keep,
+                                         const at::Tensor& idxs,
+                                         const int max_per_group) {
+  auto keep_data = keep.data<int64_t>();
+  auto idxs_data = idxs.data<int64_t>();
+  std::vector<int64_t> order(keep_data, keep_data + keep.numel());
+  std::stable_sort(order.begin(), order.end(), [&](int64_t a, int64_t b) {
+    return idxs_data[a] < idxs_data[b];
+  });
+  std::vector<int64_t> result;
+  int64_t count = 0;
+  for (size_t i = 0; i < order.size(); i++) {
+    if (i == 0 || idxs_data[order[i]] != idxs_data[order[i - 1]]) {
+      count = 0;
+    }
+    if (max_per_group <= 0 || count < max_per_group) {
+      result.push_back(order[i]);
+    }
+    count++;
+  }
+  at::Tensor keep_t = at::empty({static_cast<int64_t>(result.size())},
+                                keep.options().device(at::kCPU));
+  std::copy(result.begin(), result.end(), keep_t.data<int64_t>());
+  return keep_t;
+}
+#endif
+
+// NMS within each group of boxes sharing an idxs value, in a single call.
+at::Tensor batched_nms(const at::Tensor& dets,
+                       const at::Tensor& scores,
+                       const at::Tensor& idxs,
+                       const float threshold,
+                       const int max_per_group) {
+
+  if (dets.type().is_cuda()) {
+#ifdef WITH_CUDA
+    if (dets.numel() == 0)
+      return at::empty({0}, dets.options().dtype(at::kLong));
+    // move every group to its own region so that boxes of different groups
+    // never overlap, and run a single NMS over all of them
+    auto extent = dets.max() - dets.min() + 2;
+    auto offsets = idxs.toType(dets.type()) * extent;
+    auto b = at::cat({dets + offsets.unsqueeze(1), scores.unsqueeze(1)}, 1);
+    // the kept indices are grouped on the host
+    auto keep = nms_cuda(b, threshold).cpu();
+    auto keep_t = batched_nms_group_keep(keep, idxs.contiguous().cpu(), max_per_group);
+    return keep_t.to(dets.device());
+#else
+    AT_ERROR("Not compiled with GPU support");
+#endif
+  }
+
+  return batched_nms_cpu(dets, scores, idxs, threshold, max_per_group);
+}
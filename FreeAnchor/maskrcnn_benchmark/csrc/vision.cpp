@@ -1,15 +1,36 @@
 // Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
 #include "nms.h"
+#include "BoxCoder.h"
+#include "BoxIoU.h"
 #include "ROIAlign.h"
 #include "ROIPool.h"
+#include "RetinaNetPostProcess.h"
 #include "SigmoidFocalLoss.h"
 
 PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
-  m.def("nms", &nms, "non-maximum suppression");
+  m.def("nms", &nms, "non-maximum suppression",
+        pybind11::arg("dets"), pybind11::arg("scores"), pybind11::arg("threshold"),
+        pybind11::arg("bitmask") = true);
+  m.def("batched_nms", &batched_nms, "non-maximum suppression within each group of boxes");
+  m.def("box_encode", &BoxEncode, "BoxCoder.encode");
+  m.def("box_decode", &BoxDecode, "BoxCoder.decode");
+  m.def("box_decode_clip", &BoxDecodeClip, "BoxCoder.decode, clip_to_image and remove_small_boxes");
+  m.def("box_iou", &BoxIoU, "pairwise IoU of two sets of boxes",
+        pybind11::arg("boxes1"), pybind11::arg("boxes2"), pybind11::arg("block") = false);
+  m.def("box_iou_max", &BoxIoUMax, "max and argmax over dim of box_iou",
+        pybind11::arg("boxes1"), pybind11::arg("boxes2"), pybind11::arg("block") = false,
+        pybind11::arg("dim") = 0);
+  m.def("match_boxes", &MatchBoxes, "Matcher on the IoU of two sets of boxes");
+  m.def("box_iou_topk", &BoxIoUTopK, "top k anchors of every box by IoU");
+  m.def("box_iou_class_prob", &BoxIoUClassProb, "sparse FreeAnchor negative bag probabilities");
   m.def("roi_align_forward", &ROIAlign_forward, "ROIAlign_forward");
   m.def("roi_align_backward", &ROIAlign_backward, "ROIAlign_backward");
+  m.def("multilevel_roi_align_forward", &MultiLevelROIAlign_forward, "MultiLevelROIAlign_forward");
+  m.def("multilevel_roi_align_backward", &MultiLevelROIAlign_backward, "MultiLevelROIAlign_backward");
   m.def("roi_pool_forward", &ROIPool_forward, "ROIPool_forward");
   m.def("roi_pool_backward", &ROIPool_backward, "ROIPool_backward");
+  m.def("retinanet_postprocess", &RetinaNetPostProcess, "RetinaNetPostProcess");
   m.def("sigmoid_focalloss_forward", &SigmoidFocalLoss_forward, "SigmoidFocalLoss_forward");
   m.def("sigmoid_focalloss_backward", &SigmoidFocalLoss_backward, "SigmoidFocalLoss_backward");
+  m.def("sigmoid_focalloss_fused", &SigmoidFocalLoss_fused, "SigmoidFocalLoss_fused");
 }
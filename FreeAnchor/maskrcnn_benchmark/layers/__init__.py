@@ -6,15 +6,29 @@ from .misc import Conv2d
 from .misc import ConvTranspose2d
 from .misc import interpolate
 from .nms import nms
+from .nms import batched_nms
+from .box_coder import box_encode
+from .box_coder import box_decode
+from .box_coder import box_decode_clip
+from .box_iou import box_iou
+from .box_iou import box_iou_max
+from .box_iou import box_iou_topk
+from .box_iou import box_iou_class_prob
+from .box_iou import match_boxes
 from .roi_align import ROIAlign
 from .roi_align import roi_align
+from .roi_align import multilevel_roi_align
 from .roi_pool import ROIPool
 from .roi_pool import roi_pool
+from .retinanet_postprocess import retinanet_postprocess
 from .smooth_l1_loss import smooth_l1_loss, SmoothL1Loss
 from .sigmoid_focal_loss import SigmoidFocalLoss
 from .adjust_smooth_l1_loss import AdjustSmoothL1Loss
 
-__all__ = ["nms", "roi_align", "ROIAlign", "roi_pool", "ROIPool",
+__all__ = ["nms", "batched_nms", "box_encode", "box_decode", "box_decode_clip",
+           "box_iou", "box_iou_max", "box_iou_topk", "box_iou_class_prob",
+           "match_boxes", "roi_align", "ROIAlign", "multilevel_roi_align",
+           "roi_pool", "ROIPool", "retinanet_postprocess",
            "smooth_l1_loss", "SmoothL1Loss", "Conv2d", "ConvTranspose2d",
            "interpolate", "FrozenBatchNorm2d", "SigmoidFocalLoss",
            "AdjustSmoothL1Loss"]
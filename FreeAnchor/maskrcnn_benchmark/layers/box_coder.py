@@ -0,0 +1,6 @@
+# Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+from maskrcnn_benchmark import _C
+
+box_encode = _C.box_encode
+box_decode = _C.box_decode
+box_decode_clip = _C.box_decode_clip
@@ -0,0 +1,8 @@
+# Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+from maskrcnn_benchmark import _C
+
+box_iou = _C.box_iou
+box_iou_max = _C.box_iou_max
+box_iou_topk = _C.box_iou_topk
+match_boxes = _C.match_boxes
+box_iou_class_prob = _C.box_iou_class_prob
@@ -3,5 +3,6 @@
 from maskrcnn_benchmark import _C
 
 nms = _C.nms
+batched_nms = _C.batched_nms
 # nms.__doc__ = """
 # This function performs Non-maximum suppresion"""
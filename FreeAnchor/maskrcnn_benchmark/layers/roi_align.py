@@ -47,6 +47,59 @@ class _ROIAlign(Function):
 roi_align = _ROIAlign.apply
 
 
+class _MultiLevelROIAlign(Function):
+    """
+    ROIAlign of every roi on the FPN level LevelMapper maps it to, in one
+    pass over the rois on the CPU, without gathering the rois of every level
+    or scattering their results.
+    """
+    @staticmethod
+    def forward(ctx, rois, output_size, spatial_scales, sampling_ratio,
+                canonical_scale, canonical_level, *inputs):
+        ctx.save_for_backward(rois)
+        ctx.output_size = _pair(output_size)
+        ctx.spatial_scales = spatial_scales
+        ctx.sampling_ratio = sampling_ratio
+        ctx.canonical_scale = canonical_scale
+        ctx.canonical_level = canonical_level
+        ctx.input_shapes = [input.size() for input in inputs]
+        output = _C.multilevel_roi_align_forward(
+            list(inputs), rois, spatial_scales, ctx.output_size[0], ctx.output_size[1],
+            sampling_ratio, canonical_scale, canonical_level
+        )
+        return output
+
+    @staticmethod
+    @once_differentiable
+    def backward(ctx, grad_output):
+        rois, = ctx.saved_tensors
+        output_size = ctx.output_size
+        bs, ch = ctx.input_shapes[0][:2]
+        grad_inputs = _C.multilevel_roi_align_backward(
+            grad_output,
+            rois,
+            ctx.spatial_scales,
+            output_size[0],
+            output_size[1],
+            bs,
+            ch,
+            [shape[2] for shape in ctx.input_shapes],
+            [shape[3] for shape in ctx.input_shapes],
+            ctx.sampling_ratio,
+            ctx.canonical_scale,
+            ctx.canonical_level,
+        )
+        return (None, None, None, None, None, None) + tuple(grad_inputs)
+
+
+def multilevel_roi_align(inputs, rois, output_size, spatial_scales, sampling_ratio,
+                         canonical_scale=224, canonical_level=4):
+    return _MultiLevelROIAlign.apply(
+        rois, output_size, list(spatial_scales), sampling_ratio,
+        canonical_scale, canonical_level, *inputs
+    )
+
+
 class ROIAlign(nn.Module):
     def __init__(self, output_size, spatial_scale, sampling_ratio):
         super(ROIAlign, self).__init__()
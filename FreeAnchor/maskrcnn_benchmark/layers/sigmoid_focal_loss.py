@@ -36,6 +36,29 @@ class _SigmoidFocalLoss(Function):
 sigmoid_focalloss = _SigmoidFocalLoss.apply
 
 
+class _SigmoidFocalLossFused(Function):
+    """
+    Summed focal loss on the CPU. The gradient comes out of the same pass
+    over the logits as the loss, so backward only has to scale it.
+    """
+    @staticmethod
+    def forward(ctx, logits, targets, num_classes, gamma, alpha):
+        loss, d_logits = _C.sigmoid_focalloss_fused(
+            logits, targets, num_classes, gamma, alpha, ctx.needs_input_grad[0]
+        )
+        ctx.save_for_backward(d_logits)
+        return loss
+
+    @staticmethod
+    @once_differentiable
+    def backward(ctx, d_loss):
+        d_logits, = ctx.saved_tensors
+        return d_logits * d_loss, None, None, None, None
+
+
+sigmoid_focalloss_fused = _SigmoidFocalLossFused.apply
+
+
 class SigmoidFocalLoss(nn.Module):
     def __init__(self, num_classes, gamma, alpha):
         super(SigmoidFocalLoss, self).__init__()
@@ -44,6 +67,10 @@ class SigmoidFocalLoss(nn.Module):
         self.alpha = alpha
 
     def forward(self, logits, targets):
+        if not logits.is_cuda:
+            return sigmoid_focalloss_fused(
+                logits, targets, self.num_classes, self.gamma, self.alpha
+            )
         loss = sigmoid_focalloss(
             logits, targets, self.num_classes, self.gamma, self.alpha
         )
@@ -3,6 +3,10 @@ import math
 
 import torch
 
+from maskrcnn_benchmark.layers import box_decode as _box_decode
+from maskrcnn_benchmark.layers import box_decode_clip as _box_decode_clip
+from maskrcnn_benchmark.layers import box_encode as _box_encode
+
 
 class BoxCoder(object):
     """
@@ -28,6 +32,12 @@ class BoxCoder(object):
             reference_boxes (Tensor): reference boxes
             proposals (Tensor): boxes to be encoded
         """
+        if self._native(reference_boxes, proposals):
+            reference_boxes, proposals = torch.broadcast_tensors(reference_boxes, proposals)
+            targets = _box_encode(
+                reference_boxes.reshape(-1, 4), proposals.reshape(-1, 4), list(self.weights)
+            )
+            return targets.view(proposals.shape)
 
         TO_REMOVE = 1  # TODO remove
         ex_widths = proposals[..., 2] - proposals[..., 0] + TO_REMOVE
@@ -58,6 +68,8 @@ class BoxCoder(object):
             rel_codes (Tensor): encoded boxes
             boxes (Tensor): reference boxes.
         """
+        if self._native(rel_codes, boxes):
+            return _box_decode(rel_codes, boxes, list(self.weights), self.bbox_xform_clip)
 
         boxes = boxes.to(rel_codes.dtype)
 
@@ -93,3 +105,38 @@ class BoxCoder(object):
         pred_boxes[:, 3::4] = pred_ctr_y + 0.5 * pred_h - 1
 
         return pred_boxes
+
+    def decode_clip(self, rel_codes, boxes, image_size, min_size):
+        """
+        decode, then clip_to_image(remove_empty=False) and remove_small_boxes
+        of the decoded boxes, in a single pass on the CPU.
+
+        Arguments:
+            rel_codes (Tensor): Nx4 encoded boxes
+            boxes (Tensor): Nx4 reference boxes.
+            image_size (tuple): (width, height) of the image
+            min_size (int)
+
+        Returns:
+            pred_boxes (Tensor): the kept decoded boxes
+            keep (Tensor[int64]): their indices in boxes
+        """
+        if self._native(rel_codes, boxes):
+            return _box_decode_clip(
+                rel_codes, boxes, list(self.weights), self.bbox_xform_clip,
+                image_size[0], image_size[1], min_size
+            )
+
+        TO_REMOVE = 1
+        pred_boxes = self.decode(rel_codes, boxes)
+        pred_boxes[:, 0::2] = pred_boxes[:, 0::2].clamp(min=0, max=image_size[0] - TO_REMOVE)
+        pred_boxes[:, 1::2] = pred_boxes[:, 1::2].clamp(min=0, max=image_size[1] - TO_REMOVE)
+        ws = pred_boxes[:, 2] - pred_boxes[:, 0] + TO_REMOVE
+        hs = pred_boxes[:, 3] - pred_boxes[:, 1] + TO_REMOVE
+        keep = ((ws >= min_size) & (hs >= min_size)).nonzero().squeeze(1)
+        return pred_boxes[keep], keep
+
+    @staticmethod
+    def _native(*tensors):
+        # the CPU kernels have no backward
+        return not any(t.is_cuda or t.requires_grad for t in tensors)
@@ -1,6 +1,9 @@
 # Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
 import torch
 
+from maskrcnn_benchmark.layers import match_boxes
+from maskrcnn_benchmark.structures.boxlist_ops import boxlist_iou
+
 
 class Matcher(object):
     """
@@ -63,7 +66,41 @@ class Matcher(object):
         if self.allow_low_quality_matches:
             all_matches = matches.clone()
 
-        # Assign candidate matches with low quality to negative (unassigned) values
+        self.set_thresholds_(matches, matched_vals)
+
+        if self.allow_low_quality_matches:
+            self.set_low_quality_matches_(matches, all_matches, match_quality_matrix)
+
+        return matches
+
+    def match_boxlists(self, boxlist1, boxlist2):
+        """
+        Same as calling the matcher on boxlist_iou(boxlist1, boxlist2). On the
+        CPU the IoU is computed tile by tile and only the best gt of every
+        prediction, the best quality of every gt and its ties are kept, never
+        the MxN matrix.
+
+        Args:
+            boxlist1 (BoxList): the M ground-truth boxes
+            boxlist2 (BoxList): the N predicted boxes
+
+        Returns:
+            matches (Tensor[int64]): as __call__
+        """
+        if boxlist1.bbox.is_cuda:
+            return self(boxlist_iou(boxlist1, boxlist2))
+        if boxlist1.size != boxlist2.size:
+            raise RuntimeError(
+                "boxlists should have same image size, got {}, {}".format(boxlist1, boxlist2))
+        return match_boxes(
+            boxlist1.bbox, boxlist2.bbox, self.high_threshold, self.low_threshold,
+            self.allow_low_quality_matches, self.low_quality_threshold
+        )
+
+    def set_thresholds_(self, matches, matched_vals):
+        """
+        Assign candidate matches with low quality to negative (unassigned) values
+        """
         below_low_threshold = matched_vals < self.low_threshold
         between_thresholds = (matched_vals >= self.low_threshold) & (
             matched_vals < self.high_threshold
@@ -71,11 +108,6 @@ class Matcher(object):
         matches[below_low_threshold] = Matcher.BELOW_LOW_THRESHOLD
         matches[between_thresholds] = Matcher.BETWEEN_THRESHOLDS
 
-        if self.allow_low_quality_matches:
-            self.set_low_quality_matches_(matches, all_matches, match_quality_matrix)
-
-        return matches
-
     def set_low_quality_matches_(self, matches, all_matches, match_quality_matrix):
         """
         Produce additional matches for predictions that have only low-quality matches.
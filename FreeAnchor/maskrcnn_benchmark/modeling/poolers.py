@@ -4,6 +4,7 @@ import torch.nn.functional as F
 from torch import nn
 
 from maskrcnn_benchmark.layers import ROIAlign
+from maskrcnn_benchmark.layers import multilevel_roi_align
 
 from .utils import cat
 
@@ -60,6 +61,8 @@ class Pooler(nn.Module):
             sampling_ratio (int): sampling ratio for ROIAlign
         """
         super(Pooler, self).__init__()
+        self.scales = scales
+        self.sampling_ratio = sampling_ratio
         poolers = []
         for scale in scales:
             poolers.append(
@@ -103,6 +106,14 @@ class Pooler(nn.Module):
         if num_levels == 1:
             return self.poolers[0](x[0], rois)
 
+        if not rois.is_cuda and all(b.mode == "xyxy" for b in boxes):
+            # levels, pooling and scatter in a single pass of the CPU op;
+            # x may have more levels than the pooler, as zip drops below
+            return multilevel_roi_align(
+                x[:num_levels], rois, self.output_size, self.scales, self.sampling_ratio,
+                self.map_levels.s0, self.map_levels.lvl0
+            )
+
         levels = self.map_levels(boxes)
 
         num_rois = len(rois)
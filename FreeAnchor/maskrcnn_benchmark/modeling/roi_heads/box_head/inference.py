@@ -4,8 +4,7 @@ import torch.nn.functional as F
 from torch import nn
 
 from maskrcnn_benchmark.structures.bounding_box import BoxList
-from maskrcnn_benchmark.structures.boxlist_ops import boxlist_nms
-from maskrcnn_benchmark.structures.boxlist_ops import cat_boxlist
+from maskrcnn_benchmark.structures.boxlist_ops import boxlist_batched_nms
 from maskrcnn_benchmark.modeling.box_coder import BoxCoder
 
 
@@ -99,32 +98,23 @@ class PostProcessor(nn.Module):
         applying non-maximum suppression (NMS).
         """
         # unwrap the boxlist to avoid additional overhead.
-        # if we had multi-class NMS, we could perform this directly on the boxlist
-        boxes = boxlist.bbox.reshape(-1, num_classes * 4)
+        boxes = boxlist.bbox.reshape(-1, num_classes, 4)
         scores = boxlist.get_field("scores").reshape(-1, num_classes)
 
-        device = scores.device
-        result = []
         # Apply threshold on detection probabilities and apply NMS
         # Skip j = 0, because it's the background class
-        inds_all = scores > self.score_thresh
         no_background = int(self.free_anchor)
-        for j in range(1 - no_background, num_classes - no_background):
-            inds = inds_all[:, j].nonzero().squeeze(1)
-            scores_j = scores[inds, j]
-            boxes_j = boxes[inds, j * 4 : (j + 1) * 4]
-            boxlist_for_class = BoxList(boxes_j, boxlist.size, mode="xyxy")
-            boxlist_for_class.add_field("scores", scores_j)
-            boxlist_for_class = boxlist_nms(
-                boxlist_for_class, self.nms, score_field="scores"
-            )
-            num_labels = len(boxlist_for_class)
-            boxlist_for_class.add_field(
-                "labels", torch.full((num_labels,), j + no_background, dtype=torch.int64, device=device)
-            )
-            result.append(boxlist_for_class)
-
-        result = cat_boxlist(result)
+        first_class = 1 - no_background
+        last_class = num_classes - no_background
+        inds_all = scores[:, first_class:last_class] > self.score_thresh
+        inds, classes = inds_all.nonzero().unbind(dim=1)
+        classes = classes + first_class
+
+        result = BoxList(boxes[inds, classes], boxlist.size, mode="xyxy")
+        result.add_field("scores", scores[inds, classes])
+        result.add_field("labels", classes + no_background)
+        # all classes in one call; keeps the per-class order of the boxes
+        result = boxlist_batched_nms(result, self.nms, score_field="scores")
         number_of_detections = len(result)
 
         # Limit to max_per_image detections **over all classes**
@@ -11,6 +11,8 @@ from torch.autograd.function import once_differentiable
 
 from ..utils import cat
 
+from maskrcnn_benchmark.layers import box_iou_class_prob
+from maskrcnn_benchmark.layers import box_iou_topk
 from maskrcnn_benchmark.modeling.matcher import Matcher
 from maskrcnn_benchmark.structures.boxlist_ops import BoxList
 from maskrcnn_benchmark.structures.boxlist_ops import boxlist_iou
@@ -105,58 +107,73 @@ class FreeAnchorLossComputation(object):
                 # box_localization: a_{j}^{loc}, shape: [j, 4]
                 box_localization = self.box_coder.decode(box_regression_, anchors_.bbox)
 
-                # object_box_iou: IoU_{ij}^{loc}, shape: [i, j]
-                object_box_iou = boxlist_iou(
-                    targets_,
-                    BoxList(box_localization, anchors_.size, mode='xyxy')
-                )
+                if not box_localization.is_cuda:
+                    # image_box_prob: P{a_{j} \in A_{+}}, shape: [j, c], from
+                    # its nonzero entries only
+                    indices, nonzero_box_prob = box_iou_class_prob(
+                        targets_.bbox, labels_, box_localization,
+                        self.num_classes, self.bbox_threshold
+                    )
+                    image_box_prob = torch.zeros(
+                        anchors_.bbox.size(0), self.num_classes
+                    ).type_as(box_localization)
+                    image_box_prob[indices[0], indices[1]] = nonzero_box_prob
+                else:
+                    # object_box_iou: IoU_{ij}^{loc}, shape: [i, j]
+                    object_box_iou = boxlist_iou(
+                        targets_,
+                        BoxList(box_localization, anchors_.size, mode='xyxy')
+                    )
 
-                t1 = self.bbox_threshold
-                t2 = object_box_iou.max(dim=1, keepdim=True).values.clamp(min=t1 + 1e-12)
+                    t1 = self.bbox_threshold
+                    t2 = object_box_iou.max(dim=1, keepdim=True).values.clamp(min=t1 + 1e-12)
 
-                # object_box_prob: P{a_{j} -> b_{i}}, shape: [i, j]
-                object_box_prob = (
-                    (object_box_iou - t1) / (t2 - t1)
-                ).clamp(min=0, max=1)
+                    # object_box_prob: P{a_{j} -> b_{i}}, shape: [i, j]
+                    object_box_prob = (
+                        (object_box_iou - t1) / (t2 - t1)
+                    ).clamp(min=0, max=1)
 
-                indices = torch.stack([torch.arange(len(labels_)).type_as(labels_), labels_], dim=0)
+                    indices = torch.stack([torch.arange(len(labels_)).type_as(labels_), labels_], dim=0)
 
-                # object_cls_box_prob: P{a_{j} -> b_{i}}, shape: [i, c, j]
-                object_cls_box_prob = torch.sparse_coo_tensor(indices, object_box_prob)
+                    # object_cls_box_prob: P{a_{j} -> b_{i}}, shape: [i, c, j]
+                    object_cls_box_prob = torch.sparse_coo_tensor(indices, object_box_prob)
 
-                # image_box_iou: P{a_{j} \in A_{+}}, shape: [j, c]
-                """
-                from "start" to "end" implement:
+                    # image_box_iou: P{a_{j} \in A_{+}}, shape: [j, c]
+                    """
+                    from "start" to "end" implement:
                 
-                image_box_iou = torch.sparse.max(object_cls_box_prob, dim=0).t()
+                    image_box_iou = torch.sparse.max(object_cls_box_prob, dim=0).t()
                 
-                """
-                # start
-                indices = torch.nonzero(torch.sparse.sum(
-                    object_cls_box_prob, dim=0
-                ).to_dense()).t_()
-
-                if indices.numel() == 0:
-                    image_box_prob = torch.zeros(anchors_.bbox.size(0), self.num_classes).type_as(object_box_prob)
-                else:
-                    nonzero_box_prob = torch.where(
-                        (labels_.unsqueeze(dim=-1) == indices[0]),
-                        object_box_prob[:, indices[1]],
-                        torch.tensor([0]).type_as(object_box_prob)
-                    ).max(dim=0).values
-
-                    image_box_prob = torch.sparse_coo_tensor(
-                        indices.flip([0]), nonzero_box_prob,
-                        size=(anchors_.bbox.size(0), self.num_classes)
-                    ).to_dense()
-                # end
+                    """
+                    # start
+                    indices = torch.nonzero(torch.sparse.sum(
+                        object_cls_box_prob, dim=0
+                    ).to_dense()).t_()
+
+                    if indices.numel() == 0:
+                        image_box_prob = torch.zeros(anchors_.bbox.size(0), self.num_classes).type_as(object_box_prob)
+                    else:
+                        nonzero_box_prob = torch.where(
+                            (labels_.unsqueeze(dim=-1) == indices[0]),
+                            object_box_prob[:, indices[1]],
+                            torch.tensor([0]).type_as(object_box_prob)
+                        ).max(dim=0).values
+
+                        image_box_prob = torch.sparse_coo_tensor(
+                            indices.flip([0]), nonzero_box_prob,
+                            size=(anchors_.bbox.size(0), self.num_classes)
+                        ).to_dense()
+                    # end
 
                 box_prob.append(image_box_prob)
 
             # construct bags for objects
-            match_quality_matrix = boxlist_iou(targets_, anchors_)
-            _, matched = torch.topk(match_quality_matrix, self.pre_anchor_topk, dim=1, sorted=False)
-            del match_quality_matrix
+            if not anchors_.bbox.is_cuda:
+                _, matched = box_iou_topk(targets_.bbox, anchors_.bbox, self.pre_anchor_topk)
+            else:
+                match_quality_matrix = boxlist_iou(targets_, anchors_)
+                _, matched = torch.topk(match_quality_matrix, self.pre_anchor_topk, dim=1, sorted=False)
+                del match_quality_matrix
 
             # matched_cls_prob: P_{ij}^{cls}
             matched_cls_prob = torch.gather(
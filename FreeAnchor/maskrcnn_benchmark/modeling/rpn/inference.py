@@ -5,7 +5,6 @@ from maskrcnn_benchmark.modeling.box_coder import BoxCoder
 from maskrcnn_benchmark.structures.bounding_box import BoxList
 from maskrcnn_benchmark.structures.boxlist_ops import cat_boxlist
 from maskrcnn_benchmark.structures.boxlist_ops import boxlist_nms
-from maskrcnn_benchmark.structures.boxlist_ops import remove_small_boxes
 
 from ..utils import cat
 
@@ -99,18 +98,16 @@ class RPNPostProcessor(torch.nn.Module):
         concat_anchors = torch.cat([a.bbox for a in anchors], dim=0)
         concat_anchors = concat_anchors.reshape(N, -1, 4)[batch_idx, topk_idx]
 
-        proposals = self.box_coder.decode(
-            box_regression.view(-1, 4), concat_anchors.view(-1, 4)
-        )
-
-        proposals = proposals.view(N, -1, 4)
-
         result = []
-        for proposal, score, im_shape in zip(proposals, objectness, image_shapes):
+        for regression, anchor, score, im_shape in zip(
+            box_regression, concat_anchors, objectness, image_shapes
+        ):
+            # decode, clip_to_image and remove_small_boxes
+            proposal, keep = self.box_coder.decode_clip(
+                regression, anchor, im_shape, self.min_size
+            )
             boxlist = BoxList(proposal, im_shape, mode="xyxy")
-            boxlist.add_field("objectness", score)
-            boxlist = boxlist.clip_to_image(remove_empty=False)
-            boxlist = remove_small_boxes(boxlist, self.min_size)
+            boxlist.add_field("objectness", score[keep])
             boxlist = boxlist_nms(
                 boxlist,
                 self.nms_thresh,
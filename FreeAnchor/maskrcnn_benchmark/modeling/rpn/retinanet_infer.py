@@ -1,5 +1,6 @@
 import torch
 
+from maskrcnn_benchmark.layers import retinanet_postprocess
 from maskrcnn_benchmark.modeling.box_coder import BoxCoder
 from maskrcnn_benchmark.structures.bounding_box import BoxList
 from maskrcnn_benchmark.structures.boxlist_ops import cat_boxlist
@@ -128,6 +129,9 @@ class RetinaNetPostProcessor(torch.nn.Module):
             boxlists (list[BoxList]): the post-processed anchors, after
                 applying box decoding and NMS
         """
+        if not box_cls[0].is_cuda:
+            return self.forward_cpu(anchors, box_cls, box_regression)
+
         sampled_boxes = []
         num_levels = len(box_cls)
         anchors = list(zip(*anchors))
@@ -147,6 +151,46 @@ class RetinaNetPostProcessor(torch.nn.Module):
 
         return boxlists
 
+    def forward_cpu(self, anchors, box_cls, box_regression):
+        """
+        Same detections as forward, by a single call of the fused CPU op
+        """
+        num_levels = len(box_cls)
+        level_anchors = [
+            torch.stack([a[level].bbox for a in anchors])
+            for level in range(num_levels)
+        ]
+        image_sizes = [a[0].size for a in anchors]
+        boxes, scores, labels, counts = retinanet_postprocess(
+            box_cls, box_regression, level_anchors,
+            [w for w, h in image_sizes], [h for w, h in image_sizes],
+            self.pre_nms_thresh, self.pre_nms_top_n, self.nms_thresh,
+            self.fpn_post_nms_top_n, self.min_size,
+            list(self.box_coder.weights), self.box_coder.bbox_xform_clip
+        )
+
+        results = []
+        for boxes_i, scores_i, labels_i, image_size in zip(
+            boxes.split(counts.tolist()), scores.split(counts.tolist()),
+            labels.split(counts.tolist()), image_sizes):
+            if len(boxes_i) == 0:
+                results.append(self.empty_result(image_size, boxes.device))
+                continue
+            boxlist = BoxList(boxes_i, image_size, mode="xyxy")
+            boxlist.add_field("scores", scores_i)
+            boxlist.add_field("labels", labels_i)
+            results.append(boxlist)
+        return results
+
+    def empty_result(self, image_size, device):
+        # a single dummy detection for the images without any
+        empty_boxlist = BoxList(torch.zeros(1, 4).to(device), image_size)
+        empty_boxlist.add_field(
+            "labels", torch.LongTensor([1]).to(device))
+        empty_boxlist.add_field(
+            "scores", torch.Tensor([0.01]).to(device))
+        return empty_boxlist
+
     def select_over_all_levels(self, boxlists):
         num_images = len(boxlists)
         results = []
@@ -194,12 +238,7 @@ class RetinaNetPostProcessor(torch.nn.Module):
                     result = result[keep]
                 results.append(result)
             else:
-                empty_boxlist = BoxList(torch.zeros(1, 4).to('cuda'), boxlist.size)
-                empty_boxlist.add_field(
-                    "labels", torch.LongTensor([1]).to('cuda'))
-                empty_boxlist.add_field(
-                    "scores", torch.Tensor([0.01]).to('cuda'))
-                results.append(empty_boxlist)
+                results.append(self.empty_result(boxlist.size, boxes.device))
         return results
 
 
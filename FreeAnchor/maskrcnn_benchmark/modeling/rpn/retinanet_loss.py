@@ -12,7 +12,6 @@ from maskrcnn_benchmark.layers import SmoothL1Loss
 from maskrcnn_benchmark.layers import AdjustSmoothL1Loss
 from maskrcnn_benchmark.layers import SigmoidFocalLoss
 from maskrcnn_benchmark.modeling.matcher import Matcher
-from maskrcnn_benchmark.structures.boxlist_ops import boxlist_iou
 from maskrcnn_benchmark.structures.boxlist_ops import cat_boxlist
 
 
@@ -47,8 +46,7 @@ class RetinaNetLossComputation(object):
             )
 
     def match_targets_to_anchors(self, anchor, target):
-        match_quality_matrix = boxlist_iou(target, anchor)
-        matched_idxs = self.proposal_matcher(match_quality_matrix)
+        matched_idxs = self.proposal_matcher.match_boxlists(target, anchor)
         # RPN doesn't need any fields from target
         # for creating the labels, so clear them all
         target = target.copy_with_fields(['labels'])
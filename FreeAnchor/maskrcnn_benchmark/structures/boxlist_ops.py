@@ -4,6 +4,8 @@ import torch
 from .bounding_box import BoxList
 
 from maskrcnn_benchmark.layers import nms as _box_nms
+from maskrcnn_benchmark.layers import batched_nms as _box_batched_nms
+from maskrcnn_benchmark.layers import box_iou as _box_iou
 
 
 def boxlist_nms(boxlist, nms_thresh, max_proposals=-1, score_field="score"):
@@ -31,6 +33,34 @@ def boxlist_nms(boxlist, nms_thresh, max_proposals=-1, score_field="score"):
     return boxlist.convert(mode)
 
 
+def boxlist_batched_nms(boxlist, nms_thresh, max_proposals=-1,
+                        score_field="score", group_field="labels"):
+    """
+    Performs non-maximum suppression independently for every group of boxes
+    in a boxlist that share the same group_field value, in a single call.
+    The result is the same as concatenating boxlist_nms over the groups in
+    increasing group order.
+
+    Arguments:
+        boxlist(BoxList)
+        nms_thresh (float)
+        max_proposals (int): if > 0, then only the top max_proposals of each
+            group are kept after non-maxium suppression
+        score_field (str)
+        group_field (str): int64 field with the group of every box
+    """
+    if nms_thresh <= 0:
+        return boxlist
+    mode = boxlist.mode
+    boxlist = boxlist.convert("xyxy")
+    boxes = boxlist.bbox
+    score = boxlist.get_field(score_field)
+    groups = boxlist.get_field(group_field)
+    keep = _box_batched_nms(boxes, score, groups, nms_thresh, max_proposals)
+    boxlist = boxlist[keep.to(boxes.device)]
+    return boxlist.convert(mode)
+
+
 def remove_small_boxes(boxlist, min_size):
     """
     Only keep boxes with both sides >= min_size
@@ -68,6 +98,9 @@ def boxlist_iou(boxlist1, boxlist2):
         raise RuntimeError(
                 "boxlists should have same image size, got {}, {}".format(boxlist1, boxlist2))
 
+    if not boxlist1.bbox.is_cuda:
+        return _box_iou(boxlist1.bbox, boxlist2.bbox)
+
     N = len(boxlist1)
     M = len(boxlist2)
 
@@ -107,6 +140,8 @@ def boxlist_block_iou(boxlist1, boxlist2):
                 "boxlists should have same image size, got {}, {}".format(boxlist1, boxlist2))
 
     box1, box2 = boxlist1.bbox, boxlist2.bbox
+    if not box1.is_cuda:
+        return _box_iou(box1, box2, block=True)
 
     lt = torch.max(box1[:, None, :2], box2[:, :2])  # [N,M,2]
     rb = torch.min(box1[:, None, 2:], box2[:, 2:])  # [N,M,2]
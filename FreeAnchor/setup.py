@@ -3,6 +3,7 @@
 
 import glob
 import os
+import sys
 
 import torch
 from setuptools import find_packages
@@ -26,8 +27,20 @@ def get_extensions():
     extension = CppExtension
 
     extra_compile_args = {"cxx": []}
+    extra_link_args = []
     define_macros = []
 
+    # at::parallel_for is header-only, so the extension itself has to be built
+    # with OpenMP for the CPU kernels to run multi-threaded.
+    if sys.platform != "darwin":
+        extra_compile_args["cxx"] += ["-fopenmp"]
+        extra_link_args += ["-fopenmp"]
+
+    # The CPU kernels have AVX2/AVX-512 inner loops; they are only compiled
+    # in when targeting the build machine explicitly.
+    if os.getenv("MASKRCNN_CPU_NATIVE", "0") == "1":
+        extra_compile_args["cxx"] += ["-march=native"]
+
     if torch.cuda.is_available() and CUDA_HOME is not None:
         extension = CUDAExtension
         sources += source_cuda
@@ -50,6 +63,7 @@ def get_extensions():
             include_dirs=include_dirs,
             define_macros=define_macros,
             extra_compile_args=extra_compile_args,
+            extra_link_args=extra_link_args,
         )
     ]
 
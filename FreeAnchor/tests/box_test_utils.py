@@ -0,0 +1,31 @@
+# Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+# Box fixtures and reference implementations shared by the op tests.
+import torch
+
+
+def random_boxes(num_boxes, max_size):
+    xy = torch.rand(num_boxes, 2) * 1000
+    wh = torch.rand(num_boxes, 2) * max_size + 1
+    return torch.cat([xy, xy + wh], dim=1)
+
+
+def random_rois(num_rois, batch_size, image_size):
+    xy = torch.rand(num_rois, 2) * image_size
+    wh = torch.rand(num_rois, 2) * image_size / 2
+    batch_inds = torch.randint(0, batch_size, (num_rois, 1)).float()
+    return torch.cat([batch_inds, xy - 4, xy + wh], dim=1)
+
+
+def reference_iou(box1, box2, block=False):
+    # the broadcast implementation of boxlist_iou and boxlist_block_iou
+    lt = torch.max(box1[:, None, :2], box2[:, :2])
+    rb = torch.min(box1[:, None, 2:], box2[:, 2:])
+    wh = (rb - lt + 1).clamp(min=0)
+    wh1 = box1[:, 2:] - box1[:, :2] + 1
+    wh2 = box2[:, 2:] - box2[:, :2] + 1
+    if block:
+        return torch.min(wh / (wh1[:, None] + wh2 - wh), dim=2).values
+    inter = wh[:, :, 0] * wh[:, :, 1]
+    area1 = wh1[:, 0] * wh1[:, 1]
+    area2 = wh2[:, 0] * wh2[:, 1]
+    return inter / (area1[:, None] + area2 - inter)
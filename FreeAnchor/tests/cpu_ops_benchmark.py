@@ -0,0 +1,278 @@
+# Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+# Timing of the CPU kernels of maskrcnn_benchmark._C.
+#
+# Example usage:
+#   python tests/cpu_ops_benchmark.py roi_align --threads 1 2 4 8
+import argparse
+import time
+
+import torch
+
+from maskrcnn_benchmark import _C
+
+from box_test_utils import random_boxes, random_rois
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description="CPU op benchmark")
+    parser.add_argument("op", choices=sorted(BENCHMARKS.keys()))
+    parser.add_argument(
+        "--threads",
+        nargs="+",
+        type=int,
+        default=[1, torch.get_num_threads()],
+        help="thread counts to time the op with",
+    )
+    parser.add_argument("--iters", default=10, type=int)
+    return parser.parse_args()
+
+
+def timeit(fn, iters):
+    fn()
+    start = time.time()
+    for _ in range(iters):
+        fn()
+    return (time.time() - start) / iters
+
+
+def bench_roi_align(args):
+    # box head (7x7) and mask head (14x14) on a stride 8 FPN level
+    feature = torch.rand(2, 256, 100, 168)
+    rois = random_rois(512, 2, 800)
+    for pooled in [7, 14]:
+        for threads in args.threads:
+            torch.set_num_threads(threads)
+            t = timeit(
+                lambda: _C.roi_align_forward(feature, rois, 0.125, pooled, pooled, 2),
+                args.iters,
+            )
+            print("roi_align_forward {0}x{0} threads={1}: {2:.2f} ms".format(
+                pooled, threads, t * 1000))
+            grad = torch.rand(rois.size(0), feature.size(1), pooled, pooled)
+            t = timeit(
+                lambda: _C.roi_align_backward(
+                    grad, rois, 0.125, pooled, pooled, 2, 256, 100, 168, 2),
+                args.iters,
+            )
+            print("roi_align_backward {0}x{0} threads={1}: {2:.2f} ms".format(
+                pooled, threads, t * 1000))
+
+
+def bench_pooler(args):
+    from maskrcnn_benchmark.modeling.poolers import Pooler
+    from maskrcnn_benchmark.structures.bounding_box import BoxList
+
+    # box head pooler of an FPN on a batch of two 800x1344 images
+    scales = (0.25, 0.125, 0.0625, 0.03125)
+    features = [torch.rand(2, 256, int(200 * s * 4), int(336 * s * 4)) for s in scales]
+    boxes = [BoxList(random_boxes(512, 336), (1344, 800)) for _ in range(2)]
+    pooler = Pooler((7, 7), scales, 2)
+    rois = pooler.convert_to_roi_format(boxes)
+    levels = pooler.map_levels(boxes)
+
+    def per_level():
+        result = features[0].new_zeros(len(rois), 256, 7, 7)
+        for level, (feature, roi_align) in enumerate(zip(features, pooler.poolers)):
+            idx_in_level = torch.nonzero(levels == level).squeeze(1)
+            result[idx_in_level] = roi_align(feature, rois[idx_in_level])
+        return result
+
+    for threads in args.threads:
+        torch.set_num_threads(threads)
+        t = timeit(per_level, args.iters)
+        print("roi_align per level threads={0}: {1:.2f} ms".format(threads, t * 1000))
+        t = timeit(lambda: pooler(features, boxes), args.iters)
+        print("multilevel_roi_align threads={0}: {1:.2f} ms".format(threads, t * 1000))
+
+
+def bench_box_coder(args):
+    from maskrcnn_benchmark.modeling.box_coder import BoxCoder
+
+    # box head decode: 1000 proposals x 81 classes, and RPN decode of 200k anchors
+    coder = BoxCoder(weights=(10., 10., 5., 5.))
+    proposals = random_boxes(1000, 336)
+    codes = torch.randn(1000, 81 * 4) * 0.5
+    anchors = random_boxes(200000, 336)
+    anchor_codes = torch.randn(200000, 4) * 0.5
+    for threads in args.threads:
+        torch.set_num_threads(threads)
+        t = timeit(lambda: coder.decode(codes, proposals), args.iters)
+        print("box_decode classes=81 threads={0}: {1:.2f} ms".format(threads, t * 1000))
+        t = timeit(lambda: coder.encode(anchors, anchors.flip(0)), args.iters)
+        print("box_encode anchors=200000 threads={0}: {1:.2f} ms".format(threads, t * 1000))
+        t = timeit(lambda: coder.decode_clip(anchor_codes, anchors, (1344, 800), 0), args.iters)
+        print("box_decode_clip anchors=200000 threads={0}: {1:.2f} ms".format(
+            threads, t * 1000))
+
+
+def bench_box_iou(args):
+    from maskrcnn_benchmark.structures.bounding_box import BoxList
+    from maskrcnn_benchmark.structures.boxlist_ops import boxlist_iou
+
+    # FreeAnchor bags: 20 gt boxes against the anchors of an 800x1344 image
+    anchors = torch.cat([
+        random_boxes(n, 32 * scale)
+        for n, scale in [(150000, 1), (37500, 2), (9375, 4), (2400, 8), (600, 16)]
+    ])
+    boxes = random_boxes(20, 336)
+    labels = torch.randint(0, 80, (20,))
+
+    def dense():
+        iou = boxlist_iou(BoxList(boxes, (1344, 800)), BoxList(anchors, (1344, 800)))
+        return torch.topk(iou, 50, dim=1, sorted=False)
+
+    def broadcast():
+        lt = torch.max(boxes[:, None, :2], anchors[:, :2])
+        rb = torch.min(boxes[:, None, 2:], anchors[:, 2:])
+        wh = (rb - lt + 1).clamp(min=0)
+        inter = wh[:, :, 0] * wh[:, :, 1]
+        area1 = (boxes[:, 2] - boxes[:, 0] + 1) * (boxes[:, 3] - boxes[:, 1] + 1)
+        area2 = (anchors[:, 2] - anchors[:, 0] + 1) * (anchors[:, 3] - anchors[:, 1] + 1)
+        return inter / (area1[:, None] + area2 - inter)
+
+    for threads in args.threads:
+        torch.set_num_threads(threads)
+        t = timeit(broadcast, args.iters)
+        print("broadcast iou threads={0}: {1:.2f} ms".format(threads, t * 1000))
+        t = timeit(lambda: _C.box_iou(boxes, anchors), args.iters)
+        print("box_iou threads={0}: {1:.2f} ms".format(threads, t * 1000))
+        t = timeit(lambda: _C.box_iou_max(boxes, anchors, False, 0), args.iters)
+        print("box_iou_max threads={0}: {1:.2f} ms".format(threads, t * 1000))
+        t = timeit(dense, args.iters)
+        print("boxlist_iou + topk threads={0}: {1:.2f} ms".format(threads, t * 1000))
+        t = timeit(lambda: _C.box_iou_topk(boxes, anchors, 50), args.iters)
+        print("box_iou_topk threads={0}: {1:.2f} ms".format(threads, t * 1000))
+        t = timeit(lambda: _C.box_iou_class_prob(boxes, labels, anchors, 80, 0.5), args.iters)
+        print("box_iou_class_prob threads={0}: {1:.2f} ms".format(threads, t * 1000))
+
+
+def bench_roi_pool(args):
+    feature = torch.rand(2, 256, 100, 168)
+    rois = random_rois(512, 2, 800)
+    for threads in args.threads:
+        torch.set_num_threads(threads)
+        t = timeit(lambda: _C.roi_pool_forward(feature, rois, 0.125, 7, 7), args.iters)
+        print("roi_pool_forward threads={0}: {1:.2f} ms".format(threads, t * 1000))
+        output, argmax = _C.roi_pool_forward(feature, rois, 0.125, 7, 7)
+        grad = torch.rand_like(output)
+        t = timeit(
+            lambda: _C.roi_pool_backward(
+                grad, feature, rois, argmax, 0.125, 7, 7, 2, 256, 100, 168),
+            args.iters,
+        )
+        print("roi_pool_backward threads={0}: {1:.2f} ms".format(threads, t * 1000))
+
+
+def bench_sigmoid_focal_loss(args):
+    from maskrcnn_benchmark.layers import SigmoidFocalLoss
+
+    # all anchors of a 800x1333 image with 9 anchors per location
+    logits = torch.randn(150000, 80, requires_grad=True)
+    targets = torch.randint(-1, 81, (150000,)).int()
+    loss_func = SigmoidFocalLoss(80, 2.0, 0.25)
+    for threads in args.threads:
+        torch.set_num_threads(threads)
+        t = timeit(lambda: loss_func(logits, targets).backward(), args.iters)
+        print("sigmoid_focal_loss forward+backward threads={0}: {1:.2f} ms".format(
+            threads, t * 1000))
+
+
+def bench_matcher(args):
+    from maskrcnn_benchmark.modeling.matcher import Matcher
+    from maskrcnn_benchmark.structures.bounding_box import BoxList
+    from maskrcnn_benchmark.structures.boxlist_ops import boxlist_iou
+
+    # RPN target assignment: 100 gt boxes against the anchors of an 800x1344 image
+    anchors = BoxList(random_boxes(200000, 336), (1344, 800))
+    targets = BoxList(random_boxes(100, 336), (1344, 800))
+    matcher = Matcher(0.7, 0.3, allow_low_quality_matches=True)
+    for threads in args.threads:
+        torch.set_num_threads(threads)
+        t = timeit(lambda: matcher(boxlist_iou(targets, anchors)), args.iters)
+        print("boxlist_iou + Matcher threads={0}: {1:.2f} ms".format(threads, t * 1000))
+        t = timeit(lambda: matcher.match_boxlists(targets, anchors), args.iters)
+        print("match_boxes threads={0}: {1:.2f} ms".format(threads, t * 1000))
+
+
+def bench_nms(args):
+    for num_boxes in [1000, 10000, 50000]:
+        boxes = random_boxes(num_boxes, 200)
+        scores = torch.rand(num_boxes)
+        for threads in args.threads:
+            torch.set_num_threads(threads)
+            for bitmask in [False, True]:
+                t = timeit(lambda: _C.nms(boxes, scores, 0.5, bitmask), args.iters)
+                print("nms boxes={0} bitmask={1} threads={2}: {3:.2f} ms".format(
+                    num_boxes, bitmask, threads, t * 1000))
+
+
+def bench_batched_nms(args):
+    # box head output: 1000 proposals x 80 classes above the score threshold
+    num_boxes = 20000
+    boxes = random_boxes(num_boxes, 200)
+    scores = torch.rand(num_boxes)
+    idxs = torch.randint(0, 80, (num_boxes,))
+
+    def per_class():
+        for j in range(80):
+            inds = (idxs == j).nonzero().squeeze(1)
+            _C.nms(boxes[inds], scores[inds], 0.5)
+
+    for threads in args.threads:
+        torch.set_num_threads(threads)
+        t = timeit(per_class, args.iters)
+        print("nms per class threads={0}: {1:.2f} ms".format(threads, t * 1000))
+        t = timeit(lambda: _C.batched_nms(boxes, scores, idxs, 0.5, -1), args.iters)
+        print("batched_nms threads={0}: {1:.2f} ms".format(threads, t * 1000))
+
+
+def bench_retinanet_postprocess(args):
+    from maskrcnn_benchmark.modeling.rpn.retinanet_infer import RetinaNetPostProcessor
+    from maskrcnn_benchmark.structures.bounding_box import BoxList
+    from maskrcnn_benchmark.structures.boxlist_ops import cat_boxlist
+
+    # RetinaNet head outputs of an FPN (P3-P7) on a batch of two 800x1344 images
+    A, C = 9, 80
+    sizes = [(100, 168), (50, 84), (25, 42), (13, 21), (7, 11)]
+    box_cls = [torch.randn(2, A * C, h, w) * 2 - 5 for h, w in sizes]
+    box_regression = [torch.randn(2, A * 4, h, w) * 0.5 for h, w in sizes]
+    anchors = [
+        [BoxList(random_boxes(h * w * A, 336), (1344, 800)) for h, w in sizes]
+        for _ in range(2)
+    ]
+    postprocessor = RetinaNetPostProcessor(0.05, 1000, 0.5, 100, 0)
+
+    def per_level():
+        sampled_boxes = [
+            postprocessor.forward_for_single_feature_map(a, o, b, 0.05)
+            for a, o, b in zip(zip(*anchors), box_cls, box_regression)
+        ]
+        boxlists = [cat_boxlist(boxlist) for boxlist in zip(*sampled_boxes)]
+        return postprocessor.select_over_all_levels(boxlists)
+
+    for threads in args.threads:
+        torch.set_num_threads(threads)
+        t = timeit(per_level, args.iters)
+        print("retinanet postprocess per level threads={0}: {1:.2f} ms".format(
+            threads, t * 1000))
+        t = timeit(lambda: postprocessor(anchors, box_cls, box_regression), args.iters)
+        print("retinanet_postprocess threads={0}: {1:.2f} ms".format(threads, t * 1000))
+
+
+BENCHMARKS = {
+    "batched_nms": bench_batched_nms,
+    "box_coder": bench_box_coder,
+    "box_iou": bench_box_iou,
+    "matcher": bench_matcher,
+    "nms": bench_nms,
+    "pooler": bench_pooler,
+    "retinanet_postprocess": bench_retinanet_postprocess,
+    "roi_align": bench_roi_align,
+    "roi_pool": bench_roi_pool,
+    "sigmoid_focal_loss": bench_sigmoid_focal_loss,
+}
+
+
+if __name__ == "__main__":
+    args = parse_args()
+    BENCHMARKS[args.op](args)
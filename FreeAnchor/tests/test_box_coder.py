@@ -0,0 +1,78 @@
+# Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+import math
+import unittest
+
+import torch
+
+from maskrcnn_benchmark.modeling.box_coder import BoxCoder
+
+from box_test_utils import random_boxes
+
+
+class _PythonBoxCoder(BoxCoder):
+    # the elementwise tensor ops of BoxCoder, on the CPU too
+    @staticmethod
+    def _native(*tensors):
+        return False
+
+
+# the specialized weights, and any other
+WEIGHTS = [(10., 10., 5., 5.), (1., 1., 1., 1.), (10., 10., 5., 2.5)]
+
+
+class TestBoxCoderCPU(unittest.TestCase):
+    def test_encode(self):
+        torch.manual_seed(0)
+        gt = random_boxes(3000, 300)
+        proposals = random_boxes(3000, 300)
+        for weights in WEIGHTS:
+            expected = _PythonBoxCoder(weights).encode(gt, proposals)
+            actual = BoxCoder(weights).encode(gt, proposals)
+            self.assertTrue(torch.allclose(actual, expected, rtol=1e-5, atol=1e-5))
+
+    def test_encode_broadcast(self):
+        # the positive bags of FreeAnchor, every gt against its anchors
+        torch.manual_seed(0)
+        gt = random_boxes(20, 300).unsqueeze(dim=1)
+        anchors = random_boxes(20 * 50, 300).view(20, 50, 4)
+        coder = BoxCoder((10., 10., 5., 5.))
+        expected = _PythonBoxCoder((10., 10., 5., 5.)).encode(gt, anchors)
+        actual = coder.encode(gt, anchors)
+        self.assertEqual(actual.shape, (20, 50, 4))
+        self.assertTrue(torch.allclose(actual, expected, rtol=1e-5, atol=1e-5))
+
+    def test_decode(self):
+        torch.manual_seed(0)
+        boxes = random_boxes(3000, 300)
+        for num_codes in [1, 81]:
+            # large codes are clipped at bbox_xform_clip
+            rel_codes = torch.randn(3000, 4 * num_codes) * 3
+            for weights in WEIGHTS:
+                expected = _PythonBoxCoder(weights).decode(rel_codes, boxes)
+                actual = BoxCoder(weights).decode(rel_codes, boxes)
+                self.assertTrue(torch.allclose(actual, expected, rtol=1e-5, atol=1e-3))
+
+    def test_decode_clip(self):
+        torch.manual_seed(0)
+        boxes = random_boxes(3000, 300)
+        rel_codes = torch.randn(3000, 4) * 2
+        for weights in WEIGHTS:
+            for min_size in [0, 20]:
+                coder = BoxCoder(weights, math.log(1000. / 16))
+                expected, expected_keep = _PythonBoxCoder(weights).decode_clip(
+                    rel_codes, boxes, (800, 600), min_size)
+                actual, keep = coder.decode_clip(rel_codes, boxes, (800, 600), min_size)
+                self.assertTrue(torch.equal(keep, expected_keep))
+                self.assertTrue(torch.allclose(actual, expected, rtol=1e-5, atol=1e-3))
+                self.assertTrue((actual[:, 0::2] <= 799).all() and (actual[:, 1::2] <= 599).all())
+
+    def test_empty(self):
+        coder = BoxCoder((10., 10., 5., 5.))
+        self.assertEqual(coder.decode(torch.zeros(0, 4), torch.zeros(0, 4)).shape, (0, 4))
+        boxes, keep = coder.decode_clip(torch.zeros(0, 4), torch.zeros(0, 4), (800, 600), 0)
+        self.assertEqual(boxes.shape, (0, 4))
+        self.assertEqual(keep.numel(), 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,101 @@
+# Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+import unittest
+
+import torch
+
+from maskrcnn_benchmark import _C
+from maskrcnn_benchmark.modeling.matcher import Matcher
+from maskrcnn_benchmark.structures.bounding_box import BoxList
+from maskrcnn_benchmark.structures.boxlist_ops import boxlist_iou
+
+from box_test_utils import random_boxes, reference_iou
+
+
+def _anchors():
+    # anchors of several sizes, as on the levels of an FPN
+    return torch.cat([random_boxes(n, size) for n, size in
+                      [(4000, 32), (2000, 64), (1000, 128), (500, 256), (200, 512)]])
+
+
+class TestBoxIoUCPU(unittest.TestCase):
+    def test_dense_matches_broadcast(self):
+        torch.manual_seed(0)
+        # sizes around the 512 box tile
+        for n, m in [(1, 1), (7, 511), (30, 513), (100, 3000)]:
+            box1 = random_boxes(n, 300)
+            box2 = random_boxes(m, 300)
+            for block in [False, True]:
+                expected = reference_iou(box1, box2, block)
+                self.assertTrue(torch.equal(_C.box_iou(box1, box2, block), expected))
+
+    def test_max_matches_dense(self):
+        torch.manual_seed(0)
+        box1 = random_boxes(40, 300)
+        box2 = torch.cat([random_boxes(2000, 300), box1[:5]])
+        for block in [False, True]:
+            iou = reference_iou(box1, box2, block)
+            for dim in [0, 1]:
+                values, indices = _C.box_iou_max(box1, box2, block, dim)
+                expected = iou.max(dim=dim)[0]
+                self.assertTrue(torch.equal(values, expected))
+                gathered = iou.gather(dim, indices.unsqueeze(dim)).squeeze(dim)
+                self.assertTrue(torch.equal(gathered, expected))
+
+    def test_matcher(self):
+        torch.manual_seed(0)
+        targets = BoxList(random_boxes(20, 300), (1000, 1000))
+        anchors = BoxList(_anchors(), (1000, 1000))
+        for allow_low_quality_matches in [False, True]:
+            matcher = Matcher(0.5, 0.4, allow_low_quality_matches)
+            expected = matcher(reference_iou(targets.bbox, anchors.bbox))
+            self.assertTrue(torch.equal(matcher.match_boxlists(targets, anchors), expected))
+        self.assertTrue(torch.equal(boxlist_iou(targets, anchors),
+                                    reference_iou(targets.bbox, anchors.bbox)))
+
+    def test_topk_matches_dense(self):
+        torch.manual_seed(0)
+        anchors = _anchors()
+        # small boxes overlap fewer than k anchors
+        boxes = torch.cat([random_boxes(30, 300), random_boxes(5, 2)])
+        iou = reference_iou(boxes, anchors)
+        for k in [1, 50, 200]:
+            ious, matched = _C.box_iou_topk(boxes, anchors, k)
+            expected, _ = torch.topk(iou, k, dim=1)
+            self.assertTrue(torch.allclose(ious, expected, atol=1e-6))
+            self.assertTrue(torch.allclose(torch.gather(iou, 1, matched), ious, atol=1e-6))
+            for row in matched:
+                self.assertEqual(len(row.unique()), k)
+
+    def test_class_prob_matches_dense(self):
+        torch.manual_seed(0)
+        anchors = _anchors()
+        num_classes, t1 = 5, 0.5
+        # boxes close to some anchors, so that IoUs go above t1
+        boxes = anchors[torch.randint(0, len(anchors), (40,))] + torch.randn(40, 4)
+        labels = torch.randint(0, num_classes, (40,))
+        indices, values = _C.box_iou_class_prob(boxes, labels, anchors, num_classes, t1)
+        actual = torch.zeros(len(anchors), num_classes)
+        actual[indices[0], indices[1]] = values
+
+        iou = reference_iou(boxes, anchors)
+        t2 = iou.max(dim=1, keepdim=True).values.clamp(min=t1 + 1e-12)
+        prob = ((iou - t1) / (t2 - t1)).clamp(min=0, max=1)
+        expected = torch.zeros(len(anchors), num_classes)
+        for c in range(num_classes):
+            if (labels == c).any():
+                expected[:, c] = prob[labels == c].max(dim=0).values
+        self.assertGreater(values.numel(), 0)
+        self.assertTrue((values > 0).all())
+        self.assertTrue(torch.allclose(actual, expected, atol=1e-6))
+
+    def test_empty(self):
+        ious, matched = _C.box_iou_topk(torch.zeros(0, 4), random_boxes(10, 10), 5)
+        self.assertEqual(ious.shape, (0, 5))
+        indices, values = _C.box_iou_class_prob(
+            torch.zeros(0, 4), torch.zeros(0, dtype=torch.int64), random_boxes(10, 10), 3, 0.5)
+        self.assertEqual(indices.shape, (2, 0))
+        self.assertEqual(values.numel(), 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,48 @@
+# Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+import unittest
+
+import torch
+
+from maskrcnn_benchmark.modeling.matcher import Matcher
+from maskrcnn_benchmark.structures.bounding_box import BoxList
+
+from box_test_utils import random_boxes, reference_iou
+
+
+class TestMatcherCPU(unittest.TestCase):
+    def assertMatchesDense(self, matcher, gt, boxes):
+        expected = matcher(reference_iou(gt, boxes))
+        actual = matcher.match_boxlists(BoxList(gt, (1100, 1100)), BoxList(boxes, (1100, 1100)))
+        self.assertTrue(torch.equal(actual, expected))
+
+    def test_matches_dense(self):
+        torch.manual_seed(0)
+        gt = random_boxes(30, 300)
+        # sizes around the 512 box tile, with boxes tied at the best IoU of a
+        # gt in different tiles
+        for num_boxes in [1, 511, 513, 5000]:
+            boxes = random_boxes(num_boxes, 300)
+            boxes[-1] = gt[0]
+            boxes[0] = gt[0]
+            for allow_low_quality_matches in [False, True]:
+                for low_quality_threshold in [0.0, 0.3]:
+                    matcher = Matcher(0.7, 0.3, allow_low_quality_matches, low_quality_threshold)
+                    self.assertMatchesDense(matcher, gt, boxes)
+
+    def test_isolated_gt(self):
+        # a gt that overlaps nothing is tied with every box at IoU 0
+        torch.manual_seed(0)
+        gt = torch.cat([random_boxes(5, 300), torch.tensor([[1090., 1090., 1095., 1095.]])])
+        boxes = random_boxes(2000, 50)
+        for low_quality_threshold in [0.0, 0.3]:
+            self.assertMatchesDense(Matcher(0.7, 0.3, True, low_quality_threshold), gt, boxes)
+
+    def test_empty(self):
+        matcher = Matcher(0.7, 0.3, True)
+        matches = matcher.match_boxlists(
+            BoxList(torch.zeros(0, 4), (100, 100)), BoxList(random_boxes(10, 10), (100, 100)))
+        self.assertEqual(matches.numel(), 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
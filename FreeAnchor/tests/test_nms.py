@@ -0,0 +1,69 @@
+# Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+import unittest
+
+import torch
+
+from maskrcnn_benchmark import _C
+
+from box_test_utils import random_boxes
+
+
+class TestNMSCPU(unittest.TestCase):
+    def test_bitmask_matches_sequential(self):
+        torch.manual_seed(0)
+        # sizes around the 64 box block boundary
+        for num_boxes in [1, 63, 64, 65, 130, 2000]:
+            boxes = random_boxes(num_boxes, 200)
+            # quantized scores so that there are ties
+            scores = (torch.rand(num_boxes) * 20).floor()
+            for threshold in [0.3, 0.5, 0.7]:
+                expected = _C.nms(boxes, scores, threshold, bitmask=False)
+                keep = _C.nms(boxes, scores, threshold)
+                self.assertTrue(torch.equal(keep, expected))
+
+    def test_batched_matches_per_group(self):
+        torch.manual_seed(0)
+        boxes = random_boxes(3000, 200)
+        scores = torch.rand(3000)
+        idxs = torch.randint(0, 80, (3000,))
+        for max_per_group in [-1, 5]:
+            keep = _C.batched_nms(boxes, scores, idxs, 0.5, max_per_group)
+            expected = []
+            for group in idxs.unique().tolist():
+                inds = (idxs == group).nonzero().squeeze(1)
+                keep_group = inds[_C.nms(boxes[inds], scores[inds], 0.5)]
+                if max_per_group > 0:
+                    keep_group = keep_group[:max_per_group]
+                expected.append(keep_group)
+            self.assertTrue(torch.equal(keep, torch.cat(expected)))
+
+    def test_empty(self):
+        keep = _C.nms(torch.zeros(0, 4), torch.zeros(0), 0.5)
+        self.assertEqual(keep.numel(), 0)
+        keep = _C.batched_nms(
+            torch.zeros(0, 4), torch.zeros(0), torch.zeros(0, dtype=torch.int64), 0.5, -1)
+        self.assertEqual(keep.numel(), 0)
+
+
+@unittest.skipIf(not torch.cuda.is_available(), "CUDA is not available")
+class TestNMSCUDA(unittest.TestCase):
+    def test_batched_matches_per_group(self):
+        torch.manual_seed(0)
+        boxes = random_boxes(3000, 200).cuda()
+        scores = torch.rand(3000).cuda()
+        idxs = torch.randint(0, 80, (3000,)).cuda()
+        for max_per_group in [-1, 5]:
+            keep = _C.batched_nms(boxes, scores, idxs, 0.5, max_per_group)
+            self.assertTrue(keep.is_cuda)
+            expected = []
+            for group in idxs.unique().tolist():
+                inds = (idxs == group).nonzero().squeeze(1)
+                keep_group = inds[_C.nms(boxes[inds], scores[inds], 0.5)]
+                if max_per_group > 0:
+                    keep_group = keep_group[:max_per_group]
+                expected.append(keep_group)
+            self.assertTrue(torch.equal(keep, torch.cat(expected)))
+
+
+if __name__ == "__main__":
+    unittest.main()
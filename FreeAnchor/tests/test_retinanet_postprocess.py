@@ -0,0 +1,99 @@
+# Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+import unittest
+
+import torch
+
+from maskrcnn_benchmark.modeling.rpn.retinanet_infer import RetinaNetPostProcessor
+from maskrcnn_benchmark.structures.bounding_box import BoxList
+from maskrcnn_benchmark.structures.boxlist_ops import cat_boxlist
+
+
+def _random_anchors(num_images, sizes, image_size, num_anchors_per_location):
+    width, height = image_size
+    anchors = []
+    for _ in range(num_images):
+        per_level = []
+        for h, w in sizes:
+            n = h * w * num_anchors_per_location
+            xy = torch.rand(n, 2) * torch.tensor([width, height]).float()
+            wh = torch.rand(n, 2) * 200 + 8
+            per_level.append(BoxList(torch.cat([xy - wh / 2, xy + wh / 2], dim=1), image_size))
+        anchors.append(per_level)
+    return anchors
+
+
+def _python_forward(postprocessor, anchors, box_cls, box_regression):
+    # the per level path of RetinaNetPostProcessor.forward, without its device dispatch
+    sampled_boxes = [
+        postprocessor.forward_for_single_feature_map(a, o, b, postprocessor.pre_nms_thresh)
+        for a, o, b in zip(zip(*anchors), box_cls, box_regression)
+    ]
+    boxlists = [cat_boxlist(boxlist) for boxlist in zip(*sampled_boxes)]
+    return postprocessor.select_over_all_levels(boxlists)
+
+
+def _sorted(boxlist):
+    # by label, then by decreasing score
+    labels = boxlist.get_field("labels")
+    scores = boxlist.get_field("scores")
+    order = sorted(range(len(boxlist)), key=lambda i: (labels[i].item(), -scores[i].item()))
+    order = torch.tensor(order, dtype=torch.int64)
+    return boxlist.bbox[order], scores[order], labels[order]
+
+
+class TestRetinaNetPostProcessCPU(unittest.TestCase):
+    def assertMatchesPython(self, postprocessor, anchors, box_cls, box_regression):
+        expected = _python_forward(postprocessor, anchors, box_cls, box_regression)
+        actual = postprocessor(anchors, box_cls, box_regression)
+        self.assertEqual(len(actual), len(expected))
+        for a, e in zip(actual, expected):
+            self.assertEqual(a.size, e.size)
+            boxes, scores, labels = _sorted(a)
+            expected_boxes, expected_scores, expected_labels = _sorted(e)
+            self.assertTrue(torch.equal(labels, expected_labels))
+            self.assertTrue(torch.allclose(scores, expected_scores, atol=1e-6))
+            self.assertTrue(torch.allclose(boxes, expected_boxes, atol=1e-3))
+
+    def test_matches_python(self):
+        torch.manual_seed(0)
+        A, C = 9, 80
+        sizes = [(20, 24), (10, 12), (5, 6)]
+        anchors = _random_anchors(2, sizes, (384, 320), A)
+        # mostly background, as after the focal loss prior
+        box_cls = [torch.randn(2, A * C, h, w) * 2 - 5 for h, w in sizes]
+        box_regression = [torch.randn(2, A * 4, h, w) * 0.5 for h, w in sizes]
+        for pre_nms_top_n, fpn_post_nms_top_n in [(1000, 100), (50, 20), (1000, 0)]:
+            postprocessor = RetinaNetPostProcessor(
+                pre_nms_thresh=0.05,
+                pre_nms_top_n=pre_nms_top_n,
+                nms_thresh=0.5,
+                fpn_post_nms_top_n=fpn_post_nms_top_n,
+                min_size=0,
+            )
+            self.assertMatchesPython(postprocessor, anchors, box_cls, box_regression)
+
+    def test_min_size(self):
+        torch.manual_seed(1)
+        A, C = 3, 80
+        sizes = [(8, 8)]
+        anchors = _random_anchors(1, sizes, (64, 64), A)
+        box_cls = [torch.randn(1, A * C, h, w) for h, w in sizes]
+        box_regression = [torch.randn(1, A * 4, h, w) for h, w in sizes]
+        postprocessor = RetinaNetPostProcessor(0.05, 1000, 0.5, 100, min_size=40)
+        self.assertMatchesPython(postprocessor, anchors, box_cls, box_regression)
+
+    def test_empty(self):
+        # no candidate above the threshold keeps a single dummy detection
+        A, C = 9, 80
+        anchors = _random_anchors(2, [(4, 4)], (64, 64), A)
+        box_cls = [torch.full((2, A * C, 4, 4), -10.)]
+        box_regression = [torch.zeros(2, A * 4, 4, 4)]
+        postprocessor = RetinaNetPostProcessor(0.05, 1000, 0.5, 100, min_size=0)
+        for result in postprocessor(anchors, box_cls, box_regression):
+            self.assertEqual(len(result), 1)
+            self.assertEqual(result.bbox.device.type, "cpu")
+            self.assertEqual(result.get_field("labels").tolist(), [1])
+
+
+if __name__ == "__main__":
+    unittest.main()
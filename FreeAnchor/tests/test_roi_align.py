@@ -0,0 +1,144 @@
+# Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+import math
+import unittest
+
+import torch
+
+from maskrcnn_benchmark.layers import roi_align, multilevel_roi_align
+from maskrcnn_benchmark.modeling.poolers import Pooler
+from maskrcnn_benchmark.structures.bounding_box import BoxList
+
+from box_test_utils import random_rois
+
+
+def _bilinear(feature, y, x):
+    # feature: [C, H, W], mirrors bilinear_interpolate of the CUDA kernel
+    height, width = feature.shape[1:]
+    if y < -1.0 or y > height or x < -1.0 or x > width:
+        return feature.new_zeros(feature.shape[0])
+    y = max(y, 0.0)
+    x = max(x, 0.0)
+    y_low = int(y)
+    x_low = int(x)
+    if y_low >= height - 1:
+        y_high = y_low = height - 1
+        y = float(y_low)
+    else:
+        y_high = y_low + 1
+    if x_low >= width - 1:
+        x_high = x_low = width - 1
+        x = float(x_low)
+    else:
+        x_high = x_low + 1
+    ly = y - y_low
+    lx = x - x_low
+    hy = 1.0 - ly
+    hx = 1.0 - lx
+    return (hy * hx * feature[:, y_low, x_low] + hy * lx * feature[:, y_low, x_high]
+            + ly * hx * feature[:, y_high, x_low] + ly * lx * feature[:, y_high, x_high])
+
+
+def _roi_align_reference(input, rois, output_size, spatial_scale, sampling_ratio):
+    pooled_h, pooled_w = output_size
+    output = input.new_zeros(rois.size(0), input.size(1), pooled_h, pooled_w)
+    for n, roi in enumerate(rois.tolist()):
+        feature = input[int(roi[0])]
+        start_w, start_h, end_w, end_h = [v * spatial_scale for v in roi[1:]]
+        roi_w = max(end_w - start_w, 1.0)
+        roi_h = max(end_h - start_h, 1.0)
+        bin_h = roi_h / pooled_h
+        bin_w = roi_w / pooled_w
+        grid_h = sampling_ratio if sampling_ratio > 0 else int(math.ceil(roi_h / pooled_h))
+        grid_w = sampling_ratio if sampling_ratio > 0 else int(math.ceil(roi_w / pooled_w))
+        for ph in range(pooled_h):
+            for pw in range(pooled_w):
+                acc = input.new_zeros(input.size(1))
+                for iy in range(grid_h):
+                    y = start_h + ph * bin_h + (iy + 0.5) * bin_h / grid_h
+                    for ix in range(grid_w):
+                        x = start_w + pw * bin_w + (ix + 0.5) * bin_w / grid_w
+                        acc += _bilinear(feature, y, x)
+                output[n, :, ph, pw] = acc / (grid_h * grid_w)
+    return output
+
+
+class TestROIAlignCPU(unittest.TestCase):
+    def test_forward_matches_reference(self):
+        torch.manual_seed(0)
+        # 3 channels takes the NCHW path, 40 the channels-last block path
+        for channels in [3, 40]:
+            for sampling_ratio in [0, 2]:
+                input = torch.rand(2, channels, 12, 15)
+                rois = random_rois(6, 2, 100)
+                output = roi_align(input, rois, (5, 4), 0.125, sampling_ratio)
+                expected = _roi_align_reference(input, rois, (5, 4), 0.125, sampling_ratio)
+                self.assertTrue(torch.allclose(output, expected, atol=1e-5))
+
+    def test_backward_gradcheck(self):
+        torch.manual_seed(0)
+        for channels in [3, 40]:
+            input = torch.rand(2, channels, 10, 12, dtype=torch.float64, requires_grad=True)
+            rois = random_rois(5, 2, 80).double()
+            self.assertTrue(torch.autograd.gradcheck(
+                lambda x: roi_align(x, rois, (3, 3), 0.125, 2), (input,)))
+
+    def test_forward_empty(self):
+        input = torch.rand(1, 8, 10, 10)
+        rois = torch.zeros(0, 5)
+        output = roi_align(input, rois, (7, 7), 1.0, 2)
+        self.assertEqual(output.shape, (0, 8, 7, 7))
+
+
+class TestMultiLevelROIAlignCPU(unittest.TestCase):
+    scales = (0.25, 0.125, 0.0625, 0.03125)
+
+    def _inputs(self, channels, dtype=torch.float32):
+        features = [torch.rand(2, channels, int(64 * s), int(96 * s), dtype=dtype)
+                    for s in self.scales]
+        # rois of all sizes, so that every level gets some
+        boxes = []
+        for _ in range(2):
+            xy = torch.rand(12, 2) * 200
+            wh = torch.rand(12, 1) ** 2 * 480 + torch.rand(12, 2) * 8
+            boxes.append(BoxList(torch.cat([xy, xy + wh], dim=1).to(dtype), (384, 256)))
+        return features, boxes
+
+    def _per_level(self, pooler, features, boxes):
+        # Pooler.forward before the fused op
+        rois = pooler.convert_to_roi_format(boxes)
+        levels = pooler.map_levels(boxes)
+        result = features[0].new_zeros(len(rois), features[0].size(1), 5, 5)
+        for level, (feature, roi_align) in enumerate(zip(features, pooler.poolers)):
+            idx_in_level = torch.nonzero(levels == level).squeeze(1)
+            if len(idx_in_level) > 0:
+                result[idx_in_level] = roi_align(feature, rois[idx_in_level])
+        return result
+
+    def test_pooler_matches_per_level(self):
+        torch.manual_seed(0)
+        for channels in [3, 40]:
+            features, boxes = self._inputs(channels)
+            pooler = Pooler((5, 5), self.scales, 2)
+            levels = pooler.map_levels(boxes)
+            self.assertGreater(len(torch.unique(levels)), 2)
+            # an extra level, as the max pool of the FPN adds, is not pooled
+            output = pooler(features + [features[-1][:, :, ::2, ::2]], boxes)
+            expected = self._per_level(pooler, features, boxes)
+            self.assertTrue(torch.allclose(output, expected, atol=1e-6))
+
+    def test_backward_gradcheck(self):
+        torch.manual_seed(0)
+        features, boxes = self._inputs(3, torch.float64)
+        features = [f.requires_grad_() for f in features]
+        rois = Pooler((5, 5), self.scales, 2).convert_to_roi_format(boxes)
+        self.assertTrue(torch.autograd.gradcheck(
+            lambda *x: multilevel_roi_align(x, rois, (2, 2), self.scales, 2), features))
+
+    def test_forward_empty(self):
+        features, _ = self._inputs(8)
+        output = multilevel_roi_align(features, torch.zeros(0, 5), (7, 7), self.scales, 2)
+        self.assertEqual(output.shape, (0, 8, 7, 7))
+
+
+if __name__ == "__main__":
+    unittest.main()
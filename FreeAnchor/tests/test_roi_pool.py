@@ -0,0 +1,67 @@
+# Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+import math
+import unittest
+
+import torch
+
+from maskrcnn_benchmark import _C
+from maskrcnn_benchmark.layers import roi_pool
+
+from box_test_utils import random_rois
+
+
+def _roi_pool_reference(input, rois, output_size, spatial_scale):
+    pooled_h, pooled_w = output_size
+    height, width = input.shape[2:]
+    output = input.new_zeros(rois.size(0), input.size(1), pooled_h, pooled_w)
+    for n, roi in enumerate(rois.tolist()):
+        feature = input[int(roi[0])]
+        start_w, start_h, end_w, end_h = [int(round(v * spatial_scale)) for v in roi[1:]]
+        bin_h = max(end_h - start_h + 1, 1) / float(pooled_h)
+        bin_w = max(end_w - start_w + 1, 1) / float(pooled_w)
+        for ph in range(pooled_h):
+            hstart = min(max(int(math.floor(ph * bin_h)) + start_h, 0), height)
+            hend = min(max(int(math.ceil((ph + 1) * bin_h)) + start_h, 0), height)
+            for pw in range(pooled_w):
+                wstart = min(max(int(math.floor(pw * bin_w)) + start_w, 0), width)
+                wend = min(max(int(math.ceil((pw + 1) * bin_w)) + start_w, 0), width)
+                if hend <= hstart or wend <= wstart:
+                    continue
+                region = feature[:, hstart:hend, wstart:wend]
+                output[n, :, ph, pw] = region.contiguous().view(region.size(0), -1).max(1)[0]
+    return output
+
+
+class TestROIPoolCPU(unittest.TestCase):
+    def test_forward_matches_reference(self):
+        torch.manual_seed(0)
+        input = torch.rand(2, 4, 20, 24)
+        rois = random_rois(8, 2, 150)
+        output = roi_pool(input, rois, (5, 6), 0.125)
+        expected = _roi_pool_reference(input, rois, (5, 6), 0.125)
+        self.assertTrue(torch.equal(output, expected))
+
+    def test_argmax_layout(self):
+        torch.manual_seed(0)
+        input = torch.rand(1, 3, 16, 16)
+        rois = torch.tensor([[0, 0, 0, 60, 60], [0, 200, 200, 260, 260]], dtype=torch.float32)
+        output, argmax = _C.roi_pool_forward(input, rois, 0.25, 4, 4)
+        self.assertEqual(argmax.dtype, torch.int32)
+        self.assertEqual(argmax.shape, output.shape)
+        flat = input[0].view(3, -1)
+        gathered = flat.gather(1, argmax[0].long().view(3, -1)).view(3, 4, 4)
+        self.assertTrue(torch.equal(gathered, output[0]))
+        # the second roi lies outside of the feature map
+        self.assertTrue((argmax[1] == -1).all())
+        self.assertTrue((output[1] == 0).all())
+
+    def test_backward_gradcheck(self):
+        torch.manual_seed(0)
+        input = torch.rand(2, 3, 10, 12, dtype=torch.float64, requires_grad=True)
+        rois = random_rois(5, 2, 80).double()
+        self.assertTrue(torch.autograd.gradcheck(
+            lambda x: roi_pool(x, rois, (3, 3), 0.125), (input,)))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,63 @@
+# Copyright (c) Facebook, Inc. and its affiliates. All Rights Reserved.
+import unittest
+
+import torch
+from torch.nn import functional as F
+
+from maskrcnn_benchmark import _C
+from maskrcnn_benchmark.layers import SigmoidFocalLoss
+
+
+def _focal_loss_reference(logits, targets, gamma, alpha):
+    num_classes = logits.size(1)
+    class_range = torch.arange(1, num_classes + 1, dtype=targets.dtype).unsqueeze(0)
+    t = targets.unsqueeze(1)
+    p = torch.sigmoid(logits)
+    term1 = (1 - p) ** gamma * F.logsigmoid(logits)
+    term2 = p ** gamma * F.logsigmoid(-logits)
+    pos = (t == class_range).type_as(logits)
+    neg = ((t != class_range) & (t >= 0)).type_as(logits)
+    return -pos * term1 * alpha - neg * term2 * (1 - alpha)
+
+
+class TestSigmoidFocalLossCPU(unittest.TestCase):
+    def setUp(self):
+        torch.manual_seed(0)
+        self.logits = torch.randn(300, 20, dtype=torch.float64) * 6
+        # -1 is ignored and 0 is background
+        self.targets = torch.randint(-1, 21, (300,)).int()
+
+    def test_forward_backward(self):
+        for gamma in [2.0, 1.5]:
+            expected = _focal_loss_reference(self.logits, self.targets, gamma, 0.25)
+            losses = _C.sigmoid_focalloss_forward(self.logits, self.targets, 20, gamma, 0.25)
+            self.assertTrue(torch.allclose(losses, expected))
+
+            logits = self.logits.clone().requires_grad_()
+            d_losses = torch.rand_like(self.logits)
+            _focal_loss_reference(logits, self.targets, gamma, 0.25).backward(d_losses)
+            d_logits = _C.sigmoid_focalloss_backward(
+                self.logits, self.targets, d_losses, 20, gamma, 0.25)
+            self.assertTrue(torch.allclose(d_logits, logits.grad))
+
+    def test_fused_module(self):
+        loss_func = SigmoidFocalLoss(20, 2.0, 0.25)
+        logits = self.logits.clone().requires_grad_()
+        loss = loss_func(logits, self.targets)
+        (loss * 3).backward()
+
+        ref_logits = self.logits.clone().requires_grad_()
+        ref_loss = _focal_loss_reference(ref_logits, self.targets, 2.0, 0.25).sum()
+        (ref_loss * 3).backward()
+        self.assertTrue(torch.allclose(loss, ref_loss))
+        self.assertTrue(torch.allclose(logits.grad, ref_logits.grad))
+
+    def test_extreme_logits(self):
+        logits = torch.tensor([[-200.0, 200.0], [200.0, -200.0]])
+        targets = torch.tensor([1, 1]).int()
+        losses = _C.sigmoid_focalloss_forward(logits, targets, 2, 2.0, 0.25)
+        self.assertTrue(torch.isfinite(losses).all())
+
+
+if __name__ == "__main__":
+    unittest.main()
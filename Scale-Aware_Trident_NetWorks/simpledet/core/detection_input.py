@@ -7,8 +7,10 @@ import mxnet as mx
 
 from queue import Queue
 from threading import Thread
-from operator_py.cython.bbox import bbox_overlaps_cython
+from operator_py.cython.anchor_target import assign_anchor_label, anchor_target
+from operator_py.cython.image_transform import transform_image
 from operator_py.bbox_transform import nonlinear_transform as bbox_transform
+from utils.columnar_roidb import ColumnarRoidb
 
 
 class DetectionAugmentation(object):
@@ -35,15 +37,19 @@ class ReadRoiRecord(DetectionAugmentation):
     def apply(self, input_record):
         image = cv2.imread(input_record["image_url"], cv2.IMREAD_COLOR)
         input_record["image"] = image[:, :, ::-1].astype("float32")
-        # TODO: remove this compatibility method
-        input_record["gt_bbox"] = np.concatenate([input_record["gt_bbox"],
-                                                  input_record["gt_class"].reshape(-1, 1)],
-                                                 axis=1)
+        self.merge_gt_class(input_record)
 
         # gt_dict = pkl.load(input_record["gt_url"])
         # for s in self.gt_select:
         #     input_record[s] = gt_dict[s]
 
+    @staticmethod
+    def merge_gt_class(input_record):
+        # TODO: remove this compatibility method
+        input_record["gt_bbox"] = np.concatenate([input_record["gt_bbox"],
+                                                  input_record["gt_class"].reshape(-1, 1)],
+                                                 axis=1)
+
 
 class Norm2DImage(DetectionAugmentation):
     """
@@ -80,20 +86,29 @@ class Resize2DImageBbox(DetectionAugmentation):
         self.p = pResize  # type: ResizeParam
 
     def apply(self, input_record):
+        image = input_record["image"]
+
+        h, w = image.shape[:2]
+        scale = self.resize_bbox(input_record, h, w)
+        input_record["image"] = cv2.resize(image, None, None, scale, scale,
+                                           interpolation=cv2.INTER_LINEAR)
+
+    def resize_bbox(self, input_record, h, w):
+        """
+        scale gt_bbox and set im_info for a h x w image
+        :return: the resize factor of the image
+        """
         p = self.p
 
-        image = input_record["image"]
         gt_bbox = input_record["gt_bbox"].astype(np.float32)
 
-        short = min(image.shape[:2])
-        long = max(image.shape[:2])
+        short = min(h, w)
+        long = max(h, w)
         scale = min(p.short / short, p.long / long)
 
-        input_record["image"] = cv2.resize(image, None, None, scale, scale,
-                                           interpolation=cv2.INTER_LINEAR)
         # make sure gt boxes do not overflow
         gt_bbox[:, :4] = gt_bbox[:, :4] * scale
-        if image.shape[0] < image.shape[1]:
+        if h < w:
             gt_bbox[:, [0, 2]] = np.clip(gt_bbox[:, [0, 2]], 0, p.long)
             gt_bbox[:, [1, 3]] = np.clip(gt_bbox[:, [1, 3]], 0, p.short)
         else:
@@ -102,8 +117,8 @@ class Resize2DImageBbox(DetectionAugmentation):
         input_record["gt_bbox"] = gt_bbox
 
         # exactly as opencv
-        h, w = image.shape[:2]
         input_record["im_info"] = np.array([round(h * scale), round(w * scale), scale], dtype=np.float32)
+        return scale
 
 
 class Resize2DImage(DetectionAugmentation):
@@ -202,11 +217,14 @@ class Flip2DImageBbox(DetectionAugmentation):
             gt_bbox = input_record["gt_bbox"]
 
             input_record["image"] = image[:, ::-1]
-            flipped_bbox = gt_bbox.copy()
-            h, w = image.shape[:2]
-            flipped_bbox[:, 0] = (w - 1) - gt_bbox[:, 2]
-            flipped_bbox[:, 2] = (w - 1) - gt_bbox[:, 0]
-            input_record["gt_bbox"] = flipped_bbox
+            input_record["gt_bbox"] = self.flip_bbox(gt_bbox, image.shape[1])
+
+    @staticmethod
+    def flip_bbox(gt_bbox, w):
+        flipped_bbox = gt_bbox.copy()
+        flipped_bbox[:, 0] = (w - 1) - gt_bbox[:, 2]
+        flipped_bbox[:, 2] = (w - 1) - gt_bbox[:, 0]
+        return flipped_bbox
 
 
 class RandCrop2DImageBbox(DetectionAugmentation):
@@ -302,7 +320,6 @@ class Pad2DImageBbox(DetectionAugmentation):
         p = self.p
 
         image = input_record["image"]
-        gt_bbox = input_record["gt_bbox"]
 
         h, w = image.shape[:2]
         shape = (p.long, p.short, 3) if h >= w \
@@ -310,10 +327,14 @@ class Pad2DImageBbox(DetectionAugmentation):
 
         padded_image = np.zeros(shape, dtype=np.float32)
         padded_image[:h, :w] = image
-        padded_gt_bbox = np.full(shape=(p.max_num_gt, 5), fill_value=-1, dtype=np.float32)
-        padded_gt_bbox[:len(gt_bbox)] = gt_bbox
 
         input_record["image"] = padded_image
+        self.pad_bbox(input_record)
+
+    def pad_bbox(self, input_record):
+        gt_bbox = input_record["gt_bbox"]
+        padded_gt_bbox = np.full(shape=(self.p.max_num_gt, 5), fill_value=-1, dtype=np.float32)
+        padded_gt_bbox[:len(gt_bbox)] = gt_bbox
         input_record["gt_bbox"] = padded_gt_bbox
 
 
@@ -352,6 +373,101 @@ class ConvertImageFromHwcToChw(DetectionAugmentation):
         input_record["image"] = input_record["image"].transpose((2, 0, 1))
 
 
+class DeferredImage(object):
+    """
+    decoded image whose normalize, resize, flip, pad and chw conversion are left
+    to render, which writes it straight into an image of a batch buffer
+    shape: (3, h, w) of the rendered image
+    """
+    dtype = np.dtype(np.float32)
+
+    def __init__(self, image, scale, resized_h, resized_w, flipped, mean, std, shape):
+        self.image = image  # uint8 (h, w, bgr) as decoded
+        self.scale = scale
+        self.resized_h = resized_h
+        self.resized_w = resized_w
+        self.flipped = flipped
+        self.mean = mean
+        self.std = std
+        self.shape = shape
+
+    def render(self, out):
+        transform_image(self.image, out, self.resized_h, self.resized_w, self.scale,
+                        self.flipped, self.mean, self.std)
+
+    def __array__(self, dtype=None, copy=None):
+        image = np.empty(self.shape, dtype=np.float32)
+        self.render(image)
+        return image if dtype is None else image.astype(dtype, copy=False)
+
+
+class Fused2DImageBbox(DetectionAugmentation):
+    """
+    ReadRoiRecord, Norm2DImage, Resize2DImageBbox, optionally Flip2DImageBbox and
+    Pad2DImageBbox, then ConvertImageFromHwcToChw in one transform. gt_bbox and
+    im_info are computed by the fused transforms, the image is left as a
+    DeferredImage for the Loader worker to render into its batch buffer.
+    input: image_url, str
+    output: image, DeferredImage(3, h, w)
+            im_info, tuple(h', w', scale)
+            gt_bbox, ndarray(n, 5) or ndarray(max_num_gt, 5) if padded
+    """
+
+    def __init__(self, read, norm, resize, flip=None, pad=None):
+        super().__init__()
+        self.read = read
+        self.norm = norm
+        self.resize = resize
+        self.flip = flip
+        self.pad = pad
+
+    @staticmethod
+    def fuse(transform):
+        """
+        replace the image reading prefix of a transform list by a Fused2DImageBbox,
+        only transforms of exactly these types are fused as subclasses may change them
+        :return: the new transform list, or the list itself if it does not start so
+        """
+        kinds = [type(t) for t in transform]
+        if kinds[:3] != [ReadRoiRecord, Norm2DImage, Resize2DImageBbox]:
+            return transform
+        n = 3
+        flip = pad = None
+        if n < len(kinds) and kinds[n] is Flip2DImageBbox:
+            flip = transform[n]
+            n += 1
+        if n < len(kinds) and kinds[n] is Pad2DImageBbox:
+            pad = transform[n]
+            n += 1
+        if n == len(kinds) or kinds[n] is not ConvertImageFromHwcToChw:
+            return transform
+        fused = Fused2DImageBbox(transform[0], transform[1], transform[2], flip, pad)
+        return [fused] + list(transform[n + 1:])
+
+    def apply(self, input_record):
+        image = cv2.imread(input_record["image_url"], cv2.IMREAD_COLOR)
+        self.read.merge_gt_class(input_record)
+
+        h, w = image.shape[:2]
+        scale = self.resize.resize_bbox(input_record, h, w)
+        resized_h, resized_w = int(input_record["im_info"][0]), int(input_record["im_info"][1])
+
+        flipped = self.flip is not None and input_record["flipped"]
+        if flipped:
+            input_record["gt_bbox"] = Flip2DImageBbox.flip_bbox(input_record["gt_bbox"], resized_w)
+
+        shape = (3, resized_h, resized_w)
+        if self.pad is not None:
+            p = self.pad.p
+            shape = (3, p.long, p.short) if resized_h >= resized_w \
+                else (3, p.short, p.long)
+            self.pad.pad_bbox(input_record)
+
+        norm = self.norm.p
+        input_record["image"] = DeferredImage(image, scale, resized_h, resized_w, flipped,
+                                              norm.mean, norm.std, shape)
+
+
 class AnchorTarget2D(DetectionAugmentation):
     """
     input: image_meta: tuple(h, w, scale)
@@ -450,34 +566,14 @@ class AnchorTarget2D(DetectionAugmentation):
         self.__num_anchor = value.shape[0]
 
     def _assign_label_to_anchor(self, valid_anchor, gt_bbox, neg_thr, pos_thr, min_pos_thr):
-        num_anchor = valid_anchor.shape[0]
-        cls_label = np.full(shape=(num_anchor,), fill_value=-1, dtype=np.float32)
-
-        if len(gt_bbox) > 0:
-            # num_anchor x num_gt
-            overlaps = bbox_overlaps_cython(valid_anchor.astype(np.float32, copy=False), gt_bbox.astype(np.float32, copy=False))
-            max_overlaps = overlaps.max(axis=1)
-            argmax_overlaps = overlaps.argmax(axis=1)
-            gt_max_overlaps = overlaps.max(axis=0)
-
-            # TODO: speed up this
-            # TODO: fix potentially assigning wrong anchors as positive
-            # A correct implementation is given as
-            # gt_argmax_overlaps = np.where((overlaps.transpose() == gt_max_overlaps[:, None]) &
-            #                               (overlaps.transpose() >= min_pos_thr))[1]
-            gt_argmax_overlaps = np.where((overlaps == gt_max_overlaps) &
-                                          (overlaps >= min_pos_thr))[0]
-            # anchor class
-            cls_label[max_overlaps < neg_thr] = 0
-            # fg label: for each gt, anchor with highest overlap
-            cls_label[gt_argmax_overlaps] = 1
-            # fg label: above threshold IoU
-            cls_label[max_overlaps >= pos_thr] = 1
-        else:
-            cls_label[:] = 0
-            argmax_overlaps = np.zeros(shape=(num_anchor, ))
-
-        return cls_label, argmax_overlaps
+        """
+        label every anchor by its overlaps with the gt boxes: bg below neg_thr, fg at or
+        above pos_thr and for each gt the anchors of its highest overlap (if at least
+        min_pos_thr), ignored otherwise. Note that a gt overlapping no anchor has a highest
+        overlap of 0, so with min_pos_thr 0 every anchor becomes fg through it.
+        :return: float32 label and the index of the best overlapping gt of every anchor
+        """
+        return assign_anchor_label(valid_anchor, gt_bbox, neg_thr, pos_thr, min_pos_thr)
 
     def _sample_anchor(self, label, num, fg_fraction):
         num_fg = int(fg_fraction * num)
@@ -507,6 +603,25 @@ class AnchorTarget2D(DetectionAugmentation):
 
         return reg_target, reg_weight
 
+    def _assign_sample_target(self, valid_anchor, gt_bbox):
+        """
+        _assign_label_to_anchor, _sample_anchor and _cal_anchor_target in one native call,
+        which releases the GIL so that the loader workers run it in parallel
+        """
+        p = self.p
+        if self.DEBUG:
+            cls_label, anchor_label = \
+                self._assign_label_to_anchor(valid_anchor, gt_bbox,
+                                             p.assign.neg_thr, p.assign.pos_thr, p.assign.min_pos_thr)
+            self._sample_anchor(cls_label, p.sample.image_anchor, p.sample.pos_fraction)
+            reg_target, reg_weight = self._cal_anchor_target(cls_label, valid_anchor, gt_bbox, anchor_label)
+            return cls_label, reg_target, reg_weight
+
+        # seeded from np.random so that np.random.seed still fixes the sampling
+        seed = np.random.randint(0, 2 ** 31)
+        return anchor_target(valid_anchor, gt_bbox, p.assign.neg_thr, p.assign.pos_thr,
+                             p.assign.min_pos_thr, p.sample.image_anchor, p.sample.pos_fraction, seed)
+
     def _gather_valid_anchor(self, image_info):
         h, w = image_info[:2]
         all_anchor = self.v_all_anchor if h >= w else self.h_all_anchor
@@ -544,11 +659,7 @@ class AnchorTarget2D(DetectionAugmentation):
             gt_bbox = gt_bbox[:, :4]
 
         valid_index, valid_anchor = self._gather_valid_anchor(im_info)
-        cls_label, anchor_label = \
-            self._assign_label_to_anchor(valid_anchor, gt_bbox,
-                                         p.assign.neg_thr, p.assign.pos_thr, p.assign.min_pos_thr)
-        self._sample_anchor(cls_label, p.sample.image_anchor, p.sample.pos_fraction)
-        reg_target, reg_weight = self._cal_anchor_target(cls_label, valid_anchor, gt_bbox, anchor_label)
+        cls_label, reg_target, reg_weight = self._assign_sample_target(valid_anchor, gt_bbox)
         cls_label, reg_target, reg_weight = \
             self._scatter_valid_anchor(valid_index, cls_label, reg_target, reg_weight)
 
@@ -584,16 +695,22 @@ class Loader(mx.io.DataIter):
     Loader.next is called in the main thread,
     multiple worker threads are responsible for performing transform,
     a collector thread is responsible for converting numpy array to mxnet array.
+    A transform list starting with the image reading transforms is fused into a
+    Fused2DImageBbox, whose images are rendered by a native kernel releasing the
+    GIL straight into the batch array.
     """
 
     def __init__(self, roidb, transform, data_name, label_name, batch_size=1,
                  shuffle=False, num_worker=None, num_collector=None,
-                 worker_queue_depth=None, collector_queue_depth=None, kv=None, valid_count=-1):
+                 worker_queue_depth=None, collector_queue_depth=None, kv=None, valid_count=-1,
+                 fuse_transform=True):
         """
         This Iter will provide roi data to Fast R-CNN network
         :param roidb: must be preprocessed
         :param batch_size:
         :param shuffle: bool
+        :param fuse_transform: fuse the image reading transforms, disable it when a
+            later transform reads the image
         :return: Loader
         """
         super().__init__(batch_size=batch_size)
@@ -610,6 +727,8 @@ class Loader(mx.io.DataIter):
         else:
             self.transform = transform
             self.batch_transform = list()
+        if fuse_transform:
+            self.transform = Fused2DImageBbox.fuse(self.transform)
 
         # save parameters as properties
         self.roidb = roidb
@@ -729,11 +848,23 @@ class Loader(mx.io.DataIter):
                 records.append(roi_record)
             data_batch = {}
             for name in self.data_name + self.label_name:
-                data_batch[name] = np.ascontiguousarray(np.stack([r[name] for r in records]))
+                data_batch[name] = self.stack([r[name] for r in records])
             for trans in self.batch_transform:
                 trans.apply(data_batch)
             data_queue.put(data_batch)
 
+    @staticmethod
+    def stack(values):
+        shape = values[0].shape
+        if isinstance(values[0], DeferredImage) and all(v.shape == shape for v in values):
+            # the collector hands the batch to mxnet without a copy, so every
+            # batch gets its own array
+            batch = np.empty((len(values),) + shape, dtype=np.float32)
+            for value, out in zip(values, batch):
+                value.render(out)
+            return batch
+        return np.ascontiguousarray(np.stack(values))
+
     def collector(self):
         while True:
             record = self.data_queue.get()
@@ -867,6 +998,9 @@ class AnchorLoader(mx.io.DataIter):
 
     @staticmethod
     def roidb_aspect_group(roidb):
+        if isinstance(roidb, ColumnarRoidb):
+            vertical = roidb.h >= roidb.w
+            return roidb[np.where(vertical)[0]], roidb[np.where(~vertical)[0]]
         v_roidb, h_roidb = [], []
         for roirec in roidb:
             if roirec["h"] >= roirec["w"]:
@@ -6,6 +6,7 @@ from core.detection_module import DetModule
 from core.detection_input import Loader
 from utils.load_model import load_checkpoint
 from utils.patch_config import patch_config_as_nothrow
+from utils.columnar_roidb import load_roidb
 
 from functools import reduce
 from queue import Queue
@@ -14,7 +15,6 @@ import argparse
 import importlib
 import mxnet as mx
 import numpy as np
-import pickle as pkl
 
 
 def parse_args():
@@ -48,11 +48,11 @@ if __name__ == "__main__":
     sym = pModel.test_symbol
 
     image_sets = pDataset.image_set
-    roidbs_all = [pkl.load(open("data/cache/{}.roidb".format(i), "rb"), encoding="latin1") for i in image_sets]
+    roidbs_all = [load_roidb(i) for i in image_sets]
     roidbs_all = reduce(lambda x, y: x + y, roidbs_all)
 
     from pycocotools.coco import COCO
-    from pycocotools.cocoeval import COCOeval
+    from utils.coco_eval import COCOeval
     from utils.roidb_to_coco import roidb_to_coco
     if pTest.coco.annotation is not None:
         coco = COCO(pTest.coco.annotation)
@@ -69,7 +69,7 @@ if __name__ == "__main__":
 
     for index_split in range(int(math.ceil(len(roidbs_all) / split_size))):
         print("evaluating [%d, %d)" % (index_split * split_size, (index_split + 1) * split_size))
-        roidb = roidbs_all[index_split * split_size:(index_split + 1) * split_size]
+        roidb = list(roidbs_all[index_split * split_size:(index_split + 1) * split_size])
         roidb = pTest.process_roidb(roidb)
         for i, x in enumerate(roidb):
             x["rec_id"] = np.array(i, dtype=np.float32)
@@ -214,11 +214,14 @@ if __name__ == "__main__":
             from operator_py.nms import py_nms_wrapper
             nms = py_nms_wrapper(pTest.nms.thr)
 
-        def do_nms(k):
+        # gather the dets of every image and class, and run nms on all of them
+        # in one native call when the nms has a batched entry point
+        cat_ids = coco.getCatIds()
+        nms_keys = []
+        nms_dets = []
+        for k in output_dict:
             bbox_xyxy = output_dict[k]["bbox_xyxy"]
             cls_score = output_dict[k]["cls_score"]
-            final_dets = {}
-
             for cid in range(cls_score.shape[1]):
                 score = cls_score[:, cid]
                 if bbox_xyxy.shape[1] != 4:
@@ -229,20 +232,25 @@ if __name__ == "__main__":
                 box = cls_box[valid_inds]
                 score = score[valid_inds]
                 det = np.concatenate((box, score.reshape(-1, 1)), axis=1).astype(np.float32)
-                det = nms(det)
-                dataset_cid = coco.getCatIds()[cid]
-                final_dets[dataset_cid] = det
-            output_dict[k]["det_xyxys"] = final_dets
+                nms_keys.append((k, cat_ids[cid]))
+                nms_dets.append(det)
+            output_dict[k]["det_xyxys"] = {}
             del output_dict[k]["bbox_xyxy"]
             del output_dict[k]["cls_score"]
-            return (k, output_dict[k])
-
-        from multiprocessing import cpu_count
-        from multiprocessing.pool import Pool
-        pool = Pool(cpu_count() // 2)
-        output_dict = pool.map(do_nms, output_dict.keys())
-        output_dict = dict(output_dict)
-        pool.close()
+
+        def do_nms(det):
+            return nms(det)
+
+        if hasattr(nms, "batch"):
+            nms_dets = nms.batch(nms_dets)
+        else:
+            from multiprocessing import cpu_count
+            from multiprocessing.pool import Pool
+            pool = Pool(max(cpu_count() // 2, 1))
+            nms_dets = pool.map(do_nms, nms_dets)
+            pool.close()
+        for (k, dataset_cid), det in zip(nms_keys, nms_dets):
+            output_dict[k]["det_xyxys"][dataset_cid] = det
 
         t4_s = time.time()
         print("nms uses: %.1f" % (t4_s - t3_s))
@@ -3,7 +3,6 @@ import importlib
 import logging
 import os
 import pprint
-import pickle as pkl
 from functools import reduce
 
 from core.detection_module import DetModule
@@ -12,6 +11,7 @@ from utils.memonger_v2 import search_plan_to_layer
 from utils.lr_scheduler import LRScheduler, WarmupMultiFactorScheduler, LRSequential, AdvancedLRScheduler
 from utils.load_model import load_checkpoint
 from utils.patch_config import patch_config_as_nothrow
+from utils.columnar_roidb import ColumnarRoidb, load_roidb
 
 import mxnet as mx
 import numpy as np
@@ -65,17 +65,22 @@ def train_net(config):
 
     # load dataset and prepare imdb for training
     image_sets = pDataset.image_set
-    roidbs = [pkl.load(open("data/cache/{}.roidb".format(i), "rb"), encoding="latin1") for i in image_sets]
+    roidbs = [load_roidb(i) for i in image_sets]
     roidb = reduce(lambda x, y: x + y, roidbs)
-    # filter empty image
-    roidb = [rec for rec in roidb if rec["gt_bbox"].shape[0] > 0]
-    # add flip roi record
-    flipped_roidb = []
-    for rec in roidb:
-        new_rec = rec.copy()
-        new_rec["flipped"] = True
-        flipped_roidb.append(new_rec)
-    roidb = roidb + flipped_roidb
+    if isinstance(roidb, ColumnarRoidb):
+        # filter empty image and add flip roi record without building the records
+        roidb = roidb[np.where(roidb.num_gt > 0)[0]]
+        roidb = roidb + roidb.flip()
+    else:
+        # filter empty image
+        roidb = [rec for rec in roidb if rec["gt_bbox"].shape[0] > 0]
+        # add flip roi record
+        flipped_roidb = []
+        for rec in roidb:
+            new_rec = rec.copy()
+            new_rec["flipped"] = True
+            flipped_roidb.append(new_rec)
+        roidb = roidb + flipped_roidb
 
     from core.detection_input import AnchorLoader
     train_data = AnchorLoader(
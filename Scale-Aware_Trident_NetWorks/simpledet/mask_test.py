@@ -3,7 +3,6 @@ import importlib
 import math
 import os
 import pprint
-import pickle as pkl
 from functools import reduce
 from queue import Queue
 from threading import Thread
@@ -12,6 +11,7 @@ from core.detection_module import DetModule
 from core.detection_input import Loader
 from utils.load_model import load_checkpoint
 from utils.patch_config import patch_config_as_nothrow
+from utils.columnar_roidb import load_roidb
 
 import mxnet as mx
 import numpy as np
@@ -48,11 +48,11 @@ if __name__ == "__main__":
     sym.save(pTest.model.prefix + "_mask_test.json")
 
     image_sets = pDataset.image_set
-    roidbs_all = [pkl.load(open("data/cache/{}.roidb".format(i), "rb"), encoding="latin1") for i in image_sets]
+    roidbs_all = [load_roidb(i) for i in image_sets]
     roidbs_all = reduce(lambda x, y: x + y, roidbs_all)
 
     from pycocotools.coco import COCO
-    from pycocotools.cocoeval import COCOeval
+    from utils.coco_eval import COCOeval
     coco = COCO(pTest.coco.annotation)
 
     data_queue = Queue(100)
@@ -65,7 +65,7 @@ if __name__ == "__main__":
 
     for index_split in range(int(math.ceil(len(roidbs_all) / split_size))):
         print("evaluating [%d, %d)" % (index_split * split_size, (index_split + 1) * split_size))
-        roidb = roidbs_all[index_split * split_size:(index_split + 1) * split_size]
+        roidb = list(roidbs_all[index_split * split_size:(index_split + 1) * split_size])
         roidb = pTest.process_roidb(roidb)
         for i, x in enumerate(roidb):
             x["rec_id"] = np.array(i, dtype=np.float32)
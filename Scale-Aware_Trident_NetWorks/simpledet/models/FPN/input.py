@@ -17,8 +17,6 @@ class PyramidAnchorTarget2DBase(AnchorTarget2D):
     """
 
     def apply(self, input_record):
-        p = self.p
-
         im_info = input_record["im_info"]
         gt_bbox = input_record["gt_bbox"]
         assert isinstance(gt_bbox, np.ndarray)
@@ -30,11 +28,7 @@ class PyramidAnchorTarget2DBase(AnchorTarget2D):
             gt_bbox = gt_bbox[:, :4]
 
         valid_index, valid_anchor = self._gather_valid_anchor(im_info)
-        cls_label, anchor_label = \
-            self._assign_label_to_anchor(valid_anchor, gt_bbox,
-                                         p.assign.neg_thr, p.assign.pos_thr, p.assign.min_pos_thr)
-        self._sample_anchor(cls_label, p.sample.image_anchor, p.sample.pos_fraction)
-        reg_target, reg_weight = self._cal_anchor_target(cls_label, valid_anchor, gt_bbox, anchor_label)
+        cls_label, reg_target, reg_weight = self._assign_sample_target(valid_anchor, gt_bbox)
         cls_label, reg_target, reg_weight = \
             self._scatter_valid_anchor(valid_index, cls_label, reg_target, reg_weight)
 
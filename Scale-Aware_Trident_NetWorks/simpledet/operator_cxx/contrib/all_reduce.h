@@ -0,0 +1,169 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file all_reduce.h
+ * \brief in-process all-reduce of host buffers between the device workers
+ *        of an operator, as used by the synchronized batch norm
+*/
+#ifndef MXNET_OPERATOR_CONTRIB_ALL_REDUCE_H_
+#define MXNET_OPERATOR_CONTRIB_ALL_REDUCE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mxnet {
+namespace op {
+
+// Reusable barrier of a fixed number of threads.
+// The last thread to arrive starts the next generation. The others spin on
+// the generation for a short while, then sleep on a condition variable, so
+// that waiting for a slow device does not burn a core.
+class GenerationBarrier {
+ public:
+  explicit GenerationBarrier(int count)
+    : count_(count), spin_count_(std::thread::hardware_concurrency() > 1 ? kSpinCount : 0) {}
+
+  void Wait() {
+    const uint64_t generation = generation_.load(std::memory_order_acquire);
+    if (arrived_.fetch_add(1, std::memory_order_acq_rel) + 1 == count_) {
+      arrived_.store(0, std::memory_order_relaxed);
+      {
+        // under the lock, so that a thread about to sleep cannot miss it
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation_.store(generation + 1, std::memory_order_release);
+      }
+      cv_.notify_all();
+      return;
+    }
+    for (int i = 0; i < spin_count_; ++i) {
+      if (generation_.load(std::memory_order_acquire) != generation) {
+        return;
+      }
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] {
+      return generation_.load(std::memory_order_acquire) != generation;
+    });
+  }
+
+  // number of times all the threads have met at the barrier
+  uint64_t generation() const {
+    return generation_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static const int kSpinCount = 4096;
+  const int count_;
+  // on a single core the thread to wait for cannot run while this one spins
+  const int spin_count_;
+  std::atomic<int> arrived_{0};
+  std::atomic<uint64_t> generation_{0};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+// Mean of the host buffers of num_ranks threads, one per device.
+// For each reduction, a thread takes a slot with Join, fills Buffer(slot)
+// and calls Reduce(slot). When Reduce returns, the buffer of every slot
+// holds the mean of all the buffers.
+// Each rank reduces a slice of the buffers, summing the ranks in order, and
+// writes the mean of its slice back into every buffer. The ranks work on
+// their slices at the same time and no extra output buffer is needed.
+// The object is reused from one reduction to the next. The buffers keep
+// their size and the slot and reduction counters keep running, so several
+// reductions in a fixed order (e.g. forward, then backward) can share one
+// object. Consecutive reductions use two sets of buffers, so a thread may
+// fill its buffer for the next reduction while a slower one still reads the
+// mean of the previous one.
+template <typename DType>
+class AllReduce {
+ public:
+  explicit AllReduce(int num_ranks)
+    : num_ranks_(num_ranks), buffers_(2 * num_ranks), barrier_(num_ranks) {}
+
+  // slot of the calling thread in the next reduction. Slots are handed out
+  // round robin in order of arrival, which gives each of the num_ranks
+  // threads of a reduction a different rank, slot % num_ranks.
+  int Join() {
+    return static_cast<int>(next_slot_.fetch_add(1, std::memory_order_relaxed) % (2 * num_ranks_));
+  }
+
+  // buffer of slot. Every rank must ask for the same size in a reduction.
+  DType* Buffer(int slot, size_t size) {
+    std::vector<DType> &buffer = buffers_[slot];
+    if (buffer.size() != size) {
+      buffer.resize(size);
+    }
+    return buffer.data();
+  }
+
+  void Reduce(int slot) {
+    // every buffer is filled
+    barrier_.Wait();
+    const int rank = slot % num_ranks_;
+    std::vector<DType> *buffers = &buffers_[slot - rank];
+    const size_t size = buffers[rank].size();
+    // slices are whole cache lines, so that ranks do not write the same ones
+    const size_t align = std::max<size_t>(1, 64 / sizeof(DType));
+    const size_t slice = (size + num_ranks_ * align - 1) / (num_ranks_ * align) * align;
+    const size_t begin = std::min(size, rank * slice);
+    const size_t end = std::min(size, begin + slice);
+    DType *out = buffers[0].data();
+    if (begin < end) {
+      for (int r = 1; r < num_ranks_; ++r) {
+        const DType *in = buffers[r].data();
+        for (size_t i = begin; i < end; ++i) {
+          out[i] += in[i];
+        }
+      }
+      for (size_t i = begin; i < end; ++i) {
+        out[i] /= num_ranks_;
+      }
+      for (int r = 1; r < num_ranks_; ++r) {
+        std::copy(out + begin, out + end, buffers[r].data() + begin);
+      }
+    }
+    // every slice is reduced
+    barrier_.Wait();
+  }
+
+  // number of reductions completed by all the ranks
+  uint64_t generation() const {
+    return barrier_.generation() / 2;
+  }
+
+ private:
+  const int num_ranks_;
+  // buffers of the even reductions, then of the odd ones
+  std::vector<std::vector<DType>> buffers_;
+  GenerationBarrier barrier_;
+  std::atomic<uint64_t> next_slot_{0};
+};
+
+}  // namespace op
+}  // namespace mxnet
+
+#endif  // MXNET_OPERATOR_CONTRIB_ALL_REDUCE_H_
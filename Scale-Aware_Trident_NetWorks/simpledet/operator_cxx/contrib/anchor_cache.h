@@ -0,0 +1,165 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file anchor_cache.h
+ * \brief process-wide cache of the shifted anchors of a feature map, shared by
+ *        the CPU anchor and proposal operators
+*/
+#ifndef MXNET_OPERATOR_CONTRIB_ANCHOR_CACHE_H_
+#define MXNET_OPERATOR_CONTRIB_ANCHOR_CACHE_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace mxnet {
+namespace op {
+namespace anchor_cache {
+
+// The operators round their base anchors differently, so the recipe is part
+// of the key and the cached anchors are exactly those each operator built.
+enum AnchorRecipe {
+  kGenAnchor,   // gen_anchor_utils, double with rint
+  kProposal,    // proposal_utils and proposal_v2_utils, float with floor(x + .5)
+  kProposalV3   // proposal_v3_utils, float with rintf
+};
+
+struct AnchorKey {
+  int recipe;
+  int feature_stride;
+  std::vector<double> scales;
+  std::vector<double> ratios;
+  int height;
+  int width;
+
+  bool operator<(const AnchorKey &other) const {
+    return std::tie(recipe, feature_stride, scales, ratios, height, width) <
+           std::tie(other.recipe, other.feature_stride, other.scales, other.ratios,
+                    other.height, other.width);
+  }
+};
+
+// All the shifted anchors of a height x width feature map, laid out as
+// (height, width, num_anchors, 4) in a 64-byte aligned buffer, which is
+// the order of the GenAnchor output and of the proposal workspace.
+class AnchorGrid {
+ public:
+  // base holds the num_anchors anchors at (0, 0), 4 coordinates each
+  AnchorGrid(const std::vector<double> &base, const int feature_stride,
+             const int height, const int width)
+    : num_anchors_(static_cast<int>(base.size() / 4)), height_(height), width_(width) {
+    const size_t size = static_cast<size_t>(height) * width * num_anchors_ * 4;
+    storage_.resize(size + kAlign / sizeof(float));
+    const uintptr_t addr = reinterpret_cast<uintptr_t>(storage_.data());
+    data_ = storage_.data() + ((kAlign - addr % kAlign) % kAlign) / sizeof(float);
+    float *out = data_;
+    for (int j = 0; j < height; ++j) {
+      for (int k = 0; k < width; ++k) {
+        // the shifts are integers, so rounding the double sum once gives the
+        // same float as adding the shift to a float base anchor
+        const double shift_x = static_cast<double>(k) * feature_stride;
+        const double shift_y = static_cast<double>(j) * feature_stride;
+        for (int i = 0; i < num_anchors_; ++i) {
+          *out++ = static_cast<float>(base[i * 4 + 0] + shift_x);
+          *out++ = static_cast<float>(base[i * 4 + 1] + shift_y);
+          *out++ = static_cast<float>(base[i * 4 + 2] + shift_x);
+          *out++ = static_cast<float>(base[i * 4 + 3] + shift_y);
+        }
+      }
+    }
+  }
+
+  const float* data() const { return data_; }
+  int num_anchors() const { return num_anchors_; }
+  int height() const { return height_; }
+  int width() const { return width_; }
+  // number of anchors, height * width * num_anchors
+  size_t count() const { return static_cast<size_t>(height_) * width_ * num_anchors_; }
+
+ private:
+  static const size_t kAlign = 64;
+  int num_anchors_;
+  int height_;
+  int width_;
+  std::vector<float> storage_;
+  float *data_;
+};
+
+typedef std::shared_ptr<const AnchorGrid> AnchorGridPtr;
+
+// Least recently used grids are dropped past kMaxEntries, as every input size
+// of a multi-scale test adds one grid per level.
+class AnchorCache {
+ public:
+  static AnchorCache* Get() {
+    static AnchorCache cache;
+    return &cache;
+  }
+
+  // grid of key. On a miss, base_anchors() gives the base anchors of the
+  // recipe as a std::vector<double>, and the grid is built outside the lock.
+  template <typename BaseAnchorFn>
+  AnchorGridPtr Lookup(const AnchorKey &key, BaseAnchorFn base_anchors) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = entries_.find(key);
+      if (it != entries_.end()) {
+        it->second.second = ++clock_;
+        return it->second.first;
+      }
+    }
+    AnchorGridPtr grid = std::make_shared<const AnchorGrid>(
+        base_anchors(), key.feature_stride, key.height, key.width);
+    std::lock_guard<std::mutex> lock(mutex_);
+    // another thread may have built it meanwhile, keep the first one
+    auto inserted = entries_.insert(std::make_pair(key, std::make_pair(grid, ++clock_)));
+    if (!inserted.second) {
+      return inserted.first->second.first;
+    }
+    if (entries_.size() > kMaxEntries) {
+      auto oldest = entries_.begin();
+      for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->second.second < oldest->second.second) {
+          oldest = it;
+        }
+      }
+      entries_.erase(oldest);
+    }
+    return grid;
+  }
+
+ private:
+  static const size_t kMaxEntries = 256;
+  AnchorCache() {}
+  std::mutex mutex_;
+  // grid and the clock of its last lookup
+  std::map<AnchorKey, std::pair<AnchorGridPtr, uint64_t>> entries_;
+  uint64_t clock_ = 0;
+};
+
+}  // namespace anchor_cache
+}  // namespace op
+}  // namespace mxnet
+
+#endif  // MXNET_OPERATOR_CONTRIB_ANCHOR_CACHE_H_
@@ -24,6 +24,7 @@
 */
 
 #include "./generate_anchor-inl.h"
+#include "./anchor_cache.h"
 
 namespace mxnet {
 namespace op {
@@ -52,34 +53,28 @@ class GenAnchorOp : public Operator{
 
     Tensor<cpu, 2> out = out_data[gen_anchor::kOut].get<cpu, 2, float>(s);
 
-    std::vector<double> scales(param_.scales.begin(), param_.scales.end());
-    std::vector<double> ratios(param_.ratios.begin(), param_.ratios.end());
-
-    int num_anchors = scales.size() * ratios.size();
     int height = scores.size(2);
     int width = scores.size(3);
 
-    // Generate anchors
-    std::vector<double> base_anchor({
-      0.0f, 0.0f, param_.feature_stride - 1.0f, param_.feature_stride - 1.0f
+    // the shifted anchors only depend on the parameters and the map size
+    anchor_cache::AnchorKey key{anchor_cache::kGenAnchor, param_.feature_stride,
+                                std::vector<double>(param_.scales.begin(), param_.scales.end()),
+                                std::vector<double>(param_.ratios.begin(), param_.ratios.end()),
+                                height, width};
+    anchor_cache::AnchorGridPtr grid = anchor_cache::AnchorCache::Get()->Lookup(key, [&]() {
+      std::vector<double> scales(param_.scales.begin(), param_.scales.end());
+      std::vector<double> ratios(param_.ratios.begin(), param_.ratios.end());
+      std::vector<double> base_anchor({
+        0.0f, 0.0f, param_.feature_stride - 1.0f, param_.feature_stride - 1.0f
+      });
+      std::vector<double> anchors;
+      gen_anchor_utils::GenerateAnchors(
+        base_anchor, ratios, scales, anchors
+      );
+      return anchors;
     });
-    std::vector<double> anchors;
-    gen_anchor_utils::GenerateAnchors(
-      base_anchor, ratios, scales, anchors
-    );
-
-    // Enumerate all shifted anchors
-    for (index_t i = 0; i < num_anchors; ++i) {
-      for (index_t j = 0; j < height; ++j) {
-        for (index_t k = 0; k < width; ++k) {
-          index_t index = j * (width * num_anchors) + k * (num_anchors) + i;
-          out[index][0] = static_cast<float>(anchors[i * 4 + 0] + k * param_.feature_stride);
-          out[index][1] = static_cast<float>(anchors[i * 4 + 1] + j * param_.feature_stride);
-          out[index][2] = static_cast<float>(anchors[i * 4 + 2] + k * param_.feature_stride);
-          out[index][3] = static_cast<float>(anchors[i * 4 + 3] + j * param_.feature_stride);
-        }
-      }
-    }
+    CHECK_EQ(out.shape_.Size(), grid->count() * 4);
+    std::memcpy(out.dptr_, grid->data(), sizeof(float) * grid->count() * 4);
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -24,6 +24,7 @@
 */
 
 #include "./generate_proposal-inl.h"
+#include "./topk_utils.h"
 
 //============================
 // Bounding Box Transform Utils
@@ -181,39 +182,10 @@ namespace mxnet {
 namespace op {
 namespace utils {
 
-struct ReverseArgsortCompl {
-  const float *val_;
-  explicit ReverseArgsortCompl(float *val)
-    : val_(val) {}
-  bool operator() (float i, float j) {
-    return (val_[static_cast<index_t>(i)] >
-            val_[static_cast<index_t>(j)]);
-  }
-};
-
-// copy score and init order
-inline void CopyScore(const mshadow::Tensor<cpu, 3>& dets,
-                      mshadow::Tensor<cpu, 2> *score,
-                      mshadow::Tensor<cpu, 2> *order) {
-  for (index_t n = 0; n < dets.size(0); n++) {
-    for (index_t i = 0; i < dets.size(1); i++) {
-      (*score)[n][i] = dets[n][i][4];
-      (*order)[n][i] = i;
-    }
-  }
-}
-
-// sort order array according to score
-inline void ReverseArgsort(const mshadow::Tensor<cpu, 1>& score,
-                           mshadow::Tensor<cpu, 1> *order) {
-  ReverseArgsortCompl cmpl(score.dptr_);
-  std::sort(order->dptr_, order->dptr_ + score.size(0), cmpl);
-}
-
 // reorder proposals according to order and keep the pre_nms_top_n proposals
 // dets.size(0) == pre_nms_top_n
 inline void ReorderProposals(const mshadow::Tensor<cpu, 2>& prev_dets,
-                             const mshadow::Tensor<cpu, 1>& order,
+                             const int32_t* order,
                              const index_t pre_nms_top_n,
                              mshadow::Tensor<cpu, 2> *dets) {
   CHECK_EQ(dets->size(0), pre_nms_top_n);
@@ -275,14 +247,15 @@ class GenProposalOp : public Operator{
     int rpn_pre_nms_top_n = (param_.rpn_pre_nms_top_n > 0) ? param_.rpn_pre_nms_top_n : count;
     rpn_pre_nms_top_n = std::min(rpn_pre_nms_top_n, count);
 
-    int workspace_size = nbatch * (count * 5 + 2 * count + rpn_pre_nms_top_n * 5);
+    int workspace_size = nbatch * (count * 5 + rpn_pre_nms_top_n + rpn_pre_nms_top_n * 5);
     Tensor<cpu, 1> workspace = ctx.requested[gen_proposal::kTempSpace].get_space<cpu>(
       Shape1(workspace_size), s);
     int start = 0;
     Tensor<cpu, 3> workspace_proposals(workspace.dptr_ + start, Shape3(nbatch, count, 5));
     start += nbatch * count * 5;
-    Tensor<cpu, 3> workspace_pre_nms(workspace.dptr_ + start, Shape3(2, nbatch, count));
-    start += nbatch * 2 * count;
+    // int32 indices of the top proposals, stored in float sized slots
+    Tensor<cpu, 2> order(workspace.dptr_ + start, Shape2(nbatch, rpn_pre_nms_top_n));
+    start += nbatch * rpn_pre_nms_top_n;
     Tensor<cpu, 3> workspace_ordered_proposals(workspace.dptr_ + start,
                                                Shape3(nbatch, rpn_pre_nms_top_n, 5));
     start += nbatch * rpn_pre_nms_top_n * 5;
@@ -315,18 +288,11 @@ class GenProposalOp : public Operator{
     }
     utils::FilterBox(&workspace_proposals, param_.rpn_min_size, im_info);
 
-    Tensor<cpu, 2> score = workspace_pre_nms[0];
-    Tensor<cpu, 2> order = workspace_pre_nms[1];
-
-    utils::CopyScore(workspace_proposals,
-                     &score,
-                     &order);
-
     for(int n = 0; n < nbatch; n++) {
-      Tensor<cpu, 1> cur_order = order[n];
+      int32_t* cur_order = reinterpret_cast<int32_t*>(order[n].dptr_);
       Tensor<cpu, 2> cur_workspace_ordered_proposals = workspace_ordered_proposals[n];
-      utils::ReverseArgsort(score[n],
-                            &cur_order);
+      topk_utils::ReverseArgsortTopK(workspace_proposals[n].dptr_ + 4, 5, count,
+                                     rpn_pre_nms_top_n, cur_order);
       utils::ReorderProposals(workspace_proposals[n],
                               cur_order,
                               rpn_pre_nms_top_n,
@@ -52,14 +52,195 @@ POSSIBILITY OF SUCH DAMAGE.
  * \author Yuntao Chen
 */
 
+#include <algorithm>
+#include <cmath>
 #include "./group_norm-inl.h"
 
+namespace mshadow {
+
+// number of interleaved Welford accumulators, one per simd lane
+const int kWelfordLanes = 8;
+
+// Mean and (biased) variance of x[0, size) in a single pass.
+// Each lane runs Welford's update on every kWelfordLanes-th element, all lanes
+// share the count so the update vectorizes, then the lanes and the tail are
+// merged with Chan's formula.
+inline void WelfordMoments(const float *x, const int size, float *mean, float *var) {
+  float lane_mean[kWelfordLanes] = {0};
+  float lane_m2[kWelfordLanes] = {0};
+  const int steps = size / kWelfordLanes;
+  for (int k = 0; k < steps; ++k) {
+    const float *xk = x + k * kWelfordLanes;
+    const float inv_count = 1.f / (k + 1);
+    #pragma omp simd
+    for (int l = 0; l < kWelfordLanes; ++l) {
+      const float delta = xk[l] - lane_mean[l];
+      lane_mean[l] += delta * inv_count;
+      lane_m2[l] += delta * (xk[l] - lane_mean[l]);
+    }
+  }
+  float count = 0;
+  float m = 0;
+  float m2 = 0;
+  auto merge = [&](const float other_count, const float other_mean, const float other_m2) {
+    if (other_count == 0) {
+      return;
+    }
+    const float total = count + other_count;
+    const float delta = other_mean - m;
+    m += delta * other_count / total;
+    m2 += other_m2 + delta * delta * count * other_count / total;
+    count = total;
+  };
+  for (int l = 0; l < kWelfordLanes; ++l) {
+    merge(static_cast<float>(steps), lane_mean[l], lane_m2[l]);
+  }
+  for (int i = steps * kWelfordLanes; i < size; ++i) {
+    merge(1.f, x[i], 0.f);
+  }
+  *mean = m;
+  *var = size > 0 ? m2 / size : 0.f;
+}
+
+// mu and rsig hold N * G statistics, laid out as the CUDA Moments and InvStd
+// of group_norm_helper.h write them, so the outputs match across devices
+inline void GroupNormForward(float eps,
+                             const int N,
+                             const int G,
+                             const int D,
+                             const int HxW,
+                             const Tensor<cpu, 1> &X,
+                             const Tensor<cpu, 1> &gamma,
+                             const Tensor<cpu, 1> &beta,
+                             Tensor<cpu, 1> &Y,
+                             Tensor<cpu, 1> &mu,
+                             Tensor<cpu, 1> &rsig) {
+  const int group_size = D * HxW;
+  const float *X_data = X.dptr_;
+  const float *gamma_data = gamma.dptr_;
+  const float *beta_data = beta.dptr_;
+  float *Y_data = Y.dptr_;
+  float *mu_data = mu.dptr_;
+  float *rsig_data = rsig.dptr_;
+  #pragma omp parallel for
+  for (openmp_index_t i = 0; i < static_cast<openmp_index_t>(N * G); ++i) {
+    const float *x = X_data + i * group_size;
+    float *y = Y_data + i * group_size;
+    float mean, var;
+    WelfordMoments(x, group_size, &mean, &var);
+    const float inv_std = 1.f / std::sqrt(var + eps);
+    mu_data[i] = mean;
+    rsig_data[i] = inv_std;
+    // Y = gamma * (X - mu) * rsig + beta, with gamma * rsig hoisted per channel
+    for (int d = 0; d < D; ++d) {
+      const int c = i % G * D + d;
+      const float scale = gamma_data[c] * inv_std;
+      const float bias = beta_data[c];
+      const float *xc = x + d * HxW;
+      float *yc = y + d * HxW;
+      #pragma omp simd
+      for (int j = 0; j < HxW; ++j) {
+        yc[j] = (xc[j] - mean) * scale + bias;
+      }
+    }
+  }
+}
+
+// Same math as the CUDA kernels. With n = D * HxW and per group
+// ds = sum(gamma * dY * X), db = sum(gamma * dY),
+// dX = gamma * rsig * dY + (db * mu - ds) * rsig^3 * (X - mu) / n - db * rsig / n.
+// ds - db * mu is summed as gamma * dY * (X - mu), which does not cancel when
+// X is far from 0. ds and db hold the per (n, c) sums of dY * (X - mu) and dY,
+// which give both the group sums and the gamma and beta gradients.
+inline void GroupNormBackward(const int N,
+                              const int G,
+                              const int D,
+                              const int HxW,
+                              const Tensor<cpu, 1> &dY,
+                              const Tensor<cpu, 1> &X,
+                              const Tensor<cpu, 1> &mu,
+                              const Tensor<cpu, 1> &rsig,
+                              const Tensor<cpu, 1> &gamma,
+                              Tensor<cpu, 1> &ds,
+                              Tensor<cpu, 1> &db,
+                              Tensor<cpu, 1> &dX,
+                              Tensor<cpu, 1> &dgamma,
+                              Tensor<cpu, 1> &dbeta) {
+  const int C = G * D;
+  const int group_size = D * HxW;
+  const float *dY_data = dY.dptr_;
+  const float *X_data = X.dptr_;
+  const float *mu_data = mu.dptr_;
+  const float *rsig_data = rsig.dptr_;
+  const float *gamma_data = gamma.dptr_;
+  float *dYX_sum = ds.dptr_;
+  float *dY_sum = db.dptr_;
+  float *dX_data = dX.dptr_;
+  #pragma omp parallel for
+  for (openmp_index_t i = 0; i < static_cast<openmp_index_t>(N * G); ++i) {
+    const float *x = X_data + i * group_size;
+    const float *dy = dY_data + i * group_size;
+    float *dx = dX_data + i * group_size;
+    const int c_begin = i % G * D;
+    const float mean = mu_data[i];
+    const float inv_std = rsig_data[i];
+    float ds_val = 0;
+    float db_val = 0;
+    for (int d = 0; d < D; ++d) {
+      const float *xc = x + d * HxW;
+      const float *dyc = dy + d * HxW;
+      float dyx = 0;
+      float dysum = 0;
+      #pragma omp simd reduction(+:dyx, dysum)
+      for (int j = 0; j < HxW; ++j) {
+        dyx += dyc[j] * (xc[j] - mean);
+        dysum += dyc[j];
+      }
+      dYX_sum[i * D + d] = dyx;
+      dY_sum[i * D + d] = dysum;
+      ds_val += gamma_data[c_begin + d] * dyx;
+      db_val += gamma_data[c_begin + d] * dysum;
+    }
+    const float denom = 1.f / group_size;
+    const float c1 = -ds_val * inv_std * inv_std * inv_std * denom;
+    const float c0 = -db_val * inv_std * denom;
+    for (int d = 0; d < D; ++d) {
+      const float scale = gamma_data[c_begin + d] * inv_std;
+      const float *xc = x + d * HxW;
+      const float *dyc = dy + d * HxW;
+      float *dxc = dx + d * HxW;
+      #pragma omp simd
+      for (int j = 0; j < HxW; ++j) {
+        dxc[j] = scale * dyc[j] + c1 * (xc[j] - mean) + c0;
+      }
+    }
+  }
+  // dgamma = sum(dY * (X - mu) * rsig), dbeta = sum(dY), over batch and space
+  #pragma omp parallel for
+  for (openmp_index_t c = 0; c < static_cast<openmp_index_t>(C); ++c) {
+    float dg_val = 0;
+    float db_val = 0;
+    for (int n = 0; n < N; ++n) {
+      const int i = n * G + c / D;
+      dg_val += dYX_sum[n * C + c] * rsig_data[i];
+      db_val += dY_sum[n * C + c];
+    }
+    dgamma.dptr_[c] = dg_val;
+    dbeta.dptr_[c] = db_val;
+  }
+}
+
+}  // namespace mshadow
+
 namespace mxnet {
 namespace op {
 template <>
 Operator* CreateOp<cpu>(GroupNormParam param, int dtype) {
-  LOG(FATAL) << "not implemented.";
-  return NULL;
+  Operator *op = NULL;
+  MSHADOW_REAL_TYPE_SWITCH(dtype, DType, {
+    op = new GroupNormOp<cpu>(param);
+  });
+  return op;
 }
 
 // DO_BIND_DISPATCH comes from operator_common.h
@@ -24,6 +24,7 @@
 */
 
 #include "./nms-inl.h"
+#include "./topk_utils.h"
 
 //=====================
 // NMS Utils
@@ -32,39 +33,10 @@ namespace mxnet {
 namespace op {
 namespace utils {
 
-struct ReverseArgsortCompl {
-  const float *val_;
-  explicit ReverseArgsortCompl(float *val)
-    : val_(val) {}
-  bool operator() (float i, float j) {
-    return (val_[static_cast<index_t>(i)] >
-            val_[static_cast<index_t>(j)]);
-  }
-};
-
-// copy score and init order
-inline void CopyScore(const mshadow::Tensor<cpu, 3>& dets,
-                      mshadow::Tensor<cpu, 2> *score,
-                      mshadow::Tensor<cpu, 2> *order) {
-  for (index_t n = 0; n < dets.size(0); n++) {
-    for (index_t i = 0; i < dets.size(1); i++) {
-      (*score)[n][i] = dets[n][i][4];
-      (*order)[n][i] = i;
-    }
-  }
-}
-
-// sort order array according to score
-inline void ReverseArgsort(const mshadow::Tensor<cpu, 1>& score,
-                           mshadow::Tensor<cpu, 1> *order) {
-  ReverseArgsortCompl cmpl(score.dptr_);
-  std::sort(order->dptr_, order->dptr_ + score.size(0), cmpl);
-}
-
 // reorder proposals according to order and keep the pre_nms_top_n proposals
 // dets.size(0) == pre_nms_top_n
 inline void ReorderProposals(const mshadow::Tensor<cpu, 2>& prev_dets,
-                             const mshadow::Tensor<cpu, 1>& order,
+                             const int32_t* order,
                              const index_t pre_nms_top_n,
                              mshadow::Tensor<cpu, 2> *dets) {
   CHECK_EQ(dets->size(0), pre_nms_top_n);
@@ -169,12 +141,13 @@ class NMSOp : public Operator{
     rpn_pre_nms_top_n = std::min(rpn_pre_nms_top_n, count);
     int rpn_post_nms_top_n = std::min(param_.rpn_post_nms_top_n, rpn_pre_nms_top_n);
 
-    int workspace_size = nbatch * (2 * count + rpn_pre_nms_top_n * 5 + 3 * rpn_pre_nms_top_n);
+    int workspace_size = nbatch * (rpn_pre_nms_top_n + rpn_pre_nms_top_n * 5 + 3 * rpn_pre_nms_top_n);
     Tensor<cpu, 1> workspace = ctx.requested[nms::kTempSpace].get_space<cpu>(
       Shape1(workspace_size), s);
     int start = 0;
-    Tensor<cpu, 3> workspace_pre_nms(workspace.dptr_ + start, Shape3(2, nbatch, count));
-    start += nbatch * 2 * count;
+    // int32 indices of the top proposals, stored in float sized slots
+    Tensor<cpu, 2> order(workspace.dptr_ + start, Shape2(nbatch, rpn_pre_nms_top_n));
+    start += nbatch * rpn_pre_nms_top_n;
     Tensor<cpu, 3> workspace_ordered_proposals(workspace.dptr_ + start,
                                                Shape3(nbatch, rpn_pre_nms_top_n, 5));
     start += nbatch * rpn_pre_nms_top_n * 5;
@@ -182,26 +155,23 @@ class NMSOp : public Operator{
     start += nbatch * 3 * rpn_pre_nms_top_n;
     CHECK_EQ(workspace_size, start) << workspace_size << " " << start << std::endl;
 
-    Tensor<cpu, 2> score = workspace_pre_nms[0];
-    Tensor<cpu, 2> order = workspace_pre_nms[1];
-
-    utils::CopyScore(proposals,
-                     &score,
-                     &order);
-
     Tensor<cpu, 2> area = workspace_nms[0];
     Tensor<cpu, 2> suppressed = workspace_nms[1];
     Tensor<cpu, 2> keep = workspace_nms[2];
 
     for(int n = 0; n < nbatch; n++) {
-      Tensor<cpu, 1> cur_order = order[n];
+      int32_t* cur_order = reinterpret_cast<int32_t*>(order[n].dptr_);
       Tensor<cpu, 1> cur_area = area[n];
       Tensor<cpu, 1> cur_keep = keep[n];
       Tensor<cpu, 1> cur_suppressed = suppressed[n];
       Tensor<cpu, 2> cur_workspace_ordered_proposals = workspace_ordered_proposals[n];
       if (!param_.already_sorted) {
-          utils::ReverseArgsort(score[n],
-                                &cur_order);
+          topk_utils::ReverseArgsortTopK(proposals[n].dptr_ + 4, 5, count,
+                                         rpn_pre_nms_top_n, cur_order);
+      } else {
+          for (int i = 0; i < rpn_pre_nms_top_n; ++i) {
+            cur_order[i] = i;
+          }
       }
       utils::ReorderProposals(proposals[n],
                               cur_order,
@@ -24,6 +24,8 @@
 */
 
 #include "./proposal-inl.h"
+#include "./anchor_cache.h"
+#include "./topk_utils.h"
 
 //============================
 // Bounding Box Transform Utils
@@ -45,49 +47,58 @@ inline void BBoxTransformInv(const mshadow::Tensor<cpu, 3>& boxes,
   int heights = deltas.size(2);
   int widths = deltas.size(3);
 
-  for (int n = 0; n < nbatch; ++n) {
+  // one task per (image, row of the feature map); the boxes of a row are
+  // decoded one anchor at a time so that the deltas are read contiguously
+  #pragma omp parallel for
+  for (openmp_index_t nh = 0; nh < nbatch * heights; ++nh) {
+    const int n = nh / heights;
+    const int h = nh % heights;
     int real_height = static_cast<int>(im_info[n][0] / feature_stride);
     int real_width = static_cast<int>(im_info[n][1] / feature_stride);
     float im_height = im_info[n][0];
     float im_width = im_info[n][1];
 
     for (int a = 0; a < anchors; ++a) {
-      for (int h = 0; h < heights; ++h) {
-        for (int w = 0; w < widths; ++w) {
-          index_t index = h * (widths * anchors) + w * (anchors) + a;
-          float width = boxes[n][index][2] - boxes[n][index][0] + 1.0;
-          float height = boxes[n][index][3] - boxes[n][index][1] + 1.0;
-          float ctr_x = boxes[n][index][0] + 0.5 * (width - 1.0);
-          float ctr_y = boxes[n][index][1] + 0.5 * (height - 1.0);
-
-          float dx = deltas[n][a*4 + 0][h][w];
-          float dy = deltas[n][a*4 + 1][h][w];
-          float dw = deltas[n][a*4 + 2][h][w];
-          float dh = deltas[n][a*4 + 3][h][w];
-
-          float pred_ctr_x = dx * width + ctr_x;
-          float pred_ctr_y = dy * height + ctr_y;
-          float pred_w = exp(dw) * width;
-          float pred_h = exp(dh) * height;
-
-          float pred_x1 = pred_ctr_x - 0.5 * (pred_w - 1.0);
-          float pred_y1 = pred_ctr_y - 0.5 * (pred_h - 1.0);
-          float pred_x2 = pred_ctr_x + 0.5 * (pred_w - 1.0);
-          float pred_y2 = pred_ctr_y + 0.5 * (pred_h - 1.0);
-
-          pred_x1 = std::max(std::min(pred_x1, im_width - 1.0f), 0.0f);
-          pred_y1 = std::max(std::min(pred_y1, im_height - 1.0f), 0.0f);
-          pred_x2 = std::max(std::min(pred_x2, im_width - 1.0f), 0.0f);
-          pred_y2 = std::max(std::min(pred_y2, im_height - 1.0f), 0.0f);
-
-          (*out_pred_boxes)[n][index][0] = pred_x1;
-          (*out_pred_boxes)[n][index][1] = pred_y1;
-          (*out_pred_boxes)[n][index][2] = pred_x2;
-          (*out_pred_boxes)[n][index][3] = pred_y2;
-
-          if (h >= real_height || w >= real_width) {
-            (*out_pred_boxes)[n][index][4] = -1.0;
-          }
+      const float* dx_row = deltas[n][a*4 + 0][h].dptr_;
+      const float* dy_row = deltas[n][a*4 + 1][h].dptr_;
+      const float* dw_row = deltas[n][a*4 + 2][h].dptr_;
+      const float* dh_row = deltas[n][a*4 + 3][h].dptr_;
+      for (int w = 0; w < widths; ++w) {
+        index_t index = h * (widths * anchors) + w * (anchors) + a;
+        const float* box = boxes[n][index].dptr_;
+        float* pred_box = (*out_pred_boxes)[n][index].dptr_;
+        float width = box[2] - box[0] + 1.0;
+        float height = box[3] - box[1] + 1.0;
+        float ctr_x = box[0] + 0.5 * (width - 1.0);
+        float ctr_y = box[1] + 0.5 * (height - 1.0);
+
+        float dx = dx_row[w];
+        float dy = dy_row[w];
+        float dw = dw_row[w];
+        float dh = dh_row[w];
+
+        float pred_ctr_x = dx * width + ctr_x;
+        float pred_ctr_y = dy * height + ctr_y;
+        float pred_w = exp(dw) * width;
+        float pred_h = exp(dh) * height;
+
+        float pred_x1 = pred_ctr_x - 0.5 * (pred_w - 1.0);
+        float pred_y1 = pred_ctr_y - 0.5 * (pred_h - 1.0);
+        float pred_x2 = pred_ctr_x + 0.5 * (pred_w - 1.0);
+        float pred_y2 = pred_ctr_y + 0.5 * (pred_h - 1.0);
+
+        pred_x1 = std::max(std::min(pred_x1, im_width - 1.0f), 0.0f);
+        pred_y1 = std::max(std::min(pred_y1, im_height - 1.0f), 0.0f);
+        pred_x2 = std::max(std::min(pred_x2, im_width - 1.0f), 0.0f);
+        pred_y2 = std::max(std::min(pred_y2, im_height - 1.0f), 0.0f);
+
+        pred_box[0] = pred_x1;
+        pred_box[1] = pred_y1;
+        pred_box[2] = pred_x2;
+        pred_box[3] = pred_y2;
+
+        if (h >= real_height || w >= real_width) {
+          pred_box[4] = -1.0;
         }
       }
     }
@@ -106,43 +117,41 @@ inline void IoUTransformInv(const mshadow::Tensor<cpu, 3>& boxes,
   int anchors = deltas.size(1)/4;
   int heights = deltas.size(2);
   int widths = deltas.size(3);
-  for (int n = 0; n < nbatch; ++n){
+  #pragma omp parallel for
+  for (openmp_index_t nh = 0; nh < nbatch * heights; ++nh) {
+    const int n = nh / heights;
+    const int h = nh % heights;
     int real_height = static_cast<int>(im_info[n][0] / feature_stride);
     int real_width = static_cast<int>(im_info[n][1] / feature_stride);
     float im_height = im_info[n][0];
     float im_width = im_info[n][1];
     for (int a = 0; a < anchors; ++a) {
-      for (int h = 0; h < heights; ++h) {
-        for (int w = 0; w < widths; ++w) {
-          index_t index = h * (widths * anchors) + w * (anchors) + a;
-          float x1 = boxes[n][index][0];
-          float y1 = boxes[n][index][1];
-          float x2 = boxes[n][index][2];
-          float y2 = boxes[n][index][3];
-
-          float dx1 = deltas[n][a * 4 + 0][h][w];
-          float dy1 = deltas[n][a * 4 + 1][h][w];
-          float dx2 = deltas[n][a * 4 + 2][h][w];
-          float dy2 = deltas[n][a * 4 + 3][h][w];
-
-          float pred_x1 = x1 + dx1;
-          float pred_y1 = y1 + dy1;
-          float pred_x2 = x2 + dx2;
-          float pred_y2 = y2 + dy2;
-
-          pred_x1 = std::max(std::min(pred_x1, im_width - 1.0f), 0.0f);
-          pred_y1 = std::max(std::min(pred_y1, im_height - 1.0f), 0.0f);
-          pred_x2 = std::max(std::min(pred_x2, im_width - 1.0f), 0.0f);
-          pred_y2 = std::max(std::min(pred_y2, im_height - 1.0f), 0.0f);
-
-          (*out_pred_boxes)[n][index][0] = pred_x1;
-          (*out_pred_boxes)[n][index][1] = pred_y1;
-          (*out_pred_boxes)[n][index][2] = pred_x2;
-          (*out_pred_boxes)[n][index][3] = pred_y2;
-
-          if (h >= real_height || w >= real_width) {
-            (*out_pred_boxes)[n][index][4] = -1.0f;
-          }
+      const float* dx1_row = deltas[n][a * 4 + 0][h].dptr_;
+      const float* dy1_row = deltas[n][a * 4 + 1][h].dptr_;
+      const float* dx2_row = deltas[n][a * 4 + 2][h].dptr_;
+      const float* dy2_row = deltas[n][a * 4 + 3][h].dptr_;
+      for (int w = 0; w < widths; ++w) {
+        index_t index = h * (widths * anchors) + w * (anchors) + a;
+        const float* box = boxes[n][index].dptr_;
+        float* pred_box = (*out_pred_boxes)[n][index].dptr_;
+
+        float pred_x1 = box[0] + dx1_row[w];
+        float pred_y1 = box[1] + dy1_row[w];
+        float pred_x2 = box[2] + dx2_row[w];
+        float pred_y2 = box[3] + dy2_row[w];
+
+        pred_x1 = std::max(std::min(pred_x1, im_width - 1.0f), 0.0f);
+        pred_y1 = std::max(std::min(pred_y1, im_height - 1.0f), 0.0f);
+        pred_x2 = std::max(std::min(pred_x2, im_width - 1.0f), 0.0f);
+        pred_y2 = std::max(std::min(pred_y2, im_height - 1.0f), 0.0f);
+
+        pred_box[0] = pred_x1;
+        pred_box[1] = pred_y1;
+        pred_box[2] = pred_x2;
+        pred_box[3] = pred_y2;
+
+        if (h >= real_height || w >= real_width) {
+          pred_box[4] = -1.0f;
         }
       }
     }
@@ -154,18 +163,20 @@ inline void IoUTransformInv(const mshadow::Tensor<cpu, 3>& boxes,
 inline void FilterBox(mshadow::Tensor<cpu, 3> *dets,
                       const float rpn_min_size,
                       const mshadow::Tensor<cpu, 2>& im_info) {
-  for (index_t n = 0; n < dets->size(0); n++) {
+  const index_t count = dets->size(1);
+  #pragma omp parallel for
+  for (openmp_index_t ni = 0; ni < dets->size(0) * count; ni++) {
+    const index_t n = ni / count;
     float min_size = rpn_min_size * im_info[n][2];
-    for (index_t i = 0; i < dets->size(1); i++) {
-      float iw = (*dets)[n][i][2] - (*dets)[n][i][0] + 1.0f;
-      float ih = (*dets)[n][i][3] - (*dets)[n][i][1] + 1.0f;
-      if (iw < min_size || ih < min_size) {
-        (*dets)[n][i][0] -= min_size / 2;
-        (*dets)[n][i][1] -= min_size / 2;
-        (*dets)[n][i][2] += min_size / 2;
-        (*dets)[n][i][3] += min_size / 2;
-        (*dets)[n][i][4] = -1.0f;
-      }
+    float* det = (*dets)[n][ni % count].dptr_;
+    float iw = det[2] - det[0] + 1.0f;
+    float ih = det[3] - det[1] + 1.0f;
+    if (iw < min_size || ih < min_size) {
+      det[0] -= min_size / 2;
+      det[1] -= min_size / 2;
+      det[2] += min_size / 2;
+      det[3] += min_size / 2;
+      det[4] = -1.0f;
     }
   }
 }
@@ -181,39 +192,10 @@ namespace mxnet {
 namespace op {
 namespace proposal_utils {
 
-struct ReverseArgsortCompl {
-  const float *val_;
-  explicit ReverseArgsortCompl(float *val)
-    : val_(val) {}
-  bool operator() (float i, float j) {
-    return (val_[static_cast<index_t>(i)] >
-            val_[static_cast<index_t>(j)]);
-  }
-};
-
-// copy score and init order
-inline void CopyScore(const mshadow::Tensor<cpu, 3>& dets,
-                      mshadow::Tensor<cpu, 2> *score,
-                      mshadow::Tensor<cpu, 2> *order) {
-  for (index_t n = 0; n < dets.size(0); n++) {
-    for (index_t i = 0; i < dets.size(1); i++) {
-      (*score)[n][i] = dets[n][i][4];
-      (*order)[n][i] = i;
-    }
-  }
-}
-
-// sort order array according to score
-inline void ReverseArgsort(const mshadow::Tensor<cpu, 1>& score,
-                           mshadow::Tensor<cpu, 1> *order) {
-  ReverseArgsortCompl cmpl(score.dptr_);
-  std::sort(order->dptr_, order->dptr_ + score.size(0), cmpl);
-}
-
 // reorder proposals according to order and keep the pre_nms_top_n proposals
 // dets.size(0) == pre_nms_top_n
 inline void ReorderProposals(const mshadow::Tensor<cpu, 2>& prev_dets,
-                             const mshadow::Tensor<cpu, 1>& order,
+                             const int32_t* order,
                              const index_t pre_nms_top_n,
                              mshadow::Tensor<cpu, 2> *dets) {
   CHECK_EQ(dets->size(0), pre_nms_top_n);
@@ -225,55 +207,115 @@ inline void ReorderProposals(const mshadow::Tensor<cpu, 2>& prev_dets,
   }
 }
 
+// boxes per suppression mask
+const int kNMSBlockSize = sizeof(uint64_t) * 8;
+
+// sorted boxes as separate coordinate arrays, so that the overlaps of one box
+// with a block of boxes are computed with vector instructions
+struct NMSBoxes {
+  std::vector<float> x1, y1, x2, y2, area;
+};
+
+// bit j is set if box i overlaps box col_start + j by more than thresh
+inline uint64_t NMSBlockMask(const NMSBoxes& boxes,
+                             const index_t i,
+                             const index_t col_start,
+                             const int col_size,
+                             const float thresh) {
+  const float* x1 = boxes.x1.data() + col_start;
+  const float* y1 = boxes.y1.data() + col_start;
+  const float* x2 = boxes.x2.data() + col_start;
+  const float* y2 = boxes.y2.data() + col_start;
+  const float* area = boxes.area.data() + col_start;
+  float ix1 = boxes.x1[i];
+  float iy1 = boxes.y1[i];
+  float ix2 = boxes.x2[i];
+  float iy2 = boxes.y2[i];
+  float iarea = boxes.area[i];
+
+  uint8_t over[kNMSBlockSize];
+  #pragma omp simd
+  for (int j = 0; j < col_size; j++) {
+    float xx1 = std::max(ix1, x1[j]);
+    float yy1 = std::max(iy1, y1[j]);
+    float xx2 = std::min(ix2, x2[j]);
+    float yy2 = std::min(iy2, y2[j]);
+    float w = std::max(0.0f, xx2 - xx1 + 1.0f);
+    float h = std::max(0.0f, yy2 - yy1 + 1.0f);
+    float inter = w * h;
+    float ovr = inter / (iarea + area[j] - inter);
+    over[j] = ovr > thresh;
+  }
+  uint64_t mask = 0;
+  for (int j = 0; j < col_size; j++) {
+    mask |= static_cast<uint64_t>(over[j]) << j;
+  }
+  return mask;
+}
+
 // greedily keep the max detections (already sorted)
+// Boxes are split in blocks of 64 and suppression is tracked as one bit mask
+// per block. Blocks are resolved in score order, and the boxes kept in a block
+// are then tested against all later blocks in parallel. Only the overlaps of
+// kept boxes are computed, and the result is that of the pairwise greedy loop.
 inline void NonMaximumSuppression(const mshadow::Tensor<cpu, 2>& dets,
                                   const float thresh,
                                   const index_t post_nms_top_n,
-                                  mshadow::Tensor<cpu, 1> *area,
-                                  mshadow::Tensor<cpu, 1> *suppressed,
                                   mshadow::Tensor<cpu, 1> *keep,
                                   index_t *out_size) {
   CHECK_EQ(dets.shape_[1], 5) << "dets: [x1, y1, x2, y2, score]";
   CHECK_GT(dets.shape_[0], 0);
   CHECK_EQ(dets.CheckContiguous(), true);
-  CHECK_EQ(area->CheckContiguous(), true);
-  CHECK_EQ(suppressed->CheckContiguous(), true);
   CHECK_EQ(keep->CheckContiguous(), true);
-  // calculate area
-  for (index_t i = 0; i < dets.size(0); ++i) {
-    (*area)[i] = (dets[i][2] - dets[i][0] + 1) *
-                 (dets[i][3] - dets[i][1] + 1);
+  const index_t num_dets = dets.size(0);
+  NMSBoxes boxes;
+  boxes.x1.resize(num_dets);
+  boxes.y1.resize(num_dets);
+  boxes.x2.resize(num_dets);
+  boxes.y2.resize(num_dets);
+  boxes.area.resize(num_dets);
+  for (index_t i = 0; i < num_dets; ++i) {
+    boxes.x1[i] = dets[i][0];
+    boxes.y1[i] = dets[i][1];
+    boxes.x2[i] = dets[i][2];
+    boxes.y2[i] = dets[i][3];
+    boxes.area[i] = (dets[i][2] - dets[i][0] + 1) *
+                    (dets[i][3] - dets[i][1] + 1);
   }
 
-  // calculate nms
+  const index_t col_blocks = (num_dets + kNMSBlockSize - 1) / kNMSBlockSize;
+  std::vector<uint64_t> remv(col_blocks, 0);
+  std::vector<index_t> kept(kNMSBlockSize);
   *out_size = 0;
-  for (index_t i = 0; i < dets.size(0) && (*out_size) < post_nms_top_n; ++i) {
-    float ix1 = dets[i][0];
-    float iy1 = dets[i][1];
-    float ix2 = dets[i][2];
-    float iy2 = dets[i][3];
-    float iarea = (*area)[i];
-
-    if ((*suppressed)[i] > 0.0f) {
-      continue;
-    }
-
-    (*keep)[(*out_size)++] = i;
-    for (index_t j = i + 1; j < dets.size(0); j ++) {
-      if ((*suppressed)[j] > 0.0f) {
+  for (index_t row_block = 0; row_block < col_blocks; ++row_block) {
+    const index_t row_start = row_block * kNMSBlockSize;
+    const int row_size = std::min<index_t>(num_dets - row_start, kNMSBlockSize);
+
+    // resolve this block; earlier blocks can no longer change its mask
+    int num_kept = 0;
+    for (int i = 0; i < row_size && (*out_size) < post_nms_top_n; ++i) {
+      if (remv[row_block] & (1ULL << i)) {
         continue;
       }
-      float xx1 = std::max(ix1, dets[j][0]);
-      float yy1 = std::max(iy1, dets[j][1]);
-      float xx2 = std::min(ix2, dets[j][2]);
-      float yy2 = std::min(iy2, dets[j][3]);
-      float w = std::max(0.0f, xx2 - xx1 + 1.0f);
-      float h = std::max(0.0f, yy2 - yy1 + 1.0f);
-      float inter = w * h;
-      float ovr = inter / (iarea + (*area)[j] - inter);
-      if (ovr > thresh) {
-        (*suppressed)[j] = 1.0f;
+      kept[num_kept++] = row_start + i;
+      (*keep)[(*out_size)++] = row_start + i;
+      // only the boxes after i can be suppressed by it
+      remv[row_block] |= NMSBlockMask(boxes, row_start + i, row_start, row_size, thresh) &
+                         ~((2ULL << i) - 1);
+    }
+    if ((*out_size) >= post_nms_top_n) {
+      break;
+    }
+
+    #pragma omp parallel for
+    for (openmp_index_t col_block = row_block + 1; col_block < col_blocks; ++col_block) {
+      const index_t col_start = col_block * kNMSBlockSize;
+      const int col_size = std::min<index_t>(num_dets - col_start, kNMSBlockSize);
+      uint64_t mask = remv[col_block];
+      for (int k = 0; k < num_kept; ++k) {
+        mask |= NMSBlockMask(boxes, kept[k], col_start, col_size, thresh);
       }
+      remv[col_block] = mask;
     }
   }
 }
@@ -329,49 +371,59 @@ class ProposalOp : public Operator{
     rpn_pre_nms_top_n = std::min(rpn_pre_nms_top_n, count);
     int rpn_post_nms_top_n = std::min(param_.rpn_post_nms_top_n, rpn_pre_nms_top_n);
 
-    int workspace_size = nbatch * (count * 5 + 2 * count + rpn_pre_nms_top_n * 5 + 3 * rpn_pre_nms_top_n);
+    int workspace_size = nbatch * (count * 5 + rpn_pre_nms_top_n + rpn_pre_nms_top_n * 5 + rpn_pre_nms_top_n);
     Tensor<cpu, 1> workspace = ctx.requested[proposal::kTempSpace].get_space<cpu>(
       Shape1(workspace_size), s);
     int start = 0;
     Tensor<cpu, 3> workspace_proposals(workspace.dptr_ + start, Shape3(nbatch, count, 5));
     start += nbatch * count * 5;
-    Tensor<cpu, 3> workspace_pre_nms(workspace.dptr_ + start, Shape3(2, nbatch, count));
-    start += nbatch * 2 * count;
+    // int32 indices of the top proposals, stored in float sized slots
+    Tensor<cpu, 2> order(workspace.dptr_ + start, Shape2(nbatch, rpn_pre_nms_top_n));
+    start += nbatch * rpn_pre_nms_top_n;
     Tensor<cpu, 3> workspace_ordered_proposals(workspace.dptr_ + start,
                                                Shape3(nbatch, rpn_pre_nms_top_n, 5));
     start += nbatch * rpn_pre_nms_top_n * 5;
-    Tensor<cpu, 3> workspace_nms(workspace.dptr_ + start, Shape3(3, nbatch, rpn_pre_nms_top_n));
-    start += nbatch * 3 * rpn_pre_nms_top_n;
+    Tensor<cpu, 2> keep(workspace.dptr_ + start, Shape2(nbatch, rpn_pre_nms_top_n));
+    start += nbatch * rpn_pre_nms_top_n;
     CHECK_EQ(workspace_size, start) << workspace_size << " " << start << std::endl;
 
-    // Generate anchors
-    std::vector<float> base_anchor(4);
-    base_anchor[0] = 0.0;
-    base_anchor[1] = 0.0;
-    base_anchor[2] = param_.feature_stride - 1.0;
-    base_anchor[3] = param_.feature_stride - 1.0;
+    // Shifted anchors, generated once per map size
     CHECK_EQ(num_anchors, param_.ratios.info.size() * param_.scales.info.size());
-    std::vector<float> anchors;
-    proposal_utils::GenerateAnchors(base_anchor,
-                                    param_.ratios.info,
-                                    param_.scales.info,
-                                    &anchors);
-    for(int n = 0; n < nbatch; n++) {
-      std::memcpy(workspace_proposals.dptr_ + n * 5 * count, &anchors[0], sizeof(float) * anchors.size());
-    }
-
-    // Enumerate all shifted anchors
-    for (index_t n = 0; n < nbatch; ++n) {
-      for (index_t i = 0; i < num_anchors; ++i) {
-        for (index_t j = 0; j < height; ++j) {
-          for (index_t k = 0; k < width; ++k) {
-            index_t index = j * (width * num_anchors) + k * (num_anchors) + i;
-            workspace_proposals[n][index][0] = workspace_proposals[n][i][0] + k * param_.feature_stride;
-            workspace_proposals[n][index][1] = workspace_proposals[n][i][1] + j * param_.feature_stride;
-            workspace_proposals[n][index][2] = workspace_proposals[n][i][2] + k * param_.feature_stride;
-            workspace_proposals[n][index][3] = workspace_proposals[n][i][3] + j * param_.feature_stride;
-            workspace_proposals[n][index][4] = scores[n][i + width * height * num_anchors][j][k];
-          }
+    anchor_cache::AnchorKey key{anchor_cache::kProposal, param_.feature_stride,
+                                std::vector<double>(param_.scales.info.begin(), param_.scales.info.end()),
+                                std::vector<double>(param_.ratios.info.begin(), param_.ratios.info.end()),
+                                height, width};
+    anchor_cache::AnchorGridPtr grid = anchor_cache::AnchorCache::Get()->Lookup(key, [&]() {
+      std::vector<float> base_anchor(4);
+      base_anchor[0] = 0.0;
+      base_anchor[1] = 0.0;
+      base_anchor[2] = param_.feature_stride - 1.0;
+      base_anchor[3] = param_.feature_stride - 1.0;
+      std::vector<float> anchors;
+      proposal_utils::GenerateAnchors(base_anchor,
+                                      param_.ratios.info,
+                                      param_.scales.info,
+                                      &anchors);
+      std::vector<double> base(num_anchors * 4);
+      for (int i = 0; i < num_anchors; ++i) {
+        std::copy(&anchors[i * 5], &anchors[i * 5 + 4], &base[i * 4]);
+      }
+      return base;
+    });
+    const float *shifted_anchors = grid->data();
+    // Fill the anchors and scores of the proposals, one task per (image, row)
+    #pragma omp parallel for
+    for (openmp_index_t nj = 0; nj < nbatch * height; ++nj) {
+      const index_t n = nj / height;
+      const index_t j = nj % height;
+      for (index_t k = 0; k < width; ++k) {
+        for (index_t i = 0; i < num_anchors; ++i) {
+          index_t index = j * (width * num_anchors) + k * (num_anchors) + i;
+          workspace_proposals[n][index][0] = shifted_anchors[index * 4 + 0];
+          workspace_proposals[n][index][1] = shifted_anchors[index * 4 + 1];
+          workspace_proposals[n][index][2] = shifted_anchors[index * 4 + 2];
+          workspace_proposals[n][index][3] = shifted_anchors[index * 4 + 3];
+          workspace_proposals[n][index][4] = scores[n][i + width * height * num_anchors][j][k];
         }
       }
     }
@@ -387,37 +439,22 @@ class ProposalOp : public Operator{
     }
     proposal_utils::FilterBox(&workspace_proposals, param_.rpn_min_size, im_info);
 
-    Tensor<cpu, 2> score = workspace_pre_nms[0];
-    Tensor<cpu, 2> order = workspace_pre_nms[1];
-
-    proposal_utils::CopyScore(workspace_proposals,
-                              &score,
-                              &order);
-
-    Tensor<cpu, 2> area = workspace_nms[0];
-    Tensor<cpu, 2> suppressed = workspace_nms[1];
-    Tensor<cpu, 2> keep = workspace_nms[2];
-
-    for(int n = 0; n < nbatch; n++) {
-      Tensor<cpu, 1> cur_order = order[n];
-      Tensor<cpu, 1> cur_area = area[n];
+    // images are processed concurrently; a single image parallelizes its nms
+    #pragma omp parallel for if (nbatch > 1)
+    for (openmp_index_t n = 0; n < nbatch; n++) {
+      int32_t* cur_order = reinterpret_cast<int32_t*>(order[n].dptr_);
       Tensor<cpu, 1> cur_keep = keep[n];
-      Tensor<cpu, 1> cur_suppressed = suppressed[n];
       Tensor<cpu, 2> cur_workspace_ordered_proposals = workspace_ordered_proposals[n];
-      proposal_utils::ReverseArgsort(score[n],
-                                     &cur_order);
+      topk_utils::ReverseArgsortTopK(workspace_proposals[n].dptr_ + 4, 5, count,
+                                     rpn_pre_nms_top_n, cur_order);
       proposal_utils::ReorderProposals(workspace_proposals[n],
                                        cur_order,
                                        rpn_pre_nms_top_n,
                                        &cur_workspace_ordered_proposals);
       index_t out_size = 0;
-      suppressed = 0;  // surprised!
-
       proposal_utils::NonMaximumSuppression(cur_workspace_ordered_proposals,
                                             param_.threshold,
                                             rpn_post_nms_top_n,
-                                            &cur_area,
-                                            &cur_suppressed,
                                             &cur_keep,
                                             &out_size);
 
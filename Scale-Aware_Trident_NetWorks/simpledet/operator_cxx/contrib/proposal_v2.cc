@@ -24,6 +24,8 @@
 */
 
 #include "./proposal_v2-inl.h"
+#include "./anchor_cache.h"
+#include "./topk_utils.h"
 
 //============================
 // Bounding Box Transform Utils
@@ -188,39 +190,10 @@ namespace mxnet {
 namespace op {
 namespace proposal_v2_utils {
 
-struct ReverseArgsortCompl {
-  const float *val_;
-  explicit ReverseArgsortCompl(float *val)
-    : val_(val) {}
-  bool operator() (float i, float j) {
-    return (val_[static_cast<index_t>(i)] >
-            val_[static_cast<index_t>(j)]);
-  }
-};
-
-// copy score and init order
-inline void CopyScore(const mshadow::Tensor<cpu, 3>& dets,
-                      mshadow::Tensor<cpu, 2> *score,
-                      mshadow::Tensor<cpu, 2> *order) {
-  for (index_t n = 0; n < dets.size(0); n++) {
-    for (index_t i = 0; i < dets.size(1); i++) {
-      (*score)[n][i] = dets[n][i][4];
-      (*order)[n][i] = i;
-    }
-  }
-}
-
-// sort order array according to score
-inline void ReverseArgsort(const mshadow::Tensor<cpu, 1>& score,
-                           mshadow::Tensor<cpu, 1> *order) {
-  ReverseArgsortCompl cmpl(score.dptr_);
-  std::sort(order->dptr_, order->dptr_ + score.size(0), cmpl);
-}
-
 // reorder proposals according to order and keep the pre_nms_top_n proposals
 // dets.size(0) == pre_nms_top_n
 inline void ReorderProposals(const mshadow::Tensor<cpu, 2>& prev_dets,
-                             const mshadow::Tensor<cpu, 1>& order,
+                             const int32_t* order,
                              const index_t pre_nms_top_n,
                              mshadow::Tensor<cpu, 2> *dets) {
   CHECK_EQ(dets->size(0), pre_nms_top_n);
@@ -337,14 +310,15 @@ class ProposalOp_v2 : public Operator{
     rpn_pre_nms_top_n = std::min(rpn_pre_nms_top_n, count);
     int rpn_post_nms_top_n = std::min(param_.rpn_post_nms_top_n, rpn_pre_nms_top_n);
 
-    int workspace_size = nbatch * (count * 5 + 2 * count + rpn_pre_nms_top_n * 5 + 3 * rpn_pre_nms_top_n);
+    int workspace_size = nbatch * (count * 5 + rpn_pre_nms_top_n + rpn_pre_nms_top_n * 5 + 3 * rpn_pre_nms_top_n);
     Tensor<cpu, 1> workspace = ctx.requested[proposal_v2::kTempSpace].get_space<cpu>(
       Shape1(workspace_size), s);
     int start = 0;
     Tensor<cpu, 3> workspace_proposals(workspace.dptr_ + start, Shape3(nbatch, count, 5));
     start += nbatch * count * 5;
-    Tensor<cpu, 3> workspace_pre_nms(workspace.dptr_ + start, Shape3(2, nbatch, count));
-    start += nbatch * 2 * count;
+    // int32 indices of the top proposals, stored in float sized slots
+    Tensor<cpu, 2> order(workspace.dptr_ + start, Shape2(nbatch, rpn_pre_nms_top_n));
+    start += nbatch * rpn_pre_nms_top_n;
     Tensor<cpu, 3> workspace_ordered_proposals(workspace.dptr_ + start,
                                                Shape3(nbatch, rpn_pre_nms_top_n, 5));
     start += nbatch * rpn_pre_nms_top_n * 5;
@@ -352,32 +326,40 @@ class ProposalOp_v2 : public Operator{
     start += nbatch * 3 * rpn_pre_nms_top_n;
     CHECK_EQ(workspace_size, start) << workspace_size << " " << start << std::endl;
 
-    // Generate anchors
-    std::vector<float> base_anchor(4);
-    base_anchor[0] = 0.0;
-    base_anchor[1] = 0.0;
-    base_anchor[2] = param_.feature_stride - 1.0;
-    base_anchor[3] = param_.feature_stride - 1.0;
+    // Shifted anchors, generated once per map size
     CHECK_EQ(num_anchors, param_.ratios.info.size() * param_.scales.info.size());
-    std::vector<float> anchors;
-    proposal_v2_utils::GenerateAnchors(base_anchor,
-                                       param_.ratios.info,
-                                       param_.scales.info,
-                                       &anchors);
-    for(int n = 0; n < nbatch; n++) {
-      std::memcpy(workspace_proposals.dptr_ + n * 5 * count, &anchors[0], sizeof(float) * anchors.size());
-    }
-
-    // Enumerate all shifted anchors
+    anchor_cache::AnchorKey key{anchor_cache::kProposal, param_.feature_stride,
+                                std::vector<double>(param_.scales.info.begin(), param_.scales.info.end()),
+                                std::vector<double>(param_.ratios.info.begin(), param_.ratios.info.end()),
+                                height, width};
+    anchor_cache::AnchorGridPtr grid = anchor_cache::AnchorCache::Get()->Lookup(key, [&]() {
+      std::vector<float> base_anchor(4);
+      base_anchor[0] = 0.0;
+      base_anchor[1] = 0.0;
+      base_anchor[2] = param_.feature_stride - 1.0;
+      base_anchor[3] = param_.feature_stride - 1.0;
+      std::vector<float> anchors;
+      proposal_v2_utils::GenerateAnchors(base_anchor,
+                                         param_.ratios.info,
+                                         param_.scales.info,
+                                         &anchors);
+      std::vector<double> base(num_anchors * 4);
+      for (int i = 0; i < num_anchors; ++i) {
+        std::copy(&anchors[i * 5], &anchors[i * 5 + 4], &base[i * 4]);
+      }
+      return base;
+    });
+    const float *shifted_anchors = grid->data();
+    // Fill the anchors and scores of the proposals
     for (index_t n = 0; n < nbatch; ++n) {
-      for (index_t i = 0; i < num_anchors; ++i) {
-        for (index_t j = 0; j < height; ++j) {
-          for (index_t k = 0; k < width; ++k) {
+      for (index_t j = 0; j < height; ++j) {
+        for (index_t k = 0; k < width; ++k) {
+          for (index_t i = 0; i < num_anchors; ++i) {
             index_t index = j * (width * num_anchors) + k * (num_anchors) + i;
-            workspace_proposals[n][index][0] = workspace_proposals[n][i][0] + k * param_.feature_stride;
-            workspace_proposals[n][index][1] = workspace_proposals[n][i][1] + j * param_.feature_stride;
-            workspace_proposals[n][index][2] = workspace_proposals[n][i][2] + k * param_.feature_stride;
-            workspace_proposals[n][index][3] = workspace_proposals[n][i][3] + j * param_.feature_stride;
+            workspace_proposals[n][index][0] = shifted_anchors[index * 4 + 0];
+            workspace_proposals[n][index][1] = shifted_anchors[index * 4 + 1];
+            workspace_proposals[n][index][2] = shifted_anchors[index * 4 + 2];
+            workspace_proposals[n][index][3] = shifted_anchors[index * 4 + 3];
             workspace_proposals[n][index][4] = scores[n][i + width * height * num_anchors][j][k];
           }
         }
@@ -396,25 +378,18 @@ class ProposalOp_v2 : public Operator{
     proposal_v2_utils::FilterBox(&workspace_proposals, param_.rpn_min_size, im_info,
                                  param_.filter_scales, valid_ranges);
 
-    Tensor<cpu, 2> score = workspace_pre_nms[0];
-    Tensor<cpu, 2> order = workspace_pre_nms[1];
-
-    proposal_v2_utils::CopyScore(workspace_proposals,
-                                 &score,
-                                 &order);
-
     Tensor<cpu, 2> area = workspace_nms[0];
     Tensor<cpu, 2> suppressed = workspace_nms[1];
     Tensor<cpu, 2> keep = workspace_nms[2];
 
     for(int n = 0; n < nbatch; n++) {
-      Tensor<cpu, 1> cur_order = order[n];
+      int32_t* cur_order = reinterpret_cast<int32_t*>(order[n].dptr_);
       Tensor<cpu, 1> cur_area = area[n];
       Tensor<cpu, 1> cur_keep = keep[n];
       Tensor<cpu, 1> cur_suppressed = suppressed[n];
       Tensor<cpu, 2> cur_workspace_ordered_proposals = workspace_ordered_proposals[n];
-      proposal_v2_utils::ReverseArgsort(score[n],
-                                        &cur_order);
+      topk_utils::ReverseArgsortTopK(workspace_proposals[n].dptr_ + 4, 5, count,
+                                     rpn_pre_nms_top_n, cur_order);
       proposal_v2_utils::ReorderProposals(workspace_proposals[n],
                                           cur_order,
                                           rpn_pre_nms_top_n,
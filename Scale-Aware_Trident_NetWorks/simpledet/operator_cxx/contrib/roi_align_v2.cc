@@ -15,94 +15,63 @@ namespace op {
  */
 struct ROIAlignBackwardKernelCPU {
   /*!
-   * \param index              loop index
+   * \param index              loop index, over (image, channel) pairs of the input
    * \param top_diff           gradient of output data
    * \param argmax_x           index of value in pooled feature map on x axis
    * \param argmax_y           index of value in pooled feature map on y axis
    * \param num_rois_per_batch number of rois per batch
-   * \param num_rois           number of rois
-   * \param spatial_scale      ratio of input feature map height (or width)
-                                   to raw image height (or width)
    * \param channels           channels of input data
    * \param height             height of input data
    * \param width              width of input data
    * \param pooled_height      height of fix pooled size
    * \param pooled_width       width of fix pooled size
    * \param bottom_diff        gradient of input 4D feature map
-   * \param bottom_rois        gradient of input rois
    */
   template<typename DType>
   MSHADOW_XINLINE static void Map(int index, const DType* top_diff,
                                   const DType* argmax_x, const DType* argmax_y,
                                   const int num_rois_per_batch,
-                                  const int num_rois, const float spatial_scale,
                                   const int channels, const int height, const int width,
                                   const int pooled_height, const int pooled_width,
-                                  DType* bottom_diff, const DType* bottom_rois) {
+                                  DType* bottom_diff) {
     using namespace mxnet::op::mshadow_op;
-    // (n, c, h, w) coords in bottom data
-    int w = index % width;
-    int h = (index / width) % height;
-    int c = (index / width / height) % channels;
-    int n = index / width / height / channels;
-
-    DType gradient = 0;
-    // Accumulate gradient over all ROIs that pooled this element
-    for (int roi_n = 0; roi_n < num_rois; ++roi_n) {
-      const DType* offset_bottom_rois = bottom_rois + roi_n * 4;
-      int roi_batch_ind = roi_n / num_rois_per_batch;
-      // Skip if ROI's batch index doesn't match n
-      if (n != roi_batch_ind) {
-        continue;
-      }
-
-      DType roi_start_w = (offset_bottom_rois[0]) * spatial_scale;
-      DType roi_start_h = (offset_bottom_rois[1]) * spatial_scale;
-      DType roi_end_w = (offset_bottom_rois[2]) * spatial_scale;
-      DType roi_end_h = (offset_bottom_rois[3]) * spatial_scale;
-
-      // Skip if ROI doesn't include (h, w)
-      const bool in_roi = (w > roi_start_w - 1.0 && w < roi_end_w + 1.0 &&
-                           h > roi_start_h - 1.0 && h < roi_end_h + 1.0);
-      if (!in_roi) {
-        continue;
-      }
-
-      int offset = (roi_n * channels + c) * pooled_height * pooled_width;
+    // scatter the gradient of every pooled cell of this image and channel to
+    // the 4 pixels it was interpolated from, as the GPU kernel does. Each
+    // (image, channel) plane is owned by one task, so no atomics are needed.
+    int c = index % channels;
+    int n = index / channels;
+    DType* offset_bottom_diff = bottom_diff + (n * channels + c) * height * width;
+    const int pooled_size = pooled_height * pooled_width;
+
+    for (int roi_n = n * num_rois_per_batch; roi_n < (n + 1) * num_rois_per_batch; ++roi_n) {
+      int offset = (roi_n * channels + c) * pooled_size;
       const DType* offset_top_diff = top_diff + offset;
       const DType* offset_argmax_x = argmax_x + offset;
       const DType* offset_argmax_y = argmax_y + offset;
 
-      for (int ph = 0; ph < pooled_height; ++ph) {
-        for (int pw = 0; pw < pooled_width; ++pw) {
-          const int pool_index = ph * pooled_width + pw;
-          DType a_x = offset_argmax_x[pool_index];
-          DType a_y = offset_argmax_y[pool_index];
-          int hlow = minimum::Map(maximum::Map(static_cast<int>(floor::Map(a_y)), 0), height-1);
-          int hhigh = minimum::Map(maximum::Map(static_cast<int>(ceil::Map(a_y)), 0), height-1);
-          int wleft = minimum::Map(maximum::Map(static_cast<int>(floor::Map(a_x)), 0), width-1);
-          int wright = minimum::Map(maximum::Map(static_cast<int>(ceil::Map(a_x)), 0), width-1);
-          // (w, h) is not around (a_x, a_y)
-          if (h != hlow && h != hhigh && w != wleft && w != wright)
-            continue;
-
-          DType alpha = (hlow == hhigh) ? static_cast<DType>(0.5)
-                                        : (a_y - hlow) / (hhigh - hlow);
-          DType beta = (wleft == wright) ? static_cast<DType>(0.5)
-                                         : (a_x - wleft) / (wright - wleft);
-          if (h == hlow && w == wleft) {
-            gradient += offset_top_diff[pool_index] * (1 - alpha) * (1 - beta);
-          } else if (h == hlow && w == wright) {
-            gradient += offset_top_diff[pool_index] * (1 - alpha) * beta;
-          } else if (h == hhigh && w == wleft) {
-            gradient += offset_top_diff[pool_index] * alpha * (1 - beta);
-          } else if (h == hhigh && w == wright) {
-            gradient += offset_top_diff[pool_index] * alpha * beta;
-          }
-        }
+      for (int pool_index = 0; pool_index < pooled_size; ++pool_index) {
+        DType a_x = offset_argmax_x[pool_index];
+        DType a_y = offset_argmax_y[pool_index];
+        // nothing was pooled in this cell
+        if (a_x == static_cast<DType>(-1) || a_y == static_cast<DType>(-1))
+          continue;
+
+        int hlow = minimum::Map(maximum::Map(static_cast<int>(floor::Map(a_y)), 0), height-1);
+        int hhigh = minimum::Map(maximum::Map(static_cast<int>(ceil::Map(a_y)), 0), height-1);
+        int wleft = minimum::Map(maximum::Map(static_cast<int>(floor::Map(a_x)), 0), width-1);
+        int wright = minimum::Map(maximum::Map(static_cast<int>(ceil::Map(a_x)), 0), width-1);
+
+        DType alpha = (hlow == hhigh) ? static_cast<DType>(0.5)
+                                      : (a_y - hlow) / (hhigh - hlow);
+        DType beta = (wleft == wright) ? static_cast<DType>(0.5)
+                                       : (a_x - wleft) / (wright - wleft);
+        DType diff = offset_top_diff[pool_index];
+        offset_bottom_diff[hlow * width + wleft] += diff * (1 - alpha) * (1 - beta);
+        offset_bottom_diff[hlow * width + wright] += diff * (1 - alpha) * beta;
+        offset_bottom_diff[hhigh * width + wleft] += diff * alpha * (1 - beta);
+        offset_bottom_diff[hhigh * width + wright] += diff * alpha * beta;
       }
     }
-    bottom_diff[index] += gradient;
   }
 };
 
@@ -129,11 +98,7 @@ void ROIAlignBackward_v2<cpu>(const nnvm::NodeAttrs& attrs,
   CHECK_NE(req[1], kWriteInplace) <<
     "ROIAlign: Backward doesn't support kWriteInplace.";
 
-  const ROIAlignParam_v2 param = nnvm::get<ROIAlignParam_v2>(attrs.parsed);
-
-  const int count = outputs[0].Size();
   const int num_rois_per_batch = in_data[0].size(1);
-  const int num_rois = in_data[0].shape_.ProdShape(0, 2);
   const int channels = outputs[0].size(1);
   const int height = outputs[0].size(2);
   const int width = outputs[0].size(3);
@@ -144,7 +109,6 @@ void ROIAlignBackward_v2<cpu>(const nnvm::NodeAttrs& attrs,
   // assume all the data and gradient have the same type
   MSHADOW_REAL_TYPE_SWITCH(out_grad[0].type_flag_, DType, {
     const DType *top_diff = out_grad[0].dptr<DType>();
-    const DType *bottom_rois = in_data[0].dptr<DType>();
     DType *argmax_x = out_data[0].dptr<DType>();
     DType *argmax_y = out_data[1].dptr<DType>();
     DType *grad_in = outputs[0].dptr<DType>();
@@ -154,9 +118,8 @@ void ROIAlignBackward_v2<cpu>(const nnvm::NodeAttrs& attrs,
         Fill<false>(s, outputs[0], kWriteTo, static_cast<DType>(0));
       }
       mxnet_op::Kernel<ROIAlignBackwardKernelCPU, cpu>::Launch(s,
-        count, top_diff, argmax_x, argmax_y, num_rois_per_batch, num_rois,
-        param.spatial_scale, channels, height, width,
-        pooled_height, pooled_width, grad_in, bottom_rois);
+        outputs[0].size(0) * channels, top_diff, argmax_x, argmax_y, num_rois_per_batch,
+        channels, height, width, pooled_height, pooled_width, grad_in);
     }
     if (kWriteTo == req[roialign_v2::kBox]) {
       Fill<false>(s, outputs[1], kWriteTo, static_cast<DType>(0));
@@ -28,13 +28,13 @@
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
 #include <mxnet/operator.h>
-#include <condition_variable>
 #include <map>
 #include <vector>
 #include <string>
 #include <utility>
 #include "../operator_common.h"
 #include "../mshadow_op.h"
+#include "./all_reduce.h"
 
 namespace mxnet {
 namespace op {
@@ -75,99 +75,6 @@ struct SyncBatchNormParam : public dmlc::Parameter<SyncBatchNormParam> {
   }
 };
 
-// Modified from https://github.com/brucechin/SharedTensor
-template<class T>
-class SharedND {
- private:
-  int num_devices_;
-  T mean_;
-  T *data_;
-  bool *flag_;
-  bool mean_ready_ = false;
-  bool data_inited_ = false;
-  std::mutex mutex_;
-
- public:
-  explicit SharedND(int ndev) :num_devices_(ndev) {
-    flag_ = new bool[ndev];
-    data_ = new T[ndev];
-    memset(flag_, false, ndev * sizeof(bool));
-  }
-
-  ~SharedND() {
-    mshadow::FreeSpace(&mean_);
-    for (int i = 0; i < num_devices_; i++) {
-      mshadow::FreeSpace(&data_[i]);
-    }
-    delete [] flag_;
-    delete [] data_;
-  }
-
-  void Init(mshadow::Shape<1> shape) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (!data_inited_) {
-      for (int i = 0; i < num_devices_; i++) {
-        data_[i] = mshadow::NewTensor<cpu, real_t>(shape, 0.0f);
-      }
-      mean_ = mshadow::NewTensor<cpu, real_t>(shape, 0.0f);
-      data_inited_ = true;
-    }
-  }
-
-  T* Retrieve(mshadow::Shape<1> shape, int index) {
-    if (!data_inited_) {
-      Init(shape);
-    }
-    if (flag_[index] == false) {
-      return &data_[index];
-    } else {
-      return nullptr;
-    }
-  }
-
-  bool SetReady(int index) {
-    if (flag_[index] == false) {
-      flag_[index] = true;
-      return true;
-    } else {
-      return false;
-    }
-  }
-
-  T Pop(int index) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    while (!MeanReady()) {}
-    flag_[index] = false;
-    T tmp = mean_;
-    ResetMean();
-    return tmp;
-  }
-
-  bool MeanReady() {
-    if (mean_ready_) {
-      return true;
-    }
-    for (int i = 0; i < num_devices_; i++) {
-      if (!flag_[i]) {
-        return false;
-      }
-    }
-    for (int i = 1; i < num_devices_; i++) {
-      data_[0] += data_[i];
-    }
-    mean_ = data_[0] * 1.0f /  num_devices_;
-    mean_ready_ = true;
-    return true;
-  }
-
-  void ResetMean() {
-    for (int i = 0; i < num_devices_; i++) {
-      if (flag_[i]) return;
-    }
-    mean_ready_ = false;
-  }
-};
-
 template<class T>
 class GlobalShared {
  public:
@@ -190,58 +97,9 @@ class GlobalShared {
   std::map<std::string, T*> registry_;
 };
 
-template<class T>
-class GlobalSharedRank {
- public:
-  T Register(const std::string &key, int ndev) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto it = registry_.find(key);
-    if (it != registry_.end()) {
-      T* tmpT = it->second;
-      *tmpT = (*tmpT == ndev - 1) ? 0 : *tmpT + 1;
-      return *tmpT;
-    }
-    T *newT = new T(0);
-    registry_[key] = newT;
-    return *newT;
-  }
-  ~GlobalSharedRank() {
-    for (auto it = registry_.begin(); it != registry_.end(); it++) {
-      T *ptr = it->second;
-      delete ptr;
-    }
-  }
- private:
-  std::mutex mutex_;
-  std::map<std::string, T*> registry_;
-};
-
-class Barrier {
- private:
-  std::mutex mutex_;
-  std::condition_variable cv_;
-  std::size_t count_;
-  std::size_t total_count_;
- public:
-  explicit Barrier(std::size_t count) : count_{count}, total_count_{count} { }
-  void Wait() {
-    std::unique_lock<std::mutex> lock{mutex_};
-    if (--count_ == 0) {
-      count_ = total_count_;
-      cv_.notify_all();
-    } else {
-      cv_.wait(lock, [this] { return count_ == total_count_; });
-    }
-  }
-};
-
 // Global variables for Synchronizations
-static GlobalSharedRank<int> global_shared_rank;
-static GlobalShared<Barrier> global_shared_barrier;
-static GlobalShared<SharedND<mshadow::Tensor<cpu, 1, real_t>>> global_shared_mean;
-static GlobalShared<SharedND<mshadow::Tensor<cpu, 1, real_t>>> global_shared_var;
-static GlobalShared<SharedND<mshadow::Tensor<cpu, 1, real_t>>> global_shared_grad;
-static GlobalShared<SharedND<mshadow::Tensor<cpu, 1, real_t>>> global_shared_prod;
+// one all-reduce per layer, used by both the forward and the backward pass
+static GlobalShared<AllReduce<real_t>> global_shared_all_reduce;
 
 template<typename xpu>
 class SyncBatchNorm : public Operator {
@@ -321,9 +179,8 @@ class SyncBatchNorm : public Operator {
   
       // whether use global statistics
       if (ctx.is_train && !param_.use_global_stats) {
-        // get my rank
-        Barrier *global_barrier = global_shared_barrier.Register(param_.key + "f", param_.ndev);
-        int myRank = global_shared_rank.Register(param_.key + "f", param_.ndev);
+        AllReduce<real_t> *all_reduce = global_shared_all_reduce.Register(param_.key, param_.ndev);
+        const int slot = all_reduce->Join();
         // get the mean and var
         Tensor<xpu, 1> mean = out_data[syncbatchnorm::kMean].get<xpu, 1, real_t>(s);
         Tensor<xpu, 1> var = out_data[syncbatchnorm::kVar].get<xpu, 1, real_t>(s);
@@ -332,20 +189,14 @@ class SyncBatchNorm : public Operator {
         // E(x) and E(x^2)
         mean = scale * sumall_except_dim<1>(data);
         var = scale * sumall_except_dim<1>(F<mshadow_op::square>(data));
-        SharedND<Tensor<cpu, 1, real_t>> *sharedMean =
-          global_shared_mean.Register(param_.key, param_.ndev);
-        SharedND<Tensor<cpu, 1, real_t>> *sharedVar =
-          global_shared_var.Register(param_.key, param_.ndev);
-        // copy to cpu, push and pull
-        Tensor<cpu, 1, real_t>* mean_cpu_ptr = sharedMean->Retrieve(mean.shape_, myRank);
-        Tensor<cpu, 1, real_t>* var_cpu_ptr = sharedVar->Retrieve(mean.shape_, myRank);
-        Copy(*mean_cpu_ptr, mean, s);
-        Copy(*var_cpu_ptr, var, s);
-        sharedMean->SetReady(myRank);
-        sharedVar->SetReady(myRank);
-        global_barrier->Wait();
-        Tensor<cpu, 1, real_t> mean_cpu = sharedMean->Pop(myRank);
-        Tensor<cpu, 1, real_t> var_cpu = sharedVar->Pop(myRank);
+        // copy to cpu, average over devices, both in one reduction
+        real_t *stats = all_reduce->Buffer(slot, 2 * mean.shape_[0]);
+        Tensor<cpu, 1, real_t> mean_cpu(stats, mean.shape_);
+        Tensor<cpu, 1, real_t> var_cpu(stats + mean.shape_[0], mean.shape_);
+        Copy(mean_cpu, mean, s);
+        Copy(var_cpu, var, s);
+        s->Wait();
+        all_reduce->Reduce(slot);
         // copy back to gpu
         Copy(mean, mean_cpu, s);
         Copy(var, var_cpu, s);
@@ -460,9 +311,8 @@ class SyncBatchNorm : public Operator {
       if (param_.fix_gamma) slope = 1.f;
 
       if (ctx.is_train && !param_.use_global_stats) {
-        // get my rank
-        Barrier *global_barrier = global_shared_barrier.Register(param_.key + "b", param_.ndev);
-        int myRank = global_shared_rank.Register(param_.key + "b", param_.ndev);
+        AllReduce<real_t> *all_reduce = global_shared_all_reduce.Register(param_.key, param_.ndev);
+        const int slot = all_reduce->Join();
 
         Shape<1> dshape = Shape1(mean.shape_[0]);
         Tensor<xpu, 1> gmean = Tensor<xpu, 1>(workspace.dptr_, dshape, s);
@@ -475,20 +325,14 @@ class SyncBatchNorm : public Operator {
         Tensor<xpu, 1> sumProd = Tensor<xpu, 1>(workspace.dptr_ + 3 * mean.shape_[0], dshape, s);
         sumGrad = sumall_except_dim<1>(grad);
         sumProd = sumall_except_dim<1>(grad * (data - broadcast<1>(mean, data.shape_)));
-        SharedND<Tensor<cpu, 1, real_t>> *sharedGrad =
-          global_shared_grad.Register(param_.key, param_.ndev);
-        SharedND<Tensor<cpu, 1, real_t>> *sharedProd =
-          global_shared_prod.Register(param_.key, param_.ndev);
-        // copy to cpu, push and pull
-        Tensor<cpu, 1, real_t>* grad_cpu_ptr = sharedGrad->Retrieve(sumGrad.shape_, myRank);
-        Tensor<cpu, 1, real_t>* prod_cpu_ptr = sharedProd->Retrieve(sumProd.shape_, myRank);
-        Copy(*grad_cpu_ptr, sumGrad, s);
-        Copy(*prod_cpu_ptr, sumProd, s);
-        sharedGrad->SetReady(myRank);
-        sharedProd->SetReady(myRank);
-        global_barrier->Wait();
-        Tensor<cpu, 1, real_t> grad_cpu = sharedGrad->Pop(myRank);
-        Tensor<cpu, 1, real_t> prod_cpu = sharedProd->Pop(myRank);
+        // copy to cpu, average over devices, both in one reduction
+        real_t *sums = all_reduce->Buffer(slot, 2 * mean.shape_[0]);
+        Tensor<cpu, 1, real_t> grad_cpu(sums, dshape);
+        Tensor<cpu, 1, real_t> prod_cpu(sums + mean.shape_[0], dshape);
+        Copy(grad_cpu, sumGrad, s);
+        Copy(prod_cpu, sumProd, s);
+        s->Wait();
+        all_reduce->Reduce(slot);
         // copy back to gpu
         Copy(sumGrad, grad_cpu, s);
         Copy(sumProd, prod_cpu, s);
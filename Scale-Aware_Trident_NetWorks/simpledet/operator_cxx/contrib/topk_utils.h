@@ -0,0 +1,152 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file topk_utils.h
+ * \brief top-k selection of proposal scores shared by the CPU proposal and nms operators
+*/
+#ifndef MXNET_OPERATOR_CONTRIB_TOPK_UTILS_H_
+#define MXNET_OPERATOR_CONTRIB_TOPK_UTILS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace mxnet {
+namespace op {
+namespace topk_utils {
+
+const int kRadixBits = 8;
+const int kRadixSize = 1 << kRadixBits;
+const uint32_t kRadixMask = kRadixSize - 1;
+const int kRadixPasses = 32 / kRadixBits;
+
+// unsigned key of a score, ordered the other way round: higher scores get
+// smaller keys. -0 and +0 get the same key, as they compare equal.
+inline uint32_t ReverseScoreKey(float score) {
+  if (score == 0.0f) {
+    score = 0.0f;
+  }
+  uint32_t bits;
+  std::memcpy(&bits, &score, sizeof(bits));
+  bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+  return ~bits;
+}
+
+// Writes to order[0, top_n) the indices of the top_n highest of the count
+// scores score[0], score[stride], ..., by decreasing score and, for equal
+// scores, by increasing index.
+// The top_n-th key is found by a radix select, one 8-bit digit at a time,
+// and the selected entries, gathered in index order, are then sorted by a
+// stable LSD radix sort. This is linear in count, where sorting every score
+// with a comparator is O(count log count).
+inline void ReverseArgsortTopK(const float* score,
+                               const int stride,
+                               const int count,
+                               const int top_n,
+                               int32_t* order) {
+  if (top_n <= 0) {
+    return;
+  }
+  // scratch buffers are kept per thread and reused by later calls
+  static thread_local std::vector<uint32_t> keys;
+  static thread_local std::vector<uint32_t> sort_keys;
+  static thread_local std::vector<int32_t> sort_order;
+  keys.resize(count);
+  for (int i = 0; i < count; ++i) {
+    keys[i] = ReverseScoreKey(score[static_cast<size_t>(i) * stride]);
+  }
+
+  // radix select of the key of the top_n-th entry
+  int hist[kRadixSize];
+  uint32_t prefix = 0;
+  uint32_t prefix_mask = 0;
+  int rank = top_n;
+  for (int pass = kRadixPasses - 1; pass >= 0; --pass) {
+    const int shift = pass * kRadixBits;
+    std::fill(hist, hist + kRadixSize, 0);
+    for (int i = 0; i < count; ++i) {
+      const uint32_t key = keys[i];
+      if ((key & prefix_mask) == prefix) {
+        ++hist[(key >> shift) & kRadixMask];
+      }
+    }
+    uint32_t digit = 0;
+    while (hist[digit] < rank) {
+      rank -= hist[digit];
+      ++digit;
+    }
+    prefix |= digit << shift;
+    prefix_mask |= kRadixMask << shift;
+  }
+
+  // every key below the threshold is selected, and so are the first rank
+  // entries with the threshold key itself
+  const uint32_t threshold = prefix;
+  sort_keys.resize(2 * top_n);
+  sort_order.resize(top_n);
+  uint32_t* src_keys = sort_keys.data();
+  uint32_t* dst_keys = sort_keys.data() + top_n;
+  int32_t* src_order = order;
+  int32_t* dst_order = sort_order.data();
+  int num = 0;
+  for (int i = 0; i < count && num < top_n; ++i) {
+    const uint32_t key = keys[i];
+    if (key < threshold || (key == threshold && rank-- > 0)) {
+      src_keys[num] = key;
+      src_order[num] = i;
+      ++num;
+    }
+  }
+
+  for (int pass = 0; pass < kRadixPasses; ++pass) {
+    const int shift = pass * kRadixBits;
+    std::fill(hist, hist + kRadixSize, 0);
+    for (int i = 0; i < top_n; ++i) {
+      ++hist[(src_keys[i] >> shift) & kRadixMask];
+    }
+    // all keys share this digit, so the pass would not move anything
+    if (hist[(src_keys[0] >> shift) & kRadixMask] == top_n) {
+      continue;
+    }
+    int offset = 0;
+    for (int d = 0; d < kRadixSize; ++d) {
+      const int c = hist[d];
+      hist[d] = offset;
+      offset += c;
+    }
+    for (int i = 0; i < top_n; ++i) {
+      const int pos = hist[(src_keys[i] >> shift) & kRadixMask]++;
+      dst_keys[pos] = src_keys[i];
+      dst_order[pos] = src_order[i];
+    }
+    std::swap(src_keys, dst_keys);
+    std::swap(src_order, dst_order);
+  }
+  if (src_order != order) {
+    std::copy(src_order, src_order + top_n, order);
+  }
+}
+
+}  // namespace topk_utils
+}  // namespace op
+}  // namespace mxnet
+
+#endif  // MXNET_OPERATOR_CONTRIB_TOPK_UTILS_H_
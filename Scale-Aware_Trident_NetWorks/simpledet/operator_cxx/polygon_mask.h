@@ -0,0 +1,114 @@
+/*!
+ * \file polygon_mask.h
+ * \brief scanline rasterization of polygons into mask targets, with the
+ *        semantics of rleFrPoly and rleDecode of the COCO API
+ */
+#ifndef MXNET_OPERATOR_POLYGON_MASK_H_
+#define MXNET_OPERATOR_POLYGON_MASK_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace mxnet {
+namespace op {
+namespace polygon_mask {
+
+// Sets to 1 the pixels of the h x w column major mask, mask[x * h + y],
+// inside the polygon of the k points xy = (x0, y0, x1, y1, ...). Pixels
+// outside are left untouched, so the segments of an instance are ORed by
+// filling them into the same mask.
+// The boundary is walked exactly as rleFrPoly walks it: the vertices are
+// upsampled by 5, each edge is traced point by point and every step to
+// another x gives the y at which the parity flips in that column. Sorting
+// these flips by their position x * h + y and filling between pairs of them
+// is the RLE decoding, without building the RLE or a byte plane per segment.
+template <typename T>
+inline void FillPolygon(const double* xy, const int k, const int h, const int w, T* mask) {
+  if (k <= 0) {
+    return;
+  }
+  // scratch buffer kept per thread and reused by later calls
+  static thread_local std::vector<uint32_t> flips;
+  flips.clear();
+
+  // rleFrPoly maps an upsampled coordinate c to (c + .5) / 5 - .5 = (c - 2) / 5,
+  // which is exact in double, so the tests it does in floating point are
+  // done here on integers: column x is crossed when c - 2 is a multiple of
+  // 5, and the row is the ceil of (c - 2) / 5 clamped to [0, h]
+  const int max_x = w - 1;
+  // flip for the step between upsampled columns cu and cu + 1, at row cv
+  auto add_flip = [&](const int cu, const int cv) {
+    if (cu >= 2 && (cu - 2) % 5 == 0 && (cu - 2) / 5 <= max_x) {
+      const int y = cv <= 2 ? 0 : std::min((cv + 2) / 5, h);
+      flips.push_back(static_cast<uint32_t>((cu - 2) / 5 * h + y));
+    }
+  };
+  bool has_prev = false;
+  int prev_u = 0;
+  int prev_v = 0;
+  // dense boundary point (u, v) following (prev_u, prev_v)
+  auto visit = [&](const int u, const int v) {
+    if (has_prev && u != prev_u) {
+      add_flip(u < prev_u ? u : u - 1, std::min(v, prev_v));
+    }
+    has_prev = true;
+    prev_u = u;
+    prev_v = v;
+  };
+
+  for (int j = 0; j < k; ++j) {
+    const int next = j + 1 < k ? j + 1 : 0;
+    int xs = static_cast<int>(5 * xy[j * 2] + .5);
+    int ys = static_cast<int>(5 * xy[j * 2 + 1] + .5);
+    int xe = static_cast<int>(5 * xy[next * 2] + .5);
+    int ye = static_cast<int>(5 * xy[next * 2 + 1] + .5);
+    const int dx = std::abs(xe - xs);
+    const int dy = std::abs(ys - ye);
+    const bool flip = (dx >= dy && xs > xe) || (dx < dy && ys > ye);
+    if (flip) {
+      std::swap(xs, xe);
+      std::swap(ys, ye);
+    }
+    if (dx >= dy) {
+      const double s = static_cast<double>(ye - ys) / dx;
+      auto v_at = [&](const int t) { return static_cast<int>(ys + s * t + .5); };
+      // the edge is walked from t = dx down to 0 when flipped, every step
+      // moves to the next upsampled column and only one column in five can
+      // give a flip, so those steps are visited directly
+      const int t_first = flip ? dx : 0;
+      const int t_last = flip ? 0 : dx;
+      visit(xs + t_first, v_at(t_first));
+      for (int t = ((2 - xs) % 5 + 5) % 5; t < dx; t += 5) {
+        add_flip(xs + t, std::min(v_at(t), v_at(t + 1)));
+      }
+      prev_u = xs + t_last;
+      prev_v = v_at(t_last);
+    } else {
+      const double s = static_cast<double>(xe - xs) / dy;
+      for (int d = 0; d <= dy; ++d) {
+        const int t = flip ? dy - d : d;
+        visit(static_cast<int>(xs + s * t + .5), t + ys);
+      }
+    }
+  }
+
+  // a pixel is inside when an odd number of flips are at or before it
+  std::sort(flips.begin(), flips.end());
+  const uint32_t area = static_cast<uint32_t>(h) * w;
+  const size_t num_flips = flips.size();
+  for (size_t i = 0; i < num_flips; i += 2) {
+    const uint32_t start = flips[i];
+    const uint32_t end = i + 1 < num_flips ? std::min(flips[i + 1], area) : area;
+    for (uint32_t p = start; p < end; ++p) {
+      mask[p] = 1;
+    }
+  }
+}
+
+}  // namespace polygon_mask
+}  // namespace op
+}  // namespace mxnet
+
+#endif  // MXNET_OPERATOR_POLYGON_MASK_H_
@@ -7,7 +7,7 @@
 #include <algorithm>
 #include <cstdio>
 #include "./proposal_mask_target-inl.h"
-#include "../coco_api/common/maskApi.h"
+#include "./polygon_mask.h"
 using std::min;
 using std::max;
 using std::vector;
@@ -29,55 +29,31 @@ inline void convertPoly2Mask(const DType *roi,
      poly: The polygon points the pre-defined format(see below)
      mask_size: The mask size
      *****Outputs****
-     overlap: overlap of each box in boxes1 to each box in boxes2
+     mask: union of the segments of the polygon, as COCO rleFrPoly and rleDecode give it
      */
       DType w = roi[2] - roi[0];
       DType h = roi[3] - roi[1];
       w = max((DType)1., w);
       h = max((DType)1., h);
-      int category = static_cast<int>(poly[0]);
       int n_seg = static_cast<int>(poly[1]);
 
       int offset = 2 + n_seg;
-      RLE* rles;
-
-      rlesInit(&rles, n_seg);
+      // scratch buffer kept per thread and reused by later calls
+      static thread_local vector<double> xys;
+      std::fill(mask, mask + mask_size * mask_size, DType(0));
       for(int i = 0; i < n_seg; i++){
         int cur_len = poly[i+2];
-        double* xys = new double[cur_len];
+        xys.resize(cur_len);
         for(int j = 0; j < cur_len; j++){
           if (j % 2 == 0)
             xys[j] = (poly[offset+j+1] - roi[1]) * mask_size / h;
           else
             xys[j] = (poly[offset+j-1] - roi[0]) * mask_size / w;
-
-
         }
-        rleFrPoly(rles + i, xys, cur_len/2, mask_size, mask_size);
-        delete [] xys;
+        // segments are filled into the same mask, which ORs them
+        mxnet::op::polygon_mask::FillPolygon(xys.data(), cur_len/2, mask_size, mask_size, mask);
         offset += cur_len;
       }
-      // Decode RLE to mask
-      byte* byte_mask = new byte[mask_size*mask_size*n_seg];
-      rleDecode(rles, byte_mask, n_seg);
-
-      DType* mask_cat = mask;
-      // Flatten mask
-      for(int j = 0; j < mask_size*mask_size; j++){
-        float cur_byte = 0;
-        for(int i = 0; i< n_seg; i++){
-          int offset = i * mask_size * mask_size + j;
-          if(byte_mask[offset]==1){
-            cur_byte = 1;
-            break;
-          }
-        }
-        mask_cat[j] = cur_byte;
-      }
-
-      // Check to make sure we don't have memory leak
-      rlesFree(&rles, n_seg);
-      delete [] byte_mask;
 } // convertPoly2Mask
 
 
@@ -232,7 +208,8 @@ inline void SampleROIMask(const Tensor<cpu, 2, DType> &all_rois,
 
   ExpandBboxRegressionTargets(bbox_target_data, bbox_targets, bbox_weights, bbox_weight);
 
-  for (index_t i=0; i < fg_rois_this_image; ++i) {
+  #pragma omp parallel for
+  for (openmp_index_t i=0; i < fg_rois_this_image; ++i) {
     convertPoly2Mask(rois[i].dptr_, gt_polys[gt_assignment[kept_indexes[i]]].dptr_, mask_size, mask_targets[i].dptr_);
   }
 }
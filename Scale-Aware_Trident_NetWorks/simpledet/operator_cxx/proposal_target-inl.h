@@ -15,6 +15,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <type_traits>
 #include "./operator_common.h"
 
 #include <iostream>
@@ -22,8 +23,45 @@
 namespace mshadow {
 namespace proposal_target_v1 {
 
+// buffers of the sampling of one image, carved out of the host workspace
 template <typename DType>
-inline void SampleROI(
+struct SampleBuffer {
+  // kept rois and ground-truth boxes, one array per coordinate, so that the
+  // overlaps of a ground-truth box with every roi are computed in SIMD lanes
+  DType *roi_x1, *roi_y1, *roi_x2, *roi_y2, *roi_area;
+  DType *gt_x1, *gt_y1, *gt_x2, *gt_y2, *gt_area, *gt_label;
+  DType *max_overlaps;
+  int32_t *gt_assignment;
+  int32_t *fg_indexes, *bg_indexes, *neg_indexes, *kept_indexes;
+
+  // points the buffers into ptr and returns the bytes they take,
+  // a null ptr only computes the size
+  size_t Layout(uint8_t *ptr, index_t max_rois, index_t max_gts, index_t rois_per_image) {
+    size_t offset = 0;
+    auto carve = [&](size_t bytes) -> void* {
+      void *buffer = ptr == nullptr ? nullptr : ptr + offset;
+      offset += (bytes + 63) / 64 * 64;
+      return buffer;
+    };
+    DType **roi_arrays[] = {&roi_x1, &roi_y1, &roi_x2, &roi_y2, &roi_area, &max_overlaps};
+    for (DType **array : roi_arrays) {
+      *array = static_cast<DType*>(carve(max_rois * sizeof(DType)));
+    }
+    DType **gt_arrays[] = {&gt_x1, &gt_y1, &gt_x2, &gt_y2, &gt_area, &gt_label};
+    for (DType **array : gt_arrays) {
+      *array = static_cast<DType*>(carve(max_gts * sizeof(DType)));
+    }
+    int32_t **index_arrays[] = {&gt_assignment, &fg_indexes, &bg_indexes, &neg_indexes};
+    for (int32_t **array : index_arrays) {
+      *array = static_cast<int32_t*>(carve(max_rois * sizeof(int32_t)));
+    }
+    kept_indexes = static_cast<int32_t*>(carve(rois_per_image * sizeof(int32_t)));
+    return offset;
+  }
+};
+
+template <typename DType>
+void SampleROI(
   const Tensor<cpu, 2, DType> &all_rois,
   const Tensor<cpu, 2, DType> &gt_boxes,
   const Tensor<cpu, 1, DType> &bbox_mean,
@@ -35,7 +73,10 @@ inline void SampleROI(
   const float fg_thresh,
   const float bg_thresh_hi,
   const float bg_thresh_lo,
+  const bool proposal_without_gt,
   const bool class_agnostic,
+  const uint32_t seed,
+  SampleBuffer<DType> *buffer,
   Tensor<cpu, 2, DType> &&rois,
   Tensor<cpu, 1, DType> &&labels,
   Tensor<cpu, 2, DType> &&bbox_targets,
@@ -45,26 +86,18 @@ inline void SampleROI(
 
 template <typename DType>
 void BBoxOverlap(
-  const Tensor<cpu, 2, DType> &boxes,
-  const Tensor<cpu, 2, DType> &query_boxes,
-  Tensor<cpu, 2, DType> &overlaps
-);
-
-template <typename DType>
-void ExpandBboxRegressionTargets(
-  const Tensor<cpu, 2, DType> &bbox_target_data,
-  Tensor<cpu, 2, DType> &bbox_targets,
-  Tensor<cpu, 2, DType> &bbox_weights,
-  const Tensor<cpu, 1, DType> &bbox_weight
+  const SampleBuffer<DType> &buffer,
+  const index_t num_rois,
+  const index_t num_gts
 );
 
 template <typename DType>
 void NonLinearTransformAndNormalization(
-  const Tensor<cpu, 2, DType> &ex_rois,
-  const Tensor<cpu, 2, DType> &gt_rois,
-  Tensor<cpu, 2, DType> &targets,
+  const DType *ex_roi,
+  const DType *gt_roi,
   const Tensor<cpu, 1, DType> &bbox_mean,
-  const Tensor<cpu, 1, DType> &bbox_std
+  const Tensor<cpu, 1, DType> &bbox_std,
+  DType *target
 );
 
 } // namespace proposal_target_v1
@@ -76,6 +109,7 @@ namespace op {
 namespace proposal_target_enum {
 enum ProposalTargetInputs {kRois, kGtBboxes};
 enum ProposalTargetOutputs {kRoiOutput, kLabel, kBboxTarget, kBboxWeight, kMatch_gt_iou};
+enum ProposalTargetResource {kTempSpace, kRandom};
 }
 
 struct ProposalTargetParam : public dmlc::Parameter<ProposalTargetParam> {
@@ -135,100 +169,94 @@ class ProposalTargetOp : public Operator {
     CHECK_EQ(req[proposal_target_enum::kBboxTarget], kWriteTo);
     CHECK_EQ(req[proposal_target_enum::kBboxWeight], kWriteTo);
     Stream<xpu> *s = ctx.get_stream<xpu>();
+    const bool on_cpu               = std::is_same<xpu, cpu>::value;
     const index_t num_image         = param_.batch_images;
     const index_t num_roi           = in_data[proposal_target_enum::kRois].Size() / (num_image * 4);
     const index_t num_gtbbox        = in_data[proposal_target_enum::kGtBboxes].Size() / (num_image * 5);
     const int image_rois            = param_.image_rois;
+    const index_t num_reg           = param_.num_classes * 4;
     Tensor<xpu, 3, DType> xpu_rois      = in_data[proposal_target_enum::kRois].
                                           get_with_shape<xpu, 3, DType>(Shape3(num_image, num_roi, 4), s);
     Tensor<xpu, 3, DType> xpu_gt_bboxes = in_data[proposal_target_enum::kGtBboxes].
                                           get_with_shape<xpu, 3, DType>(Shape3(num_image, num_gtbbox, 5), s);
-    TensorContainer<cpu, 3, DType> rois     (xpu_rois.shape_);
-    TensorContainer<cpu, 3, DType> gt_bboxes(xpu_gt_bboxes.shape_);
-    Copy(rois, xpu_rois, s);
-    Copy(gt_bboxes, xpu_gt_bboxes, s);
-
-    std::vector<std::vector<Tensor<cpu, 1, DType>>> kept_rois;
-    std::vector<std::vector<Tensor<cpu, 1, DType>>> kept_gtbboxes;
-
-    // clean up bboxes
-    for (index_t i = 0; i < num_image; ++i) {
-      kept_gtbboxes.push_back(std::vector<Tensor<cpu, 1, DType>>());
-      for (index_t j = 0; j < gt_bboxes.size(1); ++j) {
-        if (gt_bboxes[i][j][4] != -1) {
-          kept_gtbboxes[i].push_back(gt_bboxes[i][j]);
-        }
-      }
-    }
+    Tensor<xpu, 3, DType> xpu_output_rois  = out_data[proposal_target_enum::kRoiOutput].
+                                             get_with_shape<xpu, 3, DType>(Shape3(num_image, image_rois, 4), s);
+    Tensor<xpu, 2, DType> xpu_labels       = out_data[proposal_target_enum::kLabel].
+                                             get_with_shape<xpu, 2, DType>(Shape2(num_image, image_rois), s);
+    Tensor<xpu, 3, DType> xpu_bbox_targets = out_data[proposal_target_enum::kBboxTarget].
+                                             get_with_shape<xpu, 3, DType>(Shape3(num_image, image_rois, num_reg), s);
+    Tensor<xpu, 3, DType> xpu_bbox_weights = out_data[proposal_target_enum::kBboxWeight].
+                                             get_with_shape<xpu, 3, DType>(Shape3(num_image, image_rois, num_reg), s);
+    Tensor<xpu, 2, DType> xpu_match_gt_ious = out_data[proposal_target_enum::kMatch_gt_iou].
+                                             get_with_shape<xpu, 2, DType>(Shape2(num_image, image_rois), s);
 
-    //for append gt
-    std::vector<TensorContainer<cpu, 1, DType>> gt_bboxes_tmp(num_image * num_gtbbox);
-    for (index_t i = 0; i < gt_bboxes_tmp.size(); ++i) {
-      gt_bboxes_tmp[i].Resize(Shape1(4));
+    // one seed per image, drawn from the random resource: the sampling is
+    // reproducible under a fixed seed whatever the number of threads
+    Random<xpu, real_t> *prnd = ctx.requested[proposal_target_enum::kRandom].get_random<xpu, real_t>(s);
+    Tensor<xpu, 1, real_t> xpu_seeds = ctx.requested[proposal_target_enum::kTempSpace].
+                                       get_space_typed<xpu, 1, real_t>(Shape1(num_image), s);
+    prnd->SampleUniform(&xpu_seeds);
+
+    // the host workspace holds the sampling buffers of every image and, when
+    // the inputs and outputs live on gpu, their host copies
+    const index_t max_rois = num_roi + num_gtbbox;
+    const size_t buffer_bytes = proposal_target_v1::SampleBuffer<DType>().
+                                Layout(nullptr, max_rois, num_gtbbox, image_rois);
+    size_t host_bytes = num_image * buffer_bytes;
+    if (!on_cpu) {
+      // 8 views, each rounded up to 64 bytes
+      host_bytes += 8 * 64 + num_image * sizeof(real_t) +
+                    num_image * (num_roi * 4 + num_gtbbox * 5 + image_rois * (6 + 2 * num_reg)) * sizeof(DType);
     }
-    index_t start = 0;
-    for (index_t i = 0; i < num_image; ++i) {
-      kept_rois.push_back(std::vector<Tensor<cpu, 1, DType>>());
-      for (index_t j = 0; j < rois.size(1); ++j) {
-        // y2 == 0 indicates padding
-        if (rois[i][j][3] > 0)
-          kept_rois[i].push_back(rois[i][j]);
-      }
-      if (!param_.proposal_without_gt) {
-        // all gt bboxes are appended
-        for (index_t j = 0; j < kept_gtbboxes[i].size(); ++j) {
-          Tensor<cpu, 1, DType> gt_tmp = gt_bboxes_tmp[start++];
-        //  gt_tmp[0] = i;
-          Copy(gt_tmp, kept_gtbboxes[i][j].Slice(0, 4));
-          kept_rois[i].push_back(gt_tmp);
-        }
-      }
+    Tensor<cpu, 1, uint8_t> workspace = ctx.requested[proposal_target_enum::kTempSpace].
+                                        get_host_space_typed<1, uint8_t>(Shape1(host_bytes));
+    uint8_t *host_ptr = workspace.dptr_ + num_image * buffer_bytes;
+    Tensor<cpu, 1, real_t> seeds           = HostView(xpu_seeds, &host_ptr);
+    Tensor<cpu, 3, DType> rois             = HostView(xpu_rois, &host_ptr);
+    Tensor<cpu, 3, DType> gt_bboxes        = HostView(xpu_gt_bboxes, &host_ptr);
+    Tensor<cpu, 3, DType> cpu_output_rois  = HostView(xpu_output_rois, &host_ptr);
+    Tensor<cpu, 2, DType> cpu_labels       = HostView(xpu_labels, &host_ptr);
+    Tensor<cpu, 3, DType> cpu_bbox_targets = HostView(xpu_bbox_targets, &host_ptr);
+    Tensor<cpu, 3, DType> cpu_bbox_weights = HostView(xpu_bbox_weights, &host_ptr);
+    Tensor<cpu, 2, DType> cpu_match_gt_ious = HostView(xpu_match_gt_ious, &host_ptr);
+    if (!on_cpu) {
+      Copy(seeds, xpu_seeds, s);
+      Copy(rois, xpu_rois, s);
+      Copy(gt_bboxes, xpu_gt_bboxes, s);
+      s->Wait();
     }
 
-    TensorContainer<cpu, 3, DType> cpu_output_rois(Shape3(num_image, image_rois, 4), 0.f);
-    TensorContainer<cpu, 2, DType> cpu_labels(Shape2(num_image, image_rois), 0.f);
-    TensorContainer<cpu, 3, DType> cpu_bbox_targets(Shape3(num_image, image_rois, param_.num_classes * 4), 0.f);
-    TensorContainer<cpu, 3, DType> cpu_bbox_weights(Shape3(num_image, image_rois, param_.num_classes * 4), 0.f);
-    TensorContainer<cpu, 2, DType> cpu_match_gt_ious(Shape2(num_image, image_rois), 0.f);
-
     index_t fg_rois_per_image = static_cast<index_t>(image_rois * param_.fg_fraction);
-    TensorContainer<cpu, 1, DType> bbox_mean(Shape1(4));
-    TensorContainer<cpu, 1, DType> bbox_std(Shape1(4));
-    TensorContainer<cpu, 1, DType> bbox_weight(Shape1(4));
-    bbox_mean[0] = param_.bbox_mean[0];
-    bbox_mean[1] = param_.bbox_mean[1];
-    bbox_mean[2] = param_.bbox_mean[2];
-    bbox_mean[3] = param_.bbox_mean[3];
-    bbox_std[0] = param_.bbox_std[0];
-    bbox_std[1] = param_.bbox_std[1];
-    bbox_std[2] = param_.bbox_std[2];
-    bbox_std[3] = param_.bbox_std[3];
-    bbox_weight[0] = param_.bbox_weight[0];
-    bbox_weight[1] = param_.bbox_weight[1];
-    bbox_weight[2] = param_.bbox_weight[2];
-    bbox_weight[3] = param_.bbox_weight[3];
-    for (index_t i = 0; i < num_image; ++i) {
-      TensorContainer<cpu, 2, DType> kept_rois_i    (Shape2(kept_rois[i].size(),     rois.size(2)));
-      TensorContainer<cpu, 2, DType> kept_gtbboxes_i(Shape2(kept_gtbboxes[i].size(), gt_bboxes.size(2)));
-      for (index_t j = 0; j < kept_rois_i.size(0); ++j) {
-          Copy(kept_rois_i[j], kept_rois[i][j]);
-      }
-      for (index_t j = 0; j < kept_gtbboxes_i.size(0); ++j) {
-          Copy(kept_gtbboxes_i[j], kept_gtbboxes[i][j]);
-      }
+    DType bbox_param[12];
+    for (index_t i = 0; i < 4; ++i) {
+      bbox_param[i] = param_.bbox_mean[i];
+      bbox_param[4 + i] = param_.bbox_std[i];
+      bbox_param[8 + i] = param_.bbox_weight[i];
+    }
+    Tensor<cpu, 1, DType> bbox_mean(bbox_param, Shape1(4));
+    Tensor<cpu, 1, DType> bbox_std(bbox_param + 4, Shape1(4));
+    Tensor<cpu, 1, DType> bbox_weight(bbox_param + 8, Shape1(4));
+
+    #pragma omp parallel for if (num_image > 1)
+    for (openmp_index_t i = 0; i < num_image; ++i) {
+      proposal_target_v1::SampleBuffer<DType> buffer;
+      buffer.Layout(workspace.dptr_ + i * buffer_bytes, max_rois, num_gtbbox, image_rois);
       proposal_target_v1::SampleROI(
-        kept_rois_i, 
-        kept_gtbboxes_i, 
-        bbox_mean, 
-        bbox_std, 
+        rois[i],
+        gt_bboxes[i],
+        bbox_mean,
+        bbox_std,
         bbox_weight,
-        fg_rois_per_image, 
+        fg_rois_per_image,
         image_rois,
-        param_.num_classes, 
-        param_.fg_thresh, 
-        param_.bg_thresh_hi, 
+        param_.num_classes,
+        param_.fg_thresh,
+        param_.bg_thresh_hi,
         param_.bg_thresh_lo,
+        param_.proposal_without_gt,
         param_.class_agnostic,
+        static_cast<uint32_t>(seeds[i] * 4294967295.0),
+        &buffer,
         cpu_output_rois[i],
         cpu_labels[i],
         cpu_bbox_targets[i],
@@ -237,22 +265,13 @@ class ProposalTargetOp : public Operator {
       );
     }
 
-    Tensor<xpu, 3, DType> xpu_output_rois  = out_data[proposal_target_enum::kRoiOutput].
-                                             get_with_shape<xpu, 3, DType>(Shape3(num_image, image_rois, 4), s);
-    Tensor<xpu, 2, DType> xpu_labels       = out_data[proposal_target_enum::kLabel].
-                                             get_with_shape<xpu, 2, DType>(Shape2(num_image, image_rois), s);
-    Tensor<xpu, 3, DType> xpu_bbox_targets = out_data[proposal_target_enum::kBboxTarget].
-                                             get_with_shape<xpu, 3, DType>(Shape3(num_image, image_rois, param_.num_classes * 4), s);
-    Tensor<xpu, 3, DType> xpu_bbox_weights = out_data[proposal_target_enum::kBboxWeight].
-                                             get_with_shape<xpu, 3, DType>(Shape3(num_image, image_rois, param_.num_classes * 4), s);
-    Tensor<xpu, 2, DType> xpu_match_gt_ious = out_data[proposal_target_enum::kMatch_gt_iou].
-                                             get_with_shape<xpu, 2, DType>(Shape2(num_image, image_rois), s);
-
-    Copy(xpu_output_rois, cpu_output_rois, s);
-    Copy(xpu_labels, cpu_labels, s);
-    Copy(xpu_bbox_targets, cpu_bbox_targets, s);
-    Copy(xpu_bbox_weights, cpu_bbox_weights, s);
-    Copy(xpu_match_gt_ious, cpu_match_gt_ious, s);
+    if (!on_cpu) {
+      Copy(xpu_output_rois, cpu_output_rois, s);
+      Copy(xpu_labels, cpu_labels, s);
+      Copy(xpu_bbox_targets, cpu_bbox_targets, s);
+      Copy(xpu_bbox_weights, cpu_bbox_weights, s);
+      Copy(xpu_match_gt_ious, cpu_match_gt_ious, s);
+    }
   }
 
   virtual void Backward(const OpContext &ctx,
@@ -277,6 +296,18 @@ class ProposalTargetOp : public Operator {
   }
 
  private:
+  // host view of tensor: the tensor itself on cpu, otherwise the next
+  // 64-byte aligned slots of the host workspace, which *ptr is moved past
+  template <int dim, typename T>
+  static Tensor<cpu, dim, T> HostView(const Tensor<xpu, dim, T> &tensor, uint8_t **ptr) {
+    if (std::is_same<xpu, cpu>::value) {
+      return Tensor<cpu, dim, T>(tensor.dptr_, tensor.shape_);
+    }
+    Tensor<cpu, dim, T> host(reinterpret_cast<T*>(*ptr), tensor.shape_);
+    *ptr += (tensor.shape_.Size() * sizeof(T) + 63) / 64 * 64;
+    return host;
+  }
+
   ProposalTargetParam param_;
 };  // class ProposalTargetOp
 
@@ -339,6 +370,11 @@ class ProposalTargetProp : public OperatorProperty {
     return true;
   }
 
+  std::vector<ResourceRequest> ForwardResource(
+      const std::vector<TShape> &in_shape) const override {
+    return {ResourceRequest::kTempSpace, ResourceRequest::kRandom};
+  }
+
   std::vector<int> DeclareBackwardDependency(
       const std::vector<int> &out_grad,
       const std::vector<int> &in_data,
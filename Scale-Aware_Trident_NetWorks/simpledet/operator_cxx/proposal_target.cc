@@ -7,227 +7,249 @@
 #include "./proposal_target-inl.h"
 #include <algorithm>
 #include <cstdio>
+#include <random>
 using std::min;
 using std::max;
 using std::vector;
-using std::begin;
-using std::end;
-using std::random_shuffle;
 using std::log;
 
 
 namespace mshadow {
 namespace proposal_target_v1 {
+
+// moves a uniform random sample of num of the count indexes to their front,
+// like random_shuffle followed by a truncation, in O(num)
+inline void SampleIndexes(int32_t *indexes, const index_t count, const index_t num,
+                          std::mt19937 *rng) {
+  for (index_t i = 0; i < num && i + 1 < count; ++i) {
+    std::uniform_int_distribution<index_t> pick(i, count - 1);
+    std::swap(indexes[i], indexes[pick(*rng)]);
+  }
+}
+
 template <typename DType>
-inline void SampleROI(const Tensor<cpu, 2, DType> &all_rois,
-                      const Tensor<cpu, 2, DType> &gt_boxes,
-                      const Tensor<cpu, 1, DType> &bbox_mean,
-                      const Tensor<cpu, 1, DType> &bbox_std,
-                      const Tensor<cpu, 1, DType> &bbox_weight,
-                      const index_t fg_rois_per_image,
-                      const index_t rois_per_image,
-                      const index_t num_classes,
-                      const float fg_thresh,
-                      const float bg_thresh_hi,
-                      const float bg_thresh_lo,
-                      const bool class_agnostic,
-                      Tensor<cpu, 2, DType> &&rois,
-                      Tensor<cpu, 1, DType> &&labels,
-                      Tensor<cpu, 2, DType> &&bbox_targets,
-                      Tensor<cpu, 2, DType> &&bbox_weights,
-                      Tensor<cpu, 1, DType> &&match_gt_ious) {
+void SampleROI(const Tensor<cpu, 2, DType> &all_rois,
+               const Tensor<cpu, 2, DType> &gt_boxes,
+               const Tensor<cpu, 1, DType> &bbox_mean,
+               const Tensor<cpu, 1, DType> &bbox_std,
+               const Tensor<cpu, 1, DType> &bbox_weight,
+               const index_t fg_rois_per_image,
+               const index_t rois_per_image,
+               const index_t num_classes,
+               const float fg_thresh,
+               const float bg_thresh_hi,
+               const float bg_thresh_lo,
+               const bool proposal_without_gt,
+               const bool class_agnostic,
+               const uint32_t seed,
+               SampleBuffer<DType> *buffer,
+               Tensor<cpu, 2, DType> &&rois,
+               Tensor<cpu, 1, DType> &&labels,
+               Tensor<cpu, 2, DType> &&bbox_targets,
+               Tensor<cpu, 2, DType> &&bbox_weights,
+               Tensor<cpu, 1, DType> &&match_gt_ious) {
+  SampleBuffer<DType> &buf = *buffer;
+  // clean up bboxes, label -1 indicates padding
+  index_t num_gts = 0;
+  for (index_t j = 0; j < gt_boxes.size(0); ++j) {
+    if (gt_boxes[j][4] != -1) {
+      buf.gt_x1[num_gts] = gt_boxes[j][0];
+      buf.gt_y1[num_gts] = gt_boxes[j][1];
+      buf.gt_x2[num_gts] = gt_boxes[j][2];
+      buf.gt_y2[num_gts] = gt_boxes[j][3];
+      buf.gt_label[num_gts] = gt_boxes[j][4];
+      ++num_gts;
+    }
+  }
+  // y2 == 0 indicates padding, all gt bboxes are appended unless proposal_without_gt
+  index_t num_rois = 0;
+  for (index_t i = 0; i < all_rois.size(0); ++i) {
+    if (all_rois[i][3] > 0) {
+      buf.roi_x1[num_rois] = all_rois[i][0];
+      buf.roi_y1[num_rois] = all_rois[i][1];
+      buf.roi_x2[num_rois] = all_rois[i][2];
+      buf.roi_y2[num_rois] = all_rois[i][3];
+      ++num_rois;
+    }
+  }
+  for (index_t j = 0; j < num_gts && !proposal_without_gt; ++j) {
+    buf.roi_x1[num_rois] = buf.gt_x1[j];
+    buf.roi_y1[num_rois] = buf.gt_y1[j];
+    buf.roi_x2[num_rois] = buf.gt_x2[j];
+    buf.roi_y2[num_rois] = buf.gt_y2[j];
+    ++num_rois;
+  }
+  for (index_t i = 0; i < num_rois; ++i) {
+    buf.roi_area[i] = (buf.roi_x2[i] - buf.roi_x1[i] + 1.f) * (buf.roi_y2[i] - buf.roi_y1[i] + 1.f);
+  }
+  for (index_t j = 0; j < num_gts; ++j) {
+    buf.gt_area[j] = (buf.gt_x2[j] - buf.gt_x1[j] + 1.f) * (buf.gt_y2[j] - buf.gt_y1[j] + 1.f);
+  }
+
   /*
   overlaps = bbox_overlaps(rois[:, 1:].astype(np.float), gt_boxes[:, :4].astype(np.float))
   gt_assignment = overlaps.argmax(axis=1)
   overlaps = overlaps.max(axis=1)
-  labels = gt_boxes[gt_assignment, 4]
   */
-  TensorContainer<cpu, 2, DType> IOUs(Shape2(all_rois.size(0), gt_boxes.size(0)), 0.f);
-  BBoxOverlap(all_rois, gt_boxes, IOUs);
+  BBoxOverlap(buf, num_rois, num_gts);
 
-  vector<DType> max_overlaps(all_rois.size(0), 0.f);
-  vector<DType> all_labels(all_rois.size(0), 0.f);
-  vector<DType> gt_assignment(all_rois.size(0), 0.f);
-  for (index_t i = 0; i < IOUs.size(0); ++i) {
-      DType max_value = IOUs[i][0];
-      index_t max_index = 0;
-      for (index_t j = 1; j < IOUs.size(1); ++j) {
-        if (max_value < IOUs[i][j]) {
-            max_value = IOUs[i][j];
-            max_index = j;
-        }
-      }
-      gt_assignment[i] = max_index;
-      max_overlaps[i] = max_value;
-      all_labels[i] = gt_boxes[max_index][4];
-  }
   /*
   fg_indexes = np.where(overlaps >= config.TRAIN.FG_THRESH)[0]
-  fg_rois_per_this_image = np.minimum(fg_rois_per_image, fg_indexes.size)
-  if len(fg_indexes) > fg_rois_per_this_image:
-    fg_indexes = npr.choice(fg_indexes, size=fg_rois_per_this_image, replace=False)
+  bg_indexes = np.where((overlaps < config.TRAIN.BG_THRESH_HI) & (overlaps >= config.TRAIN.BG_THRESH_LO))[0]
   */
-  vector<index_t> fg_indexes;
-  vector<index_t> neg_indexes;
-  for (index_t i = 0; i < max_overlaps.size(); ++i) {
-    if (max_overlaps[i] >= fg_thresh) {
-      fg_indexes.push_back(i);
+  index_t num_fg = 0;
+  index_t num_bg = 0;
+  index_t num_neg = 0;
+  for (index_t i = 0; i < num_rois; ++i) {
+    const DType overlap = buf.max_overlaps[i];
+    if (overlap >= fg_thresh) {
+      buf.fg_indexes[num_fg++] = i;
     } else {
-      neg_indexes.push_back(i);
+      buf.neg_indexes[num_neg++] = i;
+    }
+    if (overlap >= bg_thresh_lo && overlap < bg_thresh_hi) {
+      buf.bg_indexes[num_bg++] = i;
     }
-  }
-  // subsampling rois
-  index_t fg_rois_this_image;
-  fg_rois_this_image = min<index_t>(fg_rois_per_image, fg_indexes.size());
-  if (fg_indexes.size() > fg_rois_this_image) {
-    random_shuffle(begin(fg_indexes), end(fg_indexes));
-    fg_indexes.resize(fg_rois_this_image);
   }
 
   /*
-  bg_indexes = np.where((overlaps < config.TRAIN.BG_THRESH_HI) & (overlaps >= config.TRAIN.BG_THRESH_LO))[0]
+  fg_rois_per_this_image = np.minimum(fg_rois_per_image, fg_indexes.size)
+  if len(fg_indexes) > fg_rois_per_this_image:
+    fg_indexes = npr.choice(fg_indexes, size=fg_rois_per_this_image, replace=False)
   bg_rois_per_this_image = rois_per_image - fg_rois_per_this_image
   bg_rois_per_this_image = np.minimum(bg_rois_per_this_image, bg_indexes.size)
   if len(bg_indexes) > bg_rois_per_this_image:
     bg_indexes = npr.choice(bg_indexes, size=bg_rois_per_this_image, replace=False)
+  keep_indexes = np.append(fg_indexes, bg_indexes)
   */
-  vector<index_t> bg_indexes;
-  for (index_t i = 0; i < max_overlaps.size(); ++i) {
-    if (max_overlaps[i] >= bg_thresh_lo && max_overlaps[i] < bg_thresh_hi) {
-        bg_indexes.push_back(i);
-    }
+  std::mt19937 rng(seed);
+  const index_t fg_rois_this_image = min<index_t>(fg_rois_per_image, num_fg);
+  if (num_fg > fg_rois_this_image) {
+    SampleIndexes(buf.fg_indexes, num_fg, fg_rois_this_image, &rng);
   }
-  index_t bg_rois_this_image = min<index_t>(rois_per_image - fg_rois_this_image, bg_indexes.size());
-  if (bg_indexes.size() > bg_rois_this_image) {
-      random_shuffle(begin(bg_indexes), end(bg_indexes));
-      bg_indexes.resize(bg_rois_this_image);
+  const index_t bg_rois_this_image = min<index_t>(rois_per_image - fg_rois_this_image, num_bg);
+  if (num_bg > bg_rois_this_image) {
+    SampleIndexes(buf.bg_indexes, num_bg, bg_rois_this_image, &rng);
   }
-  //printf("fg %d bg %d\n", fg_rois_this_image,bg_rois_this_image);
-  // keep_indexes = np.append(fg_indexes, bg_indexes)
-  vector<index_t> kept_indexes;
+  index_t num_kept = 0;
   for (index_t i = 0; i < fg_rois_this_image; ++i) {
-      kept_indexes.push_back(fg_indexes[i]);
+    buf.kept_indexes[num_kept++] = buf.fg_indexes[i];
   }
   for (index_t i = 0; i < bg_rois_this_image; ++i) {
-      kept_indexes.push_back(bg_indexes[i]);
+    buf.kept_indexes[num_kept++] = buf.bg_indexes[i];
   }
-
   // pad with negative rois, original code is GARBAGE and omitted
-  while (kept_indexes.size() < rois_per_image && neg_indexes.size() > 0) {
-      index_t gap = rois_per_image - kept_indexes.size();
-      random_shuffle(begin(neg_indexes), end(neg_indexes));
-      for (index_t idx = 0;idx < gap && idx < neg_indexes.size();++idx) {
-          kept_indexes.push_back(neg_indexes[idx]);
-      }
+  while (num_kept < rois_per_image && num_neg > 0) {
+    const index_t gap = min<index_t>(rois_per_image - num_kept, num_neg);
+    SampleIndexes(buf.neg_indexes, num_neg, gap, &rng);
+    for (index_t idx = 0; idx < gap; ++idx) {
+      buf.kept_indexes[num_kept++] = buf.neg_indexes[idx];
+    }
   }
+
   /*
   labels = labels[keep_indexes]
   labels[fg_rois_per_this_image:] = 0
   rois = rois[keep_indexes]
   */
-  for (index_t i = 0; i < kept_indexes.size(); ++i) {
-    if (i < fg_rois_this_image){
-      labels[i] = all_labels[kept_indexes[i]];
+  rois = 0.f;
+  labels = 0.f;
+  bbox_targets = 0.f;
+  bbox_weights = 0.f;
+  match_gt_ious = 0.f;
+  for (index_t i = 0; i < num_kept; ++i) {
+    const int32_t roi = buf.kept_indexes[i];
+    rois[i][0] = buf.roi_x1[roi];
+    rois[i][1] = buf.roi_y1[roi];
+    rois[i][2] = buf.roi_x2[roi];
+    rois[i][3] = buf.roi_y2[roi];
+    match_gt_ious[i] = buf.max_overlaps[roi];
+    const int32_t gt = buf.gt_assignment[roi];
+    if (i >= fg_rois_this_image || gt < 0) {
+      continue;
     }
-    Copy(rois[i], all_rois[kept_indexes[i]]);
-    match_gt_ious[i] = max_overlaps[kept_indexes[i]];
-  }
-
-
-  TensorContainer<cpu, 2, DType> rois_tmp(Shape2(rois.size(0), 4));
-  for (index_t i = 0; i < rois_tmp.size(0); ++i) {
-      Copy(rois_tmp[i], rois[i]);
-  }
-
-  TensorContainer<cpu, 2, DType> gt_bboxes_tmp(Shape2(rois.size(0), 4));
-  for (index_t i = 0; i < rois_tmp.size(0); ++i) {
-      Copy(gt_bboxes_tmp[i], gt_boxes[gt_assignment[kept_indexes[i]]].Slice(0, 4));
-  }
-  TensorContainer<cpu, 2, DType> targets(Shape2(rois.size(0), 4));
-  NonLinearTransformAndNormalization(rois_tmp, gt_bboxes_tmp, targets, bbox_mean, bbox_std);
-
-  TensorContainer<cpu, 2, DType> bbox_target_data(Shape2(targets.size(0), 5));
-  for (index_t i = 0; i < bbox_target_data.size(0); ++i) {
-      if (class_agnostic){
-        //class-agnostic regression class index = {0, 1}
-//        bbox_target_data[i][0] = min(1.f, labels[i]);
-        bbox_target_data[i][0] = labels[i]< static_cast<DType>(1) ? labels[i]:static_cast<DType>(1);
-      }else{
-        bbox_target_data[i][0] = labels[i];
+    labels[i] = buf.gt_label[gt];
+    DType target_cls = labels[i];
+    if (class_agnostic) {
+      // class-agnostic regression class index = {0, 1}
+      target_cls = labels[i] < static_cast<DType>(1) ? labels[i] : static_cast<DType>(1);
+    }
+    if (target_cls > 0) {
+      const index_t start = 4 * static_cast<index_t>(target_cls);
+      const DType ex_roi[4] = {rois[i][0], rois[i][1], rois[i][2], rois[i][3]};
+      const DType gt_roi[4] = {buf.gt_x1[gt], buf.gt_y1[gt], buf.gt_x2[gt], buf.gt_y2[gt]};
+      NonLinearTransformAndNormalization(ex_roi, gt_roi, bbox_mean, bbox_std,
+                                         bbox_targets[i].dptr_ + start);
+      for (index_t k = 0; k < 4; ++k) {
+        bbox_weights[i][start + k] = bbox_weight[k];
       }
-      Copy(bbox_target_data[i].Slice(1, 5), targets[i]);
-  }
-
-  ExpandBboxRegressionTargets(bbox_target_data, bbox_targets, bbox_weights, bbox_weight);
-
-}
-
-template <typename DType>
-void BBoxOverlap(const Tensor<cpu, 2, DType> &boxes,
-                 const Tensor<cpu, 2, DType> &query_boxes,
-                 Tensor<cpu, 2, DType> &overlaps) {
-    const index_t n = boxes.size(0);
-    const index_t k = query_boxes.size(0);
-    for (index_t j = 0; j < k; ++j) {
-        DType query_box_area = (query_boxes[j][2] - query_boxes[j][0] + 1.f) * (query_boxes[j][3] - query_boxes[j][1] + 1.f);
-        for (index_t i = 0; i < n; ++i) {
-            DType iw = min(boxes[i][2], query_boxes[j][2]) - max(boxes[i][0], query_boxes[j][0]) + 1.f;
-            if (iw > 0) {
-                DType ih = min(boxes[i][3], query_boxes[j][3]) - max(boxes[i][1], query_boxes[j][1]) + 1.f;
-                if (ih > 0) {
-                    DType box_area = (boxes[i][2] - boxes[i][0] + 1.f) * (boxes[i][3] - boxes[i][1] + 1.f);
-                    DType union_area = box_area + query_box_area - iw * ih;
-                    overlaps[i][j] = iw * ih / union_area;
-                }
-            }
-        }
     }
+  }
 }
 
 template <typename DType>
-void ExpandBboxRegressionTargets(const Tensor<cpu, 2, DType> &bbox_target_data,
-                                 Tensor<cpu, 2, DType> &bbox_targets,
-                                 Tensor<cpu, 2, DType> &bbox_weights,
-                                 const Tensor<cpu, 1, DType> &bbox_weight) {
-  index_t num_bbox = bbox_target_data.size(0);
-  for (index_t i = 0; i < num_bbox; ++i) {
-    if (bbox_target_data[i][0] > 0) {
-      index_t cls = bbox_target_data[i][0];
-      index_t start = 4 * cls;
-      index_t end = start + 4;
-      Copy(bbox_targets[i].Slice(start, end), bbox_target_data[i].Slice(1, 5));
-      Copy(bbox_weights[i].Slice(start, end), bbox_weight);
+void BBoxOverlap(const SampleBuffer<DType> &buffer,
+                 const index_t num_rois,
+                 const index_t num_gts) {
+  const DType *x1 = buffer.roi_x1;
+  const DType *y1 = buffer.roi_y1;
+  const DType *x2 = buffer.roi_x2;
+  const DType *y2 = buffer.roi_y2;
+  const DType *area = buffer.roi_area;
+  DType *max_overlaps = buffer.max_overlaps;
+  int32_t *gt_assignment = buffer.gt_assignment;
+  if (num_gts == 0) {
+    std::fill(max_overlaps, max_overlaps + num_rois, DType(0));
+    std::fill(gt_assignment, gt_assignment + num_rois, -1);
+    return;
+  }
+  // ground-truth boxes in the outer loop, the running max and argmax over
+  // them are kept per roi, the first ground-truth box winning ties
+  for (index_t j = 0; j < num_gts; ++j) {
+    const DType query_x1 = buffer.gt_x1[j];
+    const DType query_y1 = buffer.gt_y1[j];
+    const DType query_x2 = buffer.gt_x2[j];
+    const DType query_y2 = buffer.gt_y2[j];
+    const DType query_box_area = buffer.gt_area[j];
+    const bool first = j == 0;
+    #pragma omp simd
+    for (index_t i = 0; i < num_rois; ++i) {
+      const DType iw = min(x2[i], query_x2) - max(x1[i], query_x1) + 1.f;
+      const DType ih = min(y2[i], query_y2) - max(y1[i], query_y1) + 1.f;
+      const DType inter = iw * ih;
+      const DType overlap = (iw > 0 && ih > 0) ? inter / (area[i] + query_box_area - inter) : DType(0);
+      if (first || max_overlaps[i] < overlap) {
+        max_overlaps[i] = overlap;
+        gt_assignment[i] = j;
+      }
     }
   }
 }
 
 template <typename DType>
-void NonLinearTransformAndNormalization(const Tensor<cpu, 2, DType> &ex_rois,
-                                        const Tensor<cpu, 2, DType> &gt_rois,
-                                        Tensor<cpu, 2, DType> &targets,
+void NonLinearTransformAndNormalization(const DType *ex_roi,
+                                        const DType *gt_roi,
                                         const Tensor<cpu, 1, DType> &bbox_mean,
-                                        const Tensor<cpu, 1, DType> &bbox_std) {
-  index_t num_roi = ex_rois.size(0);
-  for (index_t i = 0; i < num_roi; ++i) {
-      DType ex_width  = ex_rois[i][2] - ex_rois[i][0] + 1.f;
-      DType ex_height = ex_rois[i][3] - ex_rois[i][1] + 1.f;
-      DType ex_ctr_x  = ex_rois[i][0] + 0.5 * (ex_width - 1.f);
-      DType ex_ctr_y  = ex_rois[i][1] + 0.5 * (ex_height - 1.f);
-      DType gt_width  = gt_rois[i][2] - gt_rois[i][0] + 1.f;
-      DType gt_height = gt_rois[i][3] - gt_rois[i][1] + 1.f;
-      DType gt_ctr_x  = gt_rois[i][0] + 0.5 * (gt_width - 1.f);
-      DType gt_ctr_y  = gt_rois[i][1] + 0.5 * (gt_height - 1.f);
-      targets[i][0]   = (gt_ctr_x - ex_ctr_x) / (ex_width + 1e-14f);
-      targets[i][1]   = (gt_ctr_y - ex_ctr_y) / (ex_height + 1e-14f);
-      targets[i][2]   = log(gt_width / ex_width);
-      targets[i][3]   = log(gt_height / ex_height);
-      targets[i] -= bbox_mean;
-      targets[i] /= bbox_std;
+                                        const Tensor<cpu, 1, DType> &bbox_std,
+                                        DType *target) {
+  DType ex_width  = ex_roi[2] - ex_roi[0] + 1.f;
+  DType ex_height = ex_roi[3] - ex_roi[1] + 1.f;
+  DType ex_ctr_x  = ex_roi[0] + 0.5 * (ex_width - 1.f);
+  DType ex_ctr_y  = ex_roi[1] + 0.5 * (ex_height - 1.f);
+  DType gt_width  = gt_roi[2] - gt_roi[0] + 1.f;
+  DType gt_height = gt_roi[3] - gt_roi[1] + 1.f;
+  DType gt_ctr_x  = gt_roi[0] + 0.5 * (gt_width - 1.f);
+  DType gt_ctr_y  = gt_roi[1] + 0.5 * (gt_height - 1.f);
+  target[0] = (gt_ctr_x - ex_ctr_x) / (ex_width + 1e-14f);
+  target[1] = (gt_ctr_y - ex_ctr_y) / (ex_height + 1e-14f);
+  target[2] = log(gt_width / ex_width);
+  target[3] = log(gt_height / ex_height);
+  for (index_t k = 0; k < 4; ++k) {
+    target[k] = (target[k] - bbox_mean[k]) / bbox_std[k];
   }
 }
 
-}  // namespace pt
-
+}  // namespace proposal_target_v1
 }  // namespace mshadow
 
 namespace mxnet {
@@ -0,0 +1,24 @@
+// RPN anchor targets of one image, with the semantics of AnchorTarget2D in
+// core/detection_input.py. anchors are the [num_anchors, 4] valid anchors
+// and gt_bbox the [num_gt, 4] gt boxes, both (x1, y1, x2, y2).
+//
+// _assign_anchor_label writes the label of every anchor (-1 ignore, 0 bg,
+// 1 fg) and the index of its best overlapping gt, as _assign_label_to_anchor.
+//
+// _anchor_target in addition subsamples the labels to at most num_sample
+// anchors with at most fg_fraction of them fg, as _sample_anchor with a
+// generator seeded by seed, and writes the [num_anchors, 4] regression
+// target and weight of the fg anchors, as _cal_anchor_target. The other
+// rows of reg_target and reg_weight are left untouched.
+#include <cstdint>
+
+void _assign_anchor_label(const double* anchors, int num_anchors,
+                          const float* gt_bbox, int num_gt, float neg_thr,
+                          float pos_thr, float min_pos_thr, float* label,
+                          int64_t* argmax);
+
+void _anchor_target(const double* anchors, int num_anchors,
+                    const float* gt_bbox, int num_gt, float neg_thr,
+                    float pos_thr, float min_pos_thr, int num_sample,
+                    double fg_fraction, uint32_t seed, float* label,
+                    float* reg_target, float* reg_weight);
@@ -0,0 +1,64 @@
+cimport cython
+import numpy as np
+cimport numpy as np
+from libc.stdint cimport int64_t, uint32_t
+
+np.import_array()
+
+cdef extern from "anchor_target.hpp":
+    void _assign_anchor_label(const double*, int, const float*, int, float, float,
+                              float, float*, int64_t*) nogil
+    void _anchor_target(const double*, int, const float*, int, float, float, float,
+                        int, double, uint32_t, float*, float*, float*) nogil
+
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+def assign_anchor_label(anchor, gt_bbox, float neg_thr, float pos_thr, float min_pos_thr):
+    """
+    label the anchors of an image by their overlaps with its gt boxes
+    :param anchor: [n, 4] anchors
+    :param gt_bbox: [k, 4] gt boxes
+    :return: float32 label (-1 ignore, 0 bg, 1 fg) and int64 index of the best gt
+             of every anchor
+    """
+    cdef np.ndarray[np.float64_t, ndim=2] c_anchor = np.ascontiguousarray(anchor, dtype=np.float64)
+    cdef np.ndarray[np.float32_t, ndim=2] c_gt_bbox = np.ascontiguousarray(gt_bbox[:, :4], dtype=np.float32)
+    cdef int num_anchor = c_anchor.shape[0]
+    cdef int num_gt = c_gt_bbox.shape[0]
+    cdef np.ndarray[np.float32_t, ndim=1] label = np.empty((num_anchor, ), dtype=np.float32)
+    cdef np.ndarray[np.int64_t, ndim=1] argmax = np.empty((num_anchor, ), dtype=np.int64)
+
+    with nogil:
+        _assign_anchor_label(<const double*> c_anchor.data, num_anchor,
+                             <const float*> c_gt_bbox.data, num_gt, neg_thr, pos_thr,
+                             min_pos_thr, <float*> label.data, <int64_t*> argmax.data)
+    return label, argmax
+
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+def anchor_target(anchor, gt_bbox, float neg_thr, float pos_thr, float min_pos_thr,
+                  int num_sample, double fg_fraction, uint32_t seed):
+    """
+    label, subsample and encode the regression targets of the anchors of an image
+    :param anchor: [n, 4] anchors
+    :param gt_bbox: [k, 4] gt boxes
+    :param num_sample: number of anchors kept, at most fg_fraction of them fg
+    :param seed: seed of the subsampling
+    :return: float32 label [n], reg_target [n, 4] and reg_weight [n, 4]
+    """
+    cdef np.ndarray[np.float64_t, ndim=2] c_anchor = np.ascontiguousarray(anchor, dtype=np.float64)
+    cdef np.ndarray[np.float32_t, ndim=2] c_gt_bbox = np.ascontiguousarray(gt_bbox[:, :4], dtype=np.float32)
+    cdef int num_anchor = c_anchor.shape[0]
+    cdef int num_gt = c_gt_bbox.shape[0]
+    cdef np.ndarray[np.float32_t, ndim=1] label = np.empty((num_anchor, ), dtype=np.float32)
+    cdef np.ndarray[np.float32_t, ndim=2] reg_target = np.zeros((num_anchor, 4), dtype=np.float32)
+    cdef np.ndarray[np.float32_t, ndim=2] reg_weight = np.zeros((num_anchor, 4), dtype=np.float32)
+
+    with nogil:
+        _anchor_target(<const double*> c_anchor.data, num_anchor,
+                       <const float*> c_gt_bbox.data, num_gt, neg_thr, pos_thr, min_pos_thr,
+                       num_sample, fg_fraction, seed, <float*> label.data,
+                       <float*> reg_target.data, <float*> reg_weight.data)
+    return label, reg_target, reg_weight
@@ -0,0 +1,313 @@
+// ------------------------------------------------------------------
+// CPU kernel of the RPN anchor targets of AnchorTarget2D: overlaps, label
+// assignment, fg/bg subsampling and regression targets of one image in a
+// single pass, called from python with the GIL released so that the loader
+// threads run it side by side.
+//
+// Only the anchors near a gt box can overlap it, so the anchors are
+// bucketed on a grid and each gt is matched against the few cells around
+// it instead of against all of the anchors of the image.
+// ------------------------------------------------------------------
+
+#include "anchor_target.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+// anchors up to 2^kMaxLevel pixels wide, larger ones share the last level
+const int kMaxLevel = 24;
+// with this few gts a scan of all the anchors is cheaper than the grid
+const int kMaxScanGt = 4;
+
+// Anchors of one size class, bucketed by center on a grid whose cell is half
+// the size of the largest anchor of the class.
+struct GridLevel {
+  double half_w = 0, half_h = 0;  // largest half width and height
+  double cell = 0, inv_cell = 0;
+  double x0 = 0, y0 = 0;          // lowest anchor center, the grid corner
+  int nx = 0, ny = 0;
+  std::vector<int> start;         // nx * ny + 1 offsets into index
+  std::vector<int> index;         // anchors sorted by cell
+};
+
+class AnchorGrid {
+ public:
+  // boxes are the [n, 4] float anchors
+  AnchorGrid(const float* boxes, int n) {
+    std::vector<int> level_of(n, -1);
+    int level_size[kMaxLevel + 1] = {0};
+    for (int i = 0; i < n; ++i) {
+      const float* b = boxes + i * 4;
+      const float w = b[2] - b[0] + 1;
+      const float h = b[3] - b[1] + 1;
+      // a box of no width or height overlaps nothing, as in bbox_overlaps
+      if (!(w > 0 && h > 0)) {
+        continue;
+      }
+      level_of[i] = std::min(std::max(std::ilogb(std::max(w, h)), 0), kMaxLevel);
+      ++level_size[level_of[i]];
+    }
+    std::vector<int> members;
+    for (int level = 0; level <= kMaxLevel; ++level) {
+      if (level_size[level] == 0) {
+        continue;
+      }
+      members.clear();
+      members.reserve(level_size[level]);
+      for (int i = 0; i < n; ++i) {
+        if (level_of[i] == level) {
+          members.push_back(i);
+        }
+      }
+      levels_.emplace_back();
+      Build(boxes, members, &levels_.back());
+    }
+  }
+
+  // calls f(i) once for every anchor i whose box may overlap gt
+  template <typename F>
+  void ForEachNear(const float* gt, F f) const {
+    for (const GridLevel& l : levels_) {
+      // an anchor overlapping gt has its center within half its size of gt,
+      // widened by the +1 of the overlap and a pixel for rounding
+      const int ix0 = CellOf(gt[0] - l.half_w - 2, l.x0, l.inv_cell, l.nx);
+      const int ix1 = CellOf(gt[2] + l.half_w + 2, l.x0, l.inv_cell, l.nx);
+      const int iy0 = CellOf(gt[1] - l.half_h - 2, l.y0, l.inv_cell, l.ny);
+      const int iy1 = CellOf(gt[3] + l.half_h + 2, l.y0, l.inv_cell, l.ny);
+      for (int iy = iy0; iy <= iy1; ++iy) {
+        for (int ix = ix0; ix <= ix1; ++ix) {
+          const int cell = iy * l.nx + ix;
+          for (int k = l.start[cell]; k < l.start[cell + 1]; ++k) {
+            f(l.index[k]);
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  static int CellOf(double v, double origin, double inv_cell, int n) {
+    const double c = (v - origin) * inv_cell;
+    return c <= 0 ? 0 : std::min(static_cast<int>(c), n - 1);
+  }
+
+  static void Build(const float* boxes, const std::vector<int>& members, GridLevel* l) {
+    double x_min = HUGE_VAL, x_max = -HUGE_VAL, y_min = HUGE_VAL, y_max = -HUGE_VAL;
+    for (int i : members) {
+      const float* b = boxes + i * 4;
+      const double cx = 0.5 * (static_cast<double>(b[0]) + b[2]);
+      const double cy = 0.5 * (static_cast<double>(b[1]) + b[3]);
+      l->half_w = std::max(l->half_w, 0.5 * (static_cast<double>(b[2]) - b[0] + 1));
+      l->half_h = std::max(l->half_h, 0.5 * (static_cast<double>(b[3]) - b[1] + 1));
+      x_min = std::min(x_min, cx);
+      x_max = std::max(x_max, cx);
+      y_min = std::min(y_min, cy);
+      y_max = std::max(y_max, cy);
+    }
+    // no fewer than a few anchors per cell on average, so that far apart
+    // anchors do not blow up the grid
+    const size_t max_cells = 4 * members.size() + 64;
+    l->cell = std::max(l->half_w, l->half_h);
+    for (;;) {
+      l->nx = static_cast<int>((x_max - x_min) / l->cell) + 1;
+      l->ny = static_cast<int>((y_max - y_min) / l->cell) + 1;
+      if (static_cast<size_t>(l->nx) * l->ny <= max_cells) {
+        break;
+      }
+      l->cell *= 2;
+    }
+    l->inv_cell = 1 / l->cell;
+    l->x0 = x_min;
+    l->y0 = y_min;
+
+    const int num_cells = l->nx * l->ny;
+    std::vector<int> cell_of(members.size());
+    l->start.assign(num_cells + 1, 0);
+    for (size_t k = 0; k < members.size(); ++k) {
+      const float* b = boxes + members[k] * 4;
+      const int ix = CellOf(0.5 * (static_cast<double>(b[0]) + b[2]), l->x0, l->inv_cell, l->nx);
+      const int iy = CellOf(0.5 * (static_cast<double>(b[1]) + b[3]), l->y0, l->inv_cell, l->ny);
+      cell_of[k] = iy * l->nx + ix;
+      ++l->start[cell_of[k] + 1];
+    }
+    for (int c = 0; c < num_cells; ++c) {
+      l->start[c + 1] += l->start[c];
+    }
+    std::vector<int> fill(l->start.begin(), l->start.end() - 1);
+    l->index.resize(members.size());
+    for (size_t k = 0; k < members.size(); ++k) {
+      l->index[fill[cell_of[k]]++] = members[k];
+    }
+  }
+
+  std::vector<GridLevel> levels_;
+};
+
+// area of a box as bbox_overlaps_cython computes it
+inline float box_area(const float* b) {
+  return static_cast<float>((static_cast<double>(b[2] - b[0]) + 1.0) *
+                            (static_cast<double>(b[3] - b[1]) + 1.0));
+}
+
+// overlap of an anchor and a gt box, 0 if they do not intersect. This is
+// the arithmetic of bbox_overlaps_cython as cython compiles it, so that ties
+// and thresholds come out the same: its + 1 is a double literal, so the
+// sides, areas and union are computed in double and rounded to float as
+// they are stored.
+inline float overlap(const float* a, const float* g, float g_area) {
+  const float iw = static_cast<float>(
+      static_cast<double>(std::min(a[2], g[2]) - std::max(a[0], g[0])) + 1.0);
+  if (!(iw > 0)) {
+    return 0;
+  }
+  const float ih = static_cast<float>(
+      static_cast<double>(std::min(a[3], g[3]) - std::max(a[1], g[1])) + 1.0);
+  if (!(ih > 0)) {
+    return 0;
+  }
+  const float inter = iw * ih;
+  const float ua = static_cast<float>(
+      (static_cast<double>(a[2] - a[0]) + 1.0) * (static_cast<double>(a[3] - a[1]) + 1.0) +
+      g_area - inter);
+  return inter / ua;
+}
+
+// disables all but keep of the anchors of label value, picked uniformly at
+// random, as np.random.choice without replacement does
+void subsample(float* label, int num_anchors, float value, int keep, std::mt19937* rng) {
+  std::vector<int> inds;
+  for (int i = 0; i < num_anchors; ++i) {
+    if (label[i] == value) {
+      inds.push_back(i);
+    }
+  }
+  const int num_disable = static_cast<int>(inds.size()) - std::max(keep, 0);
+  // partial Fisher-Yates, the first num_disable picks are disabled
+  for (int k = 0; k < num_disable; ++k) {
+    std::uniform_int_distribution<int> pick(k, static_cast<int>(inds.size()) - 1);
+    std::swap(inds[k], inds[pick(*rng)]);
+    label[inds[k]] = -1;
+  }
+}
+
+// nonlinear_transform of an anchor to its gt: the anchor is float64 and the
+// gt float32 in AnchorTarget2D, so the gt sizes and centers are float
+void encode(const double* a, const float* g, float* target) {
+  const double ex_w = a[2] - a[0] + 1.0;
+  const double ex_h = a[3] - a[1] + 1.0;
+  const double ex_ctr_x = a[0] + 0.5 * (ex_w - 1.0);
+  const double ex_ctr_y = a[1] + 0.5 * (ex_h - 1.0);
+  const float gt_w = g[2] - g[0] + 1.0f;
+  const float gt_h = g[3] - g[1] + 1.0f;
+  const float gt_ctr_x = g[0] + 0.5f * (gt_w - 1.0f);
+  const float gt_ctr_y = g[1] + 0.5f * (gt_h - 1.0f);
+  target[0] = static_cast<float>((gt_ctr_x - ex_ctr_x) / (ex_w + 1e-14));
+  target[1] = static_cast<float>((gt_ctr_y - ex_ctr_y) / (ex_h + 1e-14));
+  target[2] = static_cast<float>(std::log(gt_w / ex_w));
+  target[3] = static_cast<float>(std::log(gt_h / ex_h));
+}
+
+}  // namespace
+
+void _assign_anchor_label(const double* anchors, int num_anchors,
+                          const float* gt_bbox, int num_gt, float neg_thr,
+                          float pos_thr, float min_pos_thr, float* label,
+                          int64_t* argmax) {
+  std::fill(argmax, argmax + num_anchors, 0);
+  if (num_gt == 0) {
+    std::fill(label, label + num_anchors, 0.f);
+    return;
+  }
+
+  std::vector<float> boxes(anchors, anchors + num_anchors * 4);
+  std::unique_ptr<AnchorGrid> grid;
+  if (num_gt > kMaxScanGt) {
+    grid.reset(new AnchorGrid(boxes.data(), num_anchors));
+  }
+
+  // the nonzero overlaps of every gt, in gt order
+  std::vector<int> pair_start(num_gt + 1, 0);
+  std::vector<int> pair_anchor;
+  std::vector<float> pair_overlap;
+  std::vector<float> max_overlap(num_anchors, 0.f);
+  std::vector<float> gt_max_overlap(num_gt, 0.f);
+  for (int k = 0; k < num_gt; ++k) {
+    const float* g = gt_bbox + k * 4;
+    const float g_area = box_area(g);
+    auto match = [&](int i) {
+      const float o = overlap(&boxes[i * 4], g, g_area);
+      if (o == 0) {
+        return;
+      }
+      pair_anchor.push_back(i);
+      pair_overlap.push_back(o);
+      // strictly greater keeps the first gt on ties, as argmax does
+      if (o > max_overlap[i]) {
+        max_overlap[i] = o;
+        argmax[i] = k;
+      }
+      gt_max_overlap[k] = std::max(gt_max_overlap[k], o);
+    };
+    if (grid) {
+      grid->ForEachNear(g, match);
+    } else {
+      for (int i = 0; i < num_anchors; ++i) {
+        match(i);
+      }
+    }
+    pair_start[k + 1] = static_cast<int>(pair_anchor.size());
+  }
+
+  for (int i = 0; i < num_anchors; ++i) {
+    label[i] = max_overlap[i] < neg_thr ? 0.f : -1.f;
+  }
+  // for each gt, the anchors with its highest overlap. A gt that overlaps no
+  // anchor has a highest overlap of 0, which every anchor it does not
+  // overlap matches, exactly as in _assign_label_to_anchor.
+  for (int k = 0; k < num_gt; ++k) {
+    if (!(gt_max_overlap[k] >= min_pos_thr)) {
+      continue;
+    }
+    if (gt_max_overlap[k] == 0) {
+      std::fill(label, label + num_anchors, 1.f);
+      break;
+    }
+    for (int p = pair_start[k]; p < pair_start[k + 1]; ++p) {
+      if (pair_overlap[p] == gt_max_overlap[k]) {
+        label[pair_anchor[p]] = 1;
+      }
+    }
+  }
+  for (int i = 0; i < num_anchors; ++i) {
+    if (max_overlap[i] >= pos_thr) {
+      label[i] = 1;
+    }
+  }
+}
+
+void _anchor_target(const double* anchors, int num_anchors,
+                    const float* gt_bbox, int num_gt, float neg_thr,
+                    float pos_thr, float min_pos_thr, int num_sample,
+                    double fg_fraction, uint32_t seed, float* label,
+                    float* reg_target, float* reg_weight) {
+  std::vector<int64_t> argmax(num_anchors);
+  _assign_anchor_label(anchors, num_anchors, gt_bbox, num_gt, neg_thr, pos_thr,
+                       min_pos_thr, label, argmax.data());
+
+  std::mt19937 rng(seed);
+  subsample(label, num_anchors, 1, static_cast<int>(fg_fraction * num_sample), &rng);
+  const int num_fg = static_cast<int>(std::count(label, label + num_anchors, 1.f));
+  subsample(label, num_anchors, 0, num_sample - num_fg, &rng);
+
+  for (int i = 0; i < num_anchors; ++i) {
+    if (label[i] == 1) {
+      encode(anchors + i * 4, gt_bbox + argmax[i] * 4, reg_target + i * 4);
+      std::fill(reg_weight + i * 4, reg_weight + i * 4 + 4, 1.f);
+    }
+  }
+}
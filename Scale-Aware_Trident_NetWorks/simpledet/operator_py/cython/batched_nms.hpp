@@ -0,0 +1,11 @@
+// Per-group NMS run on a pool of native threads. Each group is an array of
+// [n, 5] (x1, y1, x2, y2, score) float dets; method is one of
+//   0 soft-nms hard, 1 soft-nms linear, 2 soft-nms gaussian (as soft_nms),
+//   3 greedy nms (as operator_py.nms.nms), 4 box voting (as py_weighted_nms).
+// For box voting thresh is the keep overlap and vote_thresh the vote overlap.
+// The kept dets of group g are written row-major to out[g].
+#include <vector>
+
+void _batched_nms(const float* const* dets, const int* num_dets, int num_groups,
+                  int method, float thresh, float sigma, float score_thresh,
+                  float vote_thresh, int num_threads, std::vector<float>* out);
@@ -0,0 +1,60 @@
+cimport cython
+import numpy as np
+cimport numpy as np
+from libc.string cimport memcpy
+from libcpp.vector cimport vector
+
+np.import_array()
+
+cdef extern from "batched_nms.hpp":
+    void _batched_nms(const float**, const int*, int, int, float, float, float,
+                      float, int, vector[float]*) nogil
+
+METHODS = {'hard': 0, 'linear': 1, 'gaussian': 2, 'greedy': 3, 'vote': 4}
+
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+def batched_nms(list dets, method='greedy', float thresh=0.5, float sigma=0.5,
+                float score_thresh=0.001, float vote_thresh=0.8, int num_threads=0):
+    """
+    run nms on every [n, 5] (x1, y1, x2, y2, score) array of dets in one call
+    :param dets: list of float32 dets, one array per image and class
+    :param method: 'hard', 'linear' or 'gaussian' soft-nms, 'greedy' nms, or 'vote'
+    :param thresh: suppression overlap; for 'vote' the overlap boxes are kept below
+    :param sigma: gaussian soft-nms decay
+    :param score_thresh: soft-nms drops boxes whose decayed score falls below it
+    :param vote_thresh: 'vote' averages the boxes overlapping a kept box above it
+    :param num_threads: size of the thread pool, 0 for one thread per core
+    :return: list of kept float32 dets in the order of dets
+    """
+    assert method in METHODS, 'Unknown nms method: {}'.format(method)
+    cdef int num_groups = len(dets)
+    cdef int c_method = METHODS[method]
+    cdef vector[const float*] ptrs
+    cdef vector[int] sizes
+    cdef vector[vector[float]] out
+    cdef np.ndarray[np.float32_t, ndim=2] det
+
+    # keep the contiguous copies alive until the kernel returns
+    dets = [np.ascontiguousarray(d, dtype=np.float32) for d in dets]
+    for det in dets:
+        if det.shape[1] != 5:
+            raise ValueError('dets should be [n, 5], got {}'.format((det.shape[0], det.shape[1])))
+        ptrs.push_back(<const float*> np.PyArray_DATA(det))
+        sizes.push_back(det.shape[0])
+    out.resize(num_groups)
+
+    with nogil:
+        _batched_nms(ptrs.data(), sizes.data(), num_groups, c_method, thresh,
+                     sigma, score_thresh, vote_thresh, num_threads, out.data())
+
+    cdef int g
+    cdef np.ndarray[np.float32_t, ndim=2] kept
+    results = []
+    for g in range(num_groups):
+        kept = np.empty((out[g].size() // 5, 5), dtype=np.float32)
+        if out[g].size() > 0:
+            memcpy(np.PyArray_DATA(kept), out[g].data(), out[g].size() * sizeof(float))
+        results.append(kept)
+    return results
@@ -0,0 +1,196 @@
+// ------------------------------------------------------------------
+// CPU kernels of soft-nms, greedy nms and box voting nms, batched over
+// groups (e.g. the classes of every image of an evaluation split) so that
+// a single call from python covers all of them with the GIL released.
+// ------------------------------------------------------------------
+
+#include "batched_nms.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+namespace {
+
+const int kBoxDim = 5;
+
+inline float area(const float* a) {
+  return (a[2] - a[0] + 1) * (a[3] - a[1] + 1);
+}
+
+inline float iou(const float* a, const float* b, float area_a, float area_b) {
+  float w = std::max(0.f, std::min(a[2], b[2]) - std::max(a[0], b[0]) + 1);
+  float h = std::max(0.f, std::min(a[3], b[3]) - std::max(a[1], b[1]) + 1);
+  float inter = w * h;
+  return inter / (area_a + area_b - inter);
+}
+
+// soft_nms in cpu_nms.pyx computes areas with the double literal 1.0 that
+// cython emits for its + 1, so an area is exact until it is rounded to float
+inline double soft_area(const float* a) {
+  return (static_cast<double>(a[2] - a[0]) + 1.0) * (static_cast<double>(a[3] - a[1]) + 1.0);
+}
+
+// indices of dets ordered by decreasing score
+std::vector<int> score_order(const float* dets, int n) {
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [dets](int i, int j) {
+    return dets[i * kBoxDim + 4] > dets[j * kBoxDim + 4];
+  });
+  return order;
+}
+
+// Same selection, decay and discard order as soft_nms in cpu_nms.pyx, so
+// that the two agree box for box.
+void soft_nms(const float* dets, int n, int method, float thresh, float sigma,
+              float score_thresh, std::vector<float>* out) {
+  std::vector<float> boxes(dets, dets + n * kBoxDim);
+  int N = n;
+  for (int i = 0; i < N; ++i) {
+    int maxpos = i;
+    for (int pos = i + 1; pos < N; ++pos) {
+      if (boxes[maxpos * kBoxDim + 4] < boxes[pos * kBoxDim + 4]) {
+        maxpos = pos;
+      }
+    }
+    std::swap_ranges(&boxes[i * kBoxDim], &boxes[(i + 1) * kBoxDim],
+                     &boxes[maxpos * kBoxDim]);
+
+    const float* t = &boxes[i * kBoxDim];
+    const double t_area = soft_area(t);
+    for (int pos = i + 1; pos < N; ++pos) {
+      float* b = &boxes[pos * kBoxDim];
+      float iw = std::min(t[2], b[2]) - std::max(t[0], b[0]) + 1;
+      if (iw <= 0) continue;
+      float ih = std::min(t[3], b[3]) - std::max(t[1], b[1]) + 1;
+      if (ih <= 0) continue;
+      const float b_area = static_cast<float>(soft_area(b));
+      const float ua = static_cast<float>(t_area + b_area - iw * ih);
+      float ov = iw * ih / ua;
+
+      float weight;
+      if (method == 1) {
+        weight = ov > thresh ? 1 - ov : 1;
+      } else if (method == 2) {
+        float e = -(ov * ov) / sigma;
+        weight = static_cast<float>(std::exp(static_cast<double>(e)));
+      } else {
+        weight = ov > thresh ? 0 : 1;
+      }
+      b[4] *= weight;
+
+      // discard the box by moving the last one into its slot
+      if (b[4] < score_thresh) {
+        std::copy(&boxes[(N - 1) * kBoxDim], &boxes[N * kBoxDim], b);
+        --N;
+        --pos;
+      }
+    }
+  }
+  out->assign(boxes.begin(), boxes.begin() + N * kBoxDim);
+}
+
+// Keeps a box unless it overlaps a kept box by more than thresh.
+void greedy_nms(const float* dets, int n, float thresh,
+                std::vector<float>* out) {
+  std::vector<int> order = score_order(dets, n);
+  std::vector<float> areas(n);
+  for (int i = 0; i < n; ++i) areas[i] = area(dets + i * kBoxDim);
+  std::vector<char> suppressed(n, 0);
+
+  out->clear();
+  for (int _i = 0; _i < n; ++_i) {
+    int i = order[_i];
+    if (suppressed[i]) continue;
+    const float* a = dets + i * kBoxDim;
+    out->insert(out->end(), a, a + kBoxDim);
+    for (int _j = _i + 1; _j < n; ++_j) {
+      int j = order[_j];
+      if (suppressed[j]) continue;
+      if (iou(a, dets + j * kBoxDim, areas[i], areas[j]) > thresh) {
+        suppressed[j] = 1;
+      }
+    }
+  }
+}
+
+// Each remaining top box is replaced by the score weighted average of the
+// boxes overlapping it by more than vote_thresh, and the boxes overlapping
+// it by more than thresh are removed.
+void vote_nms(const float* dets, int n, float thresh, float vote_thresh,
+              std::vector<float>* out) {
+  std::vector<int> order = score_order(dets, n);
+  std::vector<float> areas(n);
+  for (int i = 0; i < n; ++i) areas[i] = area(dets + i * kBoxDim);
+
+  out->clear();
+  std::vector<int> rest;
+  rest.reserve(n);
+  while (!order.empty()) {
+    int i = order[0];
+    const float* a = dets + i * kBoxDim;
+    float acc[4] = {0, 0, 0, 0};
+    float score_sum = 0;
+    bool has_voter = false;
+    rest.clear();
+    for (int j : order) {
+      const float* b = dets + j * kBoxDim;
+      float ovr = iou(a, b, areas[i], areas[j]);
+      if (ovr <= thresh) rest.push_back(j);
+      if (ovr > vote_thresh) {
+        has_voter = true;
+        score_sum += b[4];
+        for (int k = 0; k < 4; ++k) acc[k] += b[4] * b[k];
+      }
+    }
+    if (!has_voter) break;
+    for (int k = 0; k < 4; ++k) out->push_back(acc[k] / score_sum);
+    out->push_back(a[4]);
+    order.swap(rest);
+  }
+}
+
+}  // namespace
+
+void _batched_nms(const float* const* dets, const int* num_dets, int num_groups,
+                  int method, float thresh, float sigma, float score_thresh,
+                  float vote_thresh, int num_threads, std::vector<float>* out) {
+  // the cost of a group is quadratic in its size, so hand out the largest
+  // groups first to keep the tail of the pool short
+  std::vector<int> groups(num_groups);
+  std::iota(groups.begin(), groups.end(), 0);
+  std::stable_sort(groups.begin(), groups.end(), [num_dets](int a, int b) {
+    return num_dets[a] > num_dets[b];
+  });
+
+  std::atomic<int> next(0);
+  auto worker = [&]() {
+    for (int k = next++; k < num_groups; k = next++) {
+      int g = groups[k];
+      if (method == 3) {
+        greedy_nms(dets[g], num_dets[g], thresh, &out[g]);
+      } else if (method == 4) {
+        vote_nms(dets[g], num_dets[g], thresh, vote_thresh, &out[g]);
+      } else {
+        soft_nms(dets[g], num_dets[g], method, thresh, sigma, score_thresh,
+                 &out[g]);
+      }
+    }
+  };
+
+  if (num_threads <= 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_threads = std::min(num_threads, num_groups);
+  std::vector<std::thread> pool;
+  for (int t = 1; t < num_threads; ++t) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& t : pool) {
+    t.join();
+  }
+}
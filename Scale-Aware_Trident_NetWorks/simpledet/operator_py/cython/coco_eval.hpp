@@ -0,0 +1,51 @@
+// Per image evaluation and accumulation of pycocotools COCOeval for the bbox
+// and segm iou types, with its numerics, run on a pool of native threads.
+//
+// The annotations are grouped by (category, image) as COCOeval.evaluateImg
+// sees them, group g = k * num_images + i holding [offset[g], offset[g + 1]).
+// bbox are (x, y, w, h). For segm every annotation also has a compressed RLE
+// string, as COCO.annToRLE gives it, at [rle_offset[j], rle_offset[j + 1])
+// of rle_counts and its (h, w) in rle_size.
+//
+// _coco_evaluate runs evaluateImg on every (group, area range) for the dets
+// of the group sorted by score and cut to max_det. The dets of group g are
+// written at [det_offset[g], det_offset[g + 1]) of dt_score and of every
+// [num_area_rng, num_iou_thrs, num_dets] row of dt_matched and dt_ignore.
+// npig[a * num_groups + g] is the number of gt of g not ignored at area range a.
+//
+// _coco_accumulate is COCOeval.accumulate over these, for the evaluated
+// (category, area range, image) indices k_list, a_list and i_list and the
+// max dets max_dets. precision and scores are [T, R, K, A, M], recall is
+// [T, K, A, M], with K, A and M the sizes of the lists, left untouched
+// where COCOeval leaves -1.
+#include <cstdint>
+
+struct CocoAnns {
+  const int64_t* offset;
+  const double* bbox;
+  const double* area;
+  const double* score;      // dt only
+  const uint8_t* iscrowd;   // gt only
+  const uint8_t* ignore;    // gt only
+  const int64_t* id;
+  const int64_t* rle_offset;  // segm only, nullptr for bbox
+  const char* rle_counts;
+  const int32_t* rle_size;
+};
+
+void _coco_evaluate(const CocoAnns& gt, const CocoAnns& dt, int num_groups,
+                    const double* iou_thrs, int num_iou_thrs,
+                    const double* area_rng, int num_area_rng, int max_det,
+                    const int64_t* det_offset, double* dt_score,
+                    uint8_t* dt_matched, uint8_t* dt_ignore, int64_t* npig,
+                    int num_threads);
+
+void _coco_accumulate(const int64_t* gt_offset, const int64_t* dt_offset,
+                      const int64_t* det_offset, const double* dt_score,
+                      const uint8_t* dt_matched, const uint8_t* dt_ignore,
+                      const int64_t* npig, int num_groups, int num_images,
+                      int num_iou_thrs, const double* rec_thrs, int num_rec_thrs,
+                      const int* k_list, int num_k, const int* a_list, int num_a,
+                      const int* i_list, int num_i, const int* max_dets, int num_m,
+                      double* precision, double* recall, double* scores,
+                      int num_threads);
@@ -0,0 +1,165 @@
+cimport cython
+import numpy as np
+cimport numpy as np
+from libc.stdint cimport int64_t, uint8_t, int32_t
+
+np.import_array()
+
+cdef extern from "coco_eval.hpp":
+    cdef struct CocoAnns:
+        const int64_t* offset
+        const double* bbox
+        const double* area
+        const double* score
+        const uint8_t* iscrowd
+        const uint8_t* ignore
+        const int64_t* id
+        const int64_t* rle_offset
+        const char* rle_counts
+        const int32_t* rle_size
+
+    void _coco_evaluate(const CocoAnns&, const CocoAnns&, int, const double*, int,
+                        const double*, int, int, const int64_t*, double*, uint8_t*,
+                        uint8_t*, int64_t*, int) nogil
+
+    void _coco_accumulate(const int64_t*, const int64_t*, const int64_t*, const double*,
+                          const uint8_t*, const uint8_t*, const int64_t*, int, int, int,
+                          const double*, int, const int*, int, const int*, int,
+                          const int*, int, const int*, int, double*, double*, double*,
+                          int) nogil
+
+
+cdef const void* _data(dict arrays, name, dtype, int64_t size):
+    # contiguous array of at least size elements, kept alive by arrays
+    array = np.ascontiguousarray(arrays[name], dtype=dtype)
+    if array.size < size:
+        raise ValueError('{} should have {} elements, got {}'.format(name, size, array.size))
+    arrays[name] = array
+    return np.PyArray_DATA(array)
+
+
+cdef CocoAnns _anns(dict anns, int num_groups, bint is_gt, bint segm) except *:
+    cdef CocoAnns c
+    c.offset = <const int64_t*> _data(anns, 'offset', np.int64, num_groups + 1)
+    cdef int64_t n = c.offset[num_groups]
+    c.bbox = <const double*> _data(anns, 'bbox', np.float64, 4 * n)
+    c.area = <const double*> _data(anns, 'area', np.float64, n)
+    c.id = <const int64_t*> _data(anns, 'id', np.int64, n)
+    c.score = NULL
+    c.iscrowd = NULL
+    c.ignore = NULL
+    if is_gt:
+        c.iscrowd = <const uint8_t*> _data(anns, 'iscrowd', np.uint8, n)
+        c.ignore = <const uint8_t*> _data(anns, 'ignore', np.uint8, n)
+    else:
+        c.score = <const double*> _data(anns, 'score', np.float64, n)
+    c.rle_offset = NULL
+    c.rle_counts = NULL
+    c.rle_size = NULL
+    if segm:
+        c.rle_offset = <const int64_t*> _data(anns, 'rle_offset', np.int64, n + 1)
+        c.rle_counts = <const char*> _data(anns, 'rle_counts', np.uint8, c.rle_offset[n])
+        c.rle_size = <const int32_t*> _data(anns, 'rle_size', np.int32, 2 * n)
+    return c
+
+
+def evaluate_images(dict gt, dict dt, int num_groups, iou_thrs, area_rng, int max_det,
+                    bint segm=False, int num_threads=0):
+    """
+    COCOeval.evaluateImg of every (category, image) group and area range
+    :param gt: dict of the gt arrays of coco_eval.hpp, offset, bbox, area, iscrowd,
+               ignore, id and for segm rle_offset, rle_counts and rle_size
+    :param dt: dict of the dt arrays, as gt with score in place of iscrowd and ignore
+    :param num_groups: number of (category, image) groups
+    :param iou_thrs: [T] iou thresholds
+    :param area_rng: [A, 2] area ranges
+    :param max_det: dets kept per group, the last of maxDets
+    :param segm: compare the rles of the annotations instead of their bbox
+    :param num_threads: size of the thread pool, 0 for one thread per core
+    :return: dict of det_offset, dt_score, dt_matched, dt_ignore and npig
+    """
+    gt = dict(gt)
+    dt = dict(dt)
+    cdef CocoAnns c_gt = _anns(gt, num_groups, True, segm)
+    cdef CocoAnns c_dt = _anns(dt, num_groups, False, segm)
+    cdef np.ndarray[np.float64_t, ndim=1] c_iou_thrs = np.ascontiguousarray(iou_thrs, dtype=np.float64)
+    cdef np.ndarray[np.float64_t, ndim=2] c_area_rng = np.ascontiguousarray(area_rng, dtype=np.float64).reshape(-1, 2)
+    cdef int T = c_iou_thrs.shape[0]
+    cdef int A = c_area_rng.shape[0]
+
+    cdef np.ndarray[np.int64_t, ndim=1] det_offset = np.zeros(num_groups + 1, dtype=np.int64)
+    np.cumsum(np.minimum(np.diff(dt['offset'][:num_groups + 1]), max_det), out=det_offset[1:])
+    cdef int64_t total = det_offset[num_groups]
+    cdef np.ndarray[np.float64_t, ndim=1] dt_score = np.zeros(total, dtype=np.float64)
+    cdef np.ndarray[np.uint8_t, ndim=3] dt_matched = np.zeros((A, T, total), dtype=np.uint8)
+    cdef np.ndarray[np.uint8_t, ndim=3] dt_ignore = np.zeros((A, T, total), dtype=np.uint8)
+    cdef np.ndarray[np.int64_t, ndim=2] npig = np.zeros((A, num_groups), dtype=np.int64)
+
+    with nogil:
+        _coco_evaluate(c_gt, c_dt, num_groups, <const double*> c_iou_thrs.data, T,
+                       <const double*> c_area_rng.data, A, max_det,
+                       <const int64_t*> det_offset.data, <double*> dt_score.data,
+                       <uint8_t*> dt_matched.data, <uint8_t*> dt_ignore.data,
+                       <int64_t*> npig.data, num_threads)
+
+    return {'det_offset': det_offset, 'dt_score': dt_score, 'dt_matched': dt_matched,
+            'dt_ignore': dt_ignore, 'npig': npig}
+
+
+def accumulate_images(gt_offset, dt_offset, dict evaluated, int num_images, rec_thrs,
+                      k_list, a_list, i_list, max_dets, int num_threads=0):
+    """
+    COCOeval.accumulate of the per image evaluation of evaluate_images
+    :param gt_offset: [num_groups + 1] gt offset of the groups
+    :param dt_offset: [num_groups + 1] dt offset of the groups, before max_det
+    :param evaluated: dict returned by evaluate_images
+    :param num_images: number of evaluated images, a group is k * num_images + i
+    :param rec_thrs: [R] recall thresholds
+    :param k_list: evaluated category of every output category
+    :param a_list: evaluated area range of every output area range
+    :param i_list: evaluated images
+    :param max_dets: [M] max dets
+    :param num_threads: size of the thread pool, 0 for one thread per core
+    :return: precision [T, R, K, A, M], recall [T, K, A, M] and scores [T, R, K, A, M]
+    """
+    cdef np.ndarray[np.int64_t, ndim=1] c_gt_offset = np.ascontiguousarray(gt_offset, dtype=np.int64)
+    cdef np.ndarray[np.int64_t, ndim=1] c_dt_offset = np.ascontiguousarray(dt_offset, dtype=np.int64)
+    cdef np.ndarray[np.int64_t, ndim=1] det_offset = evaluated['det_offset']
+    cdef np.ndarray[np.float64_t, ndim=1] dt_score = evaluated['dt_score']
+    cdef np.ndarray[np.uint8_t, ndim=3] dt_matched = evaluated['dt_matched']
+    cdef np.ndarray[np.uint8_t, ndim=3] dt_ignore = evaluated['dt_ignore']
+    cdef np.ndarray[np.int64_t, ndim=2] npig = evaluated['npig']
+    cdef np.ndarray[np.float64_t, ndim=1] c_rec_thrs = np.ascontiguousarray(rec_thrs, dtype=np.float64)
+    cdef np.ndarray[np.int32_t, ndim=1] c_k_list = np.ascontiguousarray(k_list, dtype=np.int32)
+    cdef np.ndarray[np.int32_t, ndim=1] c_a_list = np.ascontiguousarray(a_list, dtype=np.int32)
+    cdef np.ndarray[np.int32_t, ndim=1] c_i_list = np.ascontiguousarray(i_list, dtype=np.int32)
+    cdef np.ndarray[np.int32_t, ndim=1] c_max_dets = np.ascontiguousarray(max_dets, dtype=np.int32)
+    cdef int num_groups = det_offset.shape[0] - 1
+    cdef int A0 = npig.shape[0]
+    cdef int T = dt_matched.shape[1]
+    cdef int R = c_rec_thrs.shape[0]
+    cdef int K = c_k_list.shape[0]
+    cdef int A = c_a_list.shape[0]
+    cdef int M = c_max_dets.shape[0]
+    if c_gt_offset.shape[0] != num_groups + 1 or c_dt_offset.shape[0] != num_groups + 1:
+        raise ValueError('gt_offset and dt_offset should have {} elements'.format(num_groups + 1))
+    if (K and c_k_list.max() * num_images >= num_groups) or (A and c_a_list.max() >= A0) or \
+            (c_i_list.shape[0] and c_i_list.max() >= num_images):
+        raise ValueError('k_list, a_list or i_list out of the evaluated range')
+
+    cdef np.ndarray[np.float64_t, ndim=5] precision = -np.ones((T, R, K, A, M))
+    cdef np.ndarray[np.float64_t, ndim=4] recall = -np.ones((T, K, A, M))
+    cdef np.ndarray[np.float64_t, ndim=5] scores = -np.ones((T, R, K, A, M))
+
+    with nogil:
+        _coco_accumulate(<const int64_t*> c_gt_offset.data, <const int64_t*> c_dt_offset.data,
+                         <const int64_t*> det_offset.data, <const double*> dt_score.data,
+                         <const uint8_t*> dt_matched.data, <const uint8_t*> dt_ignore.data,
+                         <const int64_t*> npig.data, num_groups, num_images, T,
+                         <const double*> c_rec_thrs.data, R, <const int*> c_k_list.data, K,
+                         <const int*> c_a_list.data, A, <const int*> c_i_list.data,
+                         c_i_list.shape[0], <const int*> c_max_dets.data, M,
+                         <double*> precision.data, <double*> recall.data,
+                         <double*> scores.data, num_threads)
+
+    return precision, recall, scores
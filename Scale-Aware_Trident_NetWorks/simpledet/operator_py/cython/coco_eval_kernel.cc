@@ -0,0 +1,432 @@
+// ------------------------------------------------------------------
+// COCOeval.evaluate and accumulate of pycocotools in C++. evaluateImg
+// and accumulate are python loops over (category, area range, image),
+// here every (category, image) group and every (category, area range,
+// max dets) cell is a task of a thread pool. The ious follow bbIou,
+// rleIou and rleFrString of maskApi.c operation for operation, so the
+// precision and recall are those of pycocotools.
+// ------------------------------------------------------------------
+
+#include "coco_eval.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// run task(0) ... task(num_tasks - 1) on num_threads threads, the tasks in
+// order of decreasing cost
+template <typename Task>
+void parallel_for(const std::vector<int64_t>& cost, int num_threads, Task task) {
+  const int num_tasks = static_cast<int>(cost.size());
+  std::vector<int> order(num_tasks);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&cost](int a, int b) {
+    return cost[a] > cost[b];
+  });
+
+  std::atomic<int> next(0);
+  auto worker = [&]() {
+    for (int k = next++; k < num_tasks; k = next++) {
+      task(order[k]);
+    }
+  };
+
+  if (num_threads <= 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_threads = std::max(1, std::min(num_threads, num_tasks));
+  std::vector<std::thread> pool;
+  for (int t = 1; t < num_threads; ++t) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& t : pool) {
+    t.join();
+  }
+}
+
+struct Rle {
+  uint32_t h, w;
+  std::vector<uint32_t> cnts;
+};
+
+// rleFrString of maskApi.c
+void rle_from_string(const char* s, int64_t len, uint32_t h, uint32_t w, Rle* r) {
+  r->h = h;
+  r->w = w;
+  r->cnts.clear();
+  int64_t p = 0;
+  while (p < len && s[p]) {
+    int64_t x = 0;
+    int k = 0;
+    bool more = true;
+    while (more && p < len) {
+      const int64_t c = s[p] - 48;
+      x |= (c & 0x1f) << (5 * k);
+      more = (c & 0x20) != 0;
+      ++p;
+      ++k;
+      if (!more && (c & 0x10)) {
+        x |= static_cast<int64_t>(~0ULL << (5 * k));
+      }
+    }
+    const size_t m = r->cnts.size();
+    if (m > 2) {
+      x += r->cnts[m - 2];
+    }
+    r->cnts.push_back(static_cast<uint32_t>(x));
+  }
+}
+
+// rleToBbox of maskApi.c
+void rle_to_bbox(const Rle& r, double* bb) {
+  const uint32_t h = r.h;
+  const uint32_t w = r.w;
+  const size_t m = r.cnts.size() / 2 * 2;
+  if (m == 0) {
+    bb[0] = bb[1] = bb[2] = bb[3] = 0;
+    return;
+  }
+  uint32_t xs = w, ys = h, xe = 0, ye = 0, cc = 0, xp = 0;
+  for (size_t j = 0; j < m; ++j) {
+    cc += r.cnts[j];
+    const uint32_t t = cc - j % 2;
+    const uint32_t y = t % h;
+    const uint32_t x = (t - y) / h;
+    if (j % 2 == 0) {
+      xp = x;
+    } else if (xp < x) {
+      ys = 0;
+      ye = h - 1;
+    }
+    xs = std::min(xs, x);
+    xe = std::max(xe, x);
+    ys = std::min(ys, y);
+    ye = std::max(ye, y);
+  }
+  bb[0] = xs;
+  bb[2] = xe - xs + 1;
+  bb[1] = ys;
+  bb[3] = ye - ys + 1;
+}
+
+uint32_t rle_area(const Rle& r) {
+  uint32_t a = 0;
+  for (size_t j = 1; j < r.cnts.size(); j += 2) {
+    a += r.cnts[j];
+  }
+  return a;
+}
+
+// bbIou of maskApi.c, o[d * num_gt + g] for the num_dt boxes dt and num_gt
+// boxes gt. The loop over the gt of a det is branch free, so it vectorizes.
+void bbox_iou(const double* dt, int num_dt, const double* gt, int num_gt,
+              const uint8_t* iscrowd, double* o) {
+  std::vector<double> gx1(num_gt), gy1(num_gt), gx2(num_gt), gy2(num_gt), ga(num_gt);
+  for (int g = 0; g < num_gt; ++g) {
+    const double* b = gt + 4 * g;
+    gx1[g] = b[0];
+    gy1[g] = b[1];
+    gx2[g] = b[2] + b[0];
+    gy2[g] = b[3] + b[1];
+    ga[g] = b[2] * b[3];
+  }
+  for (int d = 0; d < num_dt; ++d) {
+    const double* b = dt + 4 * d;
+    const double dx1 = b[0], dy1 = b[1], dx2 = b[2] + b[0], dy2 = b[3] + b[1];
+    const double da = b[2] * b[3];
+    double* od = o + static_cast<int64_t>(d) * num_gt;
+    for (int g = 0; g < num_gt; ++g) {
+      const double w = std::min(dx2, gx2[g]) - std::max(dx1, gx1[g]);
+      const double h = std::min(dy2, gy2[g]) - std::max(dy1, gy1[g]);
+      const double i = w * h;
+      const double u = iscrowd[g] ? da : da + ga[g] - i;
+      od[g] = (w <= 0 || h <= 0) ? 0.0 : i / u;
+    }
+  }
+}
+
+// rleIou of maskApi.c, in the layout of bbox_iou
+void rle_iou(const std::vector<Rle>& dt, const std::vector<Rle>& gt,
+             const uint8_t* iscrowd, double* o) {
+  const int num_dt = static_cast<int>(dt.size());
+  const int num_gt = static_cast<int>(gt.size());
+  std::vector<double> db(4 * num_dt), gb(4 * num_gt);
+  for (int d = 0; d < num_dt; ++d) {
+    rle_to_bbox(dt[d], &db[4 * d]);
+  }
+  for (int g = 0; g < num_gt; ++g) {
+    rle_to_bbox(gt[g], &gb[4 * g]);
+  }
+  bbox_iou(db.data(), num_dt, gb.data(), num_gt, iscrowd, o);
+  for (int d = 0; d < num_dt; ++d) {
+    for (int g = 0; g < num_gt; ++g) {
+      double& out = o[static_cast<int64_t>(d) * num_gt + g];
+      if (!(out > 0)) {
+        continue;
+      }
+      const Rle& a = dt[d];
+      const Rle& b = gt[g];
+      if (a.h != b.h || a.w != b.w) {
+        out = -1;
+        continue;
+      }
+      const size_t ka = a.cnts.size(), kb = b.cnts.size();
+      uint32_t ca = a.cnts[0], cb = b.cnts[0], ct = 1, i = 0, u = 0;
+      size_t ia = 1, ib = 1;
+      bool va = false, vb = false;
+      while (ct > 0) {
+        const uint32_t c = std::min(ca, cb);
+        if (va || vb) {
+          u += c;
+          if (va && vb) {
+            i += c;
+          }
+        }
+        ct = 0;
+        ca -= c;
+        if (!ca && ia < ka) {
+          ca = a.cnts[ia++];
+          va = !va;
+        }
+        ct += ca;
+        cb -= c;
+        if (!cb && ib < kb) {
+          cb = b.cnts[ib++];
+          vb = !vb;
+        }
+        ct += cb;
+      }
+      if (i == 0) {
+        u = 1;
+      } else if (iscrowd[g]) {
+        u = rle_area(a);
+      }
+      out = static_cast<double>(i) / static_cast<double>(u);
+    }
+  }
+}
+
+void decode_rles(const CocoAnns& anns, int64_t begin, const std::vector<int64_t>& index,
+                 std::vector<Rle>* rles) {
+  rles->resize(index.size());
+  for (size_t j = 0; j < index.size(); ++j) {
+    const int64_t a = begin + index[j];
+    const int64_t s = anns.rle_offset[a];
+    rle_from_string(anns.rle_counts + s, anns.rle_offset[a + 1] - s,
+                    anns.rle_size[2 * a], anns.rle_size[2 * a + 1], &(*rles)[j]);
+  }
+}
+
+// evaluateImg of every area range for group g
+void evaluate_group(const CocoAnns& gt, const CocoAnns& dt, int g, int num_groups,
+                    const double* iou_thrs, int num_iou_thrs,
+                    const double* area_rng, int num_area_rng, int max_det,
+                    const int64_t* det_offset, double* dt_score,
+                    uint8_t* dt_matched, uint8_t* dt_ignore, int64_t* npig) {
+  const int64_t gt_begin = gt.offset[g];
+  const int num_gt = static_cast<int>(gt.offset[g + 1] - gt_begin);
+  const int64_t dt_begin = dt.offset[g];
+  const int num_all_dt = static_cast<int>(dt.offset[g + 1] - dt_begin);
+  const int num_dt = std::min(num_all_dt, max_det);
+  const int64_t total_dets = det_offset[num_groups];
+  const int64_t out_begin = det_offset[g];
+
+  // dets by decreasing score, stable as the mergesort of COCOeval
+  std::vector<int64_t> dind(num_all_dt);
+  std::iota(dind.begin(), dind.end(), 0);
+  std::stable_sort(dind.begin(), dind.end(), [&dt, dt_begin](int64_t a, int64_t b) {
+    return dt.score[dt_begin + a] > dt.score[dt_begin + b];
+  });
+  dind.resize(num_dt);
+  for (int d = 0; d < num_dt; ++d) {
+    dt_score[out_begin + d] = dt.score[dt_begin + dind[d]];
+  }
+
+  std::vector<uint8_t> iscrowd(num_gt);
+  for (int j = 0; j < num_gt; ++j) {
+    iscrowd[j] = gt.iscrowd[gt_begin + j];
+  }
+  std::vector<double> ious(static_cast<size_t>(num_dt) * num_gt);
+  if (num_dt > 0 && num_gt > 0) {
+    if (gt.rle_offset != nullptr) {
+      std::vector<int64_t> gind(num_gt);
+      std::iota(gind.begin(), gind.end(), 0);
+      std::vector<Rle> gt_rles, dt_rles;
+      decode_rles(gt, gt_begin, gind, &gt_rles);
+      decode_rles(dt, dt_begin, dind, &dt_rles);
+      rle_iou(dt_rles, gt_rles, iscrowd.data(), ious.data());
+    } else {
+      std::vector<double> boxes(4 * num_dt);
+      for (int d = 0; d < num_dt; ++d) {
+        std::copy_n(dt.bbox + 4 * (dt_begin + dind[d]), 4, &boxes[4 * d]);
+      }
+      bbox_iou(boxes.data(), num_dt, gt.bbox + 4 * gt_begin, num_gt, iscrowd.data(), ious.data());
+    }
+  }
+
+  std::vector<int> gind(num_gt);
+  std::vector<uint8_t> gt_ig(num_gt);
+  std::vector<double> gtm(num_gt);
+  for (int a = 0; a < num_area_rng; ++a) {
+    const double lo = area_rng[2 * a];
+    const double hi = area_rng[2 * a + 1];
+    // gt ignored last, stable as the mergesort of COCOeval
+    std::iota(gind.begin(), gind.end(), 0);
+    auto ignored = [&](int j) {
+      const double area = gt.area[gt_begin + j];
+      return gt.ignore[gt_begin + j] || area < lo || area > hi;
+    };
+    std::stable_partition(gind.begin(), gind.end(), [&](int j) { return !ignored(j); });
+    int64_t count = 0;
+    for (int j = 0; j < num_gt; ++j) {
+      gt_ig[j] = ignored(gind[j]);
+      count += gt_ig[j] == 0;
+    }
+    npig[static_cast<int64_t>(a) * num_groups + g] = count;
+
+    for (int t = 0; t < num_iou_thrs; ++t) {
+      const int64_t row = (static_cast<int64_t>(a) * num_iou_thrs + t) * total_dets + out_begin;
+      std::fill(gtm.begin(), gtm.end(), 0.0);
+      for (int d = 0; d < num_dt; ++d) {
+        const double* iou_d = ious.data() + static_cast<int64_t>(d) * num_gt;
+        double iou = std::min(iou_thrs[t], 1 - 1e-10);
+        int m = -1;
+        for (int j = 0; j < num_gt; ++j) {
+          if (gtm[j] > 0 && !iscrowd[gind[j]]) {
+            continue;
+          }
+          if (m > -1 && gt_ig[m] == 0 && gt_ig[j] == 1) {
+            break;
+          }
+          if (iou_d[gind[j]] < iou) {
+            continue;
+          }
+          iou = iou_d[gind[j]];
+          m = j;
+        }
+        const int64_t di = dt_begin + dind[d];
+        bool matched = false;
+        bool ignore = false;
+        if (m != -1) {
+          ignore = gt_ig[m] != 0;
+          // a match to a gt of id 0 counts as none, as in COCOeval
+          matched = gt.id[gt_begin + gind[m]] != 0;
+          gtm[m] = static_cast<double>(dt.id[di]);
+        }
+        const double area = dt.area[di];
+        dt_matched[row + d] = matched;
+        dt_ignore[row + d] = ignore || (!matched && (area < lo || area > hi));
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void _coco_evaluate(const CocoAnns& gt, const CocoAnns& dt, int num_groups,
+                    const double* iou_thrs, int num_iou_thrs,
+                    const double* area_rng, int num_area_rng, int max_det,
+                    const int64_t* det_offset, double* dt_score,
+                    uint8_t* dt_matched, uint8_t* dt_ignore, int64_t* npig,
+                    int num_threads) {
+  std::vector<int64_t> cost(num_groups);
+  for (int g = 0; g < num_groups; ++g) {
+    cost[g] = (gt.offset[g + 1] - gt.offset[g] + 1) * (det_offset[g + 1] - det_offset[g] + 1);
+  }
+  parallel_for(cost, num_threads, [&](int g) {
+    evaluate_group(gt, dt, g, num_groups, iou_thrs, num_iou_thrs, area_rng,
+                   num_area_rng, max_det, det_offset, dt_score, dt_matched,
+                   dt_ignore, npig);
+  });
+}
+
+void _coco_accumulate(const int64_t* gt_offset, const int64_t* dt_offset,
+                      const int64_t* det_offset, const double* dt_score,
+                      const uint8_t* dt_matched, const uint8_t* dt_ignore,
+                      const int64_t* npig, int num_groups, int num_images,
+                      int num_iou_thrs, const double* rec_thrs, int num_rec_thrs,
+                      const int* k_list, int num_k, const int* a_list, int num_a,
+                      const int* i_list, int num_i, const int* max_dets, int num_m,
+                      double* precision, double* recall, double* scores,
+                      int num_threads) {
+  const int T = num_iou_thrs, R = num_rec_thrs, K = num_k, A = num_a, M = num_m;
+  const int64_t total_dets = det_offset[num_groups];
+  const double eps = std::nextafter(1.0, 2.0) - 1.0;  // np.spacing(1)
+
+  std::vector<int64_t> cost(static_cast<size_t>(K) * A * M, 1);
+  parallel_for(cost, num_threads, [&](int cell) {
+    const int m = cell % M;
+    const int a = cell / M % A;
+    const int k = cell / M / A;
+    const int a0 = a_list[a];
+    const int max_det = max_dets[m];
+
+    // the dets of the evaluated images, [group, index within the group]
+    std::vector<std::pair<int, int>> dets;
+    int64_t num_pos = 0;
+    bool any = false;
+    for (int n = 0; n < num_i; ++n) {
+      const int g = k_list[k] * num_images + i_list[n];
+      if (gt_offset[g + 1] == gt_offset[g] && dt_offset[g + 1] == dt_offset[g]) {
+        continue;
+      }
+      any = true;
+      const int nd = static_cast<int>(std::min<int64_t>(det_offset[g + 1] - det_offset[g], max_det));
+      for (int d = 0; d < nd; ++d) {
+        dets.emplace_back(g, d);
+      }
+      num_pos += npig[static_cast<int64_t>(a0) * num_groups + g];
+    }
+    if (!any || num_pos == 0) {
+      return;
+    }
+    std::stable_sort(dets.begin(), dets.end(), [&](const std::pair<int, int>& x,
+                                                   const std::pair<int, int>& y) {
+      return dt_score[det_offset[x.first] + x.second] > dt_score[det_offset[y.first] + y.second];
+    });
+
+    const int nd = static_cast<int>(dets.size());
+    std::vector<double> rc(nd), pr(nd);
+    for (int t = 0; t < T; ++t) {
+      const int64_t row = (static_cast<int64_t>(a0) * T + t) * total_dets;
+      double tp = 0, fp = 0;
+      for (int d = 0; d < nd; ++d) {
+        const int64_t j = row + det_offset[dets[d].first] + dets[d].second;
+        if (!dt_ignore[j]) {
+          if (dt_matched[j]) {
+            tp += 1;
+          } else {
+            fp += 1;
+          }
+        }
+        rc[d] = tp / static_cast<double>(num_pos);
+        pr[d] = tp / (fp + tp + eps);
+      }
+      const int64_t cell_tkam = ((static_cast<int64_t>(t) * K + k) * A + a) * M + m;
+      recall[cell_tkam] = nd ? rc[nd - 1] : 0;
+
+      for (int d = nd - 1; d > 0; --d) {
+        if (pr[d] > pr[d - 1]) {
+          pr[d - 1] = pr[d];
+        }
+      }
+      for (int r = 0; r < R; ++r) {
+        const int pi = static_cast<int>(std::lower_bound(rc.begin(), rc.end(), rec_thrs[r]) - rc.begin());
+        const int64_t out = (((static_cast<int64_t>(t) * R + r) * K + k) * A + a) * M + m;
+        if (pi < nd) {
+          precision[out] = pr[pi];
+          scores[out] = dt_score[det_offset[dets[pi].first] + dets[pi].second];
+        } else {
+          precision[out] = 0;
+          scores[out] = 0;
+        }
+      }
+    }
+  });
+}
@@ -0,0 +1,49 @@
+// Read-only memory mapping of a columnar roidb file, as written by
+// utils/columnar_roidb.py. All integers are little endian uint64:
+//
+//   magic        8 bytes "SDROIDB1"
+//   num_records
+//   num_columns
+//   columns      num_columns RoidbColumn
+//   data         the C-contiguous data of every column at its offset
+//
+// A column is an array of numpy dtype string dtype (e.g. "<f4") with ndim
+// dimensions of shape, at offset bytes from the start of the file and 64
+// byte aligned. Open checks the header and that every column lies within
+// the file, the meaning of the columns is left to columnar_roidb.pyx.
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct RoidbColumn {
+  char name[48];
+  char dtype[8];
+  uint64_t ndim;
+  uint64_t shape[2];
+  uint64_t offset;
+  uint64_t nbytes;
+};
+
+class MappedRoidb {
+ public:
+  MappedRoidb() : base_(nullptr), size_(0), num_records_(0) {}
+  ~MappedRoidb();
+
+  // false with a message in error if path can not be mapped or is malformed
+  bool Open(const std::string& path, std::string* error);
+
+  uint64_t num_records() const { return num_records_; }
+  uint64_t num_columns() const { return columns_.size(); }
+  const RoidbColumn& column(uint64_t i) const { return columns_[i]; }
+  const void* data(uint64_t i) const { return base_ + columns_[i].offset; }
+
+ private:
+  MappedRoidb(const MappedRoidb&);
+  MappedRoidb& operator=(const MappedRoidb&);
+
+  const char* base_;
+  size_t size_;
+  uint64_t num_records_;
+  std::vector<RoidbColumn> columns_;
+};
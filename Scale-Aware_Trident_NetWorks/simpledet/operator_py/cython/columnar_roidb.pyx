@@ -0,0 +1,153 @@
+cimport cython
+import pickle
+import numpy as np
+cimport numpy as np
+from cpython.buffer cimport PyBuffer_FillInfo
+from libc.stdint cimport uint64_t
+from libcpp cimport bool
+from libcpp.string cimport string
+
+np.import_array()
+
+cdef extern from "columnar_roidb.hpp":
+    cdef struct RoidbColumn:
+        char name[48]
+        char dtype[8]
+        uint64_t ndim
+        uint64_t shape[2]
+        uint64_t offset
+        uint64_t nbytes
+
+    cdef cppclass MappedRoidb:
+        MappedRoidb()
+        bool Open(const string&, string*) nogil
+        uint64_t num_records()
+        uint64_t num_columns()
+        const RoidbColumn& column(uint64_t)
+        const void* data(uint64_t)
+
+
+cdef class _MappedBytes:
+    """
+    read-only buffer over the mapped bytes of a column, the arrays viewing it
+    keep the mapping alive
+    """
+    cdef RoidbFile owner
+    cdef const char* ptr
+    cdef Py_ssize_t size
+
+    def __getbuffer__(self, Py_buffer* buffer, int flags):
+        PyBuffer_FillInfo(buffer, self, <void*> self.ptr, self.size, 1, flags)
+
+
+cdef class RoidbFile:
+    """
+    memory-mapped columnar roidb file, see utils/columnar_roidb.py for the columns
+    columns: dict of column name to a read-only ndarray over the mapping
+    """
+    cdef MappedRoidb* roidb
+    cdef readonly dict columns
+    cdef readonly Py_ssize_t num_records
+    cdef const np.int64_t[:] url_offset
+    cdef const np.int64_t[:] gt_offset
+    cdef const np.int64_t[:] poly_instance
+    cdef const np.uint8_t[:] poly_none
+    cdef const np.int64_t[:] poly_offset
+    cdef const np.int64_t[:] extra_offset
+
+    def __cinit__(self, path):
+        self.roidb = new MappedRoidb()
+        cdef string c_path = path.encode("utf-8")
+        cdef string error
+        cdef bool ok
+        cdef RoidbColumn column
+        cdef uint64_t i
+        cdef _MappedBytes data
+        with nogil:
+            ok = self.roidb.Open(c_path, &error)
+        if not ok:
+            raise IOError(error.decode("utf-8"))
+
+        self.num_records = self.roidb.num_records()
+        self.columns = {}
+        for i in range(self.roidb.num_columns()):
+            column = self.roidb.column(i)
+            name = (<bytes> <const char*> column.name).decode("utf-8")
+            dtype = np.dtype((<bytes> <const char*> column.dtype).decode("ascii"))
+            shape = tuple(column.shape[j] for j in range(column.ndim))
+            if int(np.prod(shape)) * dtype.itemsize != column.nbytes:
+                raise IOError("{} is malformed at column {}, {} bytes do not hold {} of {}".format(
+                    path, name, column.nbytes, shape, dtype))
+            data = _MappedBytes()
+            data.owner = self
+            data.ptr = <const char*> self.roidb.data(i)
+            data.size = column.nbytes
+            self.columns[name] = np.frombuffer(data, dtype=dtype).reshape(shape)
+
+        c = self.columns
+        if "image_url.data" in c:
+            self.url_offset = c["image_url.offset"]
+        if "gt.offset" in c:
+            self.gt_offset = c["gt.offset"]
+        if "gt_poly.data" in c:
+            self.poly_instance = c["gt_poly.instance"]
+            self.poly_none = c["gt_poly.none"]
+            self.poly_offset = c["gt_poly.offset"]
+        if "extra.data" in c:
+            self.extra_offset = c["extra.offset"]
+
+    def __dealloc__(self):
+        del self.roidb
+
+    def __len__(self):
+        return self.num_records
+
+    @property
+    def num_gt(self):
+        """
+        number of gt of every record
+        """
+        if "gt.offset" in self.columns:
+            return np.diff(self.columns["gt.offset"])
+        return np.array([len(self.record(i)["gt_bbox"]) for i in range(self.num_records)],
+                        dtype=np.int64)
+
+    @cython.boundscheck(False)
+    @cython.wraparound(False)
+    def record(self, Py_ssize_t i):
+        """
+        roidb record i, as it was written. Its arrays are read-only views of the
+        mapping and its polygons are float64 arrays.
+        :param i: index of the record
+        :return: dict
+        """
+        if i < 0 or i >= self.num_records:
+            raise IndexError("record {} out of {}".format(i, self.num_records))
+        c = self.columns
+        record = {}
+        if "image_url.data" in c:
+            record["image_url"] = bytes(c["image_url.data"][self.url_offset[i]:self.url_offset[i + 1]]).decode("utf-8")
+        for key in ("im_id", "h", "w"):
+            if key in c:
+                record[key] = int(c[key][i])
+        if "flipped" in c:
+            record["flipped"] = True if c["flipped"][i] else False
+
+        cdef Py_ssize_t begin, end, j, k
+        if "gt.offset" in c:
+            begin = self.gt_offset[i]
+            end = self.gt_offset[i + 1]
+            record["gt_bbox"] = c["gt_bbox"][begin:end]
+            record["gt_class"] = c["gt_class"][begin:end]
+            if "gt_poly.data" in c:
+                poly_data = c["gt_poly.data"]
+                gt_poly = [None] * (end - begin)
+                for j in range(begin, end):
+                    if not self.poly_none[j]:
+                        gt_poly[j - begin] = [poly_data[self.poly_offset[k]:self.poly_offset[k + 1]]
+                                              for k in range(self.poly_instance[j], self.poly_instance[j + 1])]
+                record["gt_poly"] = gt_poly
+
+        if "extra.data" in c:
+            record.update(pickle.loads(c["extra.data"][self.extra_offset[i]:self.extra_offset[i + 1]]))
+        return record
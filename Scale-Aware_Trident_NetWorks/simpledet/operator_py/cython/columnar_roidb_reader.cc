@@ -0,0 +1,90 @@
+// ------------------------------------------------------------------
+// Memory mapping of columnar roidb files. The mapping is shared and
+// read-only, so the loader threads and every training process on a node
+// read the same page cache instead of each holding an unpickled copy.
+// ------------------------------------------------------------------
+
+#include "columnar_roidb.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+const char kMagic[8] = {'S', 'D', 'R', 'O', 'I', 'D', 'B', '1'};
+const uint64_t kHeaderSize = sizeof(kMagic) + 2 * sizeof(uint64_t);
+const uint64_t kAlign = 64;
+
+std::string system_error(const std::string& what, const std::string& path) {
+  return what + " " + path + ": " + std::strerror(errno);
+}
+
+}  // namespace
+
+MappedRoidb::~MappedRoidb() {
+  if (base_ != nullptr) {
+    munmap(const_cast<char*>(base_), size_);
+  }
+}
+
+bool MappedRoidb::Open(const std::string& path, std::string* error) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *error = system_error("can not open", path);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    *error = system_error("can not stat", path);
+    close(fd);
+    return false;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  if (size < kHeaderSize) {
+    *error = path + " is not a columnar roidb, it is too short";
+    close(fd);
+    return false;
+  }
+  void* base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping stays valid once the descriptor is closed
+  close(fd);
+  if (base == MAP_FAILED) {
+    *error = system_error("can not map", path);
+    return false;
+  }
+  base_ = static_cast<const char*>(base);
+  size_ = size;
+  // the loader reads records in shuffled order
+  madvise(base, size, MADV_RANDOM);
+
+  if (std::memcmp(base_, kMagic, sizeof(kMagic)) != 0) {
+    *error = path + " is not a columnar roidb, its magic does not match";
+    return false;
+  }
+  uint64_t num_columns;
+  std::memcpy(&num_records_, base_ + sizeof(kMagic), sizeof(uint64_t));
+  std::memcpy(&num_columns, base_ + sizeof(kMagic) + sizeof(uint64_t), sizeof(uint64_t));
+  if (num_columns > (size - kHeaderSize) / sizeof(RoidbColumn)) {
+    *error = path + " is truncated, its column table does not fit";
+    return false;
+  }
+  columns_.resize(num_columns);
+  if (num_columns > 0) {
+    std::memcpy(columns_.data(), base_ + kHeaderSize, num_columns * sizeof(RoidbColumn));
+  }
+  for (RoidbColumn& c : columns_) {
+    c.name[sizeof(c.name) - 1] = '\0';
+    c.dtype[sizeof(c.dtype) - 1] = '\0';
+    if (c.ndim < 1 || c.ndim > 2 || c.offset % kAlign != 0 ||
+        c.offset > size || c.nbytes > size - c.offset) {
+      *error = path + " is malformed or truncated at column " + c.name;
+      return false;
+    }
+  }
+  return true;
+}
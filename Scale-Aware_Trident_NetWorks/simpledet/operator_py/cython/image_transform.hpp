@@ -0,0 +1,13 @@
+// Image part of the ReadRoiRecord, Norm2DImage, Resize2DImageBbox,
+// Flip2DImageBbox, Pad2DImageBbox and ConvertImageFromHwcToChw transforms in
+// one pass. src is the [src_h, src_w, 3] BGR image as decoded by cv2.imread.
+// It is normalized per RGB channel as (x - mean) / std and resized by scale
+// to [resized_h, resized_w] with the bilinear taps of cv2.resize. It is
+// mirrored if flip is set and written to the [3, dst_h, dst_w] float
+// buffer dst, zero padded past the resized image.
+#include <cstdint>
+
+void _transform_image(const uint8_t* src, int src_h, int src_w,
+                      int resized_h, int resized_w, double scale, bool flip,
+                      const double* mean, const double* std, float* dst,
+                      int dst_h, int dst_w);
@@ -0,0 +1,49 @@
+cimport cython
+import numpy as np
+cimport numpy as np
+from libc.stdint cimport uint8_t
+from libcpp cimport bool
+
+np.import_array()
+
+cdef extern from "image_transform.hpp":
+    void _transform_image(const uint8_t*, int, int, int, int, double, bool,
+                          const double*, const double*, float*, int, int) nogil
+
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+def transform_image(np.ndarray[np.uint8_t, ndim=3] image, np.ndarray[np.float32_t, ndim=3] out,
+                    int resized_h, int resized_w, double scale, bint flip, mean, std):
+    """
+    normalize, resize, flip and pad a decoded image into a CHW float buffer
+    :param image: [h, w, 3] uint8 BGR image, as cv2.imread returns it
+    :param out: C-contiguous [3, out_h, out_w] float32 buffer, e.g. one image of a batch
+    :param resized_h: height of the resized image, at most out_h
+    :param resized_w: width of the resized image, at most out_w
+    :param scale: resize factor, as passed to cv2.resize
+    :param flip: mirror the resized image horizontally
+    :param mean: per channel mean, RGB order
+    :param std: per channel std, RGB order
+    """
+    if image.shape[2] != 3 or out.shape[0] != 3:
+        raise ValueError('image should be [h, w, 3] and out [3, h, w]')
+    if resized_h > out.shape[1] or resized_w > out.shape[2]:
+        raise ValueError('resized image {} does not fit into {}'.format(
+            (resized_h, resized_w), (out.shape[1], out.shape[2])))
+    if not out.flags['C_CONTIGUOUS']:
+        raise ValueError('out should be C-contiguous')
+    image = np.ascontiguousarray(image)
+    cdef np.ndarray[np.float64_t, ndim=1] c_mean = np.ascontiguousarray(mean, dtype=np.float64)
+    cdef np.ndarray[np.float64_t, ndim=1] c_std = np.ascontiguousarray(std, dtype=np.float64)
+    if c_mean.shape[0] != 3 or c_std.shape[0] != 3:
+        raise ValueError('mean and std should have 3 channels')
+    cdef int src_h = image.shape[0]
+    cdef int src_w = image.shape[1]
+    cdef int out_h = out.shape[1]
+    cdef int out_w = out.shape[2]
+
+    with nogil:
+        _transform_image(<const uint8_t*> image.data, src_h, src_w, resized_h, resized_w,
+                         scale, flip, <const double*> c_mean.data, <const double*> c_std.data,
+                         <float*> out.data, out_h, out_w)
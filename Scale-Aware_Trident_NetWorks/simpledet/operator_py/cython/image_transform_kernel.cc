@@ -0,0 +1,148 @@
+// ------------------------------------------------------------------
+// CPU kernel of the image transforms of the data loader. It goes from the
+// decoded 8-bit image straight to the padded CHW float input of the network,
+// without the full-size float copies of the python transforms, and is called
+// with the GIL released so that the loader workers run it side by side.
+// ------------------------------------------------------------------
+
+#include "image_transform.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const int kChannels = 3;
+
+// Source offset and weights of every destination pixel along one axis, for
+// the INTER_LINEAR resize of cv::resize. Along x, cv::resize clamps the taps
+// at the borders, along y it clamps only the source rows. The source
+// position is kept in double, a float one is off by up to 1e-4 pixels on
+// large images.
+void linear_taps(int src_size, int dst_size, double inv_scale, bool clamp_weight,
+                 int* ofs, float* alpha) {
+  for (int d = 0; d < dst_size; ++d) {
+    double f = (d + 0.5) * inv_scale - 0.5;
+    int s = static_cast<int>(std::floor(f));
+    f -= s;
+    if (clamp_weight) {
+      if (s < 0) {
+        s = 0;
+        f = 0;
+      }
+      if (s >= src_size - 1) {
+        s = src_size - 1;
+        f = 0;
+      }
+    }
+    ofs[d] = s;
+    alpha[2 * d] = static_cast<float>(1 - f);
+    alpha[2 * d + 1] = static_cast<float>(f);
+  }
+}
+
+// Normalized source rows resized along x. Consecutive output rows mostly
+// read the same two source rows, so the last two are kept.
+class RowCache {
+ public:
+  RowCache(const uint8_t* src, int src_w, int resized_w, const int* x_ofs,
+           const float* x_alpha, const double* mean, const double* std)
+    : src_(src), src_w_(src_w), resized_w_(resized_w), x_ofs_(x_ofs),
+      x_alpha_(x_alpha), mean_(mean), std_(std), norm_(src_w * kChannels) {
+    for (int k = 0; k < 2; ++k) {
+      index_[k] = -1;
+      rows_[k].resize(resized_w * kChannels);
+    }
+  }
+
+  // resized row of source row sy, never evicting the row of source row keep
+  const float* Get(int sy, int keep) {
+    for (int k = 0; k < 2; ++k) {
+      if (index_[k] == sy) {
+        return rows_[k].data();
+      }
+    }
+    const int k = (index_[0] == keep) ? 1 : 0;
+    Fill(sy, rows_[k].data());
+    index_[k] = sy;
+    return rows_[k].data();
+  }
+
+ private:
+  void Fill(int sy, float* row) {
+    // BGR to RGB and normalization, in double and rounded once to float as
+    // the in-place numpy arithmetic of Norm2DImage does
+    const uint8_t* s = src_ + static_cast<size_t>(sy) * src_w_ * kChannels;
+    for (int x = 0; x < src_w_; ++x) {
+      for (int c = 0; c < kChannels; ++c) {
+        const float v = static_cast<float>(s[x * kChannels + kChannels - 1 - c] - mean_[c]);
+        norm_[x * kChannels + c] = static_cast<float>(v / std_[c]);
+      }
+    }
+    for (int dx = 0; dx < resized_w_; ++dx) {
+      const float* p = &norm_[x_ofs_[dx] * kChannels];
+      const float a0 = x_alpha_[2 * dx];
+      const float a1 = x_alpha_[2 * dx + 1];
+      for (int c = 0; c < kChannels; ++c) {
+        // the second tap is past the border when its weight was clamped
+        row[dx * kChannels + c] = (a1 == 0) ? p[c] * a0 : p[c] * a0 + p[c + kChannels] * a1;
+      }
+    }
+  }
+
+  const uint8_t* src_;
+  int src_w_;
+  int resized_w_;
+  const int* x_ofs_;
+  const float* x_alpha_;
+  const double* mean_;
+  const double* std_;
+  std::vector<float> norm_;
+  std::vector<float> rows_[2];
+  int index_[2];
+};
+
+}  // namespace
+
+void _transform_image(const uint8_t* src, int src_h, int src_w,
+                      int resized_h, int resized_w, double scale, bool flip,
+                      const double* mean, const double* std, float* dst,
+                      int dst_h, int dst_w) {
+  const double inv_scale = 1.0 / scale;
+  std::vector<int> x_ofs(resized_w), y_ofs(resized_h);
+  std::vector<float> x_alpha(2 * resized_w), y_alpha(2 * resized_h);
+  linear_taps(src_w, resized_w, inv_scale, true, x_ofs.data(), x_alpha.data());
+  linear_taps(src_h, resized_h, inv_scale, false, y_ofs.data(), y_alpha.data());
+
+  RowCache cache(src, src_w, resized_w, x_ofs.data(), x_alpha.data(), mean, std);
+  const size_t plane = static_cast<size_t>(dst_h) * dst_w;
+  for (int dy = 0; dy < resized_h; ++dy) {
+    const int sy0 = std::min(std::max(y_ofs[dy], 0), src_h - 1);
+    const int sy1 = std::min(std::max(y_ofs[dy] + 1, 0), src_h - 1);
+    const float* r0 = cache.Get(sy0, sy1);
+    const float* r1 = cache.Get(sy1, sy0);
+    const float b0 = y_alpha[2 * dy];
+    const float b1 = y_alpha[2 * dy + 1];
+    for (int c = 0; c < kChannels; ++c) {
+      float* out = dst + c * plane + static_cast<size_t>(dy) * dst_w;
+      if (flip) {
+        for (int dx = 0; dx < resized_w; ++dx) {
+          const int i = dx * kChannels + c;
+          out[resized_w - 1 - dx] = r0[i] * b0 + r1[i] * b1;
+        }
+      } else {
+        for (int dx = 0; dx < resized_w; ++dx) {
+          const int i = dx * kChannels + c;
+          out[dx] = r0[i] * b0 + r1[i] * b1;
+        }
+      }
+      std::memset(out + resized_w, 0, (dst_w - resized_w) * sizeof(float));
+    }
+  }
+  for (int c = 0; c < kChannels; ++c) {
+    float* out = dst + c * plane + static_cast<size_t>(resized_h) * dst_w;
+    std::memset(out, 0, static_cast<size_t>(dst_h - resized_h) * dst_w * sizeof(float));
+  }
+}
@@ -123,6 +123,43 @@ ext_modules = [
         extra_compile_args={'gcc': ["-Wno-cpp", "-Wno-unused-function"]},
         include_dirs = [numpy_include]
     ),
+    Extension(
+        "batched_nms",
+        ["batched_nms_kernel.cc", "batched_nms.pyx"],
+        language='c++',
+        extra_compile_args={'gcc': ["-Wno-cpp", "-Wno-unused-function", "-std=c++11", "-O3", "-pthread"]},
+        extra_link_args=["-pthread"],
+        include_dirs = [numpy_include]
+    ),
+    Extension(
+        "anchor_target",
+        ["anchor_target_kernel.cc", "anchor_target.pyx"],
+        language='c++',
+        extra_compile_args={'gcc': ["-Wno-cpp", "-Wno-unused-function", "-std=c++11", "-O3"]},
+        include_dirs = [numpy_include]
+    ),
+    Extension(
+        "image_transform",
+        ["image_transform_kernel.cc", "image_transform.pyx"],
+        language='c++',
+        extra_compile_args={'gcc': ["-Wno-cpp", "-Wno-unused-function", "-std=c++11", "-O3"]},
+        include_dirs = [numpy_include]
+    ),
+    Extension(
+        "columnar_roidb",
+        ["columnar_roidb_reader.cc", "columnar_roidb.pyx"],
+        language='c++',
+        extra_compile_args={'gcc': ["-Wno-cpp", "-Wno-unused-function", "-std=c++11", "-O3"]},
+        include_dirs = [numpy_include]
+    ),
+    Extension(
+        "coco_eval",
+        ["coco_eval_kernel.cc", "coco_eval.pyx"],
+        language='c++',
+        extra_compile_args={'gcc': ["-Wno-cpp", "-Wno-unused-function", "-std=c++11", "-O3", "-pthread"]},
+        extra_link_args=["-pthread"],
+        include_dirs = [numpy_include]
+    ),
     Extension('gpu_nms',
         ['nms_kernel.cu', 'gpu_nms.pyx'],
         library_dirs=[CUDA['lib64']],
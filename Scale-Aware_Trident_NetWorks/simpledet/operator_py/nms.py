@@ -2,6 +2,13 @@ import numpy as np
 from .cython.cpu_nms import greedy_nms, soft_nms
 
 
+def batched_nms(dets, method, thresh, **kwargs):
+    # imported on first use: importing this module and calling the wrappers
+    # one dets array at a time do not need the batched_nms extension
+    from .cython.batched_nms import batched_nms as _batched_nms
+    return _batched_nms(dets, method, thresh, **kwargs)
+
+
 def cython_soft_nms_wrapper(thresh, sigma=0.5, score_thresh=0.001, method='linear'):
     methods = {'hard': 0, 'linear': 1, 'gaussian': 2}
     assert method in methods, 'Unknown soft_nms method: {}'.format(method)
@@ -13,24 +20,30 @@ def cython_soft_nms_wrapper(thresh, sigma=0.5, score_thresh=0.001, method='linea
                     np.float32(score_thresh),
                     np.uint8(methods[method]))
         return dets
+    _nms.batch = lambda dets: batched_nms(
+        dets, method, thresh, sigma=sigma, score_thresh=score_thresh)
     return _nms
 
 
 def py_nms_wrapper(thresh):
     def _nms(dets):
         return nms(dets, thresh)
+    _nms.batch = lambda dets: batched_nms(dets, 'greedy', thresh)
     return _nms
 
 
 def cpu_nms_wrapper(thresh):
     def _nms(dets):
         return greedy_nms(dets, thresh)[0]
+    _nms.batch = lambda dets: batched_nms(dets, 'greedy', thresh)
     return _nms
 
 
 def wnms_wrapper(thresh_lo, thresh_hi):
     def _nms(dets):
         return py_weighted_nms(dets, thresh_lo, thresh_hi)
+    _nms.batch = lambda dets: batched_nms(
+        dets, 'vote', thresh_lo, vote_thresh=thresh_hi)
     return _nms
 
 
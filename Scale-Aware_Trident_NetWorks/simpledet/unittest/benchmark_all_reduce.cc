@@ -0,0 +1,219 @@
+/*!
+ * \file benchmark_all_reduce.cc
+ * \brief latency of the SyncBatchNorm statistics synchronization, the
+ *        in-process all-reduce against the SharedND and Barrier scheme it
+ *        replaces, with one CPU thread per device
+ *
+ * g++ -O3 -std=c++11 -pthread -I operator_cxx/contrib unittest/benchmark_all_reduce.cc -o benchmark_all_reduce
+ * ./benchmark_all_reduce
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "all_reduce.h"
+
+using mxnet::op::AllReduce;
+
+// the previous scheme: a rank counter, a barrier and one SharedND per
+// statistic, reduced serially by the first rank to Pop, under a mutex
+class OldSharedND {
+ public:
+  explicit OldSharedND(int ndev)
+    : num_devices_(ndev), data_(ndev), flag_(ndev) {
+    for (auto &f : flag_) {
+      f = false;
+    }
+  }
+
+  float* Retrieve(size_t size, int index) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (mean_.size() != size) {
+        for (auto &d : data_) {
+          d.assign(size, 0.f);
+        }
+        mean_.assign(size, 0.f);
+      }
+    }
+    return flag_[index] ? nullptr : data_[index].data();
+  }
+
+  void SetReady(int index) { flag_[index] = true; }
+
+  const float* Pop(int index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!MeanReady()) {}
+    flag_[index] = false;
+    ResetMean();
+    return mean_.data();
+  }
+
+ private:
+  bool MeanReady() {
+    if (mean_ready_) {
+      return true;
+    }
+    for (int i = 0; i < num_devices_; i++) {
+      if (!flag_[i]) {
+        return false;
+      }
+    }
+    for (int i = 1; i < num_devices_; i++) {
+      for (size_t j = 0; j < mean_.size(); ++j) {
+        data_[0][j] += data_[i][j];
+      }
+    }
+    for (size_t j = 0; j < mean_.size(); ++j) {
+      mean_[j] = data_[0][j] * 1.0f / num_devices_;
+    }
+    mean_ready_ = true;
+    return true;
+  }
+
+  void ResetMean() {
+    for (int i = 0; i < num_devices_; i++) {
+      if (flag_[i]) return;
+    }
+    mean_ready_ = false;
+  }
+
+  int num_devices_;
+  std::vector<std::vector<float>> data_;
+  std::vector<float> mean_;
+  std::vector<std::atomic<bool>> flag_;
+  bool mean_ready_ = false;
+  std::mutex mutex_;
+};
+
+// the previous barrier waited for count_ == total_count_, which loses the
+// wakeup when a thread is back before the others have woken up and hangs
+// when run back to back, so the round is counted here
+class OldBarrier {
+ public:
+  explicit OldBarrier(size_t count) : count_(count), total_count_(count) {}
+  void Wait() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    const size_t round = round_;
+    if (--count_ == 0) {
+      count_ = total_count_;
+      ++round_;
+      cv_.notify_all();
+    } else {
+      cv_.wait(lock, [&] { return round_ != round; });
+    }
+  }
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  size_t count_;
+  size_t total_count_;
+  size_t round_ = 0;
+};
+
+class OldSync {
+ public:
+  explicit OldSync(int ndev) : ndev_(ndev), barrier_(ndev), mean_(ndev), var_(ndev) {}
+
+  void Run(const std::vector<float> &stats, std::vector<float> *out) {
+    const size_t channels = stats.size() / 2;
+    int rank;
+    {
+      std::lock_guard<std::mutex> lock(rank_mutex_);
+      rank = next_rank_;
+      next_rank_ = (next_rank_ == ndev_ - 1) ? 0 : next_rank_ + 1;
+    }
+    // a device a reduction ahead gets nullptr until the slow one has popped,
+    // the old operator would crash there, this waits instead
+    float *mean_buffer, *var_buffer;
+    while ((mean_buffer = mean_.Retrieve(channels, rank)) == nullptr) {
+      std::this_thread::yield();
+    }
+    while ((var_buffer = var_.Retrieve(channels, rank)) == nullptr) {
+      std::this_thread::yield();
+    }
+    std::copy(stats.begin(), stats.begin() + channels, mean_buffer);
+    std::copy(stats.begin() + channels, stats.end(), var_buffer);
+    mean_.SetReady(rank);
+    var_.SetReady(rank);
+    barrier_.Wait();
+    const float *mean = mean_.Pop(rank);
+    const float *var = var_.Pop(rank);
+    std::copy(mean, mean + channels, out->begin());
+    std::copy(var, var + channels, out->begin() + channels);
+  }
+
+ private:
+  int ndev_;
+  std::mutex rank_mutex_;
+  int next_rank_ = 0;
+  OldBarrier barrier_;
+  OldSharedND mean_;
+  OldSharedND var_;
+};
+
+class NewSync {
+ public:
+  explicit NewSync(int ndev) : all_reduce_(ndev) {}
+
+  void Run(const std::vector<float> &stats, std::vector<float> *out) {
+    const int slot = all_reduce_.Join();
+    float *buffer = all_reduce_.Buffer(slot, stats.size());
+    std::copy(stats.begin(), stats.end(), buffer);
+    all_reduce_.Reduce(slot);
+    std::copy(buffer, buffer + stats.size(), out->begin());
+  }
+
+ private:
+  AllReduce<float> all_reduce_;
+};
+
+// microseconds per synchronization, seen by the slowest device
+template <typename Sync>
+double LatencyUs(int ndev, size_t channels, int iters) {
+  Sync sync(ndev);
+  std::vector<double> elapsed(ndev);
+  auto worker = [&](int thread) {
+    std::vector<float> stats(2 * channels, static_cast<float>(thread));
+    std::vector<float> out(2 * channels);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i) {
+      sync.Run(stats, &out);
+    }
+    auto end = std::chrono::steady_clock::now();
+    elapsed[thread] = std::chrono::duration<double, std::micro>(end - start).count() / iters;
+  };
+  std::vector<std::thread> threads;
+  for (int t = 0; t < ndev; ++t) {
+    threads.emplace_back(worker, t);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  double slowest = 0;
+  for (double e : elapsed) {
+    slowest = std::max(slowest, e);
+  }
+  return slowest;
+}
+
+int main() {
+  const int ndevs[] = {2, 4, 8};
+  const size_t channels[] = {64, 256, 1024, 2048};
+  const int iters = 2000;
+  printf("%4s %8s %14s %14s\n", "ndev", "channels", "shared (us)", "reduce (us)");
+  for (int ndev : ndevs) {
+    for (size_t c : channels) {
+      const double old_us = LatencyUs<OldSync>(ndev, c, iters);
+      const double new_us = LatencyUs<NewSync>(ndev, c, iters);
+      printf("%4d %8zu %14.2f %14.2f\n", ndev, c, old_us, new_us);
+    }
+  }
+  return EXIT_SUCCESS;
+}
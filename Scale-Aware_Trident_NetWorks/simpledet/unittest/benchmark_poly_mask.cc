@@ -0,0 +1,168 @@
+/*!
+ * \file benchmark_poly_mask.cc
+ * \brief timing of the polygon to mask target conversion of ProposalMaskTarget,
+ *        the scanline rasterizer against the COCO RLE path it replaces,
+ *        for 512 rois with 28 x 28 masks
+ *
+ * gcc -O3 -c /path/to/cocoapi/common/maskApi.c -o maskApi.o
+ * g++ -O3 -std=c++11 -fopenmp -I operator_cxx -I /path/to/cocoapi/common \
+ *     unittest/benchmark_poly_mask.cc maskApi.o -o benchmark_poly_mask
+ * ./benchmark_poly_mask
+*/
+#include <omp.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+extern "C" {
+#include "maskApi.h"
+}
+#include "polygon_mask.h"
+
+const int kNumRois = 512;
+const int kMaskSize = 28;
+
+// the roi relative coordinates, (y, x) pairs as convertPoly2Mask passes them
+void PolyToMaskCoords(const float *roi, const float *poly, int len, std::vector<double> *xys) {
+  float w = std::max(1.f, roi[2] - roi[0]);
+  float h = std::max(1.f, roi[3] - roi[1]);
+  xys->resize(len);
+  for (int j = 0; j < len; j += 2) {
+    (*xys)[j] = (poly[j + 1] - roi[1]) * kMaskSize / h;
+    (*xys)[j + 1] = (poly[j] - roi[0]) * kMaskSize / w;
+  }
+}
+
+// the previous implementation: one RLE and one decoded byte plane per
+// segment, ORed into the mask
+void CocoPolyToMask(const float *roi, const float *poly, float *mask) {
+  int n_seg = static_cast<int>(poly[1]);
+  int offset = 2 + n_seg;
+  RLE *rles;
+  rlesInit(&rles, n_seg);
+  std::vector<double> xys;
+  for (int i = 0; i < n_seg; ++i) {
+    int cur_len = poly[i + 2];
+    PolyToMaskCoords(roi, poly + offset, cur_len, &xys);
+    rleFrPoly(rles + i, xys.data(), cur_len / 2, kMaskSize, kMaskSize);
+    offset += cur_len;
+  }
+  byte *byte_mask = new byte[kMaskSize * kMaskSize * n_seg];
+  rleDecode(rles, byte_mask, n_seg);
+  for (int j = 0; j < kMaskSize * kMaskSize; ++j) {
+    float cur_byte = 0;
+    for (int i = 0; i < n_seg; ++i) {
+      if (byte_mask[i * kMaskSize * kMaskSize + j] == 1) {
+        cur_byte = 1;
+        break;
+      }
+    }
+    mask[j] = cur_byte;
+  }
+  rlesFree(&rles, n_seg);
+  delete [] byte_mask;
+}
+
+void ScanlinePolyToMask(const float *roi, const float *poly, float *mask) {
+  int n_seg = static_cast<int>(poly[1]);
+  int offset = 2 + n_seg;
+  static thread_local std::vector<double> xys;
+  std::fill(mask, mask + kMaskSize * kMaskSize, 0.f);
+  for (int i = 0; i < n_seg; ++i) {
+    int cur_len = poly[i + 2];
+    PolyToMaskCoords(roi, poly + offset, cur_len, &xys);
+    mxnet::op::polygon_mask::FillPolygon(xys.data(), cur_len / 2, kMaskSize, kMaskSize, mask);
+    offset += cur_len;
+  }
+}
+
+template <typename F>
+double TimeMs(F f, int iters) {
+  f();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iters; ++i) {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / iters;
+}
+
+int main() {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> uniform(0.f, 1.f);
+  // gt polys as laid out by the data loader: [category, n_seg, len_0, ..., len_n, points...]
+  std::vector<std::vector<float>> polys(kNumRois);
+  std::vector<float> rois(kNumRois * 4);
+  for (int r = 0; r < kNumRois; ++r) {
+    const int n_seg = 1 + rng() % 3;
+    std::vector<float> &poly = polys[r];
+    poly.push_back(1.f);
+    poly.push_back(n_seg);
+    std::vector<float> points;
+    float x_min = 1e9f, y_min = 1e9f, x_max = -1e9f, y_max = -1e9f;
+    for (int s = 0; s < n_seg; ++s) {
+      const int num_points = 6 + rng() % 40;
+      const float cx = 100.f + 400.f * uniform(rng);
+      const float cy = 100.f + 400.f * uniform(rng);
+      const float radius = 10.f + 90.f * uniform(rng);
+      poly.push_back(2 * num_points);
+      for (int p = 0; p < num_points; ++p) {
+        const float angle = 6.2831853f * p / num_points;
+        const float dist = radius * (0.3f + 0.7f * uniform(rng));
+        const float x = cx + dist * std::cos(angle);
+        const float y = cy + dist * std::sin(angle);
+        points.push_back(x);
+        points.push_back(y);
+        x_min = std::min(x_min, x);
+        y_min = std::min(y_min, y);
+        x_max = std::max(x_max, x);
+        y_max = std::max(y_max, y);
+      }
+    }
+    poly.insert(poly.end(), points.begin(), points.end());
+    // a sampled roi only roughly covers its gt instance
+    const float jitter_w = 0.2f * (x_max - x_min);
+    const float jitter_h = 0.2f * (y_max - y_min);
+    rois[r * 4] = x_min + jitter_w * (uniform(rng) - 0.5f);
+    rois[r * 4 + 1] = y_min + jitter_h * (uniform(rng) - 0.5f);
+    rois[r * 4 + 2] = x_max + jitter_w * (uniform(rng) - 0.5f);
+    rois[r * 4 + 3] = y_max + jitter_h * (uniform(rng) - 0.5f);
+  }
+
+  std::vector<float> coco_masks(kNumRois * kMaskSize * kMaskSize);
+  std::vector<float> scanline_masks(kNumRois * kMaskSize * kMaskSize);
+  double coco_ms = TimeMs([&]() {
+    for (int r = 0; r < kNumRois; ++r) {
+      CocoPolyToMask(&rois[r * 4], polys[r].data(), &coco_masks[r * kMaskSize * kMaskSize]);
+    }
+  }, 20);
+  double scanline_ms = TimeMs([&]() {
+    for (int r = 0; r < kNumRois; ++r) {
+      ScanlinePolyToMask(&rois[r * 4], polys[r].data(), &scanline_masks[r * kMaskSize * kMaskSize]);
+    }
+  }, 20);
+  if (coco_masks != scanline_masks) {
+    printf("mask mismatch\n");
+    return EXIT_FAILURE;
+  }
+  double parallel_ms = TimeMs([&]() {
+    #pragma omp parallel for
+    for (int r = 0; r < kNumRois; ++r) {
+      ScanlinePolyToMask(&rois[r * 4], polys[r].data(), &scanline_masks[r * kMaskSize * kMaskSize]);
+    }
+  }, 20);
+  if (coco_masks != scanline_masks) {
+    printf("mask mismatch with %d threads\n", omp_get_max_threads());
+    return EXIT_FAILURE;
+  }
+
+  printf("%d rois, %dx%d masks\n", kNumRois, kMaskSize, kMaskSize);
+  printf("%-24s %10.3f ms\n", "coco rle", coco_ms);
+  printf("%-24s %10.3f ms\n", "scanline", scanline_ms);
+  printf("scanline, %2d threads     %10.3f ms\n", omp_get_max_threads(), parallel_ms);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+/*!
+ * \file benchmark_topk.cc
+ * \brief timing of the top-k selection of the CPU proposal operators against
+ *        the full argsort it replaces, for typical anchor counts
+ *
+ * g++ -O3 -std=c++11 -I operator_cxx/contrib unittest/benchmark_topk.cc -o benchmark_topk
+ * ./benchmark_topk
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "topk_utils.h"
+
+using mxnet::op::topk_utils::ReverseArgsortTopK;
+
+// the argsort the operators used before: every index, stored as float
+struct ReverseArgsortCompl {
+  const float *val_;
+  explicit ReverseArgsortCompl(const float *val)
+    : val_(val) {}
+  bool operator() (float i, float j) {
+    return (val_[static_cast<size_t>(i)] >
+            val_[static_cast<size_t>(j)]);
+  }
+};
+
+template <typename F>
+double TimeMs(F f, int iters) {
+  f();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iters; ++i) {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / iters;
+}
+
+int main() {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> uniform(0.f, 1.f);
+  const int counts[] = {20000, 50000, 100000, 200000, 500000};
+  const int top_ns[] = {1000, 6000, 12000};
+  printf("%8s %6s %14s %14s\n", "anchors", "top_n", "argsort (ms)", "top-k (ms)");
+  for (int count : counts) {
+    // dets as laid out by the operators: [x1, y1, x2, y2, score]
+    std::vector<float> dets(count * 5);
+    std::vector<float> score(count);
+    for (int i = 0; i < count; ++i) {
+      // rpn scores are sigmoid outputs, many of them close to each other
+      score[i] = uniform(rng) < 0.9f ? uniform(rng) * 0.05f : uniform(rng);
+      dets[i * 5 + 4] = score[i];
+    }
+    for (int top_n : top_ns) {
+      if (top_n > count) {
+        continue;
+      }
+      std::vector<float> order(count);
+      double argsort_ms = TimeMs([&]() {
+        std::iota(order.begin(), order.end(), 0.f);
+        std::sort(order.begin(), order.end(), ReverseArgsortCompl(score.data()));
+      }, 5);
+      std::vector<int32_t> topk(top_n);
+      double topk_ms = TimeMs([&]() {
+        ReverseArgsortTopK(dets.data() + 4, 5, count, top_n, topk.data());
+      }, 20);
+
+      // same scores as the argsort, and ties by increasing index
+      for (int i = 0; i < top_n; ++i) {
+        if (score[topk[i]] != score[static_cast<int>(order[i])] ||
+            (i > 0 && score[topk[i]] == score[topk[i - 1]] && topk[i] < topk[i - 1])) {
+          printf("mismatch at %d of count=%d top_n=%d\n", i, count, top_n);
+          return EXIT_FAILURE;
+        }
+      }
+      printf("%8d %6d %14.2f %14.2f\n", count, top_n, argsort_ms, topk_ms);
+    }
+  }
+  return EXIT_SUCCESS;
+}
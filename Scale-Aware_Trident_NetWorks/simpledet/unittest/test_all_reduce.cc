@@ -0,0 +1,89 @@
+/*!
+ * \file test_all_reduce.cc
+ * \brief stress test of the in-process all-reduce of SyncBatchNorm, with one
+ *        CPU thread per device
+ *
+ * g++ -O2 -std=c++11 -pthread -I operator_cxx/contrib unittest/test_all_reduce.cc -o test_all_reduce
+ * ./test_all_reduce
+*/
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "all_reduce.h"
+
+using mxnet::op::AllReduce;
+
+// reductions of alternating sizes, as forward and backward of layers with
+// different channel counts would do
+const size_t kSizes[] = {1, 7, 64, 513, 4096};
+const int kNumSizes = sizeof(kSizes) / sizeof(kSizes[0]);
+
+bool StressTest(int num_ranks, int iters) {
+  AllReduce<float> all_reduce(num_ranks);
+  std::atomic<int> errors{0};
+  // ranks taken in each reduction, one bit per rank
+  std::vector<std::atomic<uint32_t>> taken(iters);
+  for (auto &t : taken) {
+    t = 0;
+  }
+  auto worker = [&]() {
+    for (int iter = 0; iter < iters; ++iter) {
+      const int slot = all_reduce.Join();
+      const int rank = slot % num_ranks;
+      taken[iter].fetch_or(1u << rank);
+      const size_t size = kSizes[iter % kNumSizes];
+      float *buffer = all_reduce.Buffer(slot, size);
+      for (size_t i = 0; i < size; ++i) {
+        buffer[i] = static_cast<float>((rank + 1) * (i % 13) + iter % 5);
+      }
+      all_reduce.Reduce(slot);
+      // small integers, so the mean is exact
+      const float mean_rank = (num_ranks + 1) / 2.f;
+      for (size_t i = 0; i < size; ++i) {
+        if (buffer[i] != mean_rank * (i % 13) + iter % 5) {
+          ++errors;
+          break;
+        }
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int r = 0; r < num_ranks; ++r) {
+    threads.emplace_back(worker);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  const uint32_t all_ranks = (num_ranks == 32) ? ~0u : (1u << num_ranks) - 1;
+  for (int iter = 0; iter < iters; ++iter) {
+    if (taken[iter] != all_ranks) {
+      printf("ranks %d: reduction %d did not hand out every rank once\n", num_ranks, iter);
+      return false;
+    }
+  }
+  if (errors > 0) {
+    printf("ranks %d: %d wrong means\n", num_ranks, errors.load());
+    return false;
+  }
+  if (all_reduce.generation() != static_cast<uint64_t>(iters)) {
+    printf("ranks %d: generation %llu after %d reductions\n", num_ranks,
+           static_cast<unsigned long long>(all_reduce.generation()), iters);
+    return false;
+  }
+  return true;
+}
+
+int main() {
+  const int ranks[] = {1, 2, 3, 4, 8, 16};
+  for (int num_ranks : ranks) {
+    if (!StressTest(num_ranks, 2000)) {
+      return EXIT_FAILURE;
+    }
+    printf("ranks %2d: ok\n", num_ranks);
+  }
+  return EXIT_SUCCESS;
+}
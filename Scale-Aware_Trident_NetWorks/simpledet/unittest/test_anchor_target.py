@@ -0,0 +1,99 @@
+import unittest
+import numpy as np
+
+from operator_py.cython.anchor_target import assign_anchor_label, anchor_target
+from operator_py.cython.bbox import bbox_overlaps_cython
+from operator_py.bbox_transform import nonlinear_transform
+
+
+def np_assign_anchor_label(anchor, gt_bbox, neg_thr, pos_thr, min_pos_thr):
+    cls_label = np.full(shape=(anchor.shape[0],), fill_value=-1, dtype=np.float32)
+    if len(gt_bbox) == 0:
+        cls_label[:] = 0
+        return cls_label, np.zeros(shape=(anchor.shape[0],), dtype=np.int64)
+    overlaps = bbox_overlaps_cython(anchor.astype(np.float32), gt_bbox)
+    max_overlaps = overlaps.max(axis=1)
+    argmax_overlaps = overlaps.argmax(axis=1)
+    gt_max_overlaps = overlaps.max(axis=0)
+    gt_argmax_overlaps = np.where((overlaps == gt_max_overlaps) & (overlaps >= min_pos_thr))[0]
+    cls_label[max_overlaps < neg_thr] = 0
+    cls_label[gt_argmax_overlaps] = 1
+    cls_label[max_overlaps >= pos_thr] = 1
+    return cls_label, argmax_overlaps
+
+
+def random_anchor(rng, stride, fh, fw):
+    sizes = np.array([32, 64, 128, 256, 512], dtype=np.float64)
+    ratios = np.array([0.5, 1, 2])
+    ws = np.outer(np.sqrt(1 / ratios), sizes).reshape(-1)
+    hs = np.outer(np.sqrt(ratios), sizes).reshape(-1)
+    ctr = 0.5 * (stride - 1)
+    base = np.stack([ctr - 0.5 * (ws - 1), ctr - 0.5 * (hs - 1),
+                     ctr + 0.5 * (ws - 1), ctr + 0.5 * (hs - 1)], axis=1)
+    shift_x, shift_y = np.meshgrid(np.arange(fw, dtype=np.float32) * stride,
+                                   np.arange(fh, dtype=np.float32) * stride)
+    shift = np.stack([shift_x, shift_y, shift_x, shift_y], axis=2).reshape(-1, 1, 4)
+    anchor = (shift + base[None]).reshape(-1, 4)
+    h, w = fh * stride, fw * stride
+    valid = (anchor[:, 0] >= 0) & (anchor[:, 1] >= 0) & (anchor[:, 2] < w) & (anchor[:, 3] < h)
+    return anchor[valid], h, w
+
+
+def random_gt(rng, num_gt, h, w):
+    xy = rng.rand(num_gt, 2) * [w - 2, h - 2]
+    wh = rng.rand(num_gt, 2) * [w / 2, h / 2]
+    # a few tiny boxes, which may overlap no anchor at all
+    wh[::4] = rng.rand((num_gt + 3) // 4, 2) * 8
+    x2y2 = np.minimum(xy + wh, [w - 1, h - 1])
+    return np.hstack([xy, x2y2]).astype(np.float32)
+
+
+class TestAnchorTarget(unittest.TestCase):
+
+    def setUp(self):
+        rng = np.random.RandomState(0)
+        self.cases = []
+        for num_gt in [0, 1, 3, 20, 100]:
+            anchor, h, w = random_anchor(rng, 16, 38, 63)
+            self.cases.append((anchor, random_gt(rng, num_gt, h, w)))
+
+    def test_assign(self):
+        for anchor, gt_bbox in self.cases:
+            for min_pos_thr in [0.0, 0.3]:
+                label, argmax = assign_anchor_label(anchor, gt_bbox, 0.3, 0.7, min_pos_thr)
+                expected_label, expected_argmax = \
+                    np_assign_anchor_label(anchor, gt_bbox, 0.3, 0.7, min_pos_thr)
+                np.testing.assert_array_equal(label, expected_label)
+                np.testing.assert_array_equal(argmax, expected_argmax)
+
+    def test_sample_and_target(self):
+        for anchor, gt_bbox in self.cases:
+            expected_label, argmax = np_assign_anchor_label(anchor, gt_bbox, 0.3, 0.7, 0.3)
+            label, reg_target, reg_weight = \
+                anchor_target(anchor, gt_bbox, 0.3, 0.7, 0.3, 256, 0.5, 0)
+            num_fg = min(np.sum(expected_label == 1), 128)
+            num_bg = min(np.sum(expected_label == 0), 256 - num_fg)
+            self.assertEqual(np.sum(label == 1), num_fg)
+            self.assertEqual(np.sum(label == 0), num_bg)
+            # sampling only ever ignores anchors
+            kept = label != -1
+            np.testing.assert_array_equal(label[kept], expected_label[kept])
+
+            fg = np.where(label == 1)[0]
+            np.testing.assert_array_equal(reg_weight[fg], 1)
+            np.testing.assert_array_equal(reg_weight[label != 1], 0)
+            np.testing.assert_array_equal(reg_target[label != 1], 0)
+            if len(fg) > 0:
+                expected_target = nonlinear_transform(anchor[fg], gt_bbox[argmax[fg]])
+                np.testing.assert_allclose(reg_target[fg], expected_target, rtol=1e-6, atol=1e-6)
+
+    def test_seed(self):
+        anchor, gt_bbox = self.cases[3]
+        first = anchor_target(anchor, gt_bbox, 0.3, 0.7, 0.3, 256, 0.5, 7)
+        second = anchor_target(anchor, gt_bbox, 0.3, 0.7, 0.3, 256, 0.5, 7)
+        for a, b in zip(first, second):
+            np.testing.assert_array_equal(a, b)
+
+
+if __name__ == '__main__':
+    unittest.main()
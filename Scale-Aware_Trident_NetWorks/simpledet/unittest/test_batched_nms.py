@@ -0,0 +1,45 @@
+import unittest
+import numpy as np
+
+from operator_py.cython.batched_nms import batched_nms
+from operator_py.cython.cpu_nms import soft_nms
+from operator_py.nms import nms, py_weighted_nms
+
+
+def random_dets(rng, num_dets):
+    xy = rng.rand(num_dets, 2) * 200
+    wh = rng.rand(num_dets, 2) * 80
+    score = rng.rand(num_dets, 1)
+    return np.hstack([xy, xy + wh, score]).astype(np.float32)
+
+
+class TestBatchedNMS(unittest.TestCase):
+
+    def setUp(self):
+        rng = np.random.RandomState(0)
+        self.dets = [random_dets(rng, n) for n in [0, 1, 37, 120, 300]]
+
+    def test_soft_nms(self):
+        methods = {'hard': 0, 'linear': 1, 'gaussian': 2}
+        for method in methods:
+            for num_threads in [1, 4]:
+                results = batched_nms(self.dets, method, 0.3, sigma=0.5,
+                                      score_thresh=0.001, num_threads=num_threads)
+                for det, result in zip(self.dets, results):
+                    expected, _ = soft_nms(det, 0.5, 0.3, 0.001, methods[method])
+                    np.testing.assert_allclose(result, expected, rtol=1e-5, atol=1e-5)
+
+    def test_greedy_nms(self):
+        results = batched_nms(self.dets, 'greedy', 0.5)
+        for det, result in zip(self.dets, results):
+            np.testing.assert_array_equal(result, nms(det, 0.5))
+
+    def test_vote_nms(self):
+        results = batched_nms(self.dets, 'vote', 0.5, vote_thresh=0.8)
+        for det, result in zip(self.dets, results):
+            expected = py_weighted_nms(det, 0.5, 0.8).reshape(-1, 5)
+            np.testing.assert_allclose(result, expected, rtol=1e-5, atol=1e-3)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,128 @@
+import contextlib
+import copy
+import io
+import unittest
+
+import numpy as np
+import pycocotools.mask as mask_util
+from pycocotools.coco import COCO
+from pycocotools.cocoeval import COCOeval as PyCOCOeval
+
+from utils.coco_eval import COCOeval
+
+
+def random_polygon(rng, x, y, w, h):
+    t = np.sort(rng.uniform(0, 2 * np.pi, size=rng.randint(3, 8)))
+    px = x + w / 2 * (1 + np.cos(t))
+    py = y + h / 2 * (1 + np.sin(t))
+    return [list(np.stack([px, py], axis=1).ravel())]
+
+
+def random_dataset(rng, num_images, num_cats):
+    images = [{"id": 10 + 3 * i, "height": 120, "width": 160} for i in range(num_images)]
+    cats = [{"id": 1 + 2 * k, "name": str(k)} for k in range(num_cats)]
+    anns, ann_id = [], 0
+    for image in images:
+        for _ in range(rng.randint(0, 8)):
+            w, h = rng.uniform(2, 80, size=2)
+            x, y = rng.uniform(0, 160 - w), rng.uniform(0, 120 - h)
+            anns.append({"id": ann_id, "image_id": image["id"], "category_id": cats[rng.randint(num_cats)]["id"],
+                         "bbox": [x, y, w, h], "area": w * h, "iscrowd": int(rng.rand() < 0.1),
+                         "segmentation": random_polygon(rng, x, y, w, h)})
+            ann_id += 1
+    return {"images": images, "categories": cats, "annotations": anns}
+
+
+def random_results(rng, dataset, segm):
+    results = []
+    for image in dataset["images"]:
+        gts = [a for a in dataset["annotations"] if a["image_id"] == image["id"]]
+        for _ in range(rng.randint(0, 12)):
+            if gts and rng.rand() < 0.7:
+                gt = gts[rng.randint(len(gts))]
+                x, y, w, h = np.array(gt["bbox"]) + rng.normal(0, 4, size=4)
+                gt_polygon = np.array(gt["segmentation"][0])
+                polygon = [list(gt_polygon + rng.normal(0, 2, size=len(gt_polygon)))]
+                category_id = gt["category_id"]
+            else:
+                w, h = rng.uniform(2, 80, size=2)
+                x, y = rng.uniform(0, 160 - w), rng.uniform(0, 120 - h)
+                polygon = random_polygon(rng, x, y, w, h)
+                category_id = dataset["categories"][rng.randint(len(dataset["categories"]))]["id"]
+            w, h = max(w, 1), max(h, 1)
+            # coarse scores to have ties across images
+            result = {"image_id": image["id"], "category_id": category_id,
+                      "score": float(rng.randint(1, 20)) / 20}
+            if segm:
+                rles = mask_util.frPyObjects(polygon, image["height"], image["width"])
+                rle = mask_util.merge(rles)
+                rle["counts"] = rle["counts"].decode("ascii")
+                result["segmentation"] = rle
+            else:
+                result["bbox"] = [x, y, w, h]
+            results.append(result)
+    return results
+
+
+def make_coco(dataset):
+    with contextlib.redirect_stdout(io.StringIO()):
+        coco = COCO()
+        coco.dataset = copy.deepcopy(dataset)
+        coco.createIndex()
+    return coco
+
+
+def run(cls, dataset, results, configure, **kwargs):
+    coco = make_coco(dataset)
+    with contextlib.redirect_stdout(io.StringIO()):
+        coco_eval = cls(coco, coco.loadRes(copy.deepcopy(results)), **kwargs)
+        configure(coco_eval.params)
+        coco_eval.evaluate()
+        coco_eval.accumulate()
+        coco_eval.summarize()
+    return coco_eval
+
+
+class TestCOCOeval(unittest.TestCase):
+
+    def setUp(self):
+        self.rng = np.random.RandomState(0)
+        self.dataset = random_dataset(self.rng, 30, 4)
+
+    def assertEvalEqual(self, results, configure):
+        expected = run(PyCOCOeval, self.dataset, results, configure)
+        for num_threads in [1, 3]:
+            actual = run(COCOeval, self.dataset, results, configure, num_threads=num_threads)
+            for key in ["precision", "recall", "scores"]:
+                np.testing.assert_array_equal(actual.eval[key], expected.eval[key])
+            np.testing.assert_array_equal(actual.stats, expected.stats)
+
+    def test_bbox(self):
+        def configure(p):
+            p.iouType = "bbox"
+        self.assertEvalEqual(random_results(self.rng, self.dataset, False), configure)
+
+    def test_segm(self):
+        def configure(p):
+            p.useSegm = True
+        self.assertEvalEqual(random_results(self.rng, self.dataset, True), configure)
+
+    def test_proposal(self):
+        # the class agnostic recall of rpn_test
+        def configure(p):
+            p.iouType = "bbox"
+            p.maxDets = [10, 1, 5]
+            p.useCats = False
+        self.assertEvalEqual(random_results(self.rng, self.dataset, False), configure)
+
+    def test_subset(self):
+        # unsorted, repeated and missing ids, the gt of id 0 matches as nothing
+        def configure(p):
+            p.iouType = "bbox"
+            p.imgIds = [self.dataset["images"][i]["id"] for i in [7, 3, 3, 12]] + [1]
+            p.catIds = [5, 1, 5]
+        self.assertEvalEqual(random_results(self.rng, self.dataset, False), configure)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,123 @@
+import os
+import shutil
+import tempfile
+import unittest
+
+import numpy as np
+
+from utils.columnar_roidb import ColumnarRoidb, write_columnar_roidb
+
+
+def random_roidb(rng, num_record, with_poly=True):
+    roidb = []
+    for i in range(num_record):
+        num_gt = rng.randint(0, 5)
+        rec = {
+            "image_url": "data/coco/images/train2017/%012d.jpg" % i,
+            "im_id": int(rng.randint(1 << 40)),
+            "h": int(rng.randint(100, 1000)),
+            "w": int(rng.randint(100, 1000)),
+            "gt_class": rng.randint(1, 81, size=num_gt).astype(np.int32),
+            "gt_bbox": rng.uniform(0, 500, size=(num_gt, 4)).astype(np.float32),
+            "flipped": False
+        }
+        if with_poly:
+            rec["gt_poly"] = [None if rng.randint(4) == 0 else
+                              [list(rng.uniform(0, 500, size=2 * rng.randint(3, 8)))
+                               for _ in range(rng.randint(0, 3))]
+                              for _ in range(num_gt)]
+        roidb.append(rec)
+    return roidb
+
+
+class TestColumnarRoidb(unittest.TestCase):
+
+    def setUp(self):
+        self.rng = np.random.RandomState(0)
+        self.tmpdir = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    def roundtrip(self, roidb):
+        path = os.path.join(self.tmpdir, "test.roidbc")
+        write_columnar_roidb(roidb, path)
+        return ColumnarRoidb.open(path)
+
+    def assertRecordEqual(self, actual, expected):
+        self.assertEqual(sorted(actual.keys()), sorted(expected.keys()))
+        for k, v in expected.items():
+            if isinstance(v, np.ndarray):
+                self.assertEqual(actual[k].dtype, v.dtype)
+                np.testing.assert_array_equal(actual[k], v)
+            elif k == "gt_poly":
+                self.assertEqual(len(actual[k]), len(v))
+                for a, e in zip(actual[k], v):
+                    if e is None:
+                        self.assertIsNone(a)
+                    else:
+                        self.assertEqual([list(segm) for segm in a], e)
+            else:
+                self.assertEqual(type(actual[k]), type(v))
+                self.assertEqual(actual[k], v)
+
+    def test_roundtrip(self):
+        roidb = random_roidb(self.rng, 50)
+        columnar = self.roundtrip(roidb)
+        self.assertEqual(len(columnar), len(roidb))
+        self.assertNotIn("extra.data", columnar.files[0].columns)
+        for actual, expected in zip(columnar, roidb):
+            self.assertRecordEqual(actual, expected)
+            self.assertFalse(actual["gt_bbox"].flags.writeable)
+
+    def test_extra(self):
+        roidb = random_roidb(self.rng, 20, with_poly=False)
+        # fields of an unexpected type or only in some records are pickled
+        roidb[3]["gt_bbox"] = roidb[3]["gt_bbox"].astype(np.float64)
+        roidb[5]["resize_long"] = 1333
+        roidb[7]["im_id"] = "7"
+        columnar = self.roundtrip(roidb)
+        self.assertNotIn("gt_bbox", columnar.files[0].columns)
+        self.assertIn("h", columnar.files[0].columns)
+        for actual, expected in zip(columnar, roidb):
+            self.assertRecordEqual(actual, expected)
+        np.testing.assert_array_equal(columnar.num_gt, [len(r["gt_bbox"]) for r in roidb])
+
+    def test_sequence(self):
+        roidb = random_roidb(self.rng, 30)
+        other = random_roidb(self.rng, 10)
+        columnar = self.roundtrip(roidb)
+        write_columnar_roidb(other, os.path.join(self.tmpdir, "other.roidbc"))
+        columnar = columnar + ColumnarRoidb.open(os.path.join(self.tmpdir, "other.roidbc"))
+        roidb = roidb + other
+
+        # the filter and flip of detection_train
+        nonempty = columnar[np.where(columnar.num_gt > 0)[0]]
+        nonempty = nonempty + nonempty.flip()
+        expected = [rec for rec in roidb if len(rec["gt_bbox"]) > 0]
+        expected = expected + [dict(rec, flipped=True) for rec in expected]
+        self.assertEqual(len(nonempty), len(expected))
+        for actual, e in zip(nonempty, expected):
+            self.assertRecordEqual(actual, e)
+
+        np.testing.assert_array_equal(nonempty.h, [rec["h"] for rec in expected])
+        np.testing.assert_array_equal(nonempty.w, [rec["w"] for rec in expected])
+        self.assertRecordEqual(nonempty[-1], expected[-1])
+        self.assertRecordEqual(nonempty[-5:][1:2][0], expected[-4])
+        self.assertEqual(len(nonempty[-0:][3:4]), 1)
+
+    def test_malformed(self):
+        path = os.path.join(self.tmpdir, "test.roidbc")
+        write_columnar_roidb(random_roidb(self.rng, 5), path)
+        with open(path, "rb") as fin:
+            data = fin.read()
+        with open(path, "wb") as fout:
+            fout.write(data[:-8])
+        with self.assertRaises(IOError):
+            ColumnarRoidb.open(path)
+        with self.assertRaises(IOError):
+            ColumnarRoidb.open(os.path.join(self.tmpdir, "missing.roidbc"))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,46 @@
+import unittest
+import numpy as np
+import mxnet as mx
+
+
+def np_group_norm(x, gamma, beta, num_group, eps):
+    n, c, h, w = x.shape
+    xg = x.reshape(n, num_group, -1).astype(np.float64)
+    mean = xg.mean(axis=2, keepdims=True)
+    var = xg.var(axis=2, keepdims=True)
+    y = ((xg - mean) / np.sqrt(var + eps)).reshape(n, c, h, w)
+    return y * gamma.reshape(1, c, 1, 1) + beta.reshape(1, c, 1, 1)
+
+
+class TestGroupNorm(unittest.TestCase):
+
+    def setUp(self):
+        self.rng = np.random.RandomState(0)
+        # (shape, num_group), including a group of one channel and a 1x1 map
+        self.cases = [((2, 8, 5, 7), 4), ((1, 6, 1, 1), 3), ((3, 4, 9, 2), 4), ((2, 64, 6, 6), 32)]
+
+    def test_forward(self):
+        for shape, num_group in self.cases:
+            x = (self.rng.randn(*shape) * 3 + 10).astype(np.float32)
+            gamma = self.rng.randn(shape[1]).astype(np.float32)
+            beta = self.rng.randn(shape[1]).astype(np.float32)
+            y = mx.nd.contrib.GroupNorm(mx.nd.array(x), mx.nd.array(gamma), mx.nd.array(beta),
+                                        num_group=num_group, eps=1e-5)
+            expected = np_group_norm(x, gamma, beta, num_group, 1e-5)
+            np.testing.assert_allclose(y.asnumpy(), expected, rtol=1e-4, atol=1e-4)
+
+    def test_backward(self):
+        for shape, num_group in self.cases:
+            data = mx.sym.var("data")
+            gamma = mx.sym.var("gamma")
+            beta = mx.sym.var("beta")
+            sym = mx.sym.contrib.GroupNorm(data, gamma, beta, num_group=num_group, eps=1e-5)
+            location = [self.rng.randn(*shape),
+                        self.rng.randn(shape[1]),
+                        self.rng.randn(shape[1])]
+            mx.test_utils.check_numeric_gradient(sym, location, numeric_eps=1e-3,
+                                                 rtol=1e-2, atol=1e-3, ctx=mx.cpu())
+
+
+if __name__ == '__main__':
+    unittest.main()
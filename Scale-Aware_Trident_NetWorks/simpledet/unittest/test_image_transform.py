@@ -0,0 +1,114 @@
+import os
+import shutil
+import tempfile
+import unittest
+
+import cv2
+import numpy as np
+
+from core.detection_input import ReadRoiRecord, Norm2DImage, Resize2DImageBbox, \
+    Flip2DImageBbox, Pad2DImageBbox, ConvertImageFromHwcToChw, RenameRecord, \
+    Fused2DImageBbox, Loader
+
+
+class NormParam:
+    mean = (122.7717, 115.9465, 102.9801)
+    std = (58.4, 57.1, 57.4)
+
+
+class ResizeParam:
+    short = 200
+    long = 333
+
+
+class PadParam:
+    short = 200
+    long = 333
+    max_num_gt = 10
+
+
+class TestImageTransform(unittest.TestCase):
+
+    def setUp(self):
+        self.rng = np.random.RandomState(0)
+        self.tmpdir = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    def random_record(self, index, portrait=False):
+        h, w = self.rng.randint(20, 700, size=2)
+        if portrait:
+            h, w = max(h, w), min(h, w)
+        image = self.rng.randint(0, 256, size=(h, w, 3)).astype(np.uint8)
+        # a lossless format, both paths decode the same pixels
+        image_url = os.path.join(self.tmpdir, "%d.png" % index)
+        cv2.imwrite(image_url, image)
+        num_gt = self.rng.randint(1, 5)
+        x1 = self.rng.uniform(0, w - 10, size=num_gt)
+        y1 = self.rng.uniform(0, h - 10, size=num_gt)
+        gt_bbox = np.stack([x1, y1, x1 + 9, y1 + 9], axis=1).astype(np.float32)
+        return {"image_url": image_url, "gt_bbox": gt_bbox,
+                "gt_class": self.rng.randint(1, 81, size=num_gt).astype(np.float32),
+                "flipped": bool(self.rng.randint(2)), "h": h, "w": w}
+
+    def transforms(self, flip, pad):
+        transform = [ReadRoiRecord(None), Norm2DImage(NormParam), Resize2DImageBbox(ResizeParam)]
+        if flip:
+            transform.append(Flip2DImageBbox())
+        if pad:
+            transform.append(Pad2DImageBbox(PadParam))
+        transform.append(ConvertImageFromHwcToChw())
+        return transform
+
+    def test_fuse(self):
+        transform = self.transforms(flip=True, pad=True) + [RenameRecord({"image": "data"})]
+        fused = Fused2DImageBbox.fuse(transform)
+        self.assertEqual(len(fused), 2)
+        self.assertIsInstance(fused[0], Fused2DImageBbox)
+        self.assertIs(fused[1], transform[-1])
+        # a subclass or a transform in between is left alone
+        class MyResize(Resize2DImageBbox):
+            pass
+        transform[2] = MyResize(ResizeParam)
+        self.assertIs(Fused2DImageBbox.fuse(transform), transform)
+        transform = self.transforms(flip=True, pad=True)[:-1]
+        self.assertIs(Fused2DImageBbox.fuse(transform), transform)
+
+    def test_apply(self):
+        for flip in [False, True]:
+            for pad in [False, True]:
+                for i in range(8):
+                    record = self.random_record(i)
+                    expected = dict(record)
+                    for trans in self.transforms(flip, pad):
+                        trans.apply(expected)
+                    fused = Fused2DImageBbox.fuse(self.transforms(flip, pad))
+                    self.assertEqual(len(fused), 1)
+                    actual = dict(record)
+                    fused[0].apply(actual)
+
+                    image = actual["image"]
+                    self.assertEqual(image.shape, expected["image"].shape)
+                    np.testing.assert_allclose(np.asarray(image), expected["image"],
+                                               rtol=0, atol=1e-4)
+                    np.testing.assert_array_equal(actual["im_info"], expected["im_info"])
+                    np.testing.assert_array_equal(actual["gt_bbox"], expected["gt_bbox"])
+
+    def test_stack(self):
+        transform = Fused2DImageBbox.fuse(self.transforms(flip=True, pad=True))
+        records = []
+        for i in range(4):
+            # padded to the same shape
+            record = self.random_record(i, portrait=True)
+            transform[0].apply(record)
+            records.append(record)
+        batch = Loader.stack([r["image"] for r in records])
+        self.assertEqual(batch.dtype, np.float32)
+        self.assertTrue(batch.flags["C_CONTIGUOUS"])
+        for image, record in zip(batch, records):
+            np.testing.assert_array_equal(image, np.asarray(record["image"]))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,172 @@
+"""
+COCOeval of pycocotools with evaluate and accumulate in C++.
+
+The per image evaluation and the accumulation of the bbox and segm iou types
+run on operator_py/cython/coco_eval over every (category, image) group at
+once, with the numerics of pycocotools, so summarize and the stats are the
+same. Keypoints are left to pycocotools.
+"""
+
+import copy
+import datetime
+import time
+
+import numpy as np
+from pycocotools.cocoeval import COCOeval as _COCOeval
+
+from operator_py.cython.coco_eval import evaluate_images, accumulate_images
+
+
+def _offsets(lengths):
+    offsets = np.zeros(len(lengths) + 1, dtype=np.int64)
+    np.cumsum(lengths, out=offsets[1:])
+    return offsets
+
+
+def _counts(segm):
+    counts = segm["counts"]
+    return counts.encode("ascii") if isinstance(counts, str) else bytes(counts)
+
+
+class COCOeval(_COCOeval):
+    """
+    drop-in COCOeval, evalImgs holds the packed per image evaluation instead
+    of a list of dict
+    """
+
+    def __init__(self, cocoGt=None, cocoDt=None, iouType="segm", num_threads=0):
+        super(COCOeval, self).__init__(cocoGt, cocoDt, iouType)
+        self.num_threads = num_threads
+        self._native = False
+
+    def _pack(self, anns_by_key, num_groups, is_gt):
+        # the anns of every group in the order evaluateImg sees them
+        p = self.params
+        img_index = {img_id: i for i, img_id in enumerate(p.imgIds)}
+        cat_index = {}
+        for k, cat_id in enumerate(p.catIds):
+            cat_index.setdefault(cat_id, k)
+        num_images = len(p.imgIds)
+
+        anns, keys = [], []
+        for (img_id, cat_id), key_anns in anns_by_key.items():
+            if img_id not in img_index or cat_id not in cat_index or not key_anns:
+                continue
+            i, k = img_index[img_id], cat_index[cat_id]
+            if p.useCats:
+                key = k * num_images + i
+            else:
+                # the anns of an image are concatenated in order of p.catIds
+                key = i * len(p.catIds) + k
+            anns.extend(key_anns)
+            keys.append(np.full(len(key_anns), key, dtype=np.int64))
+        keys = np.concatenate(keys + [np.zeros(0, dtype=np.int64)])
+        order = np.argsort(keys, kind="mergesort")
+        anns = [anns[j] for j in order]
+        group = keys[order] if p.useCats else keys[order] // max(len(p.catIds), 1)
+
+        packed = {
+            "offset": _offsets(np.bincount(group, minlength=num_groups)),
+            "bbox": np.array([a["bbox"] for a in anns], dtype=np.float64).reshape(-1, 4),
+            "area": np.array([a["area"] for a in anns], dtype=np.float64),
+            "id": np.array([a["id"] for a in anns], dtype=np.int64)
+        }
+        if is_gt:
+            packed["iscrowd"] = np.array([int(a["iscrowd"]) for a in anns], dtype=np.uint8)
+            packed["ignore"] = np.array([1 if a["ignore"] else 0 for a in anns], dtype=np.uint8)
+        else:
+            packed["score"] = np.array([a["score"] for a in anns], dtype=np.float64)
+        if p.iouType == "segm":
+            counts = [_counts(a["segmentation"]) for a in anns]
+            packed["rle_offset"] = _offsets([len(c) for c in counts])
+            packed["rle_counts"] = np.frombuffer(b"".join(counts) + b"\0", dtype=np.uint8)
+            packed["rle_size"] = np.array([a["segmentation"]["size"] for a in anns],
+                                          dtype=np.int32).reshape(-1, 2)
+        return packed
+
+    def evaluate(self):
+        """
+        run per image evaluation on given images and store the packed results in self.evalImgs
+        """
+        p = self.params
+        if p.useSegm is None and p.iouType == "keypoints":
+            self._native = False
+            return super(COCOeval, self).evaluate()
+
+        tic = time.time()
+        print('Running per image evaluation...')
+        if not p.useSegm is None:
+            p.iouType = 'segm' if p.useSegm == 1 else 'bbox'
+            print('useSegm (deprecated) is not None. Running {} evaluation'.format(p.iouType))
+        print('Evaluate annotation type *{}*'.format(p.iouType))
+        p.imgIds = list(np.unique(p.imgIds))
+        if p.useCats:
+            p.catIds = list(np.unique(p.catIds))
+        p.maxDets = sorted(p.maxDets)
+        self.params = p
+
+        self._prepare()
+        num_images = len(p.imgIds)
+        num_groups = (len(p.catIds) if p.useCats else 1) * num_images
+        gt = self._pack(self._gts, num_groups, True)
+        dt = self._pack(self._dts, num_groups, False)
+        evaluated = evaluate_images(gt, dt, num_groups, p.iouThrs, p.areaRng, p.maxDets[-1],
+                                    segm=p.iouType == "segm", num_threads=self.num_threads)
+        evaluated["gt_offset"] = gt["offset"]
+        evaluated["dt_offset"] = dt["offset"]
+        self.evalImgs = evaluated
+        self._native = True
+        self._paramsEval = copy.deepcopy(self.params)
+        toc = time.time()
+        print('DONE (t={:0.2f}s).'.format(toc-tic))
+
+    def accumulate(self, p=None):
+        """
+        accumulate per image evaluation results and store the result in self.eval
+        :param p: input params for evaluation
+        """
+        if not self._native:
+            return super(COCOeval, self).accumulate(p)
+
+        print('Accumulating evaluation results...')
+        tic = time.time()
+        if p is None:
+            p = self.params
+        p.catIds = p.catIds if p.useCats == 1 else [-1]
+        T = len(p.iouThrs)
+        R = len(p.recThrs)
+        K = len(p.catIds) if p.useCats else 1
+        A = len(p.areaRng)
+        M = len(p.maxDets)
+        precision = -np.ones((T, R, K, A, M))  # -1 for the precision of absent categories
+        recall = -np.ones((T, K, A, M))
+        scores = -np.ones((T, R, K, A, M))
+
+        _pe = self._paramsEval
+        setK = set(_pe.catIds if _pe.useCats else [-1])
+        setA = set(map(tuple, _pe.areaRng))
+        setM = set(_pe.maxDets)
+        setI = set(_pe.imgIds)
+        k_list = [n for n, k in enumerate(p.catIds) if k in setK]
+        m_list = [m for n, m in enumerate(p.maxDets) if m in setM]
+        a_list = [n for n, a in enumerate(map(lambda x: tuple(x), p.areaRng)) if a in setA]
+        i_list = [n for n, i in enumerate(p.imgIds) if i in setI]
+
+        e = self.evalImgs
+        q, rc, ss = accumulate_images(e["gt_offset"], e["dt_offset"], e, len(_pe.imgIds), p.recThrs,
+                                      k_list, a_list, i_list, m_list, num_threads=self.num_threads)
+        # as COCOeval, the k-th evaluated category goes to the k-th category
+        nt = min(T, q.shape[0])
+        precision[:nt, :, :len(k_list), :len(a_list), :len(m_list)] = q[:nt]
+        recall[:nt, :len(k_list), :len(a_list), :len(m_list)] = rc[:nt]
+        scores[:nt, :, :len(k_list), :len(a_list), :len(m_list)] = ss[:nt]
+        self.eval = {
+            'params': p,
+            'counts': [T, R, K, A, M],
+            'date': datetime.datetime.now().strftime('%Y-%m-%d %H:%M:%S'),
+            'precision': precision,
+            'recall': recall,
+            'scores': scores,
+        }
+        toc = time.time()
+        print('DONE (t={:0.2f}s).'.format(toc-tic))
@@ -0,0 +1,247 @@
+"""
+Columnar roidb, a memory-mapped alternative to the pickled list of roidb records.
+
+Every field is one column over all the records, so opening a roidb only maps the
+file and the processes of a node share its page cache. The columns are
+
+    image_url.offset, image_url.data    utf-8 bytes of the image urls of all records
+    im_id, h, w, flipped                one value per record
+    gt.offset                           range of the gt of every record in the gt columns
+    gt_bbox, gt_class                   one row per gt
+    gt_poly.instance, gt_poly.none      range of the polygons of every gt, and whether its gt_poly is None
+    gt_poly.offset, gt_poly.data        float64 coordinates of all the polygons
+    extra.offset, extra.data            pickled dict of the other fields of every record
+
+A field goes to a column only if every record holds it with the expected type,
+otherwise it is pickled with the extra fields, so the conversion is lossless.
+
+Convert the pickled roidbs with
+    python3 -m utils.columnar_roidb --roidb data/cache/coco_train2017.roidb
+"""
+
+import argparse
+import os
+import pickle as pkl
+from collections import OrderedDict
+
+import numpy as np
+
+from operator_py.cython.columnar_roidb import RoidbFile
+
+
+MAGIC = b"SDROIDB1"
+ALIGN = 64
+# RoidbColumn of operator_py/cython/columnar_roidb.hpp
+COLUMN = np.dtype([("name", "S48"), ("dtype", "S8"), ("ndim", "<u8"), ("shape", "<u8", (2, )),
+                   ("offset", "<u8"), ("nbytes", "<u8")])
+
+
+def _offsets(lengths):
+    offsets = np.zeros(len(lengths) + 1, dtype=np.int64)
+    np.cumsum(lengths, out=offsets[1:])
+    return offsets
+
+
+def _is_int(value):
+    return isinstance(value, (int, np.integer)) and not isinstance(value, (bool, np.bool_))
+
+
+def _is_polygons(gt_poly, num_gt):
+    if not isinstance(gt_poly, list) or len(gt_poly) != num_gt:
+        return False
+    for ins_poly in gt_poly:
+        if ins_poly is None:
+            continue
+        if not isinstance(ins_poly, list):
+            return False
+        for segm in ins_poly:
+            if not isinstance(segm, (list, np.ndarray)) or np.ndim(segm) != 1:
+                return False
+    return True
+
+
+def _columnize(roidb):
+    columns = OrderedDict()
+    stored = set()
+
+    if all(isinstance(rec.get("image_url"), str) for rec in roidb):
+        urls = [rec["image_url"].encode("utf-8") for rec in roidb]
+        columns["image_url.offset"] = _offsets([len(url) for url in urls])
+        columns["image_url.data"] = np.frombuffer(b"".join(urls), dtype=np.uint8)
+        stored.add("image_url")
+
+    for key in ("im_id", "h", "w"):
+        if all(_is_int(rec.get(key)) for rec in roidb):
+            columns[key] = np.array([rec[key] for rec in roidb], dtype=np.int64)
+            stored.add(key)
+
+    if all(isinstance(rec.get("flipped"), (bool, np.bool_)) for rec in roidb):
+        columns["flipped"] = np.array([rec["flipped"] for rec in roidb], dtype=np.uint8)
+        stored.add("flipped")
+
+    gt_bbox = [rec.get("gt_bbox") for rec in roidb]
+    gt_class = [rec.get("gt_class") for rec in roidb]
+    if len(roidb) > 0 and \
+            all(isinstance(b, np.ndarray) and b.ndim == 2 and b.shape[1] == 4 and b.dtype == gt_bbox[0].dtype
+                for b in gt_bbox) and \
+            all(isinstance(c, np.ndarray) and c.ndim == 1 and c.dtype == gt_class[0].dtype and len(c) == len(b)
+                for b, c in zip(gt_bbox, gt_class)):
+        columns["gt.offset"] = _offsets([len(b) for b in gt_bbox])
+        columns["gt_bbox"] = np.concatenate(gt_bbox).reshape(-1, 4)
+        columns["gt_class"] = np.concatenate(gt_class)
+        stored.update(["gt_bbox", "gt_class"])
+
+        if all(_is_polygons(rec.get("gt_poly"), len(rec["gt_bbox"])) for rec in roidb):
+            ins_polys = [ins_poly for rec in roidb for ins_poly in rec["gt_poly"]]
+            segms = [segm for ins_poly in ins_polys if ins_poly is not None for segm in ins_poly]
+            columns["gt_poly.instance"] = _offsets([len(p) if p is not None else 0 for p in ins_polys])
+            columns["gt_poly.none"] = np.array([p is None for p in ins_polys], dtype=np.uint8)
+            columns["gt_poly.offset"] = _offsets([len(segm) for segm in segms])
+            columns["gt_poly.data"] = np.concatenate(
+                [np.asarray(segm, dtype=np.float64) for segm in segms] + [np.zeros(0)])
+            stored.add("gt_poly")
+
+    extras = [{k: v for k, v in rec.items() if k not in stored} for rec in roidb]
+    if any(extras):
+        extras = [pkl.dumps(extra, protocol=pkl.HIGHEST_PROTOCOL) for extra in extras]
+        columns["extra.offset"] = _offsets([len(extra) for extra in extras])
+        columns["extra.data"] = np.frombuffer(b"".join(extras), dtype=np.uint8)
+
+    return columns
+
+
+def write_columnar_roidb(roidb, path):
+    """
+    write a list of roidb records as a columnar roidb
+    :param roidb: list of dict
+    :param path: output file, replaced once it is complete
+    """
+    columns = _columnize(roidb)
+    table = np.zeros(len(columns), dtype=COLUMN)
+    offset = len(MAGIC) + 16 + table.nbytes
+    arrays = []
+    for i, (name, array) in enumerate(columns.items()):
+        array = np.ascontiguousarray(array, dtype=array.dtype.newbyteorder("<"))
+        offset = (offset + ALIGN - 1) // ALIGN * ALIGN
+        shape = list(array.shape) + [0] * (2 - array.ndim)
+        table[i] = (name.encode("utf-8"), array.dtype.str.encode("ascii"), array.ndim, shape,
+                    offset, array.nbytes)
+        arrays.append((offset, array))
+        offset += array.nbytes
+
+    tmp_path = path + ".tmp"
+    with open(tmp_path, "wb") as fout:
+        fout.write(MAGIC)
+        fout.write(np.array([len(roidb), len(columns)], dtype="<u8").tobytes())
+        fout.write(table.tobytes())
+        for offset, array in arrays:
+            fout.write(b"\0" * (offset - fout.tell()))
+            fout.write(array.tobytes())
+    os.replace(tmp_path, path)
+
+
+class ColumnarRoidb(object):
+    """
+    read-only sequence of the records of columnar roidb files. A record is built
+    on access and its arrays are views of the mapping, so a transform must not
+    modify them in place. Slicing, indexing by an array, flip and + give new
+    sequences over the same files without building any record.
+    """
+
+    def __init__(self, files, part, index, flipped):
+        self.files = files      # list of RoidbFile
+        self.part = part        # file of every record
+        self.index = index      # index of every record in its file
+        self.flipped = flipped  # flipped flag of every record
+
+    @staticmethod
+    def open(path):
+        roidb_file = RoidbFile(path)
+        n = len(roidb_file)
+        if "flipped" in roidb_file.columns:
+            flipped = roidb_file.columns["flipped"].astype(bool)
+        else:
+            flipped = np.zeros(n, dtype=bool)
+        return ColumnarRoidb([roidb_file], np.zeros(n, dtype=np.int32),
+                             np.arange(n, dtype=np.int64), flipped)
+
+    def __len__(self):
+        return len(self.index)
+
+    def __getitem__(self, item):
+        if isinstance(item, (int, np.integer)):
+            record = self.files[self.part[item]].record(self.index[item])
+            record["flipped"] = bool(self.flipped[item])
+            return record
+        return ColumnarRoidb(self.files, self.part[item], self.index[item], self.flipped[item])
+
+    def __iter__(self):
+        for i in range(len(self)):
+            yield self[i]
+
+    def __add__(self, other):
+        if isinstance(other, ColumnarRoidb):
+            return ColumnarRoidb(self.files + other.files,
+                                 np.concatenate([self.part, other.part + len(self.files)]),
+                                 np.concatenate([self.index, other.index]),
+                                 np.concatenate([self.flipped, other.flipped]))
+        return list(self) + list(other)
+
+    def __radd__(self, other):
+        return list(other) + list(self)
+
+    def flip(self):
+        """
+        the same records, flipped
+        """
+        return ColumnarRoidb(self.files, self.part, self.index, np.ones(len(self), dtype=bool))
+
+    def _gather(self, values):
+        out = np.zeros(len(self), dtype=np.int64)
+        for k, roidb_file in enumerate(self.files):
+            mask = self.part == k
+            out[mask] = values(roidb_file)[self.index[mask]]
+        return out
+
+    @property
+    def h(self):
+        return self._gather(lambda f: f.columns["h"])
+
+    @property
+    def w(self):
+        return self._gather(lambda f: f.columns["w"])
+
+    @property
+    def num_gt(self):
+        return self._gather(lambda f: f.num_gt)
+
+
+def load_roidb(image_set):
+    """
+    roidb of data/cache/<image_set>, the columnar one if it is converted and
+    not older than the pickled one
+    :return: list of dict or ColumnarRoidb
+    """
+    path = "data/cache/{}.roidb".format(image_set)
+    columnar_path = path + "c"
+    if os.path.exists(columnar_path) and \
+            (not os.path.exists(path) or os.path.getmtime(columnar_path) >= os.path.getmtime(path)):
+        return ColumnarRoidb.open(columnar_path)
+    with open(path, "rb") as fin:
+        return pkl.load(fin, encoding="latin1")
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Convert pickled roidbs to columnar roidbs')
+    parser.add_argument('--roidb', help='pickled roidb, e.g. data/cache/coco_train2017.roidb', type=str,
+                        nargs='+', required=True)
+    args = parser.parse_args()
+    return args.roidb
+
+
+if __name__ == "__main__":
+    for roidb_path in parse_args():
+        with open(roidb_path, "rb") as fin:
+            roidb = pkl.load(fin, encoding="latin1")
+        write_columnar_roidb(roidb, roidb_path + "c")
+        print("{} records of {} written to {}c".format(len(roidb), roidb_path, roidb_path))